@@ -195,6 +195,55 @@ public:
     }
 
 
+    /**
+     * read the encoded image file into bytes, without decoding it
+     * used by the prefetch pipeline, which decodes on another thread with decodeImage
+     */
+    bool readImageBytes(int id, std::vector<char> &bytes) {
+        if (!isZipped) {
+            std::ifstream f(files[id].c_str(), std::ios::binary | std::ios::ate);
+            if (!f) {
+                printf("cannot read image %s!\n", files[id].c_str());
+                return false;
+            }
+            bytes.resize(size_t(f.tellg()));
+            f.seekg(0);
+            f.read(bytes.data(), bytes.size());
+            return bool(f);
+        } else {
+#if HAS_ZIPLIB
+            zip_stat_t st;
+            zip_stat_init(&st);
+            if (zip_stat(ziparchive, files[id].c_str(), 0, &st) != 0 || !(st.valid & ZIP_STAT_SIZE))
+                return false;
+            zip_file_t *fle = zip_fopen(ziparchive, files[id].c_str(), 0);
+            if (fle == 0)
+                return false;
+            bytes.resize(st.size);
+            long readbytes = zip_fread(fle, bytes.data(), st.size);
+            zip_fclose(fle);
+            return readbytes == (long) st.size;
+#else
+            printf("ERROR: cannot read .zip archive, as compile without ziplib!\n");
+            return false;
+#endif
+        }
+    }
+
+    /// decode bytes from readImageBytes, same pixels as getImageRaw
+    MinimalImageB *decodeImage(std::vector<char> &bytes) {
+        return IOWrap::readStreamBW_8U(bytes.data(), bytes.size());
+    }
+
+    /// exposure and timestamp getImage passes to the undistorter
+    inline float getImageExposure(int id) {
+        return exposures.size() == 0 ? 1.0f : exposures[id];
+    }
+
+    inline double getImageTimestamp(int id) {
+        return timestamps.size() == 0 ? 0.0 : timestamps[id];
+    }
+
     inline float *getPhotometricGamma() {
         if (undistort == 0 || undistort->photometricUndist == 0) return 0;
         return undistort->photometricUndist->getG();
@@ -245,8 +294,8 @@ private:
         ImageAndExposure *ret2 = undistort->undistort<unsigned
         char>(
                 minimg,
-                (exposures.size() == 0 ? 1.0f : exposures[id]),
-                (timestamps.size() == 0 ? 0.0 : timestamps[id]));
+                getImageExposure(id),
+                getImageTimestamp(id));
         delete minimg;
         return ret2;
     }
@@ -0,0 +1,157 @@
+#pragma once
+#ifndef LDSO_IMAGE_PIPELINE_H_
+#define LDSO_IMAGE_PIPELINE_H_
+
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+#include "DatasetReader.h"
+
+/**
+ * Prefetches the images of an ImageFolderReader on background threads.
+ *
+ * Three stages, one thread each: read file -> decode -> undistort (photometric and geometric in one pass).
+ * Frames move through the stages in a fixed ring of buffers, so at most ringSize frames are in flight and no
+ * ImageAndExposure is allocated after construction. Every stage handles the frames in order, so the images are
+ * the same as from ImageFolderReader::getImage.
+ *
+ * Usage: img = next(), track it, then recycle(img) instead of deleting it.
+ */
+class ImagePipeline {
+public:
+    /**
+     * @param ids frames to deliver, in this order
+     * @param ringSize number of frame buffers
+     */
+    ImagePipeline(shared_ptr<ImageFolderReader> reader, const std::vector<int> &ids, int ringSize = 8) :
+            reader(reader), ids(ids) {
+        Eigen::Vector2i size = reader->undistort->getSize();
+        slots.resize(std::max(1, ringSize));
+        for (Slot &s: slots) {
+            s.out = new ImageAndExposure(size[0], size[1]);
+            queues[READ].push(&s);
+        }
+
+        for (int stage = 0; stage < NUM_STAGES; stage++)
+            threads.push_back(std::thread([this, stage] { runStage(stage); }));
+    }
+
+    ~ImagePipeline() {
+        for (Queue &q: queues)
+            q.abort();
+        for (std::thread &t: threads)
+            t.join();
+        for (Slot &s: slots) {
+            delete s.raw;
+            delete s.out;
+        }
+    }
+
+    /// next image in the order of ids, blocks until it is ready, null after the last one
+    ImageAndExposure *next() {
+        Slot *s = queues[NUM_STAGES].pop();
+        return s ? s->out : nullptr;
+    }
+
+    /// hand an image from next() back to the pipeline
+    void recycle(ImageAndExposure *img) {
+        for (Slot &s: slots)
+            if (s.out == img) {
+                queues[READ].push(&s);
+                return;
+            }
+        LOG(FATAL) << "image does not belong to this pipeline" << endl;
+    }
+
+private:
+    enum {
+        READ = 0, DECODE, UNDISTORT, NUM_STAGES
+    };
+
+    struct Slot {
+        int id = 0;
+        std::vector<char> bytes;            // encoded file
+        MinimalImageB *raw = nullptr;       // decoded image
+        ImageAndExposure *out = nullptr;    // undistorted
+    };
+
+    // slots waiting for a stage, never more than the ring
+    class Queue {
+    public:
+        void push(Slot *s) {
+            std::unique_lock<std::mutex> lock(m);
+            items.push_back(s);
+            cv.notify_one();
+        }
+
+        // null when closed and empty or when aborted
+        Slot *pop() {
+            std::unique_lock<std::mutex> lock(m);
+            cv.wait(lock, [this] { return aborted || closed || !items.empty(); });
+            if (aborted || items.empty())
+                return nullptr;
+            Slot *s = items.front();
+            items.pop_front();
+            return s;
+        }
+
+        void close() {
+            std::unique_lock<std::mutex> lock(m);
+            closed = true;
+            cv.notify_all();
+        }
+
+        void abort() {
+            std::unique_lock<std::mutex> lock(m);
+            aborted = true;
+            cv.notify_all();
+        }
+
+    private:
+        std::mutex m;
+        std::condition_variable cv;
+        std::deque<Slot *> items;
+        bool closed = false, aborted = false;
+    };
+
+    void runStage(int stage) {
+        Undistort *undistort = reader->undistort;
+        for (size_t next = 0; stage != READ || next < ids.size(); next++) {
+            Slot *s = queues[stage].pop();
+            if (s == nullptr)
+                break;
+
+            switch (stage) {
+                case READ:
+                    s->id = ids[next];
+                    if (!reader->readImageBytes(s->id, s->bytes))
+                        LOG(FATAL) << "cannot read image " << s->id << endl;
+                    break;
+                case DECODE:
+                    s->raw = reader->decodeImage(s->bytes);
+                    if (s->raw == nullptr)
+                        LOG(FATAL) << "cannot decode image " << s->id << endl;
+                    break;
+                case UNDISTORT:
+                    undistort->undistort<unsigned char>(s->raw, s->out, reader->getImageExposure(s->id),
+                                                        reader->getImageTimestamp(s->id));
+                    delete s->raw;
+                    s->raw = nullptr;
+                    break;
+            }
+            queues[stage + 1].push(s);
+        }
+        queues[stage + 1].close();
+    }
+
+    shared_ptr<ImageFolderReader> reader;
+    std::vector<int> ids;
+
+    std::vector<Slot> slots;
+    Queue queues[NUM_STAGES + 1];       // input of each stage, the last one holds the finished images
+    std::vector<std::thread> threads;
+};
+
+#endif // LDSO_IMAGE_PIPELINE_H_
@@ -0,0 +1,35 @@
+#include <cstring>
+#include <string>
+
+#include <glog/logging.h>
+
+#include "MapFile.h"
+
+/*********************************************************************************
+ * This program converts a map saved by older versions of LDSO (a plain stream of
+ * keyframes) into the chunked map file format.
+ * Usage: convert_map <old map> <new map> [compress]
+ *********************************************************************************/
+
+using namespace std;
+using namespace ldso;
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        LOG(ERROR) << "usage: " << argv[0] << " <old map> <new map> [compress]" << endl;
+        return 1;
+    }
+
+    bool compress = argc > 3 && strcmp(argv[3], "compress") == 0;
+    if (MapFile::IsMapFile(argv[1])) {
+        LOG(INFO) << argv[1] << " is already in the new format" << endl;
+        return 0;
+    }
+
+    if (!MapFile::ConvertLegacy(argv[1], argv[2], compress)) {
+        LOG(ERROR) << "failed to convert " << argv[1] << endl;
+        return 1;
+    }
+    LOG(INFO) << "converted " << argv[1] << " to " << argv[2] << endl;
+    return 0;
+}
@@ -0,0 +1,46 @@
+#include <chrono>
+#include <string>
+
+#include <glog/logging.h>
+
+#include "FlatVocabulary.h"
+
+/*********************************************************************************
+ * This program converts a DBoW3 vocabulary (.dbow3 or .yml) into a flat vocabulary
+ * file, which the examples map directly instead of parsing it at startup.
+ * Usage: convert_vocabulary <dbow3 vocabulary> <flat vocabulary>
+ *********************************************************************************/
+
+using namespace std;
+using namespace ldso;
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        LOG(ERROR) << "usage: " << argv[0] << " <dbow3 vocabulary> <flat vocabulary>" << endl;
+        return 1;
+    }
+
+    if (FlatVocabulary::IsFlatVocabulary(argv[1])) {
+        LOG(INFO) << argv[1] << " is already a flat vocabulary" << endl;
+        return 0;
+    }
+
+    ORBVocabulary voc;
+    voc.load(argv[1]);
+    FlatVocabulary flat(voc);
+    if (!flat.Valid() || !flat.Save(argv[2])) {
+        LOG(ERROR) << "failed to convert " << argv[1] << endl;
+        return 1;
+    }
+
+    // check the new file can be mapped back
+    auto start = chrono::steady_clock::now();
+    shared_ptr<ORBVocabulary> mapped = FlatVocabulary::LoadORBVocabulary(argv[2]);
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    if (!mapped || mapped->size() != voc.size()) {
+        LOG(ERROR) << "cannot map " << argv[2] << " back" << endl;
+        return 1;
+    }
+    LOG(INFO) << "converted " << argv[1] << " to " << argv[2] << ", mapped in " << ms << " ms" << endl;
+    return 0;
+}
@@ -0,0 +1,123 @@
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+/*********************************************************************************
+ * This program compares trajectories written by printResult against a ground truth,
+ * e.g. the keyframes of two builds on the same sequence:
+ *
+ *   ./bin/evaluate_ate [maxgap=0.1] gt.csv results_baseline.txt results.txt
+ *
+ * For each result it prints the number of poses (the keyframes for printResult),
+ * how many of them have a ground truth pose and the absolute trajectory error
+ * (RMSE of the positions after a Sim(3) alignment, monocular has no scale).
+ * The ground truth is either the EuRoC state_groundtruth_estimate0/data.csv
+ * (nanoseconds, comma separated) or "timestamp tx ty tz qx qy qz qw" lines.
+ * Poses between two ground truth samples at most maxgap seconds apart are
+ * interpolated, poses at the time of a sample always match.
+ *********************************************************************************/
+
+using namespace std;
+
+struct Stamped {
+    double time;
+    Eigen::Vector3d p;
+};
+
+/// positions of a trajectory file, sorted by time
+bool loadTrajectory(const string &filename, vector<Stamped> &poses) {
+    ifstream f(filename);
+    if (!f) return false;
+    string line;
+    while (getline(f, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        bool csv = line.find(',') != string::npos;
+        if (csv) replace(line.begin(), line.end(), ',', ' ');
+        istringstream in(line);
+        Stamped s;
+        if (!(in >> s.time >> s.p[0] >> s.p[1] >> s.p[2])) continue;
+        if (csv) s.time *= 1e-9;     // EuRoC stamps are in nanoseconds
+        poses.push_back(s);
+    }
+    sort(poses.begin(), poses.end(), [](const Stamped &a, const Stamped &b) { return a.time < b.time; });
+    return true;
+}
+
+/// position of the ground truth at time t, interpolated, false if t is not covered
+bool groundTruthAt(const vector<Stamped> &gt, double t, double maxGap, Eigen::Vector3d &p) {
+    const double eps = 1e-6;    // seconds, stamps written with different precision still match
+    auto it = lower_bound(gt.begin(), gt.end(), t - eps, [](const Stamped &s, double t) { return s.time < t; });
+    if (it != gt.end() && fabs(it->time - t) < eps) {
+        p = it->p;
+        return true;
+    }
+    if (it == gt.end() || it == gt.begin())
+        return false;
+    const Stamped &a = *(it - 1), &b = *it;
+    if (b.time - a.time > maxGap) return false;
+    double s = (t - a.time) / (b.time - a.time);
+    p = (1 - s) * a.p + s * b.p;
+    return true;
+}
+
+int main(int argc, char **argv) {
+
+    // seconds between ground truth samples to interpolate over, raise it for ground truth of 10 Hz or less
+    double maxGap = 0.1;
+    int first = 1;
+    if (argc > first && 1 == sscanf(argv[first], "maxgap=%lf", &maxGap))
+        first++;
+
+    if (argc < first + 2) {
+        printf("usage: %s [maxgap=seconds] groundtruth result [result ...]\n", argv[0]);
+        return 1;
+    }
+
+    vector<Stamped> gt;
+    if (!loadTrajectory(argv[first], gt) || gt.size() < 2) {
+        printf("cannot read the ground truth %s\n", argv[first]);
+        return 1;
+    }
+
+    for (int r = first + 1; r < argc; r++) {
+        vector<Stamped> poses;
+        if (!loadTrajectory(argv[r], poses)) {
+            printf("cannot read %s\n", argv[r]);
+            continue;
+        }
+
+        vector<Eigen::Vector3d> est, ref;
+        for (auto &s: poses) {
+            Eigen::Vector3d p;
+            if (groundTruthAt(gt, s.time, maxGap, p)) {
+                est.push_back(s.p);
+                ref.push_back(p);
+            }
+        }
+        if (est.size() < 3) {
+            printf("%s: %zu poses, %zu with ground truth, too few to align\n", argv[r], poses.size(), est.size());
+            continue;
+        }
+
+        Eigen::Matrix3Xd E(3, est.size()), R(3, ref.size());
+        for (size_t i = 0; i < est.size(); i++) {
+            E.col(i) = est[i];
+            R.col(i) = ref[i];
+        }
+        Eigen::Matrix4d S = Eigen::umeyama(E, R, true);
+        Eigen::Matrix3Xd aligned = (S.topLeftCorner<3, 3>() * E).colwise() + S.topRightCorner<3, 1>();
+        double rmse = sqrt((aligned - R).colwise().squaredNorm().mean());
+        double scale = S.topLeftCorner<3, 3>().col(0).norm();
+
+        printf("%s: %zu poses, %zu with ground truth, ATE rmse %.4f, scale %.4f\n", argv[r], poses.size(),
+               est.size(), rmse, scale);
+    }
+    return 0;
+}
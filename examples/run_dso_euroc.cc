@@ -9,7 +9,9 @@
 #include <glog/logging.h>
 
 #include "frontend/FullSystem.h"
+#include "FlatVocabulary.h"
 #include "DatasetReader.h"
+#include "ImagePipeline.h"
 
 using namespace std;
 using namespace ldso;
@@ -36,7 +38,7 @@ int endIdx = 100000;
 double rescale = 1;
 bool reversePlay = false;
 bool disableROS = false;
-bool prefetch = false;
+int prefetch = 0;          // > 0: decode and undistort ahead on background threads, in this many buffers
 float playbackSpeed = 0;    // 0 for linearize (play as fast as possible, while sequentializing tracking & mapping). otherwise, factor on timestamps.
 bool preload = false;
 bool useSampleOutput = false;
@@ -167,10 +169,20 @@ void parseArgument(char *arg) {
         }
         return;
     }
+    if (1 == sscanf(arg, "threads=%d", &option)) {
+        setting_numThreads = option;
+        printf("using %d worker threads (0 = all cores)\n", option);
+        return;
+    }
+    if (1 == sscanf(arg, "affinity=%d", &option)) {
+        setting_threadAffinity = option;
+        printf("pin threads starting from core %d\n", option);
+        return;
+    }
     if (1 == sscanf(arg, "prefetch=%d", &option)) {
-        if (option == 1) {
-            prefetch = true;
-            printf("PREFETCH!\n");
+        if (option > 0) {
+            prefetch = option;
+            printf("PREFETCH %d FRAMES!\n", prefetch);
         }
         return;
     }
@@ -285,8 +297,12 @@ int main(int argc, char **argv) {
         linc = -1;
     }
 
-    shared_ptr<ORBVocabulary> voc(new ORBVocabulary());
-    voc->load(vocPath);
+    // a flat vocabulary (see convert_vocabulary) is mapped instead of parsed
+    shared_ptr<ORBVocabulary> voc = FlatVocabulary::LoadORBVocabulary(vocPath);
+    if (!voc) {
+        LOG(ERROR) << "cannot load the vocabulary " << vocPath << endl;
+        exit(-1);
+    }
 
     shared_ptr<FullSystem> fullSystem(new FullSystem(voc));
     fullSystem->setGammaFunction(reader->getPhotometricGamma());
@@ -325,6 +341,10 @@ int main(int argc, char **argv) {
             }
         }
 
+        std::unique_ptr<ImagePipeline> pipeline;
+        if (!preload && prefetch > 0)
+            pipeline.reset(new ImagePipeline(reader, idsToPlay, prefetch));
+
         struct timeval tv_start;
         gettimeofday(&tv_start, NULL);
         clock_t started = clock();
@@ -348,6 +368,8 @@ int main(int argc, char **argv) {
             ImageAndExposure *img;
             if (preload)
                 img = preloadedImages[ii];
+            else if (pipeline)
+                img = pipeline->next();
             else
                 img = reader->getImage(i);
 
@@ -368,7 +390,10 @@ int main(int argc, char **argv) {
                 }
             }
             if (!skipFrame) fullSystem->addActiveFrame(img, i);
-            delete img;
+            if (pipeline)
+                pipeline->recycle(img);
+            else
+                delete img;
 
             if (fullSystem->initFailed || setting_fullResetRequested) {
                 if (ii < 250 || setting_fullResetRequested) {
@@ -401,6 +426,8 @@ int main(int argc, char **argv) {
         // for evaluation, we print the result before loop closing and after loop closing
         fullSystem->printResult(output_file, true);
         fullSystem->printResult(output_file + ".noloop", false);
+        // every tracked frame, the non-keyframes from the compact trajectory log
+        fullSystem->printTrajectory(output_file + ".all", true);
 
         int numFramesProcessed = abs(idsToPlay[0] - idsToPlay.back());
         double numSecondsProcessed = fabs(reader->getTimestamp(idsToPlay[0]) - reader->getTimestamp(idsToPlay.back()));
@@ -0,0 +1,148 @@
+#include <clocale>
+#include <cstdlib>
+#include <cstdio>
+
+#include <glog/logging.h>
+
+#include "frontend/SessionServer.h"
+#include "FlatVocabulary.h"
+#include "DatasetReader.h"
+
+/*********************************************************************************
+ * This program runs several TUM-Mono sequences at the same time in one process,
+ * one session per sequence, all sharing the vocabulary and one worker pool.
+ * Give each sequence as files<i>= calib<i>= gamma<i>= vignette<i>= with i = 0, 1, ...
+ * Results are written to results_<i>.txt
+ *********************************************************************************/
+
+using namespace std;
+using namespace ldso;
+
+const int maxSessions = 8;
+
+std::string source[maxSessions], calib[maxSessions], gammaCalib[maxSessions], vignette[maxSessions];
+std::string vocPath = "./vocab/orbvoc.dbow3";
+std::string output_prefix = "./results";
+
+int numThreads = 0;
+int firstCore = -1;
+int maxQueue = 8;
+int endIdx = 100000;
+
+void parseArgument(char *arg) {
+    int option;
+    char buf[1000];
+
+    if (1 == sscanf(arg, "threads=%d", &option)) {
+        numThreads = option;
+        printf("using %d worker threads (0 = all cores)\n", option);
+        return;
+    }
+    if (1 == sscanf(arg, "affinity=%d", &option)) {
+        firstCore = option;
+        printf("pin workers starting from core %d\n", option);
+        return;
+    }
+    if (1 == sscanf(arg, "queue=%d", &option)) {
+        maxQueue = option;
+        printf("at most %d frames waiting per session\n", option);
+        return;
+    }
+    if (1 == sscanf(arg, "end=%d", &option)) {
+        endIdx = option;
+        printf("END AT %d!\n", endIdx);
+        return;
+    }
+    if (1 == sscanf(arg, "vocab=%s", buf)) {
+        vocPath = buf;
+        printf("loading vocabulary from %s!\n", vocPath.c_str());
+        return;
+    }
+    if (1 == sscanf(arg, "output=%s", buf)) {
+        output_prefix = buf;
+        printf("output prefix %s!\n", output_prefix.c_str());
+        return;
+    }
+
+    // per sequence options
+    const char *keys[] = {"files", "calib", "gamma", "vignette"};
+    std::string *values[] = {source, calib, gammaCalib, vignette};
+    for (int k = 0; k < 4; k++) {
+        int n = 0;
+        std::string format = std::string(keys[k]) + "%d=%s";
+        if (2 == sscanf(arg, format.c_str(), &n, buf) && n >= 0 && n < maxSessions) {
+            values[k][n] = buf;
+            printf("sequence %d: %s %s\n", n, keys[k], buf);
+            return;
+        }
+    }
+
+    printf("could not parse argument \"%s\"!!!!\n", arg);
+}
+
+int main(int argc, char **argv) {
+
+    FLAGS_colorlogtostderr = true;
+    disableAllDisplay = true;
+    for (int i = 1; i < argc; i++)
+        parseArgument(argv[i]);
+
+    vector<shared_ptr<ImageFolderReader>> readers;
+    for (int i = 0; i < maxSessions && !source[i].empty(); i++)
+        readers.push_back(shared_ptr<ImageFolderReader>(
+                new ImageFolderReader(ImageFolderReader::TUM_MONO, source[i], calib[i], gammaCalib[i], vignette[i])));
+    if (readers.size() < 2) {
+        LOG(ERROR) << "give at least two sequences, files0= ... files1= ..." << endl;
+        exit(-1);
+    }
+
+    shared_ptr<ORBVocabulary> voc = FlatVocabulary::LoadORBVocabulary(vocPath);
+    if (!voc) {
+        LOG(ERROR) << "cannot load the vocabulary " << vocPath << endl;
+        exit(-1);
+    }
+
+    SessionServer server(voc, numThreads, firstCore);
+    vector<int> sessions;
+    for (auto &reader: readers) {
+        if (setting_photometricCalibration > 0 && reader->getPhotometricGamma() == 0) {
+            LOG(ERROR) << "ERROR: dont't have photometric calibation for every sequence" << endl;
+            exit(1);
+        }
+        Eigen::Matrix3f K;
+        int w, h;
+        reader->getCalibMono(K, w, h);
+        shared_ptr<CalibContext> context(new CalibContext(w, h, K));
+        sessions.push_back(server.AddSession(context, reader->getPhotometricGamma(), 0, maxQueue));
+    }
+
+    // feed the sequences frame by frame in turn, like cameras delivering at the same rate
+    int numFrames = 0;
+    for (auto &reader: readers)
+        numFrames = max(numFrames, min(reader->getNumImages(), endIdx));
+    for (int i = 0; i < numFrames; i++) {
+        for (size_t s = 0; s < readers.size(); s++) {
+            if (i >= readers[s]->getNumImages())
+                continue;
+            // wait for room in a full queue instead of dropping, to track every frame of the sequences
+            server.AddFrame(sessions[s], readers[s]->getImage(i), i, true);
+        }
+    }
+
+    server.Finish();
+
+    for (size_t s = 0; s < readers.size(); s++) {
+        string output_file = output_prefix + "_" + to_string(s) + ".txt";
+        shared_ptr<FullSystem> system = server.GetSystem(sessions[s]);
+        system->printResult(output_file, true);
+        system->printResult(output_file + ".noloop", false);
+        system->printTrajectory(output_file + ".all", true);
+
+        SessionServer::SessionStats st = server.GetStats(sessions[s]);
+        printf("sequence %zu: %lu frames tracked, %lu dropped, latency %.2fms mean %.2fms max, %.1f fps\n",
+               s, st.framesTracked, st.framesDropped, 1000 * st.meanLatency, 1000 * st.maxLatency, st.throughput);
+    }
+
+    LOG(INFO) << "EXIT NOW!";
+    return 0;
+}
@@ -9,7 +9,9 @@
 #include <glog/logging.h>
 
 #include "frontend/FullSystem.h"
+#include "FlatVocabulary.h"
 #include "DatasetReader.h"
+#include "ImagePipeline.h"
 
 /*********************************************************************************
  * This program demonstrates how to run LDSO in TUM-Mono dataset
@@ -32,7 +34,7 @@ bool reversePlay = false;
 bool disableROS = false;
 int startIdx = 0;
 int endIdx = 100000;
-bool prefetch = false;
+int prefetch = 0;          // > 0: decode and undistort ahead on background threads, in this many buffers
 float playbackSpeed = 0;    // 0 for linearize (play as fast as possible, while sequentializing tracking & mapping). otherwise, factor on timestamps.
 bool preload = false;
 bool useSampleOutput = false;
@@ -162,10 +164,20 @@ void parseArgument(char *arg) {
         }
         return;
     }
+    if (1 == sscanf(arg, "threads=%d", &option)) {
+        setting_numThreads = option;
+        printf("using %d worker threads (0 = all cores)\n", option);
+        return;
+    }
+    if (1 == sscanf(arg, "affinity=%d", &option)) {
+        setting_threadAffinity = option;
+        printf("pin threads starting from core %d\n", option);
+        return;
+    }
     if (1 == sscanf(arg, "prefetch=%d", &option)) {
-        if (option == 1) {
-            prefetch = true;
-            printf("PREFETCH!\n");
+        if (option > 0) {
+            prefetch = option;
+            printf("PREFETCH %d FRAMES!\n", prefetch);
         }
         return;
     }
@@ -315,8 +327,12 @@ int main(int argc, char **argv) {
         linc = -1;
     }
 
-    shared_ptr<ORBVocabulary> voc(new ORBVocabulary());
-    voc->load(vocPath);
+    // a flat vocabulary (see convert_vocabulary) is mapped instead of parsed
+    shared_ptr<ORBVocabulary> voc = FlatVocabulary::LoadORBVocabulary(vocPath);
+    if (!voc) {
+        LOG(ERROR) << "cannot load the vocabulary " << vocPath << endl;
+        exit(-1);
+    }
 
     shared_ptr<FullSystem> fullSystem(new FullSystem(voc));
     fullSystem->setGammaFunction(reader->getPhotometricGamma());
@@ -355,6 +371,10 @@ int main(int argc, char **argv) {
             }
         }
 
+        std::unique_ptr<ImagePipeline> pipeline;
+        if (!preload && prefetch > 0)
+            pipeline.reset(new ImagePipeline(reader, idsToPlay, prefetch));
+
         struct timeval tv_start;
         gettimeofday(&tv_start, NULL);
         clock_t started = clock();
@@ -378,6 +398,8 @@ int main(int argc, char **argv) {
             ImageAndExposure *img;
             if (preload)
                 img = preloadedImages[ii];
+            else if (pipeline)
+                img = pipeline->next();
             else
                 img = reader->getImage(i);
 
@@ -399,7 +421,10 @@ int main(int argc, char **argv) {
             if (!skipFrame) {
                 fullSystem->addActiveFrame(img, i);
             }
-            delete img;
+            if (pipeline)
+                pipeline->recycle(img);
+            else
+                delete img;
 
             if (fullSystem->initFailed || setting_fullResetRequested) {
                 if (ii < 250 || setting_fullResetRequested) {
@@ -431,6 +456,8 @@ int main(int argc, char **argv) {
 
         fullSystem->printResult(output_file, true);
         fullSystem->printResult(output_file + ".noloop", false);
+        // every tracked frame, the non-keyframes from the compact trajectory log
+        fullSystem->printTrajectory(output_file + ".all", true);
 
         int numFramesProcessed = abs(idsToPlay[0] - idsToPlay.back());
         double numSecondsProcessed = fabs(reader->getTimestamp(idsToPlay[0]) - reader->getTimestamp(idsToPlay.back()));
@@ -21,13 +21,18 @@ namespace ldso {
      * Feature is a 2D point in the image. A triangulated feature will have an associated 3D map point, but an immature
      * feature will not (instead it has a immature point). You can access a feature's host frame and the map point.
      *
-     * Feature may have a descriptor (ORB currently) if it is a corner (with isCorner == true),
+     * Feature may have a descriptor (ORB currently) if it is a corner (with isCorner() == true),
      * otherwise the descriptor, angle and level are always kept as the default value. Described features can be used
      * for feature matching, loop closing and bag-of-words ... anything you expect in a feature-based SLAM.
      *
+     * The per-feature data (uv, invD, status, score, angle, descriptor ...) is stored in the FeatureTable of the host
+     * frame, a Feature is a thin view holding its row in that table. Creating a Feature appends a row.
+     *
      * NOTE outlier features will also be kept in frame know. If you worry about the memory cost you can just clean them
      */
 
+    struct FeatureTable;
+
     struct Feature {
     public:
         EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
@@ -41,7 +46,11 @@ namespace ldso {
             OUTLIER          // the immature point diverges, or the map point becomes an outlier
         };  // the status of feature
 
-        Feature(float u, float v, shared_ptr<Frame> host) : host(host), uv(Vec2f(u, v)) {}
+        /**
+         * create a feature and append its row to the feature table of host
+         * the caller still has to push it into host->features (or drop the row again with FeatureTable::PopBack)
+         */
+        Feature(float u, float v, shared_ptr<Frame> host);
 
         ~Feature() {}
 
@@ -73,25 +82,117 @@ namespace ldso {
 
         void load(ifstream &fin, vector<shared_ptr<Frame>> &allKFs);
 
-        // =====================================================================================================
-        FeatureStatus status = IMMATURE;   // status of this feature
+        // views into the feature table of the host frame
+        inline FeatureStatus &status();             // status of this feature
+        inline Vec2f &uv();                         // pixel position in image
+        inline float &invD();                       // inverse depth, invalid if < 0, computed by dso's sliding window
+        inline float &angle();                      // rotation
+        inline float &score();                      // shi-tomasi score
+        inline unsigned char &isCorner();           // indicating if this is a corner
+        inline int &level();                        // which pyramid level is the feature computed
+        inline unsigned char *descriptor();         // ORB descriptor, 32 bytes
 
+        // =====================================================================================================
         weak_ptr<Frame> host;   // the host frame
+        FeatureTable *table = nullptr;  // feature table of the host frame, owned by it
+        int idx = 0;                    // row in the table, equals the index in host->features
 
-        Vec2f uv = Vec2f(0, 0);               // pixel position in image
-        float invD = -1;                  // inverse depth, invalid if < 0, computed by dso's sliding window
         shared_ptr<Point> point = nullptr;    // corresponding 3D point, nullptr if it is an immature point
 
-        // feature stuffs
-        float angle = 0;        // rotation
-        float score = 0;        // shi-tomasi score
-        bool isCorner = false; // indicating if this is a corner
-        int level = 0;         // which pyramid level is the feature computed
-        unsigned char descriptor[32] = {0};  // ORB descriptors
-
         // internal structures for optimizing immature points
         shared_ptr<internal::ImmaturePoint> ip = nullptr;  // the immature point
     };
+
+    /**
+     * Structure-of-arrays storage of the features of one frame, row i belongs to Frame::features[i].
+     * Scans over the features of a frame (status, position, depth, descriptors) can run over these arrays directly
+     * instead of chasing the Feature pointers.
+     */
+    struct FeatureTable {
+    public:
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+
+        /// append a row with the default values, returns its index
+        inline int PushBack(float u, float v) {
+            status.push_back(Feature::FeatureStatus::IMMATURE);
+            uv.push_back(Vec2f(u, v));
+            invD.push_back(-1);
+            angle.push_back(0);
+            score.push_back(0);
+            isCorner.push_back(0);
+            level.push_back(0);
+            descriptors.resize(descriptors.size() + 32, 0);
+            return int(status.size()) - 1;
+        }
+
+        /// drop the last row, used when a just created feature is rejected
+        inline void PopBack() {
+            status.pop_back();
+            uv.pop_back();
+            invD.pop_back();
+            angle.pop_back();
+            score.pop_back();
+            isCorner.pop_back();
+            level.pop_back();
+            descriptors.resize(descriptors.size() - 32);
+        }
+
+        inline size_t size() const {
+            return status.size();
+        }
+
+        inline void reserve(size_t n) {
+            status.reserve(n);
+            uv.reserve(n);
+            invD.reserve(n);
+            angle.reserve(n);
+            score.reserve(n);
+            isCorner.reserve(n);
+            level.reserve(n);
+            descriptors.reserve(32 * n);
+        }
+
+        vector<Feature::FeatureStatus> status;
+        VecVec2f uv;
+        vector<float> invD;
+        vector<float> angle;
+        vector<float> score;
+        vector<unsigned char> isCorner;     // not vector<bool>, Feature::isCorner() returns a reference
+        vector<int> level;
+        vector<unsigned char> descriptors;  // 32 bytes per row
+    };
+
+    inline Feature::FeatureStatus &Feature::status() {
+        return table->status[idx];
+    }
+
+    inline Vec2f &Feature::uv() {
+        return table->uv[idx];
+    }
+
+    inline float &Feature::invD() {
+        return table->invD[idx];
+    }
+
+    inline float &Feature::angle() {
+        return table->angle[idx];
+    }
+
+    inline float &Feature::score() {
+        return table->score[idx];
+    }
+
+    inline unsigned char &Feature::isCorner() {
+        return table->isCorner[idx];
+    }
+
+    inline int &Feature::level() {
+        return table->level[idx];
+    }
+
+    inline unsigned char *Feature::descriptor() {
+        return &table->descriptors[32 * idx];
+    }
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,174 @@
+#pragma once
+#ifndef LDSO_FLAT_VOCABULARY_H_
+#define LDSO_FLAT_VOCABULARY_H_
+
+#include "NumTypes.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace ldso {
+
+    /**
+     * Copy of an ORB vocabulary tree in flat arrays, for computing bag of words vectors.
+     *
+     * The nodes are stored breadth first, so the children of a node are consecutive and their 32 byte centroids form
+     * one contiguous block. Transform takes all the descriptors of a frame at once and descends the tree level by
+     * level: the descriptors sitting at the same node are compared with its children in one batched hamming distance
+     * call, so each block of centroids is loaded once per level instead of once per descriptor.
+     *
+     * The result is the same as ORBVocabulary::transform(features, bowVec, featVec, levelsup), children are visited
+     * in the same order and ties go to the first one. Except for a descriptor whose word lies above the level of
+     * featVec: DBoW3 leaves its node unset (it gets the one of the descriptor before), here it is the node of the word.
+     *
+     * The arrays can also be saved into a file and mapped back read only (see Save and Map). The file holds them
+     * exactly as they are used, so mapping it costs nothing but the mmap call, pages are read on first use and shared
+     * by all the processes mapping the same file.
+     * Layout (little endian, checked by the endian tag of the header):
+     *   header:      magic "LDSOVOC", version, endian tag, k, L, weighting, scoring, normalization,
+     *                number of nodes, number of words, offset of each array
+     *   nodes:       first child (word id of a leaf) and number of children, per node
+     *   centroids:   32 bytes per node
+     *   node ids:    node id in the original vocabulary, per node
+     *   weights:     double, per word id
+     * every array starts at a multiple of 64 bytes.
+     */
+    class FlatVocabulary {
+    public:
+        static const uint32_t VERSION = 1;
+
+        /**
+         * flattened tree of voc, built on the first call and shared by all the callers using the same vocabulary
+         * (or the mapped tree if voc was returned by LoadORBVocabulary)
+         */
+        static shared_ptr<const FlatVocabulary> Get(const shared_ptr<ORBVocabulary> &voc);
+
+        /**
+         * map a file written by Save
+         * @return null if the file is missing, truncated or of an unsupported version
+         */
+        static shared_ptr<const FlatVocabulary> Map(const string &filename);
+
+        /// true if filename starts with the magic of a flat vocabulary file
+        static bool IsFlatVocabulary(const string &filename);
+
+        /**
+         * load a vocabulary for the system: a flat vocabulary file is mapped and served by a FlatORBVocabulary,
+         * anything else is loaded by DBoW3
+         * @return null if the file cannot be loaded
+         */
+        static shared_ptr<ORBVocabulary> LoadORBVocabulary(const string &filename);
+
+        explicit FlatVocabulary(const ORBVocabulary &voc);
+
+        ~FlatVocabulary();
+
+        FlatVocabulary(const FlatVocabulary &) = delete;
+
+        FlatVocabulary &operator=(const FlatVocabulary &) = delete;
+
+        /// false if the vocabulary is empty or not made of 32 byte binary descriptors, Transform can't be used then
+        inline bool Valid() const { return valid; }
+
+        /**
+         * write the arrays into filename, to be mapped by Map
+         * @return false if the vocabulary is not valid or the file cannot be written
+         */
+        bool Save(const string &filename) const;
+
+        /**
+         * bag of words of n descriptors
+         * @param descs packed descriptors, 32 bytes each (like FeatureTable::descriptors)
+         * @param index if not null, the i-th descriptor is descs[index[i]] instead of descs[i]
+         * @param n number of descriptors
+         * @param levelsup featVec holds the nodes levelsup levels above the words
+         */
+        void Transform(const unsigned char *descs, const int *index, int n, DBoW3::BowVector &bowVec,
+                       DBoW3::FeatureVector &featVec, int levelsup) const;
+
+        /// word of a single 32 byte descriptor, stopped words included
+        DBoW3::WordId Word(const unsigned char *desc) const;
+
+        inline unsigned int NumWords() const { return numWords; }
+
+        inline DBoW3::WordValue WordWeight(DBoW3::WordId wid) const { return wordWeights[wid]; }
+
+        inline int BranchingFactor() const { return k; }
+
+        inline int DepthLevels() const { return depth; }
+
+        inline DBoW3::WeightingType Weighting() const { return weighting; }
+
+        inline DBoW3::ScoringType Scoring() const { return scoring; }
+
+    private:
+        struct Node {
+            uint32_t first = 0;     // first child, or the word id of a leaf
+            uint32_t count = 0;     // number of children, 0 for a leaf
+        };
+
+        FlatVocabulary() = default;
+
+        bool valid = false;
+        int k = 0;                              // branching factor of the vocabulary
+        int depth = 0;                          // L of the vocabulary
+        DBoW3::WeightingType weighting = DBoW3::TF_IDF;
+        DBoW3::ScoringType scoring = DBoW3::L1_NORM;
+        bool mustNormalize = false;
+        DBoW3::LNorm norm = DBoW3::L1;
+
+        // the arrays, pointing either into the vectors below or into the mapped file
+        uint32_t numNodes = 0;
+        uint32_t numWords = 0;
+        const Node *nodes = nullptr;                    // breadth first, nodes[0] is the root
+        const unsigned char *centroids = nullptr;       // 32 bytes per node
+        const uint32_t *nodeIds = nullptr;              // node id in the vocabulary
+        const DBoW3::WordValue *wordWeights = nullptr;  // by word id
+
+        vector<Node> ownNodes;
+        vector<unsigned char> ownCentroids;
+        vector<uint32_t> ownNodeIds;
+        vector<DBoW3::WordValue> ownWordWeights;
+
+        void *mapping = nullptr;
+        size_t mappingSize = 0;
+    };
+
+    /**
+     * ORBVocabulary served by a mapped FlatVocabulary, without the DBoW3 tree.
+     *
+     * It answers what the system asks from a vocabulary: the scoring and weighting types, the number of words and
+     * their weights for the loop closing database, and the transforms. Other DBoW3 queries about the tree (words,
+     * nodes, saving) see an empty tree.
+     */
+    class FlatORBVocabulary : public ORBVocabulary {
+    public:
+        explicit FlatORBVocabulary(shared_ptr<const FlatVocabulary> flat);
+
+        inline const shared_ptr<const FlatVocabulary> &Flat() const { return flat; }
+
+        unsigned int size() const override { return flat->NumWords(); }
+
+        bool empty() const override { return flat->NumWords() == 0; }
+
+        DBoW3::WordValue getWordWeight(DBoW3::WordId wid) const override { return flat->WordWeight(wid); }
+
+        void transform(const std::vector<cv::Mat> &features, DBoW3::BowVector &v) const override;
+
+        void transform(const cv::Mat &features, DBoW3::BowVector &v) const override;
+
+        void transform(const std::vector<cv::Mat> &features, DBoW3::BowVector &v, DBoW3::FeatureVector &fv,
+                       int levelsup) const override;
+
+        DBoW3::WordId transform(const cv::Mat &feature) const override;
+
+    private:
+        shared_ptr<const FlatVocabulary> flat;
+    };
+}
+
+#endif // LDSO_FLAT_VOCABULARY_H_
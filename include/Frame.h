@@ -11,13 +11,15 @@ using namespace std;
 
 #include "NumTypes.h"
 #include "AffLight.h"
+#include "Feature.h"
 
 namespace ldso {
 
     // forward declare
-    struct Feature;
     namespace internal {
         class FrameHessian;
+
+        class FrameBufferPool;
     }
     struct Point;
 
@@ -39,8 +41,10 @@ namespace ldso {
 
         /**
          * this internal structure should be created if you want to use them
+         * @param pool if given, the image buffers of the frame hessian are borrowed from it and given back when the
+         * frame hessian is destroyed
          */
-        void CreateFH(shared_ptr<Frame> frame);
+        void CreateFH(shared_ptr<Frame> frame, shared_ptr<internal::FrameBufferPool> pool = nullptr);
 
         /**
          * release the inner structures
@@ -77,6 +81,14 @@ namespace ldso {
          */
         vector<size_t> GetFeatureInGrid(const float &x, const float &y, const float &radius);
 
+        /**
+         * descriptor of the i-th feature, all zero if it doesn't have one
+         */
+        inline const unsigned char *Descriptor(size_t i) const {
+            static const unsigned char none[32] = {0};
+            return i < featureTable.size() ? &featureTable.descriptors[32 * i] : none;
+        }
+
         /**
          * compute bow vectors
          * @param voc vocabulary pointer
@@ -132,7 +144,8 @@ namespace ldso {
         bool poseValid = true;     // if pose is valid (false when initializing)
         double timeStamp = 0;      // time stamp
         AffLight aff_g2l;           // aff light transform from global to local
-        vector<shared_ptr<Feature>> features;  // Features contained
+        vector<shared_ptr<Feature>> features;  // Features contained, thin views into featureTable
+        FeatureTable featureTable;             // data of the features, row i belongs to features[i]
         vector<vector<std::size_t>> grid;      // feature grid, to fast access features in a given area
         const int gridSize = 20;                // grid size
 
@@ -0,0 +1,96 @@
+#pragma once
+#ifndef LDSO_KEYFRAME_ARCHIVE_H_
+#define LDSO_KEYFRAME_ARCHIVE_H_
+
+#include "Frame.h"
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+using namespace std;
+
+namespace ldso {
+
+    /**
+     * Store of the features of old keyframes.
+     *
+     * Archiving a keyframe encodes its features and map points as a MapFile chunk (without the pose relations),
+     * compresses it if compiled with zlib and drops them from the frame. Poses, pose relations and ids stay in the
+     * frame, so the pose graph, printResult and the loop closing database keep working on archived keyframes.
+     * Restore decodes the chunk back into the frame, the map points are recreated with their ids and status.
+     *
+     * Chunks are kept in memory up to a budget, above it the oldest ones are written into an unlinked spill file and
+     * read back from there when restored.
+     * An archived keyframe is out of the sliding window and does not change any more, so its chunk is kept after a
+     * restore and archiving it again only drops the features.
+     *
+     * Not thread safe, Map guards it.
+     */
+    class KeyFrameArchive {
+    public:
+        struct Stats {
+            int frames = 0;             // keyframes with a chunk
+            int archived = 0;           // keyframes whose features are dropped right now
+            int spilled = 0;            // chunks in the spill file
+            size_t rawBytes = 0;        // encoded size of all chunks
+            size_t memoryBytes = 0;     // stored size of the chunks in memory
+            size_t spillBytes = 0;      // stored size of the chunks in the spill file
+            unsigned long restores = 0;
+        };
+
+        /**
+         * @param memoryBudget bytes of chunks kept in memory before spilling
+         * @param spillDir directory of the spill file, empty to keep everything in memory
+         */
+        KeyFrameArchive(size_t memoryBudget, const string &spillDir);
+
+        ~KeyFrameArchive();
+
+        KeyFrameArchive(const KeyFrameArchive &) = delete;
+
+        KeyFrameArchive &operator=(const KeyFrameArchive &) = delete;
+
+        /// drop the features of frame, encoding them first if it has no chunk yet
+        void Archive(const shared_ptr<Frame> &frame);
+
+        /**
+         * decode the features of an archived frame back into it
+         * @param voc recompute the bag of words if the frame had them when archived, may be null
+         * @return false if the chunk cannot be read, the frame then stays without features
+         */
+        bool Restore(const shared_ptr<Frame> &frame, shared_ptr<ORBVocabulary> voc);
+
+        bool IsArchived(const shared_ptr<Frame> &frame) const;
+
+        Stats GetStats() const { return stats; }
+
+    private:
+        struct Record {
+            vector<unsigned char> data;     // stored chunk, empty once spilled
+            uint64_t spillOffset = 0;
+            uint64_t size = 0;              // stored size
+            uint64_t rawSize = 0;           // encoded size
+            bool compressed = false;
+            bool spilled = false;
+            bool dropped = false;           // the features of the frame are dropped
+            bool hasBoW = false;
+        };
+
+        /// move the oldest chunks into the spill file until the memory budget is met
+        void spill();
+
+        size_t memoryBudget = 0;
+        string spillDir;
+        int spillFd = -1;
+        uint64_t spillSize = 0;
+
+        unordered_map<unsigned long, Record> records;   // by frame id
+        deque<unsigned long> inMemory;                  // frame ids of the chunks in memory, oldest first
+        Stats stats;
+    };
+}
+
+#endif // LDSO_KEYFRAME_ARCHIVE_H_
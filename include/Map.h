@@ -5,18 +5,26 @@
 #include "NumTypes.h"
 #include "Frame.h"
 #include "Point.h"
+#include "KeyFrameArchive.h"
 #include "internal/CalibHessian.h"
 
 #include <set>
+#include <map>
+#include <deque>
 #include <thread>
 #include <mutex>
 
 using namespace std;
 using namespace ldso::internal;
 
+namespace g2o {
+    class SparseOptimizer;
+}
+
 namespace ldso {
 
     class FullSystem;
+    class EdgeSim3;
 
     /**
      * The global map contains all keyframes and map points, even if they are marginalized or outdated.
@@ -37,13 +45,15 @@ namespace ldso {
 
         /**
          * optimize pose graph of all kfs
-         * this will start the pose graph optimization thread (usually takes several seconds to return in my machine)
+         * this will start the pose graph optimization thread. The graph is kept between the calls, only the constraints
+         * of the keyframes from the oldest new or changed one on are relinearized, the older keyframes only move as a
+         * whole. Like the optimization of the whole graph, the pose of the last keyframe is kept.
          * @param allKFs
          * @return true if pose graph thread is started
          */
         bool OptimizeALLKFs();
 
-        // optimize pose graph on all kfs after odometry loop is done
+        // optimize pose graph on all kfs after odometry loop is done, this one always optimizes the whole graph
         void lastOptimizeAllKFs();
 
         /// update the cached 3d position of all points.
@@ -67,9 +77,35 @@ namespace ldso {
 
         unsigned long getLatestOptimizedKfId() const { return latestOptimizedKfId; }
 
+        /**
+         * archive the features of the keyframes with a kfId below keepFromKfId, see KeyFrameArchive
+         * pinned keyframes are archived when they are unpinned
+         */
+        void ArchiveKeyFrames(unsigned long keepFromKfId);
+
+        /**
+         * restore the features of kf if it is archived and keep them in memory until UnpinKeyFrame
+         * pins are counted, every PinKeyFrame needs an UnpinKeyFrame
+         * @return false if the archived features cannot be read
+         */
+        bool PinKeyFrame(const shared_ptr<Frame> &kf);
+
+        void UnpinKeyFrame(const shared_ptr<Frame> &kf);
+
+        KeyFrameArchive::Stats GetArchiveStats() {
+            unique_lock<mutex> lock(archiveMutex);
+            return archive ? archive->GetStats() : KeyFrameArchive::Stats();
+        }
+
     private:
-        // the pose graph optimization thread
-        void runPoseGraphOptimization();
+        /**
+         * the pose graph optimization thread
+         * @param full optimize all keyframes instead of only the ones affected by new or changed constraints
+         */
+        void runPoseGraphOptimization(bool full = false);
+
+        /// update the cached 3d position of the points hosted by frame from its optimized pose
+        void updateWorldPoints(const shared_ptr<Frame> &frame);
 
         mutex mapMutex; // map mutex to protect its data
         set<shared_ptr<Frame>, CmpFrameID> frames;      // all KFs by ID
@@ -82,6 +118,19 @@ namespace ldso {
         bool poseGraphRunning = false;  // is pose graph running?
         mutex mutexPoseGraph;
 
+        // the pose graph, kept between the optimizations and only touched by runPoseGraphOptimization
+        // vertices are keyed by kfId, edges by (kfId of the frame, kfId of the related frame)
+        shared_ptr<g2o::SparseOptimizer> poseGraph = nullptr;
+        map<pair<unsigned long, unsigned long>, EdgeSim3 *> poseGraphEdges;
+
+        // archive of old keyframes, everything below is protected by archiveMutex
+        // it is also held while the points of a keyframe are updated, so the features are not dropped meanwhile
+        mutex archiveMutex;
+        shared_ptr<KeyFrameArchive> archive = nullptr;    // created by the first ArchiveKeyFrames
+        deque<shared_ptr<Frame>> hotFrames;             // keyframes not archived yet, by kfId
+        unsigned long archiveBelowKfId = 0;             // keyframes below are archived unless pinned
+        map<unsigned long, int> pinCount;               // pinned keyframes by id
+
         FullSystem *fullsystem = nullptr;
     };
 
@@ -0,0 +1,132 @@
+#pragma once
+#ifndef LDSO_MAP_FILE_H_
+#define LDSO_MAP_FILE_H_
+
+#include "NumTypes.h"
+#include "Frame.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+
+using namespace std;
+
+namespace ldso {
+
+    /**
+     * Binary map file.
+     *
+     * Layout (little endian, checked by the endian tag of the header):
+     *   header | keyframe chunks ... | index
+     * The index has one entry per keyframe with its ids, pose and the offset and size of its chunk, so a reader can
+     * create all the keyframes from the index alone and decode the chunks only when they are needed.
+     * A chunk stores the features of one keyframe column by column (status, uv, invD, angle, score, isCorner), then
+     * the descriptors as one block, the map points and at last the pose relations. Chunks may be zlib compressed.
+     *
+     * The reader maps the file into memory, so only the pages of the chunks that are actually decoded are read.
+     *
+     * Maps written by the old Frame::save stream (no header) can still be read by LoadLegacy or be converted with
+     * ConvertLegacy.
+     */
+    class MapFile {
+    public:
+        static const uint32_t VERSION = 1;
+
+        MapFile() {}
+
+        ~MapFile() { Close(); }
+
+        MapFile(const MapFile &) = delete;
+
+        MapFile &operator=(const MapFile &) = delete;
+
+        /**
+         * write keyframes into a map file
+         * @param allKFs keyframes ordered by kfId
+         * @param compress zlib compress the chunks, ignored if not compiled with zlib
+         * @param pin if set, called before encoding a keyframe and the save fails if it returns false
+         * @param unpin if set, called after encoding a keyframe (also if pin failed). Together with pin this makes
+         * the features of archived keyframes available one keyframe at a time
+         * @return false if the file cannot be written
+         */
+        static bool Save(const string &filename, const vector<shared_ptr<Frame>> &allKFs, bool compress = false,
+                         const function<bool(const shared_ptr<Frame> &)> &pin = nullptr,
+                         const function<void(const shared_ptr<Frame> &)> &unpin = nullptr);
+
+        /// true if the file starts with the header of this format
+        static bool IsMapFile(const string &filename);
+
+        /// read a map written in the old stream format
+        static bool LoadLegacy(const string &filename, vector<shared_ptr<Frame>> &allKFs);
+
+        /// convert a map in the old stream format into this format
+        static bool ConvertLegacy(const string &legacyFile, const string &filename, bool compress = false);
+
+        /**
+         * map the file and read header and index, no keyframe chunk is decoded here
+         * @return false if the file is missing, truncated or of an unsupported version
+         */
+        bool Open(const string &filename);
+
+        /// unmap the file, the frames already handed out stay valid
+        void Close();
+
+        inline int NumFrames() const { return int(frames.size()); }
+
+        /**
+         * all keyframes of the file, ordered as saved
+         * their ids and poses are set, features, points and pose relations only after LoadFrame
+         */
+        inline const vector<shared_ptr<Frame>> &Frames() const { return frames; }
+
+        inline bool IsLoaded(int i) const { return loaded[i]; }
+
+        /// decode the chunk of the i-th keyframe, does nothing if it is already loaded
+        bool LoadFrame(int i);
+
+        /// decode all chunks
+        bool LoadAll();
+
+        /**
+         * serialize the features, map points and (optionally) pose relations of a keyframe into a chunk
+         * @param buf the chunk is appended to it
+         * @param withPoseRel also write the pose relations, a chunk without them leaves poseRel alone when decoded
+         */
+        static void EncodeFrame(const shared_ptr<Frame> &frame, vector<unsigned char> &buf, bool withPoseRel = true);
+
+        /**
+         * replace the features and map points of frame by the ones in a chunk of EncodeFrame
+         * @param findKF keyframe of a kfId, for the pose relations; relations to unknown keyframes are dropped
+         * @return false if the chunk is corrupted, frame is then left without features and with its pose relations
+         */
+        static bool DecodeFrame(const shared_ptr<Frame> &frame, const unsigned char *chunk, size_t size,
+                                const function<shared_ptr<Frame>(unsigned long)> &findKF = nullptr);
+
+        /// zlib compress a chunk, false if it fails or if compiled without zlib
+        static bool Compress(const vector<unsigned char> &raw, vector<unsigned char> &packed);
+
+        /// inverse of Compress, rawSize is the size of the original chunk
+        static bool Uncompress(const unsigned char *packed, size_t size, size_t rawSize, vector<unsigned char> &raw);
+
+    private:
+        struct IndexEntry {
+            uint64_t offset = 0;    // chunk position in file
+            uint64_t size = 0;      // stored size of the chunk
+            uint64_t rawSize = 0;   // size after decompression
+        };
+
+        bool compressed = false;
+        int fd = -1;
+        const unsigned char *data = nullptr;    // the mapped file
+        size_t dataSize = 0;
+
+        vector<IndexEntry> index;
+        vector<shared_ptr<Frame>> frames;
+        vector<bool> loaded;
+        unordered_map<unsigned long, int> kfIdToIndex;
+    };
+}
+
+#endif // LDSO_MAP_FILE_H_
@@ -6,7 +6,6 @@
 namespace ldso {
 
     const int PYR_LEVELS = 6;  // total image pyramids, note not all are used during tracking
-    const int NUM_THREADS = 6;
 
     // the config bits in solver
     const int SOLVER_SVD = 1;
@@ -43,7 +42,7 @@ namespace ldso {
     const float SCALE_B_INVERSE = (1.0f / SCALE_B);
 
     // the detail setting variables
-    extern int pyrLevelsUsed;
+    extern thread_local int pyrLevelsUsed;    // per thread, set together with the calibration (see CalibContext)
     extern float setting_keyframesPerSecond;
     extern bool setting_realTimeMaxKF;
     extern float setting_maxShiftWeightT;
@@ -60,6 +59,7 @@ namespace ldso {
     extern float setting_initialCalibHessian;
     extern int setting_solverMode;
     extern double setting_solverModeDelta;
+    extern int setting_solverBlockMinFrames;    // windows of at least that many frames use the block sparse Cholesky, <=0: always dense
     extern float setting_minIdepthH_act;
     extern float setting_minIdepthH_marg;
     extern int setting_margPointVisWindow;
@@ -151,6 +151,10 @@ namespace ldso {
     extern bool goStepByStep;
     extern bool plotStereoImages;
     extern bool multiThreading;
+    extern int setting_numThreads;          // worker threads used by a FullSystem, <=0: all hardware threads
+    extern int setting_threadAffinity;      // first cpu core to pin threads to (tracking, mapping, loop closing, workers), -1: no pinning
+    extern int setting_framePoolSize;       // frame image buffers kept per FullSystem, 0: allocate every frame
+    extern bool setting_framePoolHugePages; // back the frame buffer pool by huge pages if possible
     extern float freeDebugParam1;
     extern float freeDebugParam2;
     extern float freeDebugParam3;
@@ -183,6 +187,18 @@ namespace ldso {
     // this is only for debugging (and for plotting when writing a paper)
     extern bool setting_showLoopClosing;
 
+    // compress the keyframe chunks when saving the map, only has an effect if compiled with zlib
+    extern bool setting_compressMap;
+
+    // keyframes older than the newest setting_hotKeyFrames (and than the active window) are moved into a compressed
+    // archive, only their poses and pose relations stay in memory. 0 keeps all keyframes in memory
+    extern int setting_hotKeyFrames;
+
+    // archived keyframes kept in memory before the oldest ones are spilled into a file in setting_archiveSpillDir,
+    // set the directory to an empty string to never spill
+    extern int setting_archiveMemoryMB;
+    extern const char *setting_archiveSpillDir;
+
     // use the ninth pattern (described in DSO's paper)
 #define patternP staticPattern[8]
 
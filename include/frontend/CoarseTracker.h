@@ -18,8 +18,12 @@ namespace ldso {
     public:
         EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
 
-        // constuctor, allocate memory and compute the camera intrinsics pyramid
-        CoarseTracker(int w, int h);
+        /**
+         * constuctor, allocate memory and compute the camera intrinsics pyramid
+         * @param workspaceOnly only allocate the warped buffers, the reference is taken from another tracker
+         *                      by shareTrackingRef
+         */
+        CoarseTracker(int w, int h, bool workspaceOnly = false);
 
         ~CoarseTracker() {
             for (float *ptr : ptrToDelete)
@@ -44,6 +48,13 @@ namespace ldso {
         void setCoarseTrackingRef(
                 std::vector<shared_ptr<FrameHessian>>& frameHessians);
 
+        /**
+         * track against the reference of ref, using the own warped buffers
+         * the reference data is shared read-only, so ref must not be changed while this tracker is used
+         * @param ref
+         */
+        void shareTrackingRef(const CoarseTracker &ref);
+
         /**
          * Create camera intrinsics buffer given the calibrated parameters
          * @param HCalib
@@ -61,6 +72,13 @@ namespace ldso {
         Vec3 lastFlowIndicators;
         double firstCoarseRMSE = 0;
 
+        // residual and flow indicators of every visited pyramid level in the last trackNewestCoarse, in visiting
+        // order (a level may be visited twice). Used to replay the abort decision with a different minResForAbort.
+        int lastTraceN = 0;
+        int lastTraceLvl[PYR_LEVELS + 1];
+        double lastTraceRes[PYR_LEVELS + 1];
+        Vec3 lastTraceFlow[PYR_LEVELS + 1];
+
         // camera and image parameters in each pyramid
         Mat33f K[PYR_LEVELS];
         Mat33f Ki[PYR_LEVELS];
@@ -98,6 +116,28 @@ namespace ldso {
          */
         void calcGSSSE(int lvl, Mat88 &H_out, Vec8 &b_out, const SE3 &refToNew, AffLight aff_g2l);
 
+        /**
+         * 256/512 bit version of the residual loop in calcRes, implemented in CoarseTrackerAVX.cc
+         * processes the first points of lvl in multiples of kernelWidth and adds to E and the counters
+         * @return number of processed points, 0 if there is no wide kernel
+         */
+        int calcResWide(int lvl, const Mat33f &RKi, const Vec3f &t, const Vec2f &affLL, float cutoffTH,
+                        float maxEnergy, float &E, int &numTermsInE, int &numTermsInWarped, int &numSaturated);
+
+        /**
+         * 256/512 bit version of the accumulation loop in calcGSSSE, implemented in CoarseTrackerAVX.cc
+         * @param[in] lvl image pyramid level
+         * @param[in] affA affine brightness factor from reference to new frame
+         * @return number of accumulated warped points, 0 if there is no wide kernel
+         */
+        int calcGSWide(int lvl, float affA);
+
+        /**
+         * widest simd kernel the cpu supports, detected once at runtime
+         * @return 16 (AVX-512), 8 (AVX2 + FMA) or 4 (SSE only)
+         */
+        static int wideKernelWidth();
+
 
         // point cloud buffers
         // wxh in each pyramid layer
@@ -124,6 +164,7 @@ namespace ldso {
 
         std::vector<float *> ptrToDelete;    // all allocated memory, will be deleted in deconstructor
         Accumulator9 acc;
+        int kernelWidth = 4;                 // simd width used in calcRes and calcGSSSE
     };
 
     // the distance map
@@ -7,6 +7,7 @@
 
 #include "internal/GlobalCalib.h"
 #include "internal/FrameHessian.h"
+#include "internal/IndexThreadReduce.h"
 
 #include <cmath>
 
@@ -26,11 +27,16 @@ namespace ldso {
         /**
          * detector corners
          * @param frame input frame, feature should already be created by PixelSelector
+         * @param red if given, the grid rows are scored in parallel on it
          * @return number of selected features
          */
-        int DetectCorners(int nFeatures, shared_ptr<Frame> &frame);
+        int DetectCorners(int nFeatures, shared_ptr<Frame> &frame, IndexThreadReduce<Vec10> *red = nullptr);
 
-        int ComputeDescriptor(shared_ptr<Frame> &frame, shared_ptr<Feature> feat);
+        /**
+         * compute the ORB descriptor of a feature
+         * @param desc output, 32 bytes
+         */
+        int ComputeDescriptor(shared_ptr<Frame> &frame, shared_ptr<Feature> feat, unsigned char *desc);
 
         /**
          * debug stuffs
@@ -38,6 +44,13 @@ namespace ldso {
         void DrawFeatures(shared_ptr<Frame> &frame, const string &windowName = "corner");
 
     private:
+        /**
+         * score the candidates of grid rows [min, max) and keep the best ones of each cell
+         * results go to cellNum/cellCand/cellScore/cellMaxScore, indexed by gy*gridX+gx
+         */
+        void scoreCells_Reductor(shared_ptr<Frame> *frame, int gridsize, int gridX, int skip, int topK,
+                                 int min, int max, Vec10 *stats, int tid);
+
         /**
          * shi-tomasi score
          * @param frame, must have frame hessian since we need dI
@@ -120,6 +133,16 @@ namespace ldso {
 
         // static data
         std::vector<int> umax;  // used to compute rotation
+
+        // per-cell top-k buffers, reused across frames
+        std::vector<int> cellNum;           // number of kept candidates in each cell
+        std::vector<int> cellCand;          // kept candidates (index inside the cell), topK per cell, best first
+        std::vector<float> cellScore;       // their scores
+        std::vector<float> cellMaxScore;    // max score of all candidates in each cell
+
+        // spatial hash for the non-maximum suppression, reused across frames
+        std::vector<int> nmsCellStart;
+        std::vector<int> nmsCellIndex;
     };
 }
 
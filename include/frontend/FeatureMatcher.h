@@ -33,6 +33,24 @@ namespace ldso {
         /// the distance of two descriptors
         static int DescriptorDistance(const unsigned char *desc1, const unsigned char *desc2);
 
+        /**
+         * distances of one descriptor to n descriptors (1-vs-N), using the widest kernel the cpu supports
+         * @param desc the query descriptor
+         * @param descs packed descriptors, 32 bytes each (like FeatureTable::descriptors)
+         * @param index if not null, the i-th descriptor compared is descs[index[i]] instead of descs[i]
+         * @param n number of descriptors to compare with
+         * @param dist output, n distances
+         */
+        static void DescriptorDistances(const unsigned char *desc, const unsigned char *descs, const int *index,
+                                        int n, int *dist);
+
+        /**
+         * distances between two sets of descriptors (M-vs-N), dist is a m x n row-major matrix
+         * index1 and index2 work like index in the 1-vs-N version
+         */
+        static void DescriptorDistances(const unsigned char *descs1, const int *index1, int m,
+                                        const unsigned char *descs2, const int *index2, int n, int *dist);
+
         /**
          * Brute-force Search for feature matching
          * @param frame1
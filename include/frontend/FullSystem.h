@@ -2,6 +2,7 @@
 #ifndef LDSO_FULL_SYSTEM_H_
 #define LDSO_FULL_SYSTEM_H_
 
+#include <chrono>
 #include <deque>
 #include <memory>
 #include <mutex>
@@ -18,7 +19,9 @@
 #include "FeatureMatcher.h"
 #include "PixelSelector2.h"
 
+#include "internal/GlobalCalib.h"
 #include "internal/IndexThreadReduce.h"
+#include "internal/FrameBufferPool.h"
 #include "LoopClosing.h"
 
 using namespace std;
@@ -47,6 +50,23 @@ namespace ldso {
         struct ImmaturePointTemporaryResidual;
     }
 
+    /**
+     * Tracking result of one frame, kept for the whole run instead of the frame itself
+     */
+    struct TrajectoryEntry {
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+
+        TrajectoryEntry(const shared_ptr<Frame> &frame, const shared_ptr<Frame> &ref, const SE3 &Tcr) :
+                id(frame->id), refKfId(ref->kfId), timeStamp(frame->timeStamp), Tcw(frame->getPose()),
+                Tcr(Tcr.cast<float>()) {}
+
+        unsigned long id = 0;       // frame id
+        unsigned long refKfId = 0;  // kfId of the reference keyframe of the tracker
+        double timeStamp = 0;
+        SE3 Tcw;                    // pose when it was tracked
+        Sophus::SE3f Tcr;           // pose relative to the reference keyframe
+    };
+
     /**
      * FullSystem is the top-level interface of DSO system
      * call addActiveFrame to track an image
@@ -56,7 +76,52 @@ namespace ldso {
     public:
         EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
 
-        FullSystem(shared_ptr<ORBVocabulary> voc);
+        /**
+         * latency of the mapping thread, per stage of makeKeyFrame, in milliseconds
+         * The tracker can use a new keyframe once its reference is published (end of PUBLISH), the later stages
+         * only delay the next frame to be mapped.
+         */
+        struct MappingStats {
+            enum Stage {
+                TRACE = 0,      // trace the immature points into the keyframe
+                RESIDUALS,      // insert the keyframe and the residuals of the active points
+                ACTIVATE,       // activate immature points
+                OPTIMIZE,       // sliding window optimization
+                OUTLIERS,       // remove outliers
+                PUBLISH,        // build and publish the tracking reference
+                MARG_POINTS,    // flag, drop and marginalize points
+                NEW_TRACES,     // new immature points
+                RELATIONS,      // pose relations and viewer
+                MARG_FRAMES,    // marginalize frames
+                MAP,            // global map, loop closing and archive
+                NUM_STAGES
+            };
+
+            static const char *StageName(int stage);
+
+            unsigned long keyFrames = 0;
+            unsigned long nonKeyFrames = 0;
+            unsigned long skippedFrames = 0;            // not traced because mapping was behind
+            double stageTotal[NUM_STAGES] = {0};        // summed over the keyframes
+            double stageMax[NUM_STAGES] = {0};
+            double referenceTotal = 0;                  // from makeKeyFrame until the tracking reference is published
+            double referenceMax = 0;
+            double keyFrameTotal = 0;                   // whole makeKeyFrame
+            double keyFrameMax = 0;
+            double nonKeyFrameTotal = 0;
+            int maxQueue = 0;                           // most tracked frames waiting for mapping
+            unsigned long tracedPoints = 0;             // immature point traces, summed over all frames
+            double traceOutcomes[6] = {0};              // good, bad condition, oob, outlier, skipped, uninitialized
+        };
+
+        /**
+         * @param voc vocabulary, may be shared by several systems
+         * @param calib camera calibration, if null the one bound to the calling thread (see setGlobalCalib) is used
+         * @param pool worker pool, may be shared by several systems. If null the system creates its own with
+         * setting_numThreads workers
+         */
+        FullSystem(shared_ptr<ORBVocabulary> voc, shared_ptr<CalibContext> calib = nullptr,
+                   shared_ptr<ThreadPool> pool = nullptr);
 
         ~FullSystem();
 
@@ -86,12 +151,16 @@ namespace ldso {
          */
         void shutDown();
 
-        /// save all information into a binary file
+        /// save all keyframes into a map file, see MapFile
         bool saveAll(const string &filename);
 
-        /// load all information from a binary file
+        /// load all keyframes from a map file, maps in the old stream format are also accepted
         bool loadAll(const string &filename);
 
+        // calibration of this system, bound to every thread working for it
+        // NOTE keep it the first data member, the others are created with its image size
+        shared_ptr<CalibContext> calib = nullptr;
+
         // state variables
         bool isLost = false;        // if system is lost, note that dso CANNOT recover from lost
         bool initFailed = false;    // initialization failed?
@@ -103,6 +172,21 @@ namespace ldso {
             return coarseDistanceMap;
         }
 
+        shared_ptr<ThreadPool> GetThreadPool() {
+            return threadPool;
+        }
+
+        /// latency of the mapping stages, see MappingStats
+        MappingStats GetMappingStats() {
+            unique_lock<mutex> lck(mappingStatsMutex);
+            return mappingStats;
+        }
+
+        /// hits, misses and peak usage of the frame image buffers
+        FrameBufferPool::Stats GetFramePoolStats() {
+            return framePool ? framePool->GetStats() : FrameBufferPool::Stats();
+        }
+
         vector<shared_ptr<Frame>> GetActiveFrames() {
             unique_lock<mutex> lck(framesMutex);
             return frames;
@@ -129,6 +213,25 @@ namespace ldso {
          */
         Vec4 trackNewCoarse(shared_ptr<FrameHessian> fh);
 
+        /**
+         * evaluate the pose hypotheses of trackNewCoarse concurrently on the tracker workspaces
+         * results are replayed in order against the serial abort bounds, so the outcome is exactly the one of the
+         * serial loop. Stops handing out hypotheses as soon as one is accepted.
+         * @param[in] fh new frame
+         * @param[in] lastF_2_fh_tries pose hypotheses, in order of preference
+         * @param[in] firstTry index of the first hypothesis to evaluate, the ones before are already done
+         * @param[in] aff_last_2_l initial affine light parameters of every hypothesis
+         * @param[in,out] achievedRes best residual so far of each level
+         * @param[in,out] haveOneGood if any hypothesis is good
+         * @param[in,out] lastF_2_fh best pose
+         * @param[in,out] aff_g2l best affine light
+         * @param[in,out] flowVecs flow indicators of the best pose
+         */
+        void trackHypothesesMT(shared_ptr<FrameHessian> fh,
+                               const std::vector<SE3, Eigen::aligned_allocator<SE3>> &lastF_2_fh_tries, int firstTry,
+                               const AffLight &aff_last_2_l, Vec5 &achievedRes, bool &haveOneGood,
+                               SE3 &lastF_2_fh, AffLight &aff_g2l, Vec3 &flowVecs);
+
         /**
          * trace immature points into new frames, maybe keyframe or not key-frame, to update the immature point status
          * fh's pose should be estimated, otherwise trace does not make sense
@@ -136,6 +239,26 @@ namespace ldso {
          */
         void traceNewCoarse(shared_ptr<FrameHessian> fh);
 
+        // projection of a host frame into the frame being traced, computed once per host
+        struct TraceHost {
+            Mat33f KRKi;
+            Vec3f Kt;
+            Vec2f aff;
+        };
+
+        // an immature point to trace and its host
+        struct TracePoint {
+            shared_ptr<ImmaturePoint> ip;
+            const TraceHost *host;
+        };
+
+        /**
+         * reductor for tracing immature points
+         * stats[0..5] count the trace status good, bad condition, oob, outlier, skipped and uninitialized
+         */
+        void traceNewCoarse_Reductor(shared_ptr<FrameHessian> fh, const std::vector<TracePoint> *points,
+                                     int min, int max, Vec10 *stats, int tid);
+
         /**
          * activate point, turn the immature into real points and insert residuals into backend
          * called in making keyframes
@@ -271,15 +394,21 @@ namespace ldso {
         // =================== changed by tracker-thread. protected by trackMutex ============
         mutex trackMutex;
         shared_ptr<CoarseInitializer> coarseInitializer = nullptr;
+        shared_ptr<FrameBufferPool> framePool = nullptr;    // image buffers of the frame hessians
         Vec5 lastCoarseRMSE;
-        vector<shared_ptr<Frame>> allFrameHistory;      // all recorded frames
+        unsigned long numFramesReceived = 0;
+        deque<shared_ptr<Frame>> recentFrames;          // the last three frames, for the motion model of the tracker
+        deque<TrajectoryEntry, Eigen::aligned_allocator<TrajectoryEntry>> trajectory;  // every tracked frame
 
         // ================== changed by mapper-thread. protected by mapMutex ===============
         mutex mapMutex;
 
         // =================================================================================== //
-        shared_ptr<EnergyFunctional> ef = nullptr;        // optimization
+        // NOTE the pool and reducer must be declared before ef, their thread count sizes the accumulators in ef
+        shared_ptr<ThreadPool> threadPool = nullptr;      // work-stealing pool shared with loop closing and pose graph
         IndexThreadReduce<Vec10> threadReduce;            // multi thread reducing
+        IndexThreadReduce<Vec10> trackingReduce;          // reductions of the tracking thread, beside the mapping ones
+        shared_ptr<EnergyFunctional> ef = nullptr;        // optimization
 
         shared_ptr<CoarseDistanceMap> coarseDistanceMap = nullptr;  // coarse distance map
         shared_ptr<PixelSelector> pixelSelector = nullptr;          // pixel selector
@@ -291,6 +420,8 @@ namespace ldso {
 
         // active residuals
         std::vector<shared_ptr<PointFrameResidual>> activeResiduals;
+        // residuals linearizeAll drops, one list per reduce slot, kept to reuse the memory
+        std::vector<std::vector<shared_ptr<PointFrameResidual>>> toRemove;
         float currentMinActDist = 2;
 
         std::vector<float> allResVec;
@@ -299,6 +430,8 @@ namespace ldso {
         mutex coarseTrackerSwapMutex;            // if tracker sees that there is a new reference, tracker locks [coarseTrackerSwapMutex] and swaps the two.
         shared_ptr<CoarseTracker> coarseTracker_forNewKF = nullptr;            // set as as reference. protected by [coarseTrackerSwapMutex].
         shared_ptr<CoarseTracker> coarseTracker = nullptr;                    // always used to track new frames. protected by [trackMutex].
+        shared_ptr<CoarseTracker> coarseTracker_build = nullptr;              // new references are built into it, outside the lock, then swapped with [coarseTracker_forNewKF]. mapping thread only.
+        std::vector<shared_ptr<CoarseTracker>> coarseTrackerWorkspaces;       // one per thread slot, share the reference of coarseTracker. protected by [trackMutex].
 
         mutex shellPoseMutex;
 
@@ -310,9 +443,19 @@ namespace ldso {
         int needNewKFAfter = -1;    // Otherwise, a new KF is *needed that has ID bigger than [needNewKFAfter]*.
 
         thread mappingThread;
+        bool pinTrackingThread = false;     // pin the thread of the first addActiveFrame to setting_threadAffinity
         bool runMapping = true;
         bool needToKetchupMapping = false;
 
+        // mapping latency
+        typedef chrono::steady_clock Clock;
+
+        /// add the time since [since] to a stage of mappingStats, since is set to now
+        void recordMappingStage(int stage, Clock::time_point &since);
+
+        mutex mappingStatsMutex;
+        MappingStats mappingStats;
+
     public:
         shared_ptr<Map> globalMap = nullptr;    // global map
         FeatureDetector detector;   // feature detector
@@ -341,6 +484,15 @@ namespace ldso {
          */
         void printResult(const string &filename, bool printOptimized = true);
 
+        /**
+         * save the trajectory of all tracked frames in TUM or EUROC format
+         * keyframes use their own pose, the other frames their pose relative to the reference keyframe, so the
+         * refinement by the window and the loop closure are carried over to them
+         * @param filename
+         * @param printOptimized print the trajectory after loop closure?
+         */
+        void printTrajectory(const string &filename, bool printOptimized = true);
+
         /**
          * save the trajectory in Kitti format
          * NOTE we only save keyframe poses, not all poses, so they cannot be directly evaluated by
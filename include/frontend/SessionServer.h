@@ -0,0 +1,155 @@
+#pragma once
+#ifndef LDSO_SESSION_SERVER_H_
+#define LDSO_SESSION_SERVER_H_
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "NumTypes.h"
+#include "frontend/FullSystem.h"
+#include "frontend/ImageAndExposure.h"
+#include "internal/GlobalCalib.h"
+#include "internal/ThreadPool.h"
+
+using namespace std;
+using namespace ldso::internal;
+
+namespace ldso {
+
+    /**
+     * Runs several independent LDSO sessions (one per camera) in one process.
+     *
+     * All sessions share the vocabulary and one worker pool. Each session has its own calibration, FullSystem,
+     * tracking, mapping and loop closing thread. Frames are queued per session and the next frame is always taken
+     * from the waiting session with the highest priority (the one waiting longest among equal priorities), at most
+     * maxRunning sessions track at the same time. Frames of one session are tracked in order, never two at a time.
+     *
+     * The pool only runs the reductions of tracking and mapping. Tracking does not run on it: it waits for its
+     * mapping thread (for the first keyframes, or when a failed initialization is reset), and a waiting task would
+     * hold a worker the reductions of all the sessions need. For the same reason keyframes are made on the mapping
+     * thread (linearizeOperation is off), not inline in tracking.
+     */
+    class SessionServer {
+    public:
+        /**
+         * per session counters
+         */
+        struct SessionStats {
+            unsigned long framesQueued = 0;     // frames accepted by AddFrame
+            unsigned long framesTracked = 0;    // frames that went through addActiveFrame
+            unsigned long framesDropped = 0;    // frames rejected because the queue was full
+            double meanLatency = 0;             // seconds from AddFrame until tracked, averaged
+            double maxLatency = 0;              // seconds
+            double throughput = 0;              // tracked frames per second since the first one was queued
+        };
+
+        /**
+         * @param voc vocabulary shared by all sessions
+         * @param numThreads pool size, <= 0 means all hardware threads
+         * @param firstCore if >= 0, pool workers are pinned to the cores from firstCore on
+         */
+        SessionServer(shared_ptr<ORBVocabulary> voc, int numThreads = 0, int firstCore = -1);
+
+        /// waits for the queued frames and shuts all sessions down
+        ~SessionServer();
+
+        /**
+         * create a session
+         * @param calib calibration of its camera
+         * @param gammaInv inverse response of the camera, may be null. It has to live as long as the session since
+         * it is applied again when the system is reset after a failed initialization
+         * @param priority sessions with higher priority are tracked first when maxRunning sessions are tracking
+         * @param maxQueue frames that may wait for tracking, more are dropped
+         * @return session id
+         */
+        int AddSession(shared_ptr<CalibContext> calib, float *gammaInv = nullptr, int priority = 0, int maxQueue = 8);
+
+        inline int NumSessions() {
+            unique_lock<mutex> lock(serverMutex);
+            return int(sessions.size());
+        }
+
+        /// the system of a session, e.g. to set a viewer. It changes when the session is reset
+        shared_ptr<FullSystem> GetSystem(int session);
+
+        /**
+         * queue a frame for tracking, the server takes ownership of image
+         * @param wait if the session queue is full, wait for room instead of dropping the frame (e.g. offline runs)
+         * @return false if the frame was dropped
+         */
+        bool AddFrame(int session, ImageAndExposure *image, int id, bool wait = false);
+
+        /// block until all queued frames are tracked
+        void WaitIdle();
+
+        /// wait for the queued frames and finish mapping and loop closing of all sessions
+        void Finish();
+
+        SessionStats GetStats(int session);
+
+        inline shared_ptr<ThreadPool> GetThreadPool() const { return pool; }
+
+    private:
+        typedef chrono::steady_clock Clock;
+
+        struct QueuedFrame {
+            ImageAndExposure *image = nullptr;
+            int id = 0;
+            Clock::time_point queuedAt;
+        };
+
+        struct Session {
+            shared_ptr<CalibContext> calib;
+            shared_ptr<FullSystem> system;
+            float *gammaInv = nullptr;
+            int priority = 0;
+            int maxQueue = 8;
+
+            deque<QueuedFrame> frames;
+            bool scheduled = false;     // waiting in the ready list or being tracked
+            unsigned long readySince = 0;   // ready order, older first among equal priorities
+
+            thread tracker;                 // runs trackingLoop
+            condition_variable trackSignal;
+            bool trackNext = false;         // set by dispatch, the tracker takes the next frame
+            bool quit = false;
+
+            SessionStats stats;
+            double latencySum = 0;
+            bool started = false;
+            Clock::time_point firstQueued;
+        };
+
+        // put the session into the ready list, serverMutex held
+        void makeReady(int session);
+
+        // let the trackers of ready sessions go while there are free slots, serverMutex held
+        void dispatch();
+
+        // tracking thread of a session, tracks one frame each time dispatch lets it
+        void trackingLoop(int session);
+
+        // create the system of a session
+        shared_ptr<FullSystem> createSystem(const Session &s);
+
+        shared_ptr<ORBVocabulary> vocab;
+        shared_ptr<ThreadPool> pool;
+
+        mutex serverMutex;
+        condition_variable idleSignal;
+        condition_variable dequeuedSignal;  // a tracker took a frame from its queue
+        vector<unique_ptr<Session>> sessions;
+        vector<int> ready;              // sessions with frames that are not being tracked
+        unsigned long readyCounter = 0;
+        int running = 0;                // sessions tracking a frame
+        int maxRunning = 1;             // sessions tracked at the same time, half of the workers
+        bool finished = false;
+    };
+}
+
+#endif // LDSO_SESSION_SERVER_H_
@@ -27,6 +27,7 @@
 #define LDSO_UNDISORT_H_
 
 #include <Eigen/Core>
+#include <cstdint>
 #include "frontend/ImageAndExposure.h"
 #include "NumTypes.h"
 #include "MinimalImage.h"
@@ -47,12 +48,18 @@ namespace ldso {
         template<typename T>
         void processFrame(T *image_in, float exposure_time, float factor = 1);
 
+        // same as above, but writes into out (original size) instead of [output]
+        template<typename T>
+        void processFrame(const T *image_in, float exposure_time, float factor, ImageAndExposure *out) const;
+
         void unMapFloatImage(float *image);
 
         ImageAndExposure *output;
 
         float *getG() { if (!valid) return 0; else return G; };
     private:
+        friend class Undistort;     // reads G and the vignette in the fused undistortion
+
         float G[256 * 256];
         int GDepth;
         float *vignetteMap;
@@ -87,6 +94,27 @@ namespace ldso {
         ImageAndExposure *
         undistort(const MinimalImage<T> *image_raw, float exposure = 0, double timestamp = 0, float factor = 1) const;
 
+        /**
+         * undistort into a buffer of the caller (output size), nothing is allocated
+         * The photometric correction is done inside the bilinear remap, which reads the precomputed remap table.
+         * No state is shared between calls, so several frames can be undistorted at the same time.
+         */
+        template<typename T>
+        void undistort(const MinimalImage<T> *image_raw, ImageAndExposure *result, float exposure = 0,
+                       double timestamp = 0, float factor = 1) const;
+
+        /**
+         * photometric and geometric undistortion as two separate passes through an irradiance image
+         * undistortPhotometric: raw image -> irradiance, photo must have the original size
+         * undistortGeometric: irradiance -> undistorted image, result must have the output size
+         * This is the float reference of the fused undistort, which uses it when benchmark noise is enabled.
+         */
+        template<typename T>
+        void undistortPhotometric(const MinimalImage<T> *image_raw, ImageAndExposure *photo, float exposure = 0,
+                                  float factor = 1) const;
+
+        void undistortGeometric(const ImageAndExposure *photo, ImageAndExposure *result, double timestamp = 0) const;
+
         static Undistort *
         getUndistorterForFile(std::string configFilename, std::string gammaFilename, std::string vignetteFilename);
 
@@ -105,6 +133,23 @@ namespace ldso {
         float *remapX;
         float *remapY;
 
+        // remap table of the fused undistortion, per output pixel:
+        // index of the top left source pixel (-1 if outside) and the bilinear weights in 1/32768
+        int *remapIdx = nullptr;
+        uint16_t *remapWeight[4] = {nullptr, nullptr, nullptr, nullptr};   // top left, top right, bottom left/right
+        // per 8 output pixels: all their source rows can be read 4 bytes at a time without leaving the image
+        unsigned char *remapBlockWide = nullptr;
+
+        void makeRemapTable();
+
+        // fused photometric correction and remap of one frame, see UndistortAVX.cc
+        // G: response (null: linear with factor), vignetteInv: may be null
+        void remapFused(const unsigned char *in, float *out, const float *G, float factor,
+                        const float *vignetteInv) const;
+
+        void remapFused(const unsigned short *in, float *out, const float *G, float factor,
+                        const float *vignetteInv) const;
+
         void applyBlurNoise(float *img) const;
 
         void makeOptimalK_crop();
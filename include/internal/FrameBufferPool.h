@@ -0,0 +1,74 @@
+#pragma once
+#ifndef LDSO_FRAME_BUFFER_POOL_H_
+#define LDSO_FRAME_BUFFER_POOL_H_
+
+#include <mutex>
+#include <vector>
+#include <cstddef>
+
+using namespace std;
+
+namespace ldso {
+
+    namespace internal {
+
+        /**
+         * Fixed-capacity pool of the image buffers of FrameHessian (dIp and absSquaredGrad of all pyramid levels)
+         *
+         * All buffers live in one arena that is mapped and touched when the pool is created, optionally backed by
+         * huge pages. A FrameHessian created by Frame::CreateFH with a pool borrows its buffer in makeImages and
+         * gives it back when it is destroyed (Frame::ReleaseFH drops the frame's reference), so the frames thrown
+         * away after tracking neither go through the allocator nor fault in new pages.
+         * When all buffers are borrowed the heap is used and a miss is counted.
+         */
+        class FrameBufferPool {
+        public:
+            struct Stats {
+                unsigned long hits = 0;     // borrows served by the pool
+                unsigned long misses = 0;   // borrows served by the heap because the pool was empty
+                int inUse = 0;              // buffers borrowed right now, from the pool or the heap
+                int peakInUse = 0;
+                int capacity = 0;
+                bool hugePages = false;     // the arena is backed by huge pages
+            };
+
+            /// floats one FrameHessian needs with the calibration bound to the calling thread
+            static size_t FrameFloats();
+
+            /**
+             * @param bufferFloats size of one buffer
+             * @param capacity number of buffers in the arena
+             * @param hugePages try to back the arena by huge pages (explicit, then transparent)
+             */
+            FrameBufferPool(size_t bufferFloats, int capacity, bool hugePages = false);
+
+            ~FrameBufferPool();
+
+            FrameBufferPool(const FrameBufferPool &) = delete;
+
+            FrameBufferPool &operator=(const FrameBufferPool &) = delete;
+
+            /// a buffer of BufferFloats() floats, never null
+            float *Borrow();
+
+            /// give back a buffer from Borrow
+            void Return(float *buffer);
+
+            inline size_t BufferFloats() const { return bufferFloats; }
+
+            Stats GetStats();
+
+        private:
+            size_t bufferFloats = 0;
+            size_t bufferBytes = 0;     // rounded up to a cache line
+            unsigned char *arena = nullptr;
+            size_t arenaBytes = 0;
+
+            mutex poolMutex;
+            vector<float *> freeBuffers;
+            Stats stats;
+        };
+    }
+}
+
+#endif // LDSO_FRAME_BUFFER_POOL_H_
@@ -8,6 +8,8 @@
 #include "AffLight.h"
 
 #include "internal/FrameFramePrecalc.h"
+#include "internal/IndexThreadReduce.h"
+#include "internal/FrameBufferPool.h"
 
 using namespace std;
 
@@ -33,10 +35,10 @@ namespace ldso {
             }
 
             ~FrameHessian() {
-                for (int i = 0; i < pyrLevelsUsed; i++) {
-                    delete[] dIp[i];
-                    delete[]  absSquaredGrad[i];
-                }
+                if (bufferPool)
+                    bufferPool->Return(imageData);
+                else
+                    delete[] imageData;
             }
 
             // accessors
@@ -123,8 +125,10 @@ namespace ldso {
             /**
              * @brief create the images and gradient from original image
              * @param [in] HCalib camera intrinsics with hessian
+             * @param [in] red if given, large images are processed in horizontal bands in parallel on it
              */
-            void makeImages(float *image, const shared_ptr<CalibHessian> &HCalib);
+            void makeImages(float *image, const shared_ptr<CalibHessian> &HCalib,
+                            IndexThreadReduce<Vec10> *red = nullptr);
 
             inline Vec10 getPrior() {
                 Vec10 p = Vec10::Zero();
@@ -174,6 +178,10 @@ namespace ldso {
             // dI = dIp[0], the first pyramid
             Vec3f *dI = nullptr;     // trace, fine tracking. Used for direction select (not for gradient histograms etc.)
 
+            // one block holding dIp and absSquaredGrad of all levels, borrowed from bufferPool if it is set
+            float *imageData = nullptr;
+            shared_ptr<FrameBufferPool> bufferPool = nullptr;
+
             // Photometric Calibration Stuff
             float frameEnergyTH = 8 * 8 * patternNum;    // set dynamically depending on tracking residual
             float ab_exposure = 0;  // the exposure time // 曝光时间
@@ -211,6 +219,35 @@ namespace ldso {
             Vec8 delta = Vec8::Zero();             // state - state_zero.
             int idx = 0;                         // the id in the sliding window, used for constructing matricies
 
+        private:
+            // pyramid images without gradients, level 0 is the input image
+            struct PyramidBands {
+                float *level[PYR_LEVELS];
+                const float *gradWeight2;     // squared response gradient by intensity, null if not used
+                int bandRows;                 // rows of one band at level 0
+                int numBands;
+            };
+
+            /**
+             * one pass over the bands [min, max): downsample each band into the level 1.. rows, then the gradients of
+             * the rows whose neighbours are done, while they are in cache. The row on each side of the range needs a row
+             * of the neighbouring range and is left to makeBoundaryGradients
+             */
+            void makeImages_Reductor(PyramidBands *pyr, int min, int max, Vec10 *stats, int tid);
+
+            // the gradients of the rows left out on both sides of the range boundary at band b, on every level
+            void makeBoundaryGradients(PyramidBands *pyr, int b);
+
+            // dIp / absSquaredGrad of the rows [y0, y1) of a level, no gradient on the first and last row
+            void gradientRows(PyramidBands *pyr, int lvl, int y0, int y1);
+
+            // kernels, see FrameHessianAVX.cc
+            // out[x] = mean of the 2x2 block at (2x, 0) of rows r0 and r1, x < n
+            static void downsampleRow(const float *r0, const float *r1, float *out, int n);
+
+            // central differences of I (width wl) for the pixels [begin, end), written to dI and dabs
+            static void gradients(const float *I, int wl, int begin, int end, const float *gradWeight2, Vec3f *dI,
+                                  float *dabs);
         };
     }
 }
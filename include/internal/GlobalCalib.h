@@ -5,25 +5,72 @@
 #include "NumTypes.h"
 #include "Settings.h"
 
+#include <atomic>
+#include <memory>
+#include <mutex>
+
 namespace ldso {
 
     namespace internal {
 
-        // calibration data as global variables
-        extern int wG[PYR_LEVELS], hG[PYR_LEVELS];
-        extern float fxG[PYR_LEVELS], fyG[PYR_LEVELS],
+        // calibration data of the calling thread, filled by CalibContext::Bind
+        // they are per thread so several systems with different cameras can run in one process
+        extern thread_local int wG[PYR_LEVELS], hG[PYR_LEVELS];
+        extern thread_local float fxG[PYR_LEVELS], fyG[PYR_LEVELS],
                 cxG[PYR_LEVELS], cyG[PYR_LEVELS];
 
-        extern float fxiG[PYR_LEVELS], fyiG[PYR_LEVELS],
+        extern thread_local float fxiG[PYR_LEVELS], fyiG[PYR_LEVELS],
                 cxiG[PYR_LEVELS], cyiG[PYR_LEVELS];
 
-        extern Eigen::Matrix3f KG[PYR_LEVELS], KiG[PYR_LEVELS];
+        extern thread_local Eigen::Matrix3f KG[PYR_LEVELS], KiG[PYR_LEVELS];
+
+        extern thread_local float wM3G;  // w-3
+        extern thread_local float hM3G;  // h-3
+
+        /**
+         * Calibration of one camera at every pyramid level.
+         *
+         * Each FullSystem owns one and binds it (bindCalib) to every thread doing work for it: tracking, mapping, loop
+         * closing and the pool tasks it submits. The code itself keeps reading wG, fxG, pyrLevelsUsed ... of the
+         * calling thread. Binding the already bound context costs a pointer compare.
+         */
+        struct CalibContext {
+        public:
+            EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+
+            CalibContext() {}
+
+            CalibContext(int w, int h, const Eigen::Matrix3f &K) { Set(w, h, K); }
 
-        extern float wM3G;  // w-3
-        extern float hM3G;  // h-3
+            /// compute the pyramid levels and the calibration of each level, threads bound to it copy it again
+            void Set(int w, int h, const Eigen::Matrix3f &K);
 
-        // set each level's calibration
+            /// calibration bound to the calling thread, or the one of the last setGlobalCalib if there is none
+            static shared_ptr<CalibContext> Current();
+
+            int w[PYR_LEVELS] = {0}, h[PYR_LEVELS] = {0};
+            float fx[PYR_LEVELS] = {0}, fy[PYR_LEVELS] = {0}, cx[PYR_LEVELS] = {0}, cy[PYR_LEVELS] = {0};
+            float fxi[PYR_LEVELS] = {0}, fyi[PYR_LEVELS] = {0}, cxi[PYR_LEVELS] = {0}, cyi[PYR_LEVELS] = {0};
+            Eigen::Matrix3f K[PYR_LEVELS], Ki[PYR_LEVELS];
+            float wM3 = 0, hM3 = 0;
+            int pyrLevels = 0;
+
+        private:
+            friend void bindCalib(const shared_ptr<CalibContext> &calib);
+
+            std::atomic<int> version{0};    // changed by Set, so a thread notices it has to copy again
+            std::mutex setMutex;            // held by Set while it writes and by bindCalib while it copies
+        };
+
+        /**
+         * set each level's calibration
+         * this creates a new calibration context, binds it to the calling thread and makes it the default of threads
+         * that have none bound
+         */
         void setGlobalCalib(int w, int h, const Eigen::Matrix3f &K);
+
+        /// copy a calibration into the calling thread's wG, fxG ... and make it its current one, nothing if calib is null
+        void bindCalib(const shared_ptr<CalibContext> &calib);
     }
 }
 
@@ -6,8 +6,14 @@
 #include <mutex>
 #include <condition_variable>
 #include <functional>
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+#include <Eigen/Core>
 
 #include "Settings.h"
+#include "internal/ThreadPool.h"
 
 using namespace std;
 using namespace std::placeholders;
@@ -20,6 +26,18 @@ namespace ldso {
          * Multi thread tasks
          * use reduce function to multi threads a given task
          * like removing outliers or activating points
+         *
+         * The work is executed on a (possibly shared) work-stealing ThreadPool. Chunks are handed out by an atomic
+         * counter and completion is tracked by an atomic barrier, so no lock is taken per chunk. The calling thread
+         * works on its own reduction while waiting, which makes nested reductions (a reduce called from inside a
+         * pool task) safe.
+         *
+         * Each participating thread gets a slot id in [0, NumSlots()) which is passed as the tid argument, so tid
+         * still indexes the per-thread buffers of the callers. As before, every tid that got no chunk is called once
+         * with an empty range (0,0).
+         *
+         * stats is per instance, concurrent reductions should use separate instances on the same pool. The reduction
+         * state is kept by the instance and reused, so a reduction makes no allocation (see ThreadPool::Submit).
          * @tparam Running
          */
         template<typename Running>
@@ -28,145 +46,196 @@ namespace ldso {
         public:
             EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
 
-            inline IndexThreadReduce() {
-                callPerIndex = bind(&IndexThreadReduce::callPerIndexDefault, this, _1, _2, _3, _4);
-                for (int i = 0; i < NUM_THREADS; i++) {
-                    isDone[i] = false;
-                    gotOne[i] = true;
-                    workerThreads[i] = thread(&IndexThreadReduce::workerLoop, this, i);
-                }
+            inline IndexThreadReduce() : IndexThreadReduce(ThreadPool::Global()) {}
 
+            inline explicit IndexThreadReduce(shared_ptr<ThreadPool> pool) : pool(pool), job(pool->NumThreads()) {
+                memset(&stats, 0, sizeof(Running));
             }
 
             inline ~IndexThreadReduce() {
-                running = false;
-
-                exMutex.lock();
-                todo_signal.notify_all();
-                exMutex.unlock();
-
-                for (int i = 0; i < NUM_THREADS; i++)
-                    workerThreads[i].join();
-
-
+                // tickets of past reductions may still be queued in the pool, they point to job
+                while (job.outstanding.load() > 0)
+                    this_thread::yield();
                 printf("destroyed ThreadReduce\n");
-
             }
 
-            inline void
-            reduce(function<void(int, int, Running *, int)> callPerIndex, int first, int end, int stepSize = 0) {
+            /**
+             * call callPerIndex(min, max, stats, tid) on chunks of [first, end), on the pool
+             * callPerIndex is called through a const reference and is not copied, so a reduction allocates nothing
+             * @param stepSize chunk size, 0: one chunk per slot
+             */
+            template<typename CallPerIndex>
+            inline void reduce(const CallPerIndex &callPerIndex, int first, int end, int stepSize = 0) {
 
                 memset(&stats, 0, sizeof(Running));
 
+                const int numSlots = NumSlots();
                 if (stepSize == 0)
-                    stepSize = ((end - first) + NUM_THREADS - 1) / NUM_THREADS;
-
-                unique_lock<mutex> lock(exMutex);
-
-                // save
-                this->callPerIndex = callPerIndex;
-                nextIndex = first;
-                maxIndex = end;
-                this->stepSize = stepSize;
-
-                // go worker threads!
-                for (int i = 0; i < NUM_THREADS; i++) {
-                    isDone[i] = false;
-                    gotOne[i] = false;
+                    stepSize = ((end - first) + numSlots - 1) / numSlots;
+
+                // the job is reused, only a reduction started while it runs (from another thread or nested in one of
+                // its tasks) gets its own
+                shared_ptr<Job> ownJob;
+                Job *j = &job;
+                if (job.busy.exchange(true)) {
+                    ownJob.reset(new Job(numSlots));
+                    j = ownJob.get();
+                }
+                unsigned gen = j->start(&callPerIndex, &invoke<CallPerIndex>, first, end, stepSize);
+
+                // one ticket per additional participant, a ticket arriving after everything is done just returns
+                int numTickets = std::min(numSlots - 1, j->numChunks - 1);
+                for (int i = 0; i < numTickets; i++) {
+                    j->outstanding.fetch_add(1);
+                    if (ownJob)
+                        pool->Submit([ownJob, gen] { ownJob->ticket(gen); });
+                    else
+                        pool->Submit([j, gen] { j->ticket(gen); });
                 }
 
-                // let them start!
-                todo_signal.notify_all();
-
+                j->participate();
+                j->waitDone();
 
-                // wait for all worker threads to signal they are done.
-                while (true) {
-                    // wait for at least one to finish
-                    done_signal.wait(lock);
+                // the tids that didn't get any chunk are called once with an empty range
+                for (int t = 0; t < numSlots; t++) {
+                    if (!j->slotUsed[t]) {
+                        Running s;
+                        memset(&s, 0, sizeof(Running));
+                        callPerIndex(0, 0, &s, t);
+                        j->slotStats[t] += s;
+                    }
+                    stats += j->slotStats[t];
+                }
 
-                    // check if actually all are finished.
-                    bool allDone = true;
-                    for (int i = 0; i < NUM_THREADS; i++)
-                        allDone = allDone && isDone[i];
+                if (!ownJob)
+                    job.busy.store(false);
+            }
 
-                    // all are finished! exit.
-                    if (allDone)
-                        break;
-                }
+            /// number of distinct tid values handed to the reduce functions
+            inline int NumSlots() const {
+                return pool->NumThreads();
+            }
 
-                nextIndex = 0;
-                maxIndex = 0;
-                this->callPerIndex = bind(&IndexThreadReduce::callPerIndexDefault, this, _1, _2, _3, _4);
+            inline shared_ptr<ThreadPool> GetPool() const {
+                return pool;
             }
 
             Running stats;
 
         private:
-            thread workerThreads[NUM_THREADS];
-            bool isDone[NUM_THREADS];
-            bool gotOne[NUM_THREADS];
-
-            mutex exMutex;
-            condition_variable todo_signal;
-            condition_variable done_signal;
-
-            int nextIndex =0;
-            int maxIndex =0;
-            int stepSize =1;
 
-            bool running =true;
+            typedef void (*Invoker)(const void *callPerIndex, int min, int max, Running *stats, int tid);
 
-            function<void(int, int, Running *, int)> callPerIndex;
-
-            void callPerIndexDefault(int i, int j, Running *k, int tid) {
-                printf("ERROR: should never be called....\n");
-                assert(false);
+            template<typename CallPerIndex>
+            static void invoke(const void *callPerIndex, int min, int max, Running *stats, int tid) {
+                (*static_cast<const CallPerIndex *>(callPerIndex))(min, max, stats, tid);
             }
 
-            void workerLoop(int idx) {
-                unique_lock<mutex> lock(exMutex);
-
-                while (running) {
-                    // try to get something to do.
-                    int todo = 0;
-                    bool gotSomething = false;
-                    if (nextIndex < maxIndex) {
-                        // got something!
-                        todo = nextIndex;
-                        nextIndex += stepSize;
-                        gotSomething = true;
+            /**
+             * State of one reduction. The pool tasks (tickets) carry the generation of the reduction they were
+             * submitted for, a ticket of an earlier one runs nothing, so the job can be reused by the next reduction
+             * while old tickets are still queued.
+             */
+            struct Job {
+                EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+
+                explicit Job(int numSlots) : numSlots(numSlots), slotUsed(numSlots, 0), slotStats(numSlots) {}
+
+                // set up the next reduction, returns its generation
+                unsigned start(const void *callable, Invoker invoker, int first, int end, int stepSize) {
+                    unsigned gen = generation.fetch_add(1) + 1;
+                    // participants of the previous reduction that got past the generation check leave first
+                    while (active.load() > 0)
+                        this_thread::yield();
+
+                    this->callable = callable;
+                    this->invoker = invoker;
+                    this->first = first;
+                    this->end = end;
+                    this->stepSize = stepSize;
+                    numChunks = (end > first && stepSize > 0) ? (end - first + stepSize - 1) / stepSize : 0;
+                    nextChunk.store(0);
+                    nextSlot.store(0);
+                    chunksDone.store(0);
+                    for (int t = 0; t < numSlots; t++) {
+                        slotUsed[t] = 0;
+                        memset(&slotStats[t], 0, sizeof(Running));
                     }
+                    return gen;
+                }
 
-                    // if got something: do it (unlock in the meantime)
-                    if (gotSomething) {
-                        lock.unlock();
+                // a pool task of the reduction gen
+                void ticket(unsigned gen) {
+                    active.fetch_add(1);
+                    if (generation.load() == gen)
+                        participate();
+                    active.fetch_sub(1);
+                    outstanding.fetch_sub(1);
+                }
+
+                // grab a slot and process chunks until none are left
+                void participate() {
+                    if (nextChunk.load(memory_order_relaxed) >= numChunks)
+                        return;
+                    int slot = nextSlot.fetch_add(1);
+                    if (slot >= numSlots)
+                        return;
 
-                        assert(callPerIndex != 0);
+                    while (true) {
+                        int c = nextChunk.fetch_add(1);
+                        if (c >= numChunks)
+                            break;
+                        int todo = first + c * stepSize;
 
                         Running s;
                         memset(&s, 0, sizeof(Running));
-                        callPerIndex(todo, std::min(todo + stepSize, maxIndex), &s, idx);
-                        gotOne[idx] = true;
-                        lock.lock();
-                        stats += s;
-                    } // otherwise wait on signal, releasing lock in the meantime.
-                    else {
-                        if (!gotOne[idx]) {
-                            lock.unlock();
-                            assert(callPerIndex != 0);
-                            Running s;
-                            memset(&s, 0, sizeof(Running));
-                            callPerIndex(0, 0, &s, idx);
-                            gotOne[idx] = true;
-                            lock.lock();
-                            stats += s;
+                        invoker(callable, todo, std::min(todo + stepSize, end), &s, slot);
+                        slotStats[slot] += s;
+                        slotUsed[slot] = 1;
+
+                        if (chunksDone.fetch_add(1) + 1 == numChunks) {
+                            unique_lock<mutex> lock(doneMutex);
+                            done_signal.notify_all();
                         }
-                        isDone[idx] = true;
-                        done_signal.notify_all();
-                        todo_signal.wait(lock);
                     }
                 }
-            }
+
+                void waitDone() {
+                    // chunks are usually short, spin a little before sleeping
+                    for (int i = 0; i < 1000 && chunksDone.load() < numChunks; i++)
+                        this_thread::yield();
+                    if (chunksDone.load() < numChunks) {
+                        unique_lock<mutex> lock(doneMutex);
+                        done_signal.wait(lock, [this] { return chunksDone.load() >= numChunks; });
+                    }
+                }
+
+                const void *callable = nullptr;
+                Invoker invoker = nullptr;
+                int first = 0;
+                int end = 0;
+                int stepSize = 1;
+                int numSlots = 0;
+                int numChunks = 0;
+
+                atomic<int> nextChunk{0};
+                atomic<int> nextSlot{0};
+                atomic<int> chunksDone{0};
+
+                atomic<unsigned> generation{0};
+                atomic<int> active{0};          // tickets between their generation check and their end
+                atomic<int> outstanding{0};     // tickets submitted and not finished
+                atomic<bool> busy{false};       // a reduction is running on it
+
+                vector<char> slotUsed;
+                vector<Running, Eigen::aligned_allocator<Running>> slotStats;
+
+                mutex doneMutex;
+                condition_variable done_signal;
+            };
+
+            shared_ptr<ThreadPool> pool;
+            Job job;
         };
 
     }
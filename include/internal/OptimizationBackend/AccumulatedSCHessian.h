@@ -18,17 +18,16 @@ namespace ldso {
         public:
             EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
 
-            inline AccumulatedSCHessianSSE() {
-                for (int i = 0; i < NUM_THREADS; i++) {
-                    accE[i] = 0;
-                    accEB[i] = 0;
-                    accD[i] = 0;
-                    nframes[i] = 0;
-                }
+            /**
+             * @param numThreads number of thread slots (tids) the reducer uses, each gets its own accumulators
+             */
+            inline explicit AccumulatedSCHessianSSE(int numThreads = 1) :
+                    accE(numThreads, nullptr), accEB(numThreads, nullptr), accD(numThreads, nullptr),
+                    accHcc(numThreads), accbc(numThreads), nframes(numThreads, 0), capacity(numThreads, 0) {
             };
 
             inline ~AccumulatedSCHessianSSE() {
-                for (int i = 0; i < NUM_THREADS; i++) {
+                for (size_t i = 0; i < nframes.size(); i++) {
                     if (accE[i] != 0) delete[] accE[i];
                     if (accEB[i] != 0) delete[] accEB[i];
                     if (accD[i] != 0) delete[] accD[i];
@@ -36,13 +35,15 @@ namespace ldso {
             };
 
             inline void setZero(int n, int min = 0, int max = 1, Vec10 *stats = 0, int tid = 0) {
-                if (n != nframes[tid]) {
+                // the arrays only grow, they are allocated for a full window at once
+                if (n > capacity[tid]) {
                     if (accE[tid] != 0) delete[] accE[tid];
                     if (accEB[tid] != 0) delete[] accEB[tid];
                     if (accD[tid] != 0) delete[] accD[tid];
-                    accE[tid] = new AccumulatorXX<8, CPARS>[n * n];
-                    accEB[tid] = new AccumulatorX<8>[n * n];
-                    accD[tid] = new AccumulatorXX<8, 8>[n * n * n];
+                    int c = capacity[tid] = std::max(n, setting_maxFrames + 1);
+                    accE[tid] = new AccumulatorXX<8, CPARS>[c * c];
+                    accEB[tid] = new AccumulatorX<8>[c * c];
+                    accD[tid] = new AccumulatorXX<8, 8>[c * c * c];
                 }
                 accbc[tid].initialize();
                 accHcc[tid].initialize();
@@ -57,52 +58,75 @@ namespace ldso {
                 nframes[tid] = n;
             }
 
-            void stitchDouble(MatXX &H_sc, VecX &b_sc, const EnergyFunctional * const, int tid = 0);
-
-            void addPoint( shared_ptr<PointHessian> p, bool shiftPriorToZero, int tid = 0);
+            void addPoint(const shared_ptr<PointHessian> &p, bool shiftPriorToZero, int tid = 0);
 
-            void stitchDoubleMT(IndexThreadReduce<Vec10>* red, MatXX &H, VecX &b, EnergyFunctional const *const EF,
-                                bool MT) {
+            /**
+             * stitch the accumulated blocks into the top left nframes * 8 + CPARS corner of H and b, the rest of them
+             * is left untouched so they can be allocated once for the largest window
+             * @param Hs, bs per-thread buffers of the multi-threaded stitch, NumThreads() of them at least as large
+             */
+            void stitchDoubleMT(IndexThreadReduce<Vec10>* red, MatXX &H, VecX &b, vector<MatXX> &Hs, vector<VecX> &bs,
+                                EnergyFunctional const *const EF, bool MT) {
                 // sum up, splitting by bock in square.
                 if (MT) {
-                    MatXX Hs[NUM_THREADS];
-                    VecX bs[NUM_THREADS];
-                    for (int i = 0; i < NUM_THREADS; i++) {
-                        assert(nframes[0] == nframes[i]);
-                        Hs[i] = MatXX::Zero(nframes[0] * 8 + CPARS, nframes[0] * 8 + CPARS);
-                        bs[i] = VecX::Zero(nframes[0] * 8 + CPARS);
-                    }
+                    assert(red->NumSlots() == NumThreads());
+                    clearStitchBuffersMT(Hs, bs);
 
                     red->reduce(std::bind(&AccumulatedSCHessianSSE::stitchDoubleInternal,
-                                          this, Hs, bs, EF, _1, _2, _3, _4), 0, nframes[0] * nframes[0], 0);
+                                          this, Hs.data(), bs.data(), EF, _1, _2, _3, _4), 0,
+                                nframes[0] * nframes[0], 0);
 
-                    // sum up results
-                    H = Hs[0];
-                    b = bs[0];
-
-                    for (int i = 1; i < NUM_THREADS; i++) {
-                        H.noalias() += Hs[i];
-                        b.noalias() += bs[i];
-                    }
+                    finishStitchMT(Hs, bs, H, b);
                 } else {
-                    H = MatXX::Zero(nframes[0] * 8 + CPARS, nframes[0] * 8 + CPARS);
-                    b = VecX::Zero(nframes[0] * 8 + CPARS);
+                    const int dim = nframes[0] * 8 + CPARS;
+                    H.topLeftCorner(dim, dim).setZero();
+                    b.head(dim).setZero();
                     stitchDoubleInternal(&H, &b, EF, 0, nframes[0] * nframes[0], 0, -1);
+                    copyTransposedParts(H);
                 }
+            }
 
-                // make diagonal by copying over parts.
-                for (int h = 0; h < nframes[0]; h++) {
-                    int hIdx = CPARS + h * 8;
-                    H.block<CPARS, 8>(0, hIdx).noalias() = H.block<8, CPARS>(hIdx, 0).transpose();
+            /// zero the per-thread buffers of a multi-threaded stitchDoubleInternal over nframes^2 frame pairs
+            inline void clearStitchBuffersMT(vector<MatXX> &Hs, vector<VecX> &bs) const {
+                const int dim = nframes[0] * 8 + CPARS;
+                assert((int) Hs.size() >= NumThreads() && (int) bs.size() >= NumThreads());
+                for (int i = 0; i < NumThreads(); i++) {
+                    assert(nframes[0] == nframes[i]);
+                    assert(Hs[i].rows() >= dim && bs[i].size() >= dim);
+                    Hs[i].topLeftCorner(dim, dim).setZero();
+                    bs[i].head(dim).setZero();
                 }
             }
 
-            AccumulatorXX<8, CPARS> *accE[NUM_THREADS];
-            AccumulatorX<8> *accEB[NUM_THREADS];
-            AccumulatorXX<8, 8> *accD[NUM_THREADS];
-            AccumulatorXX<CPARS, CPARS> accHcc[NUM_THREADS];
-            AccumulatorX<CPARS> accbc[NUM_THREADS];
-            int nframes[NUM_THREADS];
+            /// sum up the per-thread results of stitchDoubleInternal into the top left corner of H and b
+            inline void finishStitchMT(const vector<MatXX> &Hs, const vector<VecX> &bs, MatXX &H, VecX &b) const {
+                const int dim = nframes[0] * 8 + CPARS;
+                H.topLeftCorner(dim, dim) = Hs[0].topLeftCorner(dim, dim);
+                b.head(dim) = bs[0].head(dim);
+
+                for (int i = 1; i < NumThreads(); i++) {
+                    H.topLeftCorner(dim, dim) += Hs[i].topLeftCorner(dim, dim);
+                    b.head(dim) += bs[i].head(dim);
+                }
+                copyTransposedParts(H);
+            }
+
+            void stitchDoubleInternal(
+                    MatXX *H, VecX *b, EnergyFunctional const *const EF,
+                    int min, int max, Vec10 *stats, int tid);
+
+            /// number of per-thread accumulator sets
+            inline int NumThreads() const {
+                return int(nframes.size());
+            }
+
+            vector<AccumulatorXX<8, CPARS> *> accE;
+            vector<AccumulatorX<8> *> accEB;
+            vector<AccumulatorXX<8, 8> *> accD;
+            vector<AccumulatorXX<CPARS, CPARS>, Eigen::aligned_allocator<AccumulatorXX<CPARS, CPARS>>> accHcc;
+            vector<AccumulatorX<CPARS>, Eigen::aligned_allocator<AccumulatorX<CPARS>>> accbc;
+            vector<int> nframes;
+            vector<int> capacity;   // number of frames the arrays are allocated for
 
             void addPointsInternal(
                     std::vector<shared_ptr<PointHessian>> *points, bool shiftPriorToZero,
@@ -112,9 +136,13 @@ namespace ldso {
 
         private:
 
-            void stitchDoubleInternal(
-                    MatXX *H, VecX *b, EnergyFunctional const *const EF,
-                    int min, int max, Vec10 *stats, int tid);
+            // make diagonal by copying over parts.
+            inline void copyTransposedParts(MatXX &H) const {
+                for (int h = 0; h < nframes[0]; h++) {
+                    int hIdx = CPARS + h * 8;
+                    H.block<CPARS, 8>(0, hIdx).noalias() = H.block<8, CPARS>(hIdx, 0).transpose();
+                }
+            }
         };
 
     }
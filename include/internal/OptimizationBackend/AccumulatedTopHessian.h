@@ -21,29 +21,29 @@ namespace ldso {
         public:
             EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
 
-            inline AccumulatedTopHessianSSE() {
-                for (int tid = 0; tid < NUM_THREADS; tid++) {
-                    nres[tid] = 0;
-                    acc[tid] = 0;
-                    nframes[tid] = 0;
-                }
-
+            /**
+             * @param numThreads number of thread slots (tids) the reducer uses, each gets its own accumulators
+             */
+            inline explicit AccumulatedTopHessianSSE(int numThreads = 1) :
+                    nframes(numThreads, 0), acc(numThreads, nullptr), nres(numThreads, 0), capacity(numThreads, 0) {
             };
 
             inline ~AccumulatedTopHessianSSE() {
-                for (int tid = 0; tid < NUM_THREADS; tid++) {
+                for (size_t tid = 0; tid < acc.size(); tid++) {
                     if (acc[tid] != 0) delete[] acc[tid];
                 }
             };
 
             inline void setZero(int nFrames, int min = 0, int max = 1, Vec10 *stats = 0, int tid = 0) {
 
-                if (nFrames != nframes[tid]) {
+                // the array only grows, it is allocated for a full window at once
+                if (nFrames > capacity[tid]) {
                     if (acc[tid] != 0) delete[] acc[tid];
+                    capacity[tid] = std::max(nFrames, setting_maxFrames + 1);
 #if USE_XI_MODEL
-                    acc[tid] = new Accumulator14[nFrames*nFrames];
+                    acc[tid] = new Accumulator14[capacity[tid] * capacity[tid]];
 #else
-                    acc[tid] = new AccumulatorApprox[nFrames * nFrames];
+                    acc[tid] = new AccumulatorApprox[capacity[tid] * capacity[tid]];
 #endif
                 }
 
@@ -54,59 +54,75 @@ namespace ldso {
 
             }
 
-            void stitchDouble(MatXX &H, VecX &b, EnergyFunctional const *const EF, bool usePrior, bool useDelta,
-                              int tid = 0);
-
             template<int mode>
-            void addPoint(shared_ptr<PointHessian> p, EnergyFunctional const *const ef, int tid = 0);
+            void addPoint(const shared_ptr<PointHessian> &p, EnergyFunctional const *const ef, int tid = 0);
 
 
-            void stitchDoubleMT(IndexThreadReduce<Vec10>* red, MatXX &H, VecX &b, EnergyFunctional const *const EF,
-                                bool usePrior, bool MT) {
+            /**
+             * stitch the accumulated blocks into the top left nframes * 8 + CPARS corner of H and b, the rest of them
+             * is left untouched so they can be allocated once for the largest window
+             * @param Hs, bs per-thread buffers of the multi-threaded stitch, NumThreads() of them at least as large
+             */
+            void stitchDoubleMT(IndexThreadReduce<Vec10>* red, MatXX &H, VecX &b, vector<MatXX> &Hs, vector<VecX> &bs,
+                                EnergyFunctional const *const EF, bool usePrior, bool MT) {
                 // sum up, splitting by bock in square.
                 if (MT) {
-                    MatXX Hs[NUM_THREADS];
-                    VecX bs[NUM_THREADS];
-                    for (int i = 0; i < NUM_THREADS; i++) {
-                        assert(nframes[0] == nframes[i]);
-                        Hs[i] = MatXX::Zero(nframes[0] * 8 + CPARS, nframes[0] * 8 + CPARS);
-                        bs[i] = VecX::Zero(nframes[0] * 8 + CPARS);
-                    }
+                    assert(red->NumSlots() == NumThreads());
+                    clearStitchBuffersMT(Hs, bs);
 
                     red->reduce(bind(&AccumulatedTopHessianSSE::stitchDoubleInternal,
-                                     this, Hs, bs, EF, usePrior, _1, _2, _3, _4), 0, nframes[0] * nframes[0], 0);
-
-                    // sum up results
-                    H = Hs[0];
-                    b = bs[0];
+                                     this, Hs.data(), bs.data(), EF, usePrior, _1, _2, _3, _4), 0,
+                                nframes[0] * nframes[0], 0);
 
-                    for (int i = 1; i < NUM_THREADS; i++) {
-                        H.noalias() += Hs[i];
-                        b.noalias() += bs[i];
-                        nres[0] += nres[i];
-                    }
+                    finishStitchMT(Hs, bs, H, b);
                 } else {
-                    H = MatXX::Zero(nframes[0] * 8 + CPARS, nframes[0] * 8 + CPARS);
-                    b = VecX::Zero(nframes[0] * 8 + CPARS);
+                    const int dim = nframes[0] * 8 + CPARS;
+                    H.topLeftCorner(dim, dim).setZero();
+                    b.head(dim).setZero();
                     stitchDoubleInternal(&H, &b, EF, usePrior, 0, nframes[0] * nframes[0], 0, -1);
+                    copyTransposedParts(H);
                 }
+            }
 
-                // make diagonal by copying over parts.
-                for (int h = 0; h < nframes[0]; h++) {
-                    int hIdx = CPARS + h * 8;
-                    H.block<CPARS, 8>(0, hIdx).noalias() = H.block<8, CPARS>(hIdx, 0).transpose();
+            /// zero the per-thread buffers of a multi-threaded stitchDoubleInternal over nframes^2 frame pairs
+            inline void clearStitchBuffersMT(vector<MatXX> &Hs, vector<VecX> &bs) const {
+                const int dim = nframes[0] * 8 + CPARS;
+                assert((int) Hs.size() >= NumThreads() && (int) bs.size() >= NumThreads());
+                for (int i = 0; i < NumThreads(); i++) {
+                    assert(nframes[0] == nframes[i]);
+                    assert(Hs[i].rows() >= dim && bs[i].size() >= dim);
+                    Hs[i].topLeftCorner(dim, dim).setZero();
+                    bs[i].head(dim).setZero();
+                }
+            }
 
-                    for (int t = h + 1; t < nframes[0]; t++) {
-                        int tIdx = CPARS + t * 8;
-                        H.block<8, 8>(hIdx, tIdx).noalias() += H.block<8, 8>(tIdx, hIdx).transpose();
-                        H.block<8, 8>(tIdx, hIdx).noalias() = H.block<8, 8>(hIdx, tIdx).transpose();
-                    }
+            /// sum up the per-thread results of stitchDoubleInternal into the top left corner of H and b
+            inline void finishStitchMT(const vector<MatXX> &Hs, const vector<VecX> &bs, MatXX &H, VecX &b) {
+                const int dim = nframes[0] * 8 + CPARS;
+                H.topLeftCorner(dim, dim) = Hs[0].topLeftCorner(dim, dim);
+                b.head(dim) = bs[0].head(dim);
+
+                for (int i = 1; i < NumThreads(); i++) {
+                    H.topLeftCorner(dim, dim) += Hs[i].topLeftCorner(dim, dim);
+                    b.head(dim) += bs[i].head(dim);
+                    nres[0] += nres[i];
                 }
+                copyTransposedParts(H);
+            }
+
+            void stitchDoubleInternal(
+                    MatXX *H, VecX *b, EnergyFunctional const *const EF, bool usePrior,
+                    int min, int max, Vec10 *stats, int tid);
+
+            /// number of per-thread accumulator sets
+            inline int NumThreads() const {
+                return int(acc.size());
             }
 
-            int nframes[NUM_THREADS];
-            EIGEN_ALIGN16 AccumulatorApprox *acc[NUM_THREADS];
-            int nres[NUM_THREADS];
+            vector<int> nframes;
+            vector<AccumulatorApprox *> acc;
+            vector<int> nres;
+            vector<int> capacity;   // number of frames acc is allocated for
 
             template<int mode>
             inline void addPointsInternal(
@@ -119,9 +135,19 @@ namespace ldso {
 
         private:
 
-            void stitchDoubleInternal(
-                    MatXX *H, VecX *b, EnergyFunctional const *const EF, bool usePrior,
-                    int min, int max, Vec10 *stats, int tid);
+            // make diagonal by copying over parts.
+            inline void copyTransposedParts(MatXX &H) const {
+                for (int h = 0; h < nframes[0]; h++) {
+                    int hIdx = CPARS + h * 8;
+                    H.block<CPARS, 8>(0, hIdx).noalias() = H.block<8, CPARS>(hIdx, 0).transpose();
+
+                    for (int t = h + 1; t < nframes[0]; t++) {
+                        int tIdx = CPARS + t * 8;
+                        H.block<8, 8>(hIdx, tIdx).noalias() += H.block<8, 8>(tIdx, hIdx).transpose();
+                        H.block<8, 8>(tIdx, hIdx).noalias() = H.block<8, 8>(hIdx, tIdx).transpose();
+                    }
+                }
+            }
         };
     }
 }
@@ -0,0 +1,65 @@
+#pragma once
+#ifndef LDSO_BLOCK_CHOLESKY_H_
+#define LDSO_BLOCK_CHOLESKY_H_
+
+#include "NumTypes.h"
+
+#include <vector>
+
+using namespace std;
+
+namespace ldso {
+
+    namespace internal {
+
+        /**
+         * Cholesky decomposition of the reduced camera system of the sliding window, on its 8x8 frame blocks.
+         *
+         * The system has the layout of the EnergyFunctional: CPARS calibration parameters, then 8 parameters per
+         * frame. The calibration is eliminated last (it is coupled with every frame), the frames in window order.
+         * A frame pair that shares no residual, no point and no marginalization prior has an exactly zero block;
+         * zero blocks are skipped and only the fill-in of the elimination is computed, every block operation is a
+         * fixed size 8x8 (or CPARS x 8) product.
+         *
+         * Unlike the dense LDLT there is no pivoting, Compute fails on a system that is not positive definite and
+         * the caller has to fall back to the dense solver.
+         */
+        class BlockCholesky {
+        public:
+            EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+
+            /// make room for nFrames frames, the storage only grows
+            void Reserve(int nFrames);
+
+            /**
+             * factorize H, of dimension CPARS + 8 * nFrames, only its lower triangle is read
+             * @return false if H is not positive definite
+             */
+            bool Compute(const Eigen::Ref<const MatXX> &H, int nFrames);
+
+            /// solve H x = b with the last decomposition, x is written into b
+            void SolveInPlace(Eigen::Ref<VecX> b) const;
+
+            /// number of nonzero frame blocks below the diagonal in the last decomposition, fill-in included
+            inline int NumOffDiagonalBlocks() const { return numOffDiagonal; }
+
+        private:
+            inline Mat88 &L(int i, int j) { return Lff[i * frameCapacity + j]; }
+
+            inline const Mat88 &L(int i, int j) const { return Lff[i * frameCapacity + j]; }
+
+            inline bool nonZero(int i, int j) const { return nz[i * frameCapacity + j] != 0; }
+
+            int frameCapacity = 0;
+            int nFrames = 0;
+            int numOffDiagonal = 0;
+
+            vector<Mat88, Eigen::aligned_allocator<Mat88>> Lff;     // frame x frame blocks, lower triangle
+            vector<MatC8, Eigen::aligned_allocator<MatC8>> Lcf;     // calibration x frame blocks
+            MatCC Lcc;                                              // calibration block
+            vector<char> nz;                                        // nonzero pattern of Lff
+        };
+    }
+}
+
+#endif // LDSO_BLOCK_CHOLESKY_H_
@@ -8,6 +8,7 @@
 #include "internal/CalibHessian.h"
 #include "internal/OptimizationBackend/AccumulatedTopHessian.h"
 #include "internal/OptimizationBackend/AccumulatedSCHessian.h"
+#include "internal/OptimizationBackend/SolverWorkspace.h"
 
 namespace ldso {
     namespace internal {
@@ -51,7 +52,10 @@ namespace ldso {
 
             friend class FeatureObsResidual;
 
-            EnergyFunctional();
+            /**
+             * @param numThreads number of thread slots of the reducer set in red, sizes the per-thread accumulators
+             */
+            explicit EnergyFunctional(int numThreads = 1);
 
             ~EnergyFunctional();
 
@@ -84,6 +88,8 @@ namespace ldso {
 
             /**
              * marginalize a given frame
+             * The frame is moved to the end of the prior and eliminated in place, HM and bM shrink by 8 without
+             * reallocating.
              * @param fh
              */
             void marginalizeFrame(shared_ptr<FrameHessian> fh);
@@ -95,7 +101,13 @@ namespace ldso {
             void removePoint(shared_ptr<PointHessian> ph);
 
             /**
-             * Marg all points to compute Bundle Adjustment
+             * queue a point flagged as MARGINALIZED, for the next marginalizePointsF
+             * @param ph
+             */
+            void queuePointForMarg(shared_ptr<PointHessian> ph);
+
+            /**
+             * Marg the queued points into the prior (HM, bM), then clear the queue
              */
             void marginalizePointsF();
 
@@ -147,17 +159,23 @@ namespace ldso {
              */
             void setAdjointsF(shared_ptr<CalibHessian> Hcalib);
 
+            /**
+             * build the projection used by orthogonalize from lastNullspaces_pose and lastNullspaces_scale
+             * call it whenever they changed, the solver iterations then only apply it
+             */
+            void makeNullspaceProjector();
+
             // all related frames
             std::vector<shared_ptr<FrameHessian>> frames;
             int nPoints = 0, nFrames = 0, nResiduals = 0;
 
-            MatXX HM = MatXX::Zero(CPARS, CPARS);   // frame-frame H matrix
-            VecX bM = VecX::Zero(CPARS);    // frame-frame b vector
+            // frame-frame H matrix and b vector of the prior, mapped onto the top left corner of HMStorage and
+            // bMStorage, which are allocated for a full window and only grow
+            Eigen::Map<MatXX, 0, Eigen::OuterStride<>> HM;
+            Eigen::Map<VecX> bM;
 
             int resInA = 0, resInL = 0, resInM = 0;
 
-            MatXX lastHS;
-            VecX lastbS;
             VecX lastX;
 
             std::vector<VecX> lastNullspaces_forLogging;
@@ -180,14 +198,24 @@ namespace ldso {
         private:
             /// I really don't know what are they doing in the private functions
 
-            VecX getStitchedDeltaF() const {
-                VecX d = VecX(CPARS + nFrames * 8);
+            /// stitch the deltas into the head of ws.delta
+            Eigen::VectorBlock<VecX> getStitchedDeltaF() {
+                Eigen::VectorBlock<VecX> d = ws.delta.head(CPARS + nFrames * 8);
                 d.head<CPARS>() = cDeltaF.cast<double>();
                 for (int h = 0; h < nFrames; h++)
                     d.segment<8>(CPARS + 8 * h) = frames[h]->delta;
                 return d;
             }
 
+            /// allocate the adjoint arrays for at least nFrames^2 frame pairs, they only grow
+            void reserveAdjoints(int nFrames);
+
+            /// map HM and bM onto dim x dim of their storage, growing it (and keeping the prior) if needed
+            void resizePrior(int dim);
+
+            /// reverse the order of the rows and columns [begin, end) of the prior
+            void reversePrior(int begin, int end);
+
             /**
              * substitute the variable x into frameHessians
              */
@@ -199,17 +227,30 @@ namespace ldso {
             void resubstituteFPt(const VecCf &xc, Mat18f *xAd, int min, int max, Vec10 *stats,
                                  int tid);
 
-            void accumulateAF_MT(MatXX &H, VecX &b, bool MT);
+            /**
+             * accumulate the active (A) and linearized (L) top hessians and the Schur complement of the points (sc)
+             * in a single sweep over allPoints, each point is loaded once for the three of them
+             * The results are in the top left corner of ws.HA, ws.HL, ws.Hsc and the heads of ws.bA, ws.bL, ws.bsc.
+             */
+            void accumulateF_MT(bool MT);
 
-            void accumulateLF_MT(MatXX &H, VecX &b, bool MT);
+            void setZeroAccumulatorsF(int min, int max, Vec10 *stats, int tid);
 
-            void accumulateSCF_MT(MatXX &H, VecX &b, bool MT);
+            void accumulatePointsF(int min, int max, Vec10 *stats, int tid);
 
             void calcLEnergyPt(int min, int max, Vec10 *stats, int tid);
 
-            void orthogonalize(VecX *b, MatXX *H);
+            /**
+             * project the last pose and scale nullspaces out of b (and H), with the projector of
+             * makeNullspaceProjector
+             */
+            void orthogonalize(Eigen::Ref<VecX> b);
+
+            void orthogonalize(Eigen::Ref<VecX> b, Eigen::Ref<MatXX> H);
 
             // don't use shared_ptr to handle dynamic arrays
+            // they are indexed by the current nFrames and allocated for adCapacity frames
+            int adCapacity = 0;
             Mat18f *adHTdeltaF = nullptr;
 
             Mat88 *adHost = nullptr;    // arrays of adjoints, adHost = -Adj(HostToTarget)^T
@@ -226,8 +267,13 @@ namespace ldso {
             shared_ptr<AccumulatedTopHessianSSE> accSSE_top_A;
             shared_ptr<AccumulatedSCHessianSSE> accSSE_bot;
 
+            SolverWorkspace ws;
+
+            MatXX HMStorage;
+            VecX bMStorage;
+
             std::vector<shared_ptr<PointHessian>> allPoints;
-            std::vector<shared_ptr<PointHessian>> allPointsToMarg;
+            std::vector<shared_ptr<PointHessian>> allPointsToMarg;     // queued by queuePointForMarg
 
             float currentLambda = 0;
         };
@@ -1107,7 +1107,7 @@ namespace ldso {
 
             Mat99f H;
             Vec9f b;
-            size_t num;
+            size_t num;     // points accumulated: updateSSE* add 4, updateSingle* 1, updateLanes numPoints
 
             inline void initialize() {
                 H.setZero();
@@ -1613,6 +1613,21 @@ namespace ldso {
                 shiftUp(false);
             }
 
+            /**
+             * add partial sums in the layout of updateSSE (45 entries of 4 lanes), e.g. folded down by the 256 and
+             * 512 bit kernels of CoarseTracker. Keep blocks to a few hundred points so the summation stays precise.
+             * @param lanes 4*45 floats, 16 byte aligned
+             * @param numPoints number of points summed up in lanes, counted in num like updateSSE counts its 4
+             */
+            inline void updateLanes(const float *lanes, int numPoints) {
+                for (int i = 0; i < 45; i++)
+                    _mm_store_ps(SSEData + 4 * i, _mm_add_ps(_mm_load_ps(SSEData + 4 * i), _mm_load_ps(lanes + 4 * i)));
+                num += numPoints;
+                // as many additions per lane as updateSSE calls for these points
+                numIn1 += (numPoints + 3) / 4;
+                shiftUp(false);
+            }
+
 
         private:
             EIGEN_ALIGN16 float SSEData[4 * 45];
@@ -0,0 +1,116 @@
+#pragma once
+#ifndef LDSO_SOLVER_WORKSPACE_H_
+#define LDSO_SOLVER_WORKSPACE_H_
+
+#include "NumTypes.h"
+#include "internal/OptimizationBackend/BlockCholesky.h"
+
+#include <Eigen/Cholesky>
+
+#include <memory>
+#include <vector>
+
+using namespace std;
+
+namespace ldso {
+
+    namespace internal {
+
+        /// grow m to at least dim x dim, it is not touched if it is large enough already
+        inline void reserveDense(MatXX &m, int dim) {
+            if (m.rows() < dim || m.cols() < dim)
+                m.resize(dim, dim);
+        }
+
+        /// grow v to at least dim entries, it is not touched if it is large enough already
+        template<typename Vector>
+        inline void reserveDense(Vector &v, int dim) {
+            if (v.size() < dim)
+                v.resize(dim);
+        }
+
+        /**
+         * Dense buffers of the sliding window solver, kept by the EnergyFunctional across iterations and keyframes.
+         *
+         * Everything is allocated for the largest system seen so far (at least setting_maxFrames + 1 frames, reserved
+         * when the EnergyFunctional is created) and used through its top left corner, or head, of the current
+         * dimension. Neither an LM iteration nor a change of the window size allocates then.
+         */
+        class SolverWorkspace {
+        public:
+            EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+
+            /**
+             * make room for systems of up to nFrames frames
+             * @param numThreads number of per-thread stitch buffers
+             */
+            inline void Reserve(int nFrames, int numThreads) {
+                const int dim = CPARS + 8 * nFrames;
+                if (dim <= capacity && (int) HsA.size() >= numThreads)
+                    return;
+                capacity = std::max(capacity, dim);
+                frameCapacity = std::max(frameCapacity, nFrames);
+
+                for (MatXX *m : {&HA, &HL, &Hsc, &HFinal, &HScaled})
+                    reserveDense(*m, capacity);
+                for (VecX *v : {&bA, &bL, &bsc, &bMtop, &bFinal, &SVecI, &x, &delta, &HMdelta})
+                    reserveDense(*v, capacity);
+                reserveDense(xF, capacity);
+                if (margK.rows() < capacity)
+                    margK.resize(capacity, 8);
+                blockCholesky.Reserve(frameCapacity);
+                if ((int) xAd.size() < frameCapacity * frameCapacity)
+                    xAd.resize(frameCapacity * frameCapacity);
+
+                for (vector<MatXX> *Hs : {&HsA, &HsL, &HsSC}) {
+                    if ((int) Hs->size() < numThreads)
+                        Hs->resize(numThreads);
+                    for (MatXX &m : *Hs)
+                        reserveDense(m, capacity);
+                }
+                for (vector<VecX> *bs : {&bsA, &bsL, &bsSC}) {
+                    if ((int) bs->size() < numThreads)
+                        bs->resize(numThreads);
+                    for (VecX &v : *bs)
+                        reserveDense(v, capacity);
+                }
+            }
+
+            /// decomposition of dim x dim systems, kept per dimension since it owns its storage
+            inline Eigen::LDLT<MatXX> &LDLT(int dim) {
+                if ((int) ldlt.size() <= dim)
+                    ldlt.resize(dim + 1);
+                if (!ldlt[dim])
+                    ldlt[dim].reset(new Eigen::LDLT<MatXX>(dim));
+                return *ldlt[dim];
+            }
+
+            int capacity = 0;           // dimension the buffers can hold
+            int frameCapacity = 0;      // number of frames the buffers can hold
+
+            MatXX HA, HL, Hsc;          // active, linearized and Schur complement parts of the system
+            VecX bA, bL, bsc;
+            MatXX HFinal, HScaled;
+            VecX bMtop, bFinal, SVecI, x;
+            VecX delta, HMdelta;        // stitched delta and HM * delta
+            VecXf xF;
+            Eigen::Matrix<double, Eigen::Dynamic, 8> margK;     // Schur complement factor of a marginalized frame
+            vector<Mat18f, Eigen::aligned_allocator<Mat18f>> xAd;   // step mapped by the adjoints, per frame pair
+            BlockCholesky blockCholesky;    // solver of the large windows
+
+            // factors of the nullspace projection N * (N' * N)^-1 * N' = nsU * nsW' and the products applying it,
+            // sized by EnergyFunctional::makeNullspaceProjector
+            MatXX nsU, nsW, nsWH, nsWHU, nsUWHU;
+            VecX nsWb, nsUWb;
+
+            // per-thread buffers of the multi-threaded stitch of HA, HL and Hsc
+            vector<MatXX> HsA, HsL, HsSC;
+            vector<VecX> bsA, bsL, bsSC;
+
+        private:
+            vector<unique_ptr<Eigen::LDLT<MatXX>>> ldlt;    // by dimension
+        };
+    }
+}
+
+#endif // LDSO_SOLVER_WORKSPACE_H_
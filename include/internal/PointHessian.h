@@ -31,7 +31,7 @@ namespace ldso {
                 if (point->mHostFeature.expired()) {
                     LOG(FATAL) << "host feature expired!" << endl;
                 }
-                point->mHostFeature.lock()->invD = idepth;
+                point->mHostFeature.lock()->invD() = idepth;
             }
 
             inline void setIdepthScaled(float idepth_scaled) {
@@ -40,7 +40,7 @@ namespace ldso {
                 if (point->mHostFeature.expired()) {
                     LOG(FATAL) << "host feature expired!" << endl;
                 }
-                point->mHostFeature.lock()->invD = idepth;
+                point->mHostFeature.lock()->invD() = idepth;
             }
 
             inline void setIdepthZero(float idepth) {
@@ -55,8 +55,8 @@ namespace ldso {
                 int visInToMarg = 0;
                 for (shared_ptr<PointFrameResidual> &r : residuals) {
                     if (r->state_state != ResState::IN) continue;
-                    for (shared_ptr<FrameHessian> k : toMarg)
-                        if (r->target.lock() == k) visInToMarg++;
+                    for (shared_ptr<FrameHessian> &k : toMarg)
+                        if (r->targetPtr == k.get()) visInToMarg++;
                 }
 
                 if ((int) residuals.size() >= setting_minGoodActiveResForMarg &&
@@ -41,13 +41,16 @@ namespace ldso {
         public:
             EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
 
-            PointFrameResidual() : J(new RawResidualJacobian) {}
+            PointFrameResidual() {}
 
             PointFrameResidual(shared_ptr<PointHessian> point_, shared_ptr<FrameHessian> host_,
-                               shared_ptr<FrameHessian> target_) : J(new RawResidualJacobian) {
+                               shared_ptr<FrameHessian> target_) {
                 point = point_;
                 host = host_;
                 target = target_;
+                pointPtr = point_.get();
+                hostPtr = host_.get();
+                targetPtr = target_.get();
                 resetOOB();
             }
 
@@ -96,7 +99,15 @@ namespace ldso {
             weak_ptr<PointHessian> point;
             weak_ptr<FrameHessian> host;
             weak_ptr<FrameHessian> target;
-            shared_ptr<RawResidualJacobian> J = nullptr;
+
+            // the same as point/host/target, for the per-iteration loops where lock() would cost two atomic refcount
+            // updates per access. They are valid as long as the residual is in the window: a residual is dropped
+            // before its point or target frame is removed.
+            PointHessian *pointPtr = nullptr;
+            FrameHessian *hostPtr = nullptr;
+            FrameHessian *targetPtr = nullptr;
+
+            RawResidualJacobian J;  // stored inline, so the jacobians lie next to the residual state
 
             bool isNew = true;
             Eigen::Vector2f projectedTo[MAX_RES_PER_POINT]; // 从host到target的投影点
@@ -119,10 +130,10 @@ namespace ldso {
             bool isActiveAndIsGoodNEW = false;
 
             void takeData() {
-                Vec2f JI_JI_Jd = J->JIdx2 * J->Jpdd;
+                Vec2f JI_JI_Jd = J.JIdx2 * J.Jpdd;
                 for (int i = 0; i < 6; i++)
-                    JpJdF[i] = J->Jpdxi[0][i] * JI_JI_Jd[0] + J->Jpdxi[1][i] * JI_JI_Jd[1];
-                JpJdF.segment<2>(6) = J->JabJIdx * J->Jpdd;
+                    JpJdF[i] = J.Jpdxi[0][i] * JI_JI_Jd[0] + J.Jpdxi[1][i] * JI_JI_Jd[1];
+                JpJdF.segment<2>(6) = J.JabJIdx * J.Jpdd;
             }
 
         };
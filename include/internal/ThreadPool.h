@@ -0,0 +1,123 @@
+#pragma once
+#ifndef LDSO_THREAD_POOL_H_
+#define LDSO_THREAD_POOL_H_
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <vector>
+#include <memory>
+
+using namespace std;
+
+namespace ldso {
+
+    namespace internal {
+
+        struct CalibContext;
+
+        /**
+         * Work-stealing thread pool
+         *
+         * Each worker owns a deque of tasks. The owner pops from the back (newest first, cache friendly) and idle
+         * workers steal from the front of other deques. Workers only sleep when no task is queued anywhere.
+         *
+         * The pool itself knows nothing about index ranges, see IndexThreadReduce for the reduction front-end.
+         * One pool may be shared by several reducers and threads (mapping, loop closing, pose graph, ...).
+         */
+        class ThreadPool {
+        public:
+            /**
+             * @param numThreads number of worker threads, at least one is created
+             * @param firstCore if >= 0, worker i is pinned to cpu core firstCore+i (wrapped around the core count)
+             */
+            explicit ThreadPool(int numThreads, int firstCore = -1);
+
+            ~ThreadPool();
+
+            ThreadPool(const ThreadPool &) = delete;
+
+            ThreadPool &operator=(const ThreadPool &) = delete;
+
+            /**
+             * queue a task. If called from a worker of this pool the task goes to its own deque, otherwise the
+             * deques are filled round robin. The task runs with the calibration of the submitting thread bound
+             * (see CalibContext). Tasks must not throw.
+             * Queuing allocates nothing once the deques have grown, unless the task does not fit into the small buffer
+             * of std::function (two pointers).
+             * @param task
+             */
+            void Submit(function<void()> task);
+
+            /// number of worker threads
+            inline int NumThreads() const {
+                return int(workers.size());
+            }
+
+            /// index of the calling thread in this pool, or -1 if it is not a worker of this pool
+            int CurrentWorker() const;
+
+            /**
+             * the process-wide pool, created on first use with setting_numThreads workers
+             * @return
+             */
+            static shared_ptr<ThreadPool> Global();
+
+            /**
+             * turn a requested thread count into an actual one, <= 0 means all hardware threads
+             * @param numThreads
+             * @return
+             */
+            static int ResolveNumThreads(int numThreads);
+
+            /**
+             * pin a thread to a cpu core, core is wrapped around the number of cores
+             * does nothing (and returns false) on platforms without affinity support or if core < 0
+             * @return true if succeeded
+             */
+            static bool PinThread(thread &th, int core);
+
+            static bool PinCurrentThread(int core);
+
+        private:
+            struct Task {
+                function<void()> run;
+                shared_ptr<CalibContext> calib;     // bound before run, if set
+            };
+
+            /// deque of tasks on a ring buffer, it only grows
+            struct WorkerQueue {
+                void PushBack(Task &task);
+
+                bool PopBack(Task &task);
+
+                bool PopFront(Task &task);
+
+                mutex queueMutex;
+                vector<Task> ring = vector<Task>(64);
+                size_t head = 0;
+                size_t count = 0;
+            };
+
+            void WorkerLoop(int idx);
+
+            // pop from back of own deque, otherwise steal from the front of the others
+            bool TryGetTask(int idx, Task &task);
+
+            vector<unique_ptr<WorkerQueue>> queues;
+            vector<thread> workers;
+
+            atomic<int> numQueued{0};        // tasks sitting in any deque
+            atomic<unsigned> nextQueue{0};   // round robin for external submits
+            atomic<bool> running{true};
+
+            mutex sleepMutex;
+            condition_variable wakeSignal;
+        };
+
+    }
+}
+
+#endif // LDSO_THREAD_POOL_H_
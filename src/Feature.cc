@@ -1,5 +1,6 @@
 #include "Feature.h"
 #include "Point.h"
+#include "Frame.h"
 #include "internal/ImmaturePoint.h"
 #include "internal/PointHessian.h"
 
@@ -11,6 +12,10 @@ using namespace ldso::internal;
 
 namespace ldso {
 
+    Feature::Feature(float u, float v, shared_ptr<Frame> host) : host(host), table(&host->featureTable) {
+        idx = table->PushBack(u, v);
+    }
+
     void Feature::CreateFromImmature() {
         if (point) {
             LOG(WARNING) << "Map point already created! You cannot create twice! " << endl;
@@ -20,7 +25,7 @@ namespace ldso {
 
         point = shared_ptr<Point>(new Point(ip->feature));
         point->mpPH->point = point;   // set the point hessians backward pointer
-        status = Feature::FeatureStatus::VALID;
+        status() = Feature::FeatureStatus::VALID;
     }
 
     void Feature::ReleaseImmature() {
@@ -37,30 +42,33 @@ namespace ldso {
     }
 
     void Feature::save(ofstream &fout) {
-        fout.write((char *) &status, sizeof(status));
-        fout.write((char *) &uv[0], sizeof(float));
-        fout.write((char *) &uv[1], sizeof(float));
-        fout.write((char *) &invD, sizeof(float));
-        fout.write((char *) &isCorner, sizeof(bool));
-        fout.write((char *) &angle, sizeof(float));
-        fout.write((char *) &score, sizeof(float));
-        fout.write((char *) descriptor, sizeof(uchar) * 32);
-        if (point && status == Feature::FeatureStatus::VALID)
+        bool corner = isCorner();
+        fout.write((char *) &status(), sizeof(FeatureStatus));
+        fout.write((char *) &uv()[0], sizeof(float));
+        fout.write((char *) &uv()[1], sizeof(float));
+        fout.write((char *) &invD(), sizeof(float));
+        fout.write((char *) &corner, sizeof(bool));
+        fout.write((char *) &angle(), sizeof(float));
+        fout.write((char *) &score(), sizeof(float));
+        fout.write((char *) descriptor(), sizeof(uchar) * 32);
+        if (point && status() == Feature::FeatureStatus::VALID)
             point->save(fout);
     }
 
     void Feature::load(ifstream &fin, vector<shared_ptr<Frame>> &allKFs) {
 
-        fin.read((char *) &status, sizeof(status));
-        fin.read((char *) &uv[0], sizeof(float));
-        fin.read((char *) &uv[1], sizeof(float));
-        fin.read((char *) &invD, sizeof(float));
-        fin.read((char *) &isCorner, sizeof(bool));
-        fin.read((char *) &angle, sizeof(float));
-        fin.read((char *) &score, sizeof(float));
-        fin.read((char *) descriptor, sizeof(uchar) * 32);
+        bool corner = false;
+        fin.read((char *) &status(), sizeof(FeatureStatus));
+        fin.read((char *) &uv()[0], sizeof(float));
+        fin.read((char *) &uv()[1], sizeof(float));
+        fin.read((char *) &invD(), sizeof(float));
+        fin.read((char *) &corner, sizeof(bool));
+        fin.read((char *) &angle(), sizeof(float));
+        fin.read((char *) &score(), sizeof(float));
+        fin.read((char *) descriptor(), sizeof(uchar) * 32);
+        isCorner() = corner;
 
-        if (status == Feature::FeatureStatus::VALID) {
+        if (status() == Feature::FeatureStatus::VALID) {
             point = shared_ptr<Point>(new Point);
             point->load(fin, allKFs);
         }
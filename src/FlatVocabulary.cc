@@ -0,0 +1,420 @@
+#include "FlatVocabulary.h"
+#include "frontend/FeatureMatcher.h"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace ldso {
+
+    static const char VOC_MAGIC[8] = {'L', 'D', 'S', 'O', 'V', 'O', 'C', 0};
+    static const uint32_t VOC_ENDIAN_TAG = 0x01020304;
+
+    struct FlatVocabularyHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t endianTag;
+        int32_t k;
+        int32_t L;
+        int32_t weighting;
+        int32_t scoring;
+        int32_t mustNormalize;
+        int32_t norm;
+        uint32_t numNodes;
+        uint32_t numWords;
+        uint64_t nodesOffset;
+        uint64_t centroidsOffset;
+        uint64_t nodeIdsOffset;
+        uint64_t weightsOffset;
+        uint64_t fileSize;
+    };
+
+    // arrays start at cache line boundaries of the mapping
+    static inline uint64_t alignOffset(uint64_t offset) {
+        return (offset + 63) & ~uint64_t(63);
+    }
+
+    shared_ptr<const FlatVocabulary> FlatVocabulary::Get(const shared_ptr<ORBVocabulary> &voc) {
+        auto mapped = dynamic_cast<const FlatORBVocabulary *>(voc.get());
+        if (mapped)
+            return mapped->Flat();
+
+        // keyed by the vocabulary, the weak pointer tells if the address has been reused by another one
+        static mutex cacheMutex;
+        static map<const ORBVocabulary *, pair<weak_ptr<ORBVocabulary>, shared_ptr<const FlatVocabulary>>> cache;
+
+        unique_lock<mutex> lock(cacheMutex);
+        for (auto it = cache.begin(); it != cache.end();) {
+            if (it->second.first.expired())
+                it = cache.erase(it);
+            else
+                ++it;
+        }
+
+        auto &entry = cache[voc.get()];
+        if (!entry.second) {
+            entry.first = voc;
+            entry.second = shared_ptr<const FlatVocabulary>(new FlatVocabulary(*voc));
+        }
+        return entry.second;
+    }
+
+    FlatVocabulary::FlatVocabulary(const ORBVocabulary &voc) {
+        if (voc.empty() || voc.getDescritorSize() != 32 || voc.getDescritorType() != CV_8UC1) {
+            LOG(WARNING) << "vocabulary is not made of 32 byte binary descriptors, using its own transform" << endl;
+            return;
+        }
+
+        k = voc.getBranchingFactor();
+        depth = voc.getDepthLevels();
+        weighting = voc.getWeightingType();
+        scoring = voc.getScoringType();
+        mustNormalize = voc.mustNormalize(norm);
+
+        numNodes = voc.getNumNodes();
+        numWords = voc.size();
+        ownNodes.resize(numNodes);
+        ownCentroids.assign(32 * size_t(numNodes), 0);
+        ownNodeIds.resize(numNodes);
+        ownWordWeights.assign(numWords, 0);
+        nodes = ownNodes.data();
+        centroids = ownCentroids.data();
+        nodeIds = ownNodeIds.data();
+        wordWeights = ownWordWeights.data();
+
+        // breadth first, the children of each node get the next free slots
+        ownNodeIds[0] = 0;
+        uint32_t next = 1;
+        for (uint32_t i = 0; i < next; i++) {
+            const vector<DBoW3::NodeId> &children = voc.getNodeChildren(ownNodeIds[i]);
+            Node &node = ownNodes[i];
+            if (children.empty()) {
+                DBoW3::WordId wid = voc.getNodeWordId(ownNodeIds[i]);
+                if (wid >= numWords) {
+                    LOG(WARNING) << "vocabulary node " << ownNodeIds[i] << " has an invalid word id" << endl;
+                    return;
+                }
+                node.first = wid;
+                ownWordWeights[wid] = voc.getNodeWeight(ownNodeIds[i]);
+                continue;
+            }
+            node.first = next;
+            node.count = children.size();
+            for (DBoW3::NodeId child: children) {
+                if (next >= numNodes) {
+                    LOG(WARNING) << "vocabulary tree is inconsistent, using its own transform" << endl;
+                    return;
+                }
+                ownNodeIds[next] = child;
+                const cv::Mat &desc = voc.getNodeDescriptor(child);
+                if (desc.cols * desc.elemSize() != 32) {
+                    LOG(WARNING) << "vocabulary node " << child << " has no 32 byte descriptor" << endl;
+                    return;
+                }
+                memcpy(&ownCentroids[32 * size_t(next)], desc.ptr<unsigned char>(), 32);
+                next++;
+            }
+        }
+        valid = true;
+        LOG(INFO) << "flattened vocabulary: " << next << " nodes, " << numWords << " words" << endl;
+    }
+
+    FlatVocabulary::~FlatVocabulary() {
+        if (mapping)
+            munmap(mapping, mappingSize);
+    }
+
+    bool FlatVocabulary::Save(const string &filename) const {
+        if (!valid) {
+            LOG(ERROR) << "cannot save an invalid flat vocabulary" << endl;
+            return false;
+        }
+
+        FlatVocabularyHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, VOC_MAGIC, 8);
+        header.version = VERSION;
+        header.endianTag = VOC_ENDIAN_TAG;
+        header.k = k;
+        header.L = depth;
+        header.weighting = weighting;
+        header.scoring = scoring;
+        header.mustNormalize = mustNormalize;
+        header.norm = norm;
+        header.numNodes = numNodes;
+        header.numWords = numWords;
+        header.nodesOffset = alignOffset(sizeof(header));
+        header.centroidsOffset = alignOffset(header.nodesOffset + sizeof(Node) * uint64_t(numNodes));
+        header.nodeIdsOffset = alignOffset(header.centroidsOffset + 32 * uint64_t(numNodes));
+        header.weightsOffset = alignOffset(header.nodeIdsOffset + sizeof(uint32_t) * uint64_t(numNodes));
+        header.fileSize = header.weightsOffset + sizeof(DBoW3::WordValue) * uint64_t(numWords);
+
+        ofstream fout(filename, ios::out | ios::binary);
+        if (!fout) {
+            LOG(ERROR) << "cannot open " << filename << endl;
+            return false;
+        }
+
+        uint64_t written = 0;
+        auto put = [&](uint64_t offset, const void *data, uint64_t size) {
+            static const char zeros[64] = {0};
+            fout.write(zeros, offset - written);
+            fout.write(reinterpret_cast<const char *>(data), size);
+            written = offset + size;
+        };
+        put(0, &header, sizeof(header));
+        put(header.nodesOffset, nodes, sizeof(Node) * uint64_t(numNodes));
+        put(header.centroidsOffset, centroids, 32 * uint64_t(numNodes));
+        put(header.nodeIdsOffset, nodeIds, sizeof(uint32_t) * uint64_t(numNodes));
+        put(header.weightsOffset, wordWeights, sizeof(DBoW3::WordValue) * uint64_t(numWords));
+
+        if (!fout) {
+            LOG(ERROR) << "failed to write " << filename << endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool FlatVocabulary::IsFlatVocabulary(const string &filename) {
+        ifstream fin(filename, ios::in | ios::binary);
+        char magic[8] = {0};
+        if (!fin.read(magic, 8))
+            return false;
+        return memcmp(magic, VOC_MAGIC, 8) == 0;
+    }
+
+    shared_ptr<const FlatVocabulary> FlatVocabulary::Map(const string &filename) {
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            LOG(ERROR) << "cannot open " << filename << endl;
+            return nullptr;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(FlatVocabularyHeader)) {
+            LOG(ERROR) << filename << " is not a flat vocabulary file" << endl;
+            close(fd);
+            return nullptr;
+        }
+
+        // shared read only mapping, the pages come from the page cache and are shared by every process using the file
+        size_t size = st.st_size;
+        void *mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED) {
+            LOG(ERROR) << "cannot map " << filename << endl;
+            return nullptr;
+        }
+
+        shared_ptr<FlatVocabulary> flat(new FlatVocabulary());
+        flat->mapping = mapping;
+        flat->mappingSize = size;
+
+        const unsigned char *base = static_cast<const unsigned char *>(mapping);
+        FlatVocabularyHeader header;
+        memcpy(&header, base, sizeof(header));
+        if (memcmp(header.magic, VOC_MAGIC, 8) != 0) {
+            LOG(ERROR) << filename << " is not a flat vocabulary file" << endl;
+            return nullptr;
+        }
+        if (header.endianTag != VOC_ENDIAN_TAG) {
+            LOG(ERROR) << filename << " was written on a machine with another byte order" << endl;
+            return nullptr;
+        }
+        if (header.version > VERSION) {
+            LOG(ERROR) << "flat vocabulary version " << header.version << " is newer than the supported " << VERSION
+                       << endl;
+            return nullptr;
+        }
+
+        auto inFile = [&](uint64_t offset, uint64_t bytes) {
+            return offset % 64 == 0 && offset <= size && bytes <= size - offset;
+        };
+        if (header.numNodes == 0 || header.fileSize > size ||
+            !inFile(header.nodesOffset, sizeof(Node) * uint64_t(header.numNodes)) ||
+            !inFile(header.centroidsOffset, 32 * uint64_t(header.numNodes)) ||
+            !inFile(header.nodeIdsOffset, sizeof(uint32_t) * uint64_t(header.numNodes)) ||
+            !inFile(header.weightsOffset, sizeof(DBoW3::WordValue) * uint64_t(header.numWords))) {
+            LOG(ERROR) << filename << " is truncated" << endl;
+            return nullptr;
+        }
+
+        flat->k = header.k;
+        flat->depth = header.L;
+        flat->weighting = DBoW3::WeightingType(header.weighting);
+        flat->scoring = DBoW3::ScoringType(header.scoring);
+        flat->mustNormalize = header.mustNormalize != 0;
+        flat->norm = DBoW3::LNorm(header.norm);
+        flat->numNodes = header.numNodes;
+        flat->numWords = header.numWords;
+        flat->nodes = reinterpret_cast<const Node *>(base + header.nodesOffset);
+        flat->centroids = base + header.centroidsOffset;
+        flat->nodeIds = reinterpret_cast<const uint32_t *>(base + header.nodeIdsOffset);
+        flat->wordWeights = reinterpret_cast<const DBoW3::WordValue *>(base + header.weightsOffset);
+        flat->valid = true;
+
+        LOG(INFO) << "mapped flat vocabulary " << filename << ": " << header.numNodes << " nodes, "
+                  << header.numWords << " words" << endl;
+        return flat;
+    }
+
+    shared_ptr<ORBVocabulary> FlatVocabulary::LoadORBVocabulary(const string &filename) {
+        if (IsFlatVocabulary(filename)) {
+            shared_ptr<const FlatVocabulary> flat = Map(filename);
+            if (!flat)
+                return nullptr;
+            return shared_ptr<ORBVocabulary>(new FlatORBVocabulary(flat));
+        }
+        shared_ptr<ORBVocabulary> voc(new ORBVocabulary());
+        voc->load(filename);
+        return voc;
+    }
+
+    void FlatVocabulary::Transform(const unsigned char *descs, const int *index, int n, DBoW3::BowVector &bowVec,
+                                   DBoW3::FeatureVector &featVec, int levelsup) const {
+        bowVec.clear();
+        featVec.clear();
+        if (!valid || n <= 0)
+            return;
+
+        // current node of each descriptor and the node stored into featVec
+        vector<uint32_t> current(n, 0);
+        vector<DBoW3::NodeId> featureNode(n, 0);
+        const int nodeLevel = depth - levelsup;
+
+        // descriptors not at a leaf yet, as (node, descriptor)
+        vector<pair<uint32_t, int>> active;
+        if (nodes[0].count > 0) {
+            active.resize(n);
+            for (int i = 0; i < n; i++)
+                active[i] = make_pair(0u, i);
+        }
+
+        vector<int> rows, dist;
+        for (int level = 1; !active.empty(); level++) {
+            // group the descriptors by node so every block of children is compared with all of them at once
+            sort(active.begin(), active.end());
+
+            size_t kept = 0;
+            for (size_t begin = 0; begin < active.size();) {
+                const Node &node = nodes[active[begin].first];
+                size_t end = begin;
+                rows.clear();
+                while (end < active.size() && active[end].first == active[begin].first) {
+                    int i = active[end].second;
+                    rows.push_back(index ? index[i] : i);
+                    end++;
+                }
+
+                int m = rows.size(), k = node.count;
+                dist.resize(size_t(m) * k);
+                FeatureMatcher::DescriptorDistances(descs, rows.data(), m, &centroids[32 * size_t(node.first)],
+                                                    nullptr, k, dist.data());
+
+                for (int r = 0; r < m; r++) {
+                    const int *d = &dist[size_t(r) * k];
+                    int best = 0;
+                    for (int c = 1; c < k; c++) {
+                        if (d[c] < d[best])
+                            best = c;
+                    }
+                    int i = active[begin + r].second;
+                    uint32_t child = node.first + best;
+                    current[i] = child;
+                    // a leaf above the level of featVec stands for its own subtree
+                    if (level == nodeLevel || (level < nodeLevel && nodes[child].count == 0))
+                        featureNode[i] = nodeIds[child];
+                    if (nodes[child].count > 0)
+                        active[kept++] = make_pair(child, i);
+                }
+                begin = end;
+            }
+            active.resize(kept);
+        }
+
+        // same accumulation as ORBVocabulary::transform
+        bool tf = weighting == DBoW3::TF || weighting == DBoW3::TF_IDF;
+        for (int i = 0; i < n; i++) {
+            const Node &leaf = nodes[current[i]];
+            DBoW3::WordValue w = wordWeights[leaf.first];
+            if (w > 0) {    // not stopped
+                if (tf)
+                    bowVec.addWeight(leaf.first, w);
+                else
+                    bowVec.addIfNotExist(leaf.first, w);
+                featVec.addFeature(featureNode[i], i);
+            }
+        }
+
+        if (tf && !bowVec.empty() && !mustNormalize) {
+            const double nd = bowVec.size();
+            for (auto &word: bowVec)
+                word.second /= nd;
+        }
+        if (mustNormalize)
+            bowVec.normalize(norm);
+    }
+
+    DBoW3::WordId FlatVocabulary::Word(const unsigned char *desc) const {
+        if (!valid)
+            return 0;
+        int dist[256];
+        vector<int> wide;
+        uint32_t current = 0;
+        while (nodes[current].count > 0) {
+            const Node &node = nodes[current];
+            int *d = dist;
+            if (node.count > 256) {
+                wide.resize(node.count);
+                d = wide.data();
+            }
+            FeatureMatcher::DescriptorDistances(desc, nullptr, 1, &centroids[32 * size_t(node.first)], nullptr,
+                                                node.count, d);
+            uint32_t best = 0;
+            for (uint32_t c = 1; c < node.count; c++) {
+                if (d[c] < d[best])
+                    best = c;
+            }
+            current = node.first + best;
+        }
+        return nodes[current].first;
+    }
+
+    FlatORBVocabulary::FlatORBVocabulary(shared_ptr<const FlatVocabulary> flat) :
+            ORBVocabulary(flat->BranchingFactor(), flat->DepthLevels(), flat->Weighting(), flat->Scoring()),
+            flat(flat) {}
+
+    void FlatORBVocabulary::transform(const std::vector<cv::Mat> &features, DBoW3::BowVector &v) const {
+        DBoW3::FeatureVector fv;
+        transform(features, v, fv, 0);
+    }
+
+    void FlatORBVocabulary::transform(const cv::Mat &features, DBoW3::BowVector &v) const {
+        vector<unsigned char> descs(32 * size_t(features.rows));
+        for (int r = 0; r < features.rows; r++)
+            memcpy(&descs[32 * size_t(r)], features.ptr<unsigned char>(r), 32);
+        DBoW3::FeatureVector fv;
+        flat->Transform(descs.data(), nullptr, features.rows, v, fv, 0);
+    }
+
+    void FlatORBVocabulary::transform(const std::vector<cv::Mat> &features, DBoW3::BowVector &v,
+                                      DBoW3::FeatureVector &fv, int levelsup) const {
+        vector<unsigned char> descs(32 * features.size());
+        for (size_t i = 0; i < features.size(); i++)
+            memcpy(&descs[32 * i], features[i].ptr<unsigned char>(), 32);
+        flat->Transform(descs.data(), nullptr, features.size(), v, fv, levelsup);
+    }
+
+    DBoW3::WordId FlatORBVocabulary::transform(const cv::Mat &feature) const {
+        return flat->Word(feature.ptr<unsigned char>());
+    }
+}
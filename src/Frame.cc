@@ -1,6 +1,7 @@
 #include "Frame.h"
 #include "Feature.h"
 #include "Point.h"
+#include "FlatVocabulary.h"
 
 #include "internal/FrameHessian.h"
 #include "internal/GlobalCalib.h"
@@ -34,18 +35,19 @@ namespace ldso {
         }
     }
 
-    void Frame::CreateFH(shared_ptr<Frame> frame) {
+    void Frame::CreateFH(shared_ptr<Frame> frame, shared_ptr<internal::FrameBufferPool> pool) {
         frameHessian = shared_ptr<internal::FrameHessian>(new internal::FrameHessian(frame));
+        frameHessian->bufferPool = pool;
     }
 
     void Frame::SetFeatureGrid() {
         int gw = wG[0] / gridSize, gh = hG[0] / gridSize;
         grid.resize(gw * gh);
         for (size_t i = 0; i < features.size(); i++) {
-            if (features[i]->isCorner) {
+            if (featureTable.isCorner[i]) {
                 // assign feature to grid
-                int gridX = features[i]->uv[0] / gridSize;
-                int gridY = features[i]->uv[1] / gridSize;
+                int gridX = featureTable.uv[i][0] / gridSize;
+                int gridY = featureTable.uv[i][1] / gridSize;
                 grid[gridY * gw + gridX].push_back(i);
             }
         }
@@ -75,8 +77,8 @@ namespace ldso {
             for (int iy = gridYmin; iy <= gridYmax; iy++) {
                 const vector<size_t> cell = grid[iy * gw + ix];
                 for (auto &k: cell) {
-                    float u = features[k]->uv[0];
-                    float v = features[k]->uv[1];
+                    float u = featureTable.uv[k][0];
+                    float v = featureTable.uv[k][1];
 
                     if (((u - x) * (u - x) + (v - y) * (v - y)) < r2)
                         indices.push_back(k);
@@ -87,17 +89,27 @@ namespace ldso {
 
     void Frame::ComputeBoW(shared_ptr<ORBVocabulary> voc) {
         // convert corners into BoW
-        vector<cv::Mat> allDesp;
+        bowIdx.clear();
+        vector<int> rows;
         for (size_t i = 0; i < features.size(); i++) {
-            auto &feat = features[i];
-            if (feat->isCorner) {
-                cv::Mat m(1, 32, CV_8U);
-                for (int k = 0; k < 32; k++)
-                    m.data[k] = feat->descriptor[k];
-                allDesp.push_back(m);
+            if (featureTable.isCorner[i]) {
+                rows.push_back(i);
                 bowIdx.push_back(i);
             }
         }
+
+        shared_ptr<const FlatVocabulary> flat = FlatVocabulary::Get(voc);
+        if (flat->Valid()) {
+            flat->Transform(featureTable.descriptors.data(), rows.data(), rows.size(), bowVec, featVec, 4);
+            return;
+        }
+
+        vector<cv::Mat> allDesp;
+        for (int i: rows) {
+            cv::Mat m(1, 32, CV_8U);
+            memcpy(m.data, Descriptor(i), 32);
+            allDesp.push_back(m);
+        }
         voc->transform(allDesp, bowVec, featVec, 4);
     }
 
@@ -110,9 +122,9 @@ namespace ldso {
 
     vector<shared_ptr<Point>> Frame::GetPoints() {
         vector<shared_ptr<Point>> pts;
-        for (auto &feat: features) {
-            if (feat->status == Feature::FeatureStatus::VALID) {
-                pts.push_back(feat->point);
+        for (size_t i = 0; i < features.size(); i++) {
+            if (featureTable.status[i] == Feature::FeatureStatus::VALID) {
+                pts.push_back(features[i]->point);
             }
         }
         return pts;
@@ -166,6 +178,7 @@ namespace ldso {
         int nufeatures = 0;
         fin.read((char *) &nufeatures, sizeof(int));
         features.resize(nufeatures, nullptr);
+        featureTable.reserve(nufeatures);
         for (auto &feat: features) {
             feat = shared_ptr<Feature>(new Feature(0, 0, thisFrame));
         }
@@ -173,7 +186,7 @@ namespace ldso {
         int n = 0;
         for (auto &feat: features) {
             feat->load(fin, allKF);
-            if (feat->status == Feature::FeatureStatus::VALID) {
+            if (feat->status() == Feature::FeatureStatus::VALID) {
                 feat->point->mHostFeature = feat;
             }
             n++;
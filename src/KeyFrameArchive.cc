@@ -0,0 +1,138 @@
+#include "KeyFrameArchive.h"
+#include "MapFile.h"
+#include "Feature.h"
+
+#include <glog/logging.h>
+
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace ldso {
+
+    KeyFrameArchive::KeyFrameArchive(size_t memoryBudget, const string &spillDir) :
+            memoryBudget(memoryBudget), spillDir(spillDir) {}
+
+    KeyFrameArchive::~KeyFrameArchive() {
+        if (spillFd >= 0)
+            close(spillFd);
+    }
+
+    void KeyFrameArchive::Archive(const shared_ptr<Frame> &frame) {
+        Record &rec = records[frame->id];
+        if (rec.dropped)
+            return;
+
+        if (rec.size == 0) {
+            vector<unsigned char> raw;
+            MapFile::EncodeFrame(frame, raw, false);
+            rec.rawSize = raw.size();
+            rec.compressed = MapFile::Compress(raw, rec.data);
+            if (!rec.compressed)
+                rec.data.swap(raw);
+            rec.size = rec.data.size();
+            rec.hasBoW = !frame->featVec.empty();
+
+            stats.frames++;
+            stats.rawBytes += rec.rawSize;
+            stats.memoryBytes += rec.size;
+            inMemory.push_back(frame->id);
+        }
+
+        // swap with empty containers so the memory is actually freed
+        vector<shared_ptr<Feature>>().swap(frame->features);
+        frame->featureTable = FeatureTable();
+        vector<vector<size_t>>().swap(frame->grid);
+        frame->bowVec.clear();
+        frame->featVec.clear();
+        vector<size_t>().swap(frame->bowIdx);
+        rec.dropped = true;
+        stats.archived++;
+
+        spill();
+    }
+
+    bool KeyFrameArchive::Restore(const shared_ptr<Frame> &frame, shared_ptr<ORBVocabulary> voc) {
+        auto it = records.find(frame->id);
+        if (it == records.end() || !it->second.dropped)
+            return true;
+        Record &rec = it->second;
+
+        vector<unsigned char> stored;
+        const vector<unsigned char> *chunk = &rec.data;
+        if (rec.spilled) {
+            stored.resize(rec.size);
+            if (pread(spillFd, stored.data(), rec.size, rec.spillOffset) != ssize_t(rec.size)) {
+                LOG(ERROR) << "cannot read archived keyframe " << frame->kfId << " from the spill file" << endl;
+                return false;
+            }
+            chunk = &stored;
+        }
+
+        vector<unsigned char> raw;
+        if (rec.compressed) {
+            if (!MapFile::Uncompress(chunk->data(), chunk->size(), rec.rawSize, raw)) {
+                LOG(ERROR) << "failed to decompress archived keyframe " << frame->kfId << endl;
+                return false;
+            }
+            chunk = &raw;
+        }
+
+        if (!MapFile::DecodeFrame(frame, chunk->data(), chunk->size())) {
+            LOG(ERROR) << "archived keyframe " << frame->kfId << " is corrupted" << endl;
+            return false;
+        }
+        if (rec.hasBoW && voc)
+            frame->ComputeBoW(voc);
+
+        rec.dropped = false;
+        stats.archived--;
+        stats.restores++;
+        return true;
+    }
+
+    bool KeyFrameArchive::IsArchived(const shared_ptr<Frame> &frame) const {
+        auto it = records.find(frame->id);
+        return it != records.end() && it->second.dropped;
+    }
+
+    void KeyFrameArchive::spill() {
+        if (spillDir.empty() || stats.memoryBytes <= memoryBudget)
+            return;
+
+        if (spillFd < 0) {
+            string path = spillDir + "/ldso-archive-XXXXXX";
+            vector<char> name(path.begin(), path.end());
+            name.push_back(0);
+            spillFd = mkstemp(name.data());
+            if (spillFd < 0) {
+                LOG(WARNING) << "cannot create a spill file in " << spillDir
+                             << ", archived keyframes stay in memory" << endl;
+                spillDir.clear();
+                return;
+            }
+            // the file goes away with the descriptor
+            unlink(name.data());
+        }
+
+        while (stats.memoryBytes > memoryBudget && !inMemory.empty()) {
+            Record &rec = records[inMemory.front()];
+            if (pwrite(spillFd, rec.data.data(), rec.size, spillSize) != ssize_t(rec.size)) {
+                LOG(WARNING) << "cannot write the spill file, archived keyframes stay in memory" << endl;
+                spillDir.clear();
+                return;
+            }
+            inMemory.pop_front();
+            rec.spillOffset = spillSize;
+            rec.spilled = true;
+            vector<unsigned char>().swap(rec.data);
+            spillSize += rec.size;
+
+            stats.spilled++;
+            stats.memoryBytes -= rec.size;
+            stats.spillBytes += rec.size;
+        }
+    }
+}
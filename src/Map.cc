@@ -6,6 +6,7 @@
 #include "internal/FrameHessian.h"
 #include "internal/PointHessian.h"
 #include "internal/PR.h"
+#include "Settings.h"
 
 #include <g2o/core/block_solver.h>
 #include <g2o/core/optimization_algorithm_gauss_newton.h>
@@ -14,16 +15,60 @@
 #include <g2o/solvers/linear_solver_eigen.h>
 #include <g2o/core/robust_kernel_impl.h>
 
+#include <climits>
+
 using namespace std;
 using namespace ldso::internal;
 
 namespace ldso {
 
     void Map::AddKeyFrame(shared_ptr<Frame> kf) {
-        unique_lock<mutex> mapLock(mapMutex);
-        if (frames.find(kf) == frames.end()) {
+        {
+            unique_lock<mutex> mapLock(mapMutex);
+            if (frames.find(kf) != frames.end())
+                return;
             frames.insert(kf);
         }
+        unique_lock<mutex> lock(archiveMutex);
+        hotFrames.push_back(kf);
+    }
+
+    void Map::ArchiveKeyFrames(unsigned long keepFromKfId) {
+        unique_lock<mutex> lock(archiveMutex);
+        if (!archive) {
+            archive = shared_ptr<KeyFrameArchive>(
+                    new KeyFrameArchive(size_t(setting_archiveMemoryMB) << 20, setting_archiveSpillDir));
+        }
+
+        archiveBelowKfId = max(archiveBelowKfId, keepFromKfId);
+        while (!hotFrames.empty() && hotFrames.front()->kfId < archiveBelowKfId) {
+            shared_ptr<Frame> kf = hotFrames.front();
+            hotFrames.pop_front();
+            if (pinCount.count(kf->id) == 0)
+                archive->Archive(kf);
+        }
+    }
+
+    bool Map::PinKeyFrame(const shared_ptr<Frame> &kf) {
+        unique_lock<mutex> lock(archiveMutex);
+        pinCount[kf->id]++;
+        if (archive && archive->IsArchived(kf)) {
+            if (!archive->Restore(kf, fullsystem ? fullsystem->vocab : nullptr))
+                return false;
+            // the points kept the world position of the time they were archived
+            updateWorldPoints(kf);
+        }
+        return true;
+    }
+
+    void Map::UnpinKeyFrame(const shared_ptr<Frame> &kf) {
+        unique_lock<mutex> lock(archiveMutex);
+        auto it = pinCount.find(kf->id);
+        if (it == pinCount.end() || --it->second > 0)
+            return;
+        pinCount.erase(it);
+        if (archive && kf->kfId < archiveBelowKfId)
+            archive->Archive(kf);
     }
 
     void Map::lastOptimizeAllKFs() {
@@ -39,7 +84,7 @@ namespace ldso {
         // no locking of mapMutex since we assume that odometry has finished
         framesOpti = frames;
         currentKF = *frames.rbegin();
-        runPoseGraphOptimization();
+        runPoseGraphOptimization(true);
     }
 
     bool Map::OptimizeALLKFs() {
@@ -55,104 +100,177 @@ namespace ldso {
             currentKF = *frames.rbegin();
         }
 
-        //  start the pose graph thread
-        thread th = thread(&Map::runPoseGraphOptimization, this);
-        th.detach();    // it will set posegraphrunning to false when returns
+        //  start the pose graph, on the shared pool if there is one so we don't spawn a thread each time
+        shared_ptr<ThreadPool> pool = fullsystem ? fullsystem->GetThreadPool() : nullptr;
+        if (pool) {
+            pool->Submit([this] { runPoseGraphOptimization(); });
+        } else {
+            shared_ptr<CalibContext> calib = CalibContext::Current();
+            thread th = thread([this, calib]() {
+                bindCalib(calib);
+                runPoseGraphOptimization(false);
+            });
+            th.detach();    // it will set posegraphrunning to false when returns
+        }
         return true;
     }
 
     void Map::UpdateAllWorldPoints() {
         unique_lock<mutex> lock(mutexPoseGraph);
-        for (shared_ptr<Frame> frame: frames) {
-            for (auto &feat: frame->features) {
-                if (feat->point) {
-                    feat->point->ComputeWorldPos();
-                }
+        unique_lock<mutex> archiveLock(archiveMutex);
+        for (const shared_ptr<Frame> &frame: frames)
+            updateWorldPoints(frame);
+    }
+
+    void Map::updateWorldPoints(const shared_ptr<Frame> &frame) {
+        // same as Point::ComputeWorldPos, but with the pose fetched once per frame and uv/invD read from the table
+        Sim3 Twc = frame->getPoseOpti().inverse();
+        const FeatureTable &table = frame->featureTable;
+        for (size_t k = 0; k < table.size(); k++) {
+            shared_ptr<Point> &point = frame->features[k]->point;
+            if (point) {
+                Vec3 Kip = 1.0 / table.invD[k] * Vec3(
+                        fxiG[0] * table.uv[k][0] + cxiG[0],
+                        fyiG[0] * table.uv[k][1] + cyiG[0],
+                        1);
+                point->mWorldPos = Twc * Kip;
             }
         }
     }
 
-    void Map::runPoseGraphOptimization() {
+    void Map::runPoseGraphOptimization(bool full) {
 
         LOG(INFO) << "start pose graph thread!" << endl;
-        // Setup optimizer
-        g2o::SparseOptimizer optimizer;
-        typedef BlockSolver<BlockSolverTraits<7, 3> > BlockSolverType;
-        BlockSolverType::LinearSolverType *linearSolver;
-        linearSolver = new g2o::LinearSolverEigen<BlockSolverType::PoseMatrixType>();
-        BlockSolverType *solver_ptr = new BlockSolverType(linearSolver);
-        // g2o::OptimizationAlgorithmLevenberg *solver = new g2o::OptimizationAlgorithmLevenberg(solver_ptr);
-        g2o::OptimizationAlgorithmGaussNewton *solver = new g2o::OptimizationAlgorithmGaussNewton(solver_ptr);
-        // g2o::OptimizationAlgorithmDogleg *solver = new g2o::OptimizationAlgorithmDogleg(solver_ptr);
-        optimizer.setAlgorithm(solver);
-        optimizer.setVerbose(false);
-
-        // keyframes
-        int maxKFid = 0;
-        int cntEdgePR = 0;
+        if (!poseGraph) {
+            // Setup optimizer, it is kept for all the later runs
+            poseGraph = shared_ptr<g2o::SparseOptimizer>(new g2o::SparseOptimizer());
+            typedef BlockSolver<BlockSolverTraits<7, 3> > BlockSolverType;
+            BlockSolverType::LinearSolverType *linearSolver;
+            linearSolver = new g2o::LinearSolverEigen<BlockSolverType::PoseMatrixType>();
+            BlockSolverType *solver_ptr = new BlockSolverType(linearSolver);
+            // g2o::OptimizationAlgorithmLevenberg *solver = new g2o::OptimizationAlgorithmLevenberg(solver_ptr);
+            g2o::OptimizationAlgorithmGaussNewton *solver = new g2o::OptimizationAlgorithmGaussNewton(solver_ptr);
+            // g2o::OptimizationAlgorithmDogleg *solver = new g2o::OptimizationAlgorithmDogleg(solver_ptr);
+            poseGraph->setAlgorithm(solver);
+            poseGraph->setVerbose(false);
+        }
+        g2o::SparseOptimizer &optimizer = *poseGraph;
 
+        // the oldest keyframe whose vertex or constraints changed since the last run, everything before it keeps
+        // its optimized relative poses
+        unsigned long firstDirty = full ? 0 : ULONG_MAX;
+
+        // keyframes, add the new ones and pick up the poses odometry has changed
         for (const shared_ptr<Frame> &fr: framesOpti) {
 
             // each kf has Sim3 pose
             int idKF = fr->kfId;
-            if (idKF > maxKFid) {
-                maxKFid = idKF;
-            }
 
             // P+R
-            VertexSim3 *vSim3 = new VertexSim3();
             Sim3 Scw = fr->getPoseOpti();
             CHECK(Scw.scale() > 0);
-            vSim3->setEstimate(Scw);
-            vSim3->setId(idKF);
-            optimizer.addVertex(vSim3);
-
-            // fix the last one since we don't want to affect the frames in window
-            if (fr == currentKF) {
-                vSim3->setFixed(true);
+            VertexSim3 *vSim3 = (VertexSim3 *) optimizer.vertex(idKF);
+            if (vSim3 == nullptr) {
+                vSim3 = new VertexSim3();
+                vSim3->setId(idKF);
+                vSim3->setEstimate(Scw);
+                optimizer.addVertex(vSim3);
+                firstDirty = min(firstDirty, fr->kfId);
+            } else if (vSim3->estimate().matrix() != Scw.matrix()) {
+                vSim3->setEstimate(Scw);
+                firstDirty = min(firstDirty, fr->kfId);
             }
-
         }
 
-        // edges
+        // edges, add the new ones and update the ones whose relative pose has been re-estimated
+        set<EdgeSim3 *> seenEdges;
         for (const shared_ptr<Frame> &fr: framesOpti) {
             unique_lock<mutex> lock(fr->mutexPoseRel);
             for (auto &rel: fr->poseRel) {
                 VertexSim3 *vPR1 = (VertexSim3 *) optimizer.vertex(fr->kfId);
                 VertexSim3 *vPR2 = (VertexSim3 *) optimizer.vertex(rel.first->kfId);
-                EdgeSim3 *edgePR = new EdgeSim3();
                 if (vPR1 == nullptr || vPR2 == nullptr)
                     continue;
-                edgePR->setVertex(0, vPR1);
-                edgePR->setVertex(1, vPR2);
-                edgePR->setMeasurement(rel.second.Tcr);
 
-                if (rel.second.isLoop)
-                    edgePR->setInformation(rel.second.info /* *10 */);
-                else
-                    edgePR->setInformation(rel.second.info);
+                const Mat77 &info = rel.second.info;    // loop edges use the same weight (was info *10)
 
-                optimizer.addEdge(edgePR);
-                cntEdgePR++;
+                EdgeSim3 *&edgePR = poseGraphEdges[make_pair(fr->kfId, rel.first->kfId)];
+                if (edgePR == nullptr) {
+                    edgePR = new EdgeSim3();
+                    edgePR->setVertex(0, vPR1);
+                    edgePR->setVertex(1, vPR2);
+                    edgePR->setMeasurement(rel.second.Tcr);
+                    edgePR->setInformation(info);
+                    optimizer.addEdge(edgePR);
+                    firstDirty = min(firstDirty, min(fr->kfId, rel.first->kfId));
+                } else if (edgePR->measurement().matrix() != rel.second.Tcr.matrix() ||
+                           edgePR->information() != info) {
+                    edgePR->setMeasurement(rel.second.Tcr);
+                    edgePR->setInformation(info);
+                    firstDirty = min(firstDirty, min(fr->kfId, rel.first->kfId));
+                }
+                seenEdges.insert(edgePR);
             }
         }
 
-        optimizer.initializeOptimization();
-        optimizer.optimize(25);
-
-        // recover the pose and points estimation
-        for (shared_ptr<Frame> frame: framesOpti) {
-            VertexSim3 *vSim3 = (VertexSim3 *) optimizer.vertex(frame->kfId);
-            Sim3 Scw = vSim3->estimate();
-            CHECK(Scw.scale() > 0);
+        // constraints that are gone
+        for (auto it = poseGraphEdges.begin(); it != poseGraphEdges.end();) {
+            if (seenEdges.count(it->second) == 0) {
+                firstDirty = min(firstDirty, min(it->first.first, it->first.second));
+                optimizer.removeEdge(it->second);
+                it = poseGraphEdges.erase(it);
+            } else {
+                ++it;
+            }
+        }
 
-            frame->setPoseOpti(Scw);
-            // reset the map point world position because we've changed the keyframe pose
-            for (auto &feat: frame->features) {
-                if (feat->point) {
-                    feat->point->ComputeWorldPos();
+        if (firstDirty != ULONG_MAX) {
+            // only the edges touching the dirty part are relinearized
+            g2o::HyperGraph::EdgeSet activeEdges;
+            bool oldInvolved = false;     // an older keyframe is the boundary of the dirty part
+            for (auto &e: poseGraphEdges) {
+                if (max(e.first.first, e.first.second) >= firstDirty) {
+                    activeEdges.insert(e.second);
+                    oldInvolved = oldInvolved || min(e.first.first, e.first.second) < firstDirty;
                 }
             }
+
+            // there is one gauge, the pose of the last keyframe, which we don't want to change since it is in the
+            // window. The older keyframes are a block whose relative poses are already optimal, as a whole they are
+            // free: the dirty part is solved against the block held still, then the whole graph is moved by the
+            // one Sim3 which brings the last keyframe back, what the batch optimization with only the last keyframe
+            // fixed would give. Without older keyframes on the boundary the last keyframe is fixed right away.
+            Sim3 ScwCurrent = currentKF->getPoseOpti();
+            for (const shared_ptr<Frame> &fr: framesOpti) {
+                VertexSim3 *vSim3 = (VertexSim3 *) optimizer.vertex(fr->kfId);
+                vSim3->setFixed(oldInvolved ? fr->kfId < firstDirty : fr == currentKF);
+            }
+
+            LOG(INFO) << "pose graph: optimizing from kf " << firstDirty << ", " << activeEdges.size() << " of "
+                      << poseGraphEdges.size() << " edges" << endl;
+            if (!activeEdges.empty()) {
+                optimizer.initializeOptimization(activeEdges);
+                optimizer.optimize(25);
+            }
+
+            Sim3 gauge;     // identity unless the older keyframes held the dirty part
+            if (oldInvolved)
+                gauge = ((VertexSim3 *) optimizer.vertex(currentKF->kfId))->estimate().inverse() * ScwCurrent;
+
+            // recover the pose and points estimation, archived keyframes update their points when restored
+            unique_lock<mutex> archiveLock(archiveMutex);
+            for (const shared_ptr<Frame> &frame: framesOpti) {
+                if (frame->kfId < firstDirty && !oldInvolved)
+                    continue;
+                VertexSim3 *vSim3 = (VertexSim3 *) optimizer.vertex(frame->kfId);
+                Sim3 Scw = vSim3->estimate() * gauge;
+                CHECK(Scw.scale() > 0);
+                vSim3->setEstimate(Scw);
+
+                frame->setPoseOpti(Scw);
+                // reset the map point world position because we've changed the keyframe pose
+                updateWorldPoints(frame);
+            }
         }
 
         poseGraphRunning = false;
@@ -0,0 +1,539 @@
+#include "MapFile.h"
+#include "Feature.h"
+#include "Point.h"
+
+#include <glog/logging.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#if HAS_ZLIB
+#include <zlib.h>
+#endif
+
+using namespace std;
+
+namespace ldso {
+
+    // "LDSOMAP" and a zero
+    static const char MAP_MAGIC[8] = {'L', 'D', 'S', 'O', 'M', 'A', 'P', 0};
+    static const uint32_t MAP_ENDIAN_TAG = 0x01020304;
+    static const uint32_t MAP_FLAG_COMPRESSED = 1;
+
+    // header: magic, version, endian tag, flags, number of keyframes, index offset
+    static const size_t MAP_HEADER_SIZE = 8 + 4 + 4 + 4 + 4 + 8;
+    // index entry: id, kfId, timestamp, Tcw, TcwOpti, chunk offset, stored size, raw size
+    static const size_t MAP_INDEX_ENTRY_SIZE = 8 + 8 + 8 + 16 * 8 + 16 * 8 + 8 + 8 + 8;
+    // least bytes of one feature in a chunk: status, uv, invD, angle, score, isCorner, descriptor
+    static const size_t MAP_FEATURE_SIZE = 4 + 8 + 4 + 4 + 4 + 1 + 32;
+
+    /**
+     * append plain values and arrays to a byte buffer
+     */
+    class ChunkWriter {
+    public:
+        ChunkWriter(vector<unsigned char> &buf) : buf(buf) {}
+
+        template<typename T>
+        inline void Put(const T &v) { PutArray(&v, 1); }
+
+        template<typename T>
+        inline void PutArray(const T *v, size_t n) {
+            size_t pos = buf.size();
+            buf.resize(pos + n * sizeof(T));
+            if (n) memcpy(&buf[pos], v, n * sizeof(T));
+        }
+
+        template<typename Derived>
+        inline void PutMatrix(const Eigen::MatrixBase<Derived> &m) {
+            for (int i = 0; i < m.rows(); i++)
+                for (int j = 0; j < m.cols(); j++)
+                    Put(double(m(i, j)));
+        }
+
+        /// pad to 8 bytes so the next block starts aligned inside the chunk
+        inline void Align() { buf.resize((buf.size() + 7) & ~size_t(7), 0); }
+
+    private:
+        vector<unsigned char> &buf;
+    };
+
+    /**
+     * read plain values and arrays from a byte range, fails (and stays failed) instead of reading past its end
+     */
+    class ChunkReader {
+    public:
+        ChunkReader(const unsigned char *p, size_t size) : p(p), end(p + size) {}
+
+        template<typename T>
+        inline T Get() {
+            T v{};
+            GetArray(&v, 1);
+            return v;
+        }
+
+        template<typename T>
+        inline bool GetArray(T *v, size_t n) {
+            if (!ok || size_t(end - p) < n * sizeof(T)) {
+                ok = false;
+                return false;
+            }
+            if (n) memcpy(v, p, n * sizeof(T));
+            p += n * sizeof(T);
+            return true;
+        }
+
+        template<typename Derived>
+        inline void GetMatrix(Eigen::MatrixBase<Derived> &m) {
+            for (int i = 0; i < m.rows(); i++)
+                for (int j = 0; j < m.cols(); j++)
+                    m(i, j) = Get<double>();
+        }
+
+        inline size_t Remaining() const { return ok ? size_t(end - p) : 0; }
+
+        inline void Align(const unsigned char *base) {
+            size_t off = p - base;
+            size_t pad = ((off + 7) & ~size_t(7)) - off;
+            if (size_t(end - p) < pad) ok = false;
+            else p += pad;
+        }
+
+        bool ok = true;
+
+    private:
+        const unsigned char *p;
+        const unsigned char *end;
+    };
+
+    void MapFile::EncodeFrame(const shared_ptr<Frame> &frame, vector<unsigned char> &buf, bool withPoseRel) {
+        ChunkWriter w(buf);
+        const FeatureTable &table = frame->featureTable;
+        uint32_t nFeatures = table.size();
+
+        vector<uint32_t> pointFeature;
+        for (uint32_t k = 0; k < nFeatures; k++) {
+            if (table.status[k] == Feature::FeatureStatus::VALID && frame->features[k]->point)
+                pointFeature.push_back(k);
+        }
+
+        unique_lock<mutex> lock(frame->mutexPoseRel);
+        w.Put(nFeatures);
+        w.Put(uint32_t(pointFeature.size()));
+        w.Put(uint32_t(withPoseRel ? frame->poseRel.size() : 0));
+        w.Put(uint32_t(0));
+
+        // feature columns
+        for (uint32_t k = 0; k < nFeatures; k++)
+            w.Put(int32_t(table.status[k]));
+        for (uint32_t k = 0; k < nFeatures; k++)
+            w.PutArray(table.uv[k].data(), 2);
+        w.PutArray(table.invD.data(), nFeatures);
+        w.PutArray(table.angle.data(), nFeatures);
+        w.PutArray(table.score.data(), nFeatures);
+        w.PutArray(table.isCorner.data(), nFeatures);
+        w.Align();
+
+        // descriptors
+        w.PutArray(table.descriptors.data(), 32 * size_t(nFeatures));
+
+        // map points
+        for (uint32_t k: pointFeature) {
+            const shared_ptr<Point> &point = frame->features[k]->point;
+            w.Put(uint64_t(point->id));
+            w.Put(k);
+            w.Put(int32_t(point->status));
+        }
+
+        // pose relations
+        if (!withPoseRel)
+            return;
+        for (auto &rel: frame->poseRel) {
+            w.Put(uint64_t(rel.first->kfId));
+            w.Put(uint32_t(rel.second.isLoop));
+            w.Put(uint32_t(0));
+            w.PutMatrix(rel.second.Tcr.matrix());
+            w.PutMatrix(rel.second.info);
+        }
+    }
+
+    /**
+     * write header, chunks and index of a map file
+     */
+    static bool writeMap(ofstream &fout, const vector<shared_ptr<Frame>> &allKFs, bool compress,
+                         const function<bool(const shared_ptr<Frame> &)> &pin,
+                         const function<void(const shared_ptr<Frame> &)> &unpin) {
+        vector<unsigned char> header;
+        ChunkWriter hw(header);
+        hw.PutArray(MAP_MAGIC, 8);
+        hw.Put(uint32_t(MapFile::VERSION));
+        hw.Put(MAP_ENDIAN_TAG);
+        hw.Put(uint32_t(compress ? MAP_FLAG_COMPRESSED : 0));
+        hw.Put(uint32_t(allKFs.size()));
+        hw.Put(uint64_t(0));    // index offset, filled in at last
+        fout.write((const char *) header.data(), header.size());
+
+        vector<unsigned char> index;
+        ChunkWriter iw(index);
+        vector<unsigned char> raw, packed;
+        uint64_t offset = header.size();
+        for (const shared_ptr<Frame> &frame: allKFs) {
+            raw.clear();
+            bool pinned = !pin || pin(frame);
+            if (pinned)
+                MapFile::EncodeFrame(frame, raw);
+            if (unpin)
+                unpin(frame);
+            if (!pinned) {
+                LOG(ERROR) << "keyframe " << frame->kfId << " is not available for saving" << endl;
+                return false;
+            }
+
+            const vector<unsigned char> *stored = &raw;
+            if (compress) {
+                if (!MapFile::Compress(raw, packed)) {
+                    LOG(ERROR) << "failed to compress keyframe " << frame->kfId << endl;
+                    return false;
+                }
+                stored = &packed;
+            }
+            fout.write((const char *) stored->data(), stored->size());
+
+            iw.Put(uint64_t(frame->id));
+            iw.Put(uint64_t(frame->kfId));
+            iw.Put(frame->timeStamp);
+            iw.PutMatrix(frame->getPose().matrix());
+            iw.PutMatrix(frame->getPoseOpti().matrix());
+            iw.Put(offset);
+            iw.Put(uint64_t(stored->size()));
+            iw.Put(uint64_t(raw.size()));
+            offset += stored->size();
+        }
+
+        fout.write((const char *) index.data(), index.size());
+        fout.seekp(MAP_HEADER_SIZE - 8);
+        fout.write((const char *) &offset, sizeof(offset));
+        fout.close();
+        return bool(fout);
+    }
+
+    bool MapFile::Save(const string &filename, const vector<shared_ptr<Frame>> &allKFs, bool compress,
+                       const function<bool(const shared_ptr<Frame> &)> &pin,
+                       const function<void(const shared_ptr<Frame> &)> &unpin) {
+#if !HAS_ZLIB
+        if (compress)
+            LOG(WARNING) << "compiled without zlib, the map is saved uncompressed" << endl;
+        compress = false;
+#endif
+        // written aside and renamed when complete, a failed save leaves the old file (or none) behind
+        const string tmpFile = filename + ".tmp";
+        ofstream fout(tmpFile, ios::out | ios::binary);
+        if (!fout) return false;
+
+        if (!writeMap(fout, allKFs, compress, pin, unpin)) {
+            fout.close();
+            remove(tmpFile.c_str());
+            return false;
+        }
+        if (rename(tmpFile.c_str(), filename.c_str()) != 0) {
+            LOG(ERROR) << "cannot replace " << filename << endl;
+            remove(tmpFile.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    bool MapFile::IsMapFile(const string &filename) {
+        ifstream fin(filename, ios::in | ios::binary);
+        char magic[8] = {0};
+        if (!fin.read(magic, 8))
+            return false;
+        return memcmp(magic, MAP_MAGIC, 8) == 0;
+    }
+
+    bool MapFile::LoadLegacy(const string &filename, vector<shared_ptr<Frame>> &allKFs) {
+        ifstream fin(filename, ios::in | ios::binary);
+        if (!fin) return false;
+        int numKF = 0;
+        fin.read((char *) &numKF, sizeof(numKF));
+
+        allKFs.clear();
+        allKFs.resize(numKF, nullptr);
+        for (auto &kf: allKFs) {
+            kf = shared_ptr<Frame>(new Frame());
+        }
+
+        int i = 0;
+        while (!fin.eof() && i < int(allKFs.size())) {
+            shared_ptr<Frame> &newFrame = allKFs[i];
+            newFrame->load(fin, newFrame, allKFs);
+            i++;
+        }
+        return true;
+    }
+
+    bool MapFile::ConvertLegacy(const string &legacyFile, const string &filename, bool compress) {
+        vector<shared_ptr<Frame>> allKFs;
+        if (!LoadLegacy(legacyFile, allKFs))
+            return false;
+        return Save(filename, allKFs, compress);
+    }
+
+    bool MapFile::Open(const string &filename) {
+        Close();
+
+        fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            LOG(ERROR) << "cannot open map file " << filename << endl;
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || size_t(st.st_size) < MAP_HEADER_SIZE) {
+            LOG(ERROR) << "map file " << filename << " is too short" << endl;
+            Close();
+            return false;
+        }
+        dataSize = st.st_size;
+        void *p = mmap(nullptr, dataSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) {
+            LOG(ERROR) << "cannot map file " << filename << endl;
+            dataSize = 0;
+            Close();
+            return false;
+        }
+        data = (const unsigned char *) p;
+        // the chunks are decoded on demand, in any order
+        madvise(p, dataSize, MADV_RANDOM);
+
+        ChunkReader hr(data, MAP_HEADER_SIZE);
+        char magic[8];
+        hr.GetArray(magic, 8);
+        uint32_t version = hr.Get<uint32_t>();
+        uint32_t endianTag = hr.Get<uint32_t>();
+        uint32_t flags = hr.Get<uint32_t>();
+        uint32_t numKF = hr.Get<uint32_t>();
+        uint64_t indexOffset = hr.Get<uint64_t>();
+
+        if (memcmp(magic, MAP_MAGIC, 8) != 0) {
+            LOG(ERROR) << filename << " is not a map file" << endl;
+            Close();
+            return false;
+        }
+        if (endianTag != MAP_ENDIAN_TAG) {
+            LOG(ERROR) << "map file " << filename << " was written on a machine with another byte order" << endl;
+            Close();
+            return false;
+        }
+        if (version > VERSION) {
+            LOG(ERROR) << "map file version " << version << " is newer than the supported " << VERSION << endl;
+            Close();
+            return false;
+        }
+        compressed = flags & MAP_FLAG_COMPRESSED;
+#if !HAS_ZLIB
+        if (compressed) {
+            LOG(ERROR) << "map file " << filename << " is compressed but compiled without zlib" << endl;
+            Close();
+            return false;
+        }
+#endif
+        // a save that failed before writing the index leaves the offset at 0
+        if (indexOffset < MAP_HEADER_SIZE || indexOffset > dataSize ||
+            (dataSize - indexOffset) / MAP_INDEX_ENTRY_SIZE < numKF) {
+            LOG(ERROR) << "map file " << filename << " is truncated" << endl;
+            Close();
+            return false;
+        }
+
+        // create all keyframes from the index
+        ChunkReader ir(data + indexOffset, dataSize - indexOffset);
+        index.resize(numKF);
+        frames.resize(numKF);
+        loaded.assign(numKF, false);
+        for (uint32_t i = 0; i < numKF; i++) {
+            shared_ptr<Frame> frame(new Frame());
+            frame->id = ir.Get<uint64_t>();
+            frame->kfId = ir.Get<uint64_t>();
+            frame->timeStamp = ir.Get<double>();
+            Mat44 Tcw, TcwOpti;
+            ir.GetMatrix(Tcw);
+            ir.GetMatrix(TcwOpti);
+            frame->setPose(SE3(Tcw));
+            frame->setPoseOpti(Sim3(TcwOpti));
+
+            IndexEntry &e = index[i];
+            e.offset = ir.Get<uint64_t>();
+            e.size = ir.Get<uint64_t>();
+            e.rawSize = ir.Get<uint64_t>();
+            if (e.offset > dataSize || e.size > dataSize - e.offset) {
+                LOG(ERROR) << "map file " << filename << " has a bad chunk index" << endl;
+                Close();
+                return false;
+            }
+
+            frames[i] = frame;
+            kfIdToIndex[frame->kfId] = i;
+        }
+        return true;
+    }
+
+    void MapFile::Close() {
+        if (data)
+            munmap((void *) data, dataSize);
+        if (fd >= 0)
+            close(fd);
+        data = nullptr;
+        dataSize = 0;
+        fd = -1;
+        index.clear();
+        frames.clear();
+        loaded.clear();
+        kfIdToIndex.clear();
+    }
+
+    bool MapFile::LoadFrame(int i) {
+        if (i < 0 || i >= NumFrames() || !data)
+            return false;
+        if (loaded[i])
+            return true;
+
+        const IndexEntry &e = index[i];
+        const unsigned char *chunk = data + e.offset;
+        size_t chunkSize = e.size;
+        vector<unsigned char> unpacked;
+        if (compressed) {
+            if (!Uncompress(chunk, e.size, e.rawSize, unpacked)) {
+                LOG(ERROR) << "failed to decompress keyframe chunk " << i << endl;
+                return false;
+            }
+            chunk = unpacked.data();
+            chunkSize = unpacked.size();
+        }
+
+        auto findKF = [this](unsigned long kfId) -> shared_ptr<Frame> {
+            auto it = kfIdToIndex.find(kfId);
+            return it == kfIdToIndex.end() ? nullptr : frames[it->second];
+        };
+        if (!DecodeFrame(frames[i], chunk, chunkSize, findKF)) {
+            LOG(ERROR) << "keyframe chunk " << i << " is corrupted" << endl;
+            return false;
+        }
+        loaded[i] = true;
+        return true;
+    }
+
+    bool MapFile::DecodeFrame(const shared_ptr<Frame> &frame, const unsigned char *chunk, size_t size,
+                              const function<shared_ptr<Frame>(unsigned long)> &findKF) {
+        ChunkReader r(chunk, size);
+
+        uint32_t nFeatures = r.Get<uint32_t>();
+        uint32_t nPoints = r.Get<uint32_t>();
+        uint32_t nPoseRel = r.Get<uint32_t>();
+        r.Get<uint32_t>();
+        // a corrupted count must not allocate before the reads below would fail
+        frame->features.clear();
+        frame->featureTable = FeatureTable();
+        if (!r.ok || nFeatures > r.Remaining() / MAP_FEATURE_SIZE)
+            return false;
+
+        frame->features.reserve(nFeatures);
+        frame->featureTable.reserve(nFeatures);
+        for (uint32_t k = 0; k < nFeatures; k++)
+            frame->features.push_back(shared_ptr<Feature>(new Feature(0, 0, frame)));
+
+        // feature columns straight into the table
+        FeatureTable &table = frame->featureTable;
+        vector<int32_t> status(nFeatures);
+        r.GetArray(status.data(), nFeatures);
+        for (uint32_t k = 0; k < nFeatures && r.ok; k++) {
+            table.status[k] = Feature::FeatureStatus(status[k]);
+            r.GetArray(table.uv[k].data(), 2);
+        }
+        r.GetArray(table.invD.data(), nFeatures);
+        r.GetArray(table.angle.data(), nFeatures);
+        r.GetArray(table.score.data(), nFeatures);
+        r.GetArray(table.isCorner.data(), nFeatures);
+        r.Align(chunk);
+        r.GetArray(table.descriptors.data(), 32 * size_t(nFeatures));
+
+        for (uint32_t n = 0; n < nPoints && r.ok; n++) {
+            uint64_t id = r.Get<uint64_t>();
+            uint32_t k = r.Get<uint32_t>();
+            int32_t pointStatus = r.Get<int32_t>();
+            if (k >= nFeatures) {
+                r.ok = false;
+                break;
+            }
+            shared_ptr<Feature> &feat = frame->features[k];
+            feat->point = shared_ptr<Point>(new Point);
+            feat->point->id = id;
+            feat->point->status = Point::PointStatus(pointStatus);
+            feat->point->mHostFeature = feat;
+        }
+
+        // pose relations are only replaced by a complete chunk
+        decltype(frame->poseRel) poseRel;
+        if (nPoseRel > 0) {
+            for (uint32_t n = 0; n < nPoseRel && r.ok; n++) {
+                uint64_t kfId = r.Get<uint64_t>();
+                bool isLoop = r.Get<uint32_t>() != 0;
+                r.Get<uint32_t>();
+                Mat44 T;
+                Mat77 info;
+                r.GetMatrix(T);
+                r.GetMatrix(info);
+                shared_ptr<Frame> related = findKF ? findKF(kfId) : nullptr;
+                if (r.ok && related)
+                    poseRel[related] = Frame::RELPOSE(Sim3(T), info, isLoop);
+            }
+        }
+
+        if (!r.ok) {
+            // no partly decoded features
+            frame->features.clear();
+            frame->featureTable = FeatureTable();
+            return false;
+        }
+        if (nPoseRel > 0) {
+            unique_lock<mutex> lock(frame->mutexPoseRel);
+            frame->poseRel.swap(poseRel);
+        }
+        return true;
+    }
+
+    bool MapFile::Compress(const vector<unsigned char> &raw, vector<unsigned char> &packed) {
+#if HAS_ZLIB
+        uLongf packedSize = compressBound(raw.size());
+        packed.resize(packedSize);
+        if (compress2(packed.data(), &packedSize, raw.data(), raw.size(), Z_DEFAULT_COMPRESSION) != Z_OK)
+            return false;
+        packed.resize(packedSize);
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    bool MapFile::Uncompress(const unsigned char *packed, size_t size, size_t rawSize, vector<unsigned char> &raw) {
+#if HAS_ZLIB
+        raw.resize(rawSize);
+        uLongf unpackedSize = rawSize;
+        return uncompress(raw.data(), &unpackedSize, packed, size) == Z_OK && unpackedSize == rawSize;
+#else
+        return false;
+#endif
+    }
+
+    bool MapFile::LoadAll() {
+        for (int i = 0; i < NumFrames(); i++) {
+            if (!LoadFrame(i))
+                return false;
+        }
+        return true;
+    }
+}
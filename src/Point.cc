@@ -38,9 +38,9 @@ namespace ldso {
             if (!frame)
                 return;
             Sim3 Twc = frame->getPoseOpti().inverse();
-            Vec3 Kip = 1.0 / feat->invD * Vec3(
-                    fxiG[0] * feat->uv[0] + cxiG[0],
-                    fyiG[0] * feat->uv[1] + cyiG[0],
+            Vec3 Kip = 1.0 / feat->invD() * Vec3(
+                    fxiG[0] * feat->uv()[0] + cxiG[0],
+                    fyiG[0] * feat->uv()[1] + cyiG[0],
                     1);
             mWorldPos = Twc * Kip;
         }
@@ -5,7 +5,7 @@ using namespace std;
 
 namespace ldso {
 
-    int pyrLevelsUsed = PYR_LEVELS;
+    thread_local int pyrLevelsUsed = PYR_LEVELS;
     float setting_keyframesPerSecond = 0;
     bool setting_realTimeMaxKF = false;
     float setting_maxShiftWeightT = 0.04f * (640 + 480);
@@ -22,6 +22,7 @@ namespace ldso {
     float setting_initialCalibHessian = 5e9;
     int setting_solverMode = SOLVER_FIX_LAMBDA | SOLVER_ORTHOGONALIZE_X_LATER ;
     double setting_solverModeDelta = 0.00001;
+    int setting_solverBlockMinFrames = 10;
     float setting_minIdepthH_act = 100;
     float setting_minIdepthH_marg = 50;
     int setting_margPointVisWindow = 0;
@@ -107,6 +108,10 @@ namespace ldso {
     bool disableReconfigure = false;
     bool debugSaveImages = false;
     bool multiThreading = true;
+    int setting_numThreads = 6;
+    int setting_threadAffinity = -1;
+    int setting_framePoolSize = 12;
+    bool setting_framePoolHugePages = false;
     bool disableAllDisplay = false;
     bool setting_onlyLogKFPoses = true;
     bool setting_logStuff = true;
@@ -128,6 +133,10 @@ namespace ldso {
     bool setting_enableLoopClosing = true;
     bool setting_fastLoopClosing = true;
     bool setting_showLoopClosing = false;
+    bool setting_compressMap = false;
+    int setting_hotKeyFrames = 100;
+    int setting_archiveMemoryMB = 256;
+    const char *setting_archiveSpillDir = "/tmp";
 
     void handleKey(char k) {
         char kkk = k;
@@ -27,10 +27,10 @@ namespace ldso {
         return alignedPtr;
     }
 
-    CoarseTracker::CoarseTracker(int ww, int hh) {
+    CoarseTracker::CoarseTracker(int ww, int hh, bool workspaceOnly) {
 
         // make coarse tracking templates.
-        for (int lvl = 0; lvl < pyrLevelsUsed; lvl++) {
+        for (int lvl = 0; lvl < pyrLevelsUsed && !workspaceOnly; lvl++) {
             int wl = ww >> lvl;
             int hl = hh >> lvl;
 
@@ -56,6 +56,7 @@ namespace ldso {
         buf_warped_refColor = allocAligned<4, float>(ww * hh, ptrToDelete);
 
         w[0] = h[0] = 0;
+        kernelWidth = wideKernelWidth();
     }
 
     bool CoarseTracker::trackNewestCoarse(
@@ -66,6 +67,7 @@ namespace ldso {
 
         lastResiduals.setConstant(NAN);
         lastFlowIndicators.setConstant(1000);
+        lastTraceN = 0;
 
         newFrame = newFrameHessian;
 
@@ -185,6 +187,10 @@ namespace ldso {
             // set last residual for that level, as well as flow indicators.
             lastResiduals[lvl] = sqrtf((float) (resOld[0] / resOld[1]));
             lastFlowIndicators = resOld.segment<3>(2);
+            lastTraceLvl[lastTraceN] = lvl;
+            lastTraceRes[lastTraceN] = lastResiduals[lvl];
+            lastTraceFlow[lastTraceN] = lastFlowIndicators;
+            lastTraceN++;
             if (lastResiduals[lvl] > 1.5 * minResForAbort[lvl])
                 return false;
 
@@ -255,6 +261,34 @@ namespace ldso {
         firstCoarseRMSE = -1;
     }
 
+    void CoarseTracker::shareTrackingRef(const CoarseTracker &ref) {
+
+        lastRef = ref.lastRef;
+        lastRef_aff_g2l = ref.lastRef_aff_g2l;
+        refFrameID = ref.refFrameID;
+
+        for (int lvl = 0; lvl < pyrLevelsUsed; lvl++) {
+            K[lvl] = ref.K[lvl];
+            Ki[lvl] = ref.Ki[lvl];
+            fx[lvl] = ref.fx[lvl];
+            fy[lvl] = ref.fy[lvl];
+            fxi[lvl] = ref.fxi[lvl];
+            fyi[lvl] = ref.fyi[lvl];
+            cx[lvl] = ref.cx[lvl];
+            cy[lvl] = ref.cy[lvl];
+            cxi[lvl] = ref.cxi[lvl];
+            cyi[lvl] = ref.cyi[lvl];
+            w[lvl] = ref.w[lvl];
+            h[lvl] = ref.h[lvl];
+
+            pc_u[lvl] = ref.pc_u[lvl];
+            pc_v[lvl] = ref.pc_v[lvl];
+            pc_idepth[lvl] = ref.pc_idepth[lvl];
+            pc_color[lvl] = ref.pc_color[lvl];
+            pc_n[lvl] = ref.pc_n[lvl];
+        }
+    }
+
     void CoarseTracker::makeCoarseDepthL0(std::vector<shared_ptr<FrameHessian>> frameHessians) {
 
         // make coarse tracking templates for latstRef.
@@ -263,7 +297,7 @@ namespace ldso {
 
         for (shared_ptr<FrameHessian> fh: frameHessians) {
             for (shared_ptr<Feature> feat: fh->frame->features) {
-                if (feat->status == Feature::FeatureStatus::VALID &&
+                if (feat->status() == Feature::FeatureStatus::VALID &&
                     feat->point->status == Point::PointStatus::ACTIVE) {
 
                     shared_ptr<PointHessian> ph = feat->point->mpPH;
@@ -472,7 +506,8 @@ namespace ldso {
         float *lpc_color = pc_color[lvl];
 
 
-        for (int i = 0; i < nl; i++) {
+        // pixel shifts are only sampled on every 32nd point of level 0
+        for (int i = 0; lvl == 0 && i < nl; i += 32) {
             float id = lpc_idepth[i];
             float x = lpc_u[i];
             float y = lpc_v[i];
@@ -482,39 +517,51 @@ namespace ldso {
             float v = pt[1] / pt[2];
             float Ku = fxl * u + cxl;
             float Kv = fyl * v + cyl;
-            float new_idepth = id / pt[2];
 
-            if (lvl == 0 && i % 32 == 0) {
-                // translation only (positive)
-                Vec3f ptT = Ki[lvl] * Vec3f(x, y, 1) + t * id;
-                float uT = ptT[0] / ptT[2];
-                float vT = ptT[1] / ptT[2];
-                float KuT = fxl * uT + cxl;
-                float KvT = fyl * vT + cyl;
-
-                // translation only (negative)
-                Vec3f ptT2 = Ki[lvl] * Vec3f(x, y, 1) - t * id;
-                float uT2 = ptT2[0] / ptT2[2];
-                float vT2 = ptT2[1] / ptT2[2];
-                float KuT2 = fxl * uT2 + cxl;
-                float KvT2 = fyl * vT2 + cyl;
-
-                //translation and rotation (negative)
-                Vec3f pt3 = RKi * Vec3f(x, y, 1) - t * id;
-                float u3 = pt3[0] / pt3[2];
-                float v3 = pt3[1] / pt3[2];
-                float Ku3 = fxl * u3 + cxl;
-                float Kv3 = fyl * v3 + cyl;
-
-                //translation and rotation (positive)
-                //already have it.
-
-                sumSquaredShiftT += (KuT - x) * (KuT - x) + (KvT - y) * (KvT - y);
-                sumSquaredShiftT += (KuT2 - x) * (KuT2 - x) + (KvT2 - y) * (KvT2 - y);
-                sumSquaredShiftRT += (Ku - x) * (Ku - x) + (Kv - y) * (Kv - y);
-                sumSquaredShiftRT += (Ku3 - x) * (Ku3 - x) + (Kv3 - y) * (Kv3 - y);
-                sumSquaredShiftNum += 2;
-            }
+            // translation only (positive)
+            Vec3f ptT = Ki[lvl] * Vec3f(x, y, 1) + t * id;
+            float uT = ptT[0] / ptT[2];
+            float vT = ptT[1] / ptT[2];
+            float KuT = fxl * uT + cxl;
+            float KvT = fyl * vT + cyl;
+
+            // translation only (negative)
+            Vec3f ptT2 = Ki[lvl] * Vec3f(x, y, 1) - t * id;
+            float uT2 = ptT2[0] / ptT2[2];
+            float vT2 = ptT2[1] / ptT2[2];
+            float KuT2 = fxl * uT2 + cxl;
+            float KvT2 = fyl * vT2 + cyl;
+
+            //translation and rotation (negative)
+            Vec3f pt3 = RKi * Vec3f(x, y, 1) - t * id;
+            float u3 = pt3[0] / pt3[2];
+            float v3 = pt3[1] / pt3[2];
+            float Ku3 = fxl * u3 + cxl;
+            float Kv3 = fyl * v3 + cyl;
+
+            //translation and rotation (positive)
+            //already have it.
+
+            sumSquaredShiftT += (KuT - x) * (KuT - x) + (KvT - y) * (KvT - y);
+            sumSquaredShiftT += (KuT2 - x) * (KuT2 - x) + (KvT2 - y) * (KvT2 - y);
+            sumSquaredShiftRT += (Ku - x) * (Ku - x) + (Kv - y) * (Kv - y);
+            sumSquaredShiftRT += (Ku3 - x) * (Ku3 - x) + (Kv3 - y) * (Kv3 - y);
+            sumSquaredShiftNum += 2;
+        }
+
+        // the 256/512 bit kernel takes the bulk of the points, the rest is done here
+        int i = calcResWide(lvl, RKi, t, affLL, cutoffTH, maxEnergy, E, numTermsInE, numTermsInWarped, numSaturated);
+        for (; i < nl; i++) {
+            float id = lpc_idepth[i];
+            float x = lpc_u[i];
+            float y = lpc_v[i];
+
+            Vec3f pt = RKi * Vec3f(x, y, 1) + t * id;
+            float u = pt[0] / pt[2];
+            float v = pt[1] / pt[2];
+            float Ku = fxl * u + cxl;
+            float Kv = fyl * v + cyl;
+            float new_idepth = id / pt[2];
 
             if (!(Ku > 2 && Kv > 2 && Ku < wl - 3 && Kv < hl - 3 && new_idepth > 0)) continue;
 
@@ -575,12 +622,13 @@ namespace ldso {
 
         acc.initialize();
 
+        float affA = (float) (AffLight::fromToVecExposure(lastRef->ab_exposure, newFrame->ab_exposure,
+                                                          lastRef_aff_g2l, aff_g2l)[0]);
+
         __m128 fxl = _mm_set1_ps(fx[lvl]);
         __m128 fyl = _mm_set1_ps(fy[lvl]);
         __m128 b0 = _mm_set1_ps(lastRef_aff_g2l.b);
-        __m128 a = _mm_set1_ps(
-                (float) (AffLight::fromToVecExposure(lastRef->ab_exposure, newFrame->ab_exposure, lastRef_aff_g2l,
-                                                     aff_g2l)[0]));
+        __m128 a = _mm_set1_ps(affA);
 
         __m128 one = _mm_set1_ps(1);
         __m128 minusOne = _mm_set1_ps(-1);
@@ -588,7 +636,8 @@ namespace ldso {
 
         int n = buf_warped_n;
         assert(n % 4 == 0);
-        for (int i = 0; i < n; i += 4) {
+        // the 256/512 bit kernel takes the bulk of the points, the rest is done here
+        for (int i = calcGSWide(lvl, affA); i < n; i += 4) {
             __m128 dx = _mm_mul_ps(_mm_load_ps(buf_warped_dx + i), fxl);
             __m128 dy = _mm_mul_ps(_mm_load_ps(buf_warped_dy + i), fyl);
             __m128 u = _mm_load_ps(buf_warped_u + i);
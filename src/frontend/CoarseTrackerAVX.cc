@@ -0,0 +1,582 @@
+#include "frontend/CoarseTracker.h"
+#include "internal/GlobalCalib.h"
+#include "internal/FrameHessian.h"
+
+/**
+ * 256 bit (AVX2 + FMA) and 512 bit (AVX-512F) kernels of CoarseTracker::calcRes and CoarseTracker::calcGSSSE
+ *
+ * The kernels are compiled with per-function target attributes and picked at runtime by wideKernelWidth(), so one
+ * binary runs on every x86 cpu. Other platforms (and compilers without target attributes) use the SSE/NEON path.
+ */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LDSO_WIDE_KERNELS
+#include <immintrin.h>
+#define LDSO_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define LDSO_TARGET_AVX512 __attribute__((target("avx512f,avx2,fma")))
+#endif
+
+namespace ldso {
+
+#ifdef LDSO_WIDE_KERNELS
+
+    // input and output of the residual kernels, see CoarseTracker::calcRes
+    struct ResKernelArgs {
+        // reference points
+        const float *pc_u;
+        const float *pc_v;
+        const float *pc_idepth;
+        const float *pc_color;
+        int n;
+
+        // new image, 3 floats (intensity, dx, dy) per pixel
+        const float *dINew;
+        int wl, hl;
+        float fx, fy, cx, cy;
+
+        Mat33f RKi;
+        Vec3f t;
+        Vec2f affLL;
+        float huberTH;
+        float cutoffTH;
+        float maxEnergy;
+
+        // warped buffers
+        float *warped_idepth;
+        float *warped_u;
+        float *warped_v;
+        float *warped_dx;
+        float *warped_dy;
+        float *warped_residual;
+        float *warped_weight;
+        float *warped_refColor;
+
+        // sums
+        float E;
+        int numTermsInE;
+        int numTermsInWarped;
+        int numSaturated;
+    };
+
+    // input of the Gauss-Newton kernels, see CoarseTracker::calcGSSSE
+    struct GSKernelArgs {
+        const float *warped_idepth;
+        const float *warped_u;
+        const float *warped_v;
+        const float *warped_dx;
+        const float *warped_dy;
+        const float *warped_residual;
+        const float *warped_weight;
+        const float *warped_refColor;
+        int n;
+
+        float fx, fy;
+        float a, b0;
+    };
+
+    // points summed up in the wide registers before they are handed to the Accumulator9 hierarchy
+    const int GS_KERNEL_BLOCK = 512;
+
+    /**
+     * permutations that move the selected lanes of an 8 lane register to the front, AVX2 has no compress store
+     */
+    struct CompressTable {
+        alignas(32) int idx[256][8];
+
+        CompressTable() {
+            for (int mask = 0; mask < 256; mask++) {
+                int k = 0;
+                for (int lane = 0; lane < 8; lane++)
+                    if (mask & (1 << lane))
+                        idx[mask][k++] = lane;
+                for (; k < 8; k++)
+                    idx[mask][k] = 0;
+            }
+        }
+    };
+
+    static const CompressTable &compressTable() {
+        static CompressTable table;
+        return table;
+    }
+
+    // ============================================================================== //
+    // AVX2
+
+    LDSO_TARGET_AVX2
+    static inline void compressStoreAVX2(float *dst, __m256i perm, __m256 v) {
+        _mm256_storeu_ps(dst, _mm256_permutevar8x32_ps(v, perm));
+    }
+
+    LDSO_TARGET_AVX2
+    static inline __m256 gatherAVX2(const float *base, __m256i idx, __m256 mask) {
+        return _mm256_mask_i32gather_ps(_mm256_setzero_ps(), base, idx, mask, 4);
+    }
+
+    LDSO_TARGET_AVX2
+    static int calcResAVX2(ResKernelArgs &args) {
+
+        const int n = args.n & ~7;
+        const CompressTable &table = compressTable();
+
+        const __m256 r00 = _mm256_set1_ps(args.RKi(0, 0)), r01 = _mm256_set1_ps(args.RKi(0, 1)),
+                r02 = _mm256_set1_ps(args.RKi(0, 2));
+        const __m256 r10 = _mm256_set1_ps(args.RKi(1, 0)), r11 = _mm256_set1_ps(args.RKi(1, 1)),
+                r12 = _mm256_set1_ps(args.RKi(1, 2));
+        const __m256 r20 = _mm256_set1_ps(args.RKi(2, 0)), r21 = _mm256_set1_ps(args.RKi(2, 1)),
+                r22 = _mm256_set1_ps(args.RKi(2, 2));
+        const __m256 t0 = _mm256_set1_ps(args.t[0]), t1 = _mm256_set1_ps(args.t[1]), t2 = _mm256_set1_ps(args.t[2]);
+
+        const __m256 fxl = _mm256_set1_ps(args.fx), fyl = _mm256_set1_ps(args.fy);
+        const __m256 cxl = _mm256_set1_ps(args.cx), cyl = _mm256_set1_ps(args.cy);
+        const __m256 minUV = _mm256_set1_ps(2);
+        const __m256 maxU = _mm256_set1_ps(args.wl - 3), maxV = _mm256_set1_ps(args.hl - 3);
+
+        const __m256 aff0 = _mm256_set1_ps(args.affLL[0]), aff1 = _mm256_set1_ps(args.affLL[1]);
+        const __m256 huberTH = _mm256_set1_ps(args.huberTH);
+        const __m256 cutoffTH = _mm256_set1_ps(args.cutoffTH);
+        const __m256 maxEnergy = _mm256_set1_ps(args.maxEnergy);
+        const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1), two = _mm256_set1_ps(2);
+        const __m256 signMask = _mm256_set1_ps(-0.0f);
+
+        const __m256i three = _mm256_set1_epi32(3);
+        const __m256i wl = _mm256_set1_epi32(args.wl);
+        const int rowStride = 3 * args.wl;
+
+        __m256 E = zero;
+        int numTermsInE = 0, numSaturated = 0, numTermsInWarped = args.numTermsInWarped;
+
+        for (int i = 0; i < n; i += 8) {
+            __m256 x = _mm256_loadu_ps(args.pc_u + i);
+            __m256 y = _mm256_loadu_ps(args.pc_v + i);
+            __m256 id = _mm256_loadu_ps(args.pc_idepth + i);
+
+            // pt = RKi * (x,y,1) + t * id
+            __m256 ptx = _mm256_fmadd_ps(r00, x, _mm256_fmadd_ps(r01, y, _mm256_fmadd_ps(t0, id, r02)));
+            __m256 pty = _mm256_fmadd_ps(r10, x, _mm256_fmadd_ps(r11, y, _mm256_fmadd_ps(t1, id, r12)));
+            __m256 ptz = _mm256_fmadd_ps(r20, x, _mm256_fmadd_ps(r21, y, _mm256_fmadd_ps(t2, id, r22)));
+
+            __m256 u = _mm256_div_ps(ptx, ptz);
+            __m256 v = _mm256_div_ps(pty, ptz);
+            __m256 Ku = _mm256_fmadd_ps(fxl, u, cxl);
+            __m256 Kv = _mm256_fmadd_ps(fyl, v, cyl);
+            __m256 newIdepth = _mm256_div_ps(id, ptz);
+
+            __m256 inside = _mm256_and_ps(
+                    _mm256_and_ps(_mm256_cmp_ps(Ku, minUV, _CMP_GT_OQ), _mm256_cmp_ps(Kv, minUV, _CMP_GT_OQ)),
+                    _mm256_and_ps(_mm256_cmp_ps(Ku, maxU, _CMP_LT_OQ), _mm256_cmp_ps(Kv, maxV, _CMP_LT_OQ)));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(newIdepth, zero, _CMP_GT_OQ));
+            if (_mm256_movemask_ps(inside) == 0)
+                continue;
+
+            // bilinear interpolation, same weights as getInterpolatedElement33
+            __m256i ix = _mm256_cvttps_epi32(Ku);
+            __m256i iy = _mm256_cvttps_epi32(Kv);
+            __m256 dx = _mm256_sub_ps(Ku, _mm256_cvtepi32_ps(ix));
+            __m256 dy = _mm256_sub_ps(Kv, _mm256_cvtepi32_ps(iy));
+            __m256 dxdy = _mm256_mul_ps(dx, dy);
+            __m256 wbr = dxdy;
+            __m256 wbl = _mm256_sub_ps(dy, dxdy);
+            __m256 wtr = _mm256_sub_ps(dx, dxdy);
+            __m256 wtl = _mm256_add_ps(_mm256_sub_ps(_mm256_sub_ps(one, dx), dy), dxdy);
+
+            __m256i idx = _mm256_mullo_epi32(_mm256_add_epi32(ix, _mm256_mullo_epi32(iy, wl)), three);
+            __m256 hit[3];
+            for (int c = 0; c < 3; c++) {
+                const float *base = args.dINew + c;
+                __m256 tl = gatherAVX2(base, idx, inside);
+                __m256 tr = gatherAVX2(base + 3, idx, inside);
+                __m256 bl = gatherAVX2(base + rowStride, idx, inside);
+                __m256 br = gatherAVX2(base + rowStride + 3, idx, inside);
+                hit[c] = _mm256_fmadd_ps(wbr, br, _mm256_fmadd_ps(wbl, bl,
+                                                                  _mm256_fmadd_ps(wtr, tr, _mm256_mul_ps(wtl, tl))));
+            }
+
+            // finite intensity: hit - hit is 0 and not nan
+            __m256 valid = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_sub_ps(hit[0], hit[0]), zero, _CMP_EQ_OQ));
+
+            __m256 refColor = _mm256_loadu_ps(args.pc_color + i);
+            __m256 residual = _mm256_sub_ps(hit[0], _mm256_fmadd_ps(aff0, refColor, aff1));
+            __m256 absRes = _mm256_andnot_ps(signMask, residual);
+            __m256 hw = _mm256_blendv_ps(_mm256_div_ps(huberTH, absRes), one,
+                                         _mm256_cmp_ps(absRes, huberTH, _CMP_LT_OQ));
+            __m256 saturated = _mm256_cmp_ps(absRes, cutoffTH, _CMP_GT_OQ);
+
+            __m256 energy = _mm256_mul_ps(_mm256_mul_ps(hw, _mm256_mul_ps(residual, residual)),
+                                          _mm256_sub_ps(two, hw));
+            energy = _mm256_blendv_ps(energy, maxEnergy, saturated);
+            E = _mm256_add_ps(E, _mm256_and_ps(energy, valid));
+
+            int validMask = _mm256_movemask_ps(valid);
+            int satMask = validMask & _mm256_movemask_ps(saturated);
+            int keepMask = validMask & ~satMask;
+            numTermsInE += __builtin_popcount(validMask);
+            numSaturated += __builtin_popcount(satMask);
+            if (keepMask == 0)
+                continue;
+
+            __m256i perm = _mm256_load_si256((const __m256i *) table.idx[keepMask]);
+            compressStoreAVX2(args.warped_idepth + numTermsInWarped, perm, newIdepth);
+            compressStoreAVX2(args.warped_u + numTermsInWarped, perm, u);
+            compressStoreAVX2(args.warped_v + numTermsInWarped, perm, v);
+            compressStoreAVX2(args.warped_dx + numTermsInWarped, perm, hit[1]);
+            compressStoreAVX2(args.warped_dy + numTermsInWarped, perm, hit[2]);
+            compressStoreAVX2(args.warped_residual + numTermsInWarped, perm, residual);
+            compressStoreAVX2(args.warped_weight + numTermsInWarped, perm, hw);
+            compressStoreAVX2(args.warped_refColor + numTermsInWarped, perm, refColor);
+            numTermsInWarped += __builtin_popcount(keepMask);
+        }
+
+        // horizontal sum
+        __m128 E4 = _mm_add_ps(_mm256_castps256_ps128(E), _mm256_extractf128_ps(E, 1));
+        EIGEN_ALIGN16 float E4f[4];
+        _mm_store_ps(E4f, E4);
+        args.E += E4f[0] + E4f[1] + E4f[2] + E4f[3];
+        args.numTermsInE += numTermsInE;
+        args.numSaturated += numSaturated;
+        args.numTermsInWarped = numTermsInWarped;
+        return n;
+    }
+
+    LDSO_TARGET_AVX2
+    static int calcGSAVX2(const GSKernelArgs &args, Accumulator9 &acc) {
+
+        const int n = args.n & ~7;
+
+        const __m256 fxl = _mm256_set1_ps(args.fx);
+        const __m256 fyl = _mm256_set1_ps(args.fy);
+        const __m256 b0 = _mm256_set1_ps(args.b0);
+        const __m256 a = _mm256_set1_ps(args.a);
+        const __m256 one = _mm256_set1_ps(1);
+        const __m256 minusOne = _mm256_set1_ps(-1);
+        const __m256 zero = _mm256_setzero_ps();
+
+        EIGEN_ALIGN16 float lanes[4 * 45];
+        __m256 sum[45];
+
+        for (int start = 0; start < n; start += GS_KERNEL_BLOCK) {
+            const int end = std::min(n, start + GS_KERNEL_BLOCK);
+            for (int k = 0; k < 45; k++)
+                sum[k] = zero;
+
+            for (int i = start; i < end; i += 8) {
+                __m256 dx = _mm256_mul_ps(_mm256_loadu_ps(args.warped_dx + i), fxl);
+                __m256 dy = _mm256_mul_ps(_mm256_loadu_ps(args.warped_dy + i), fyl);
+                __m256 u = _mm256_loadu_ps(args.warped_u + i);
+                __m256 v = _mm256_loadu_ps(args.warped_v + i);
+                __m256 id = _mm256_loadu_ps(args.warped_idepth + i);
+                __m256 w = _mm256_loadu_ps(args.warped_weight + i);
+
+                // same Jacobian as calcGSSSE
+                __m256 J[9];
+                J[0] = _mm256_mul_ps(id, dx);
+                J[1] = _mm256_mul_ps(id, dy);
+                J[2] = _mm256_sub_ps(zero, _mm256_mul_ps(id, _mm256_fmadd_ps(u, dx, _mm256_mul_ps(v, dy))));
+                J[3] = _mm256_sub_ps(zero, _mm256_fmadd_ps(_mm256_mul_ps(u, v), dx,
+                                                           _mm256_mul_ps(dy, _mm256_fmadd_ps(v, v, one))));
+                J[4] = _mm256_fmadd_ps(_mm256_mul_ps(u, v), dy, _mm256_mul_ps(dx, _mm256_fmadd_ps(u, u, one)));
+                J[5] = _mm256_fmsub_ps(u, dy, _mm256_mul_ps(v, dx));
+                J[6] = _mm256_mul_ps(a, _mm256_sub_ps(b0, _mm256_loadu_ps(args.warped_refColor + i)));
+                J[7] = minusOne;
+                J[8] = _mm256_loadu_ps(args.warped_residual + i);
+
+                int k = 0;
+                for (int r = 0; r < 9; r++) {
+                    __m256 Jrw = _mm256_mul_ps(J[r], w);
+                    for (int c = r; c < 9; c++, k++)
+                        sum[k] = _mm256_fmadd_ps(Jrw, J[c], sum[k]);
+                }
+            }
+
+            for (int k = 0; k < 45; k++)
+                _mm_store_ps(lanes + 4 * k,
+                             _mm_add_ps(_mm256_castps256_ps128(sum[k]), _mm256_extractf128_ps(sum[k], 1)));
+            acc.updateLanes(lanes, end - start);
+        }
+        return n;
+    }
+
+    // ============================================================================== //
+    // AVX-512
+
+    LDSO_TARGET_AVX512
+    static inline __m512 gatherAVX512(const float *base, __m512i idx, __mmask16 mask) {
+        return _mm512_mask_i32gather_ps(_mm512_setzero_ps(), mask, idx, base, 4);
+    }
+
+    LDSO_TARGET_AVX512
+    static int calcResAVX512(ResKernelArgs &args) {
+
+        const int n = args.n & ~15;
+
+        const __m512 r00 = _mm512_set1_ps(args.RKi(0, 0)), r01 = _mm512_set1_ps(args.RKi(0, 1)),
+                r02 = _mm512_set1_ps(args.RKi(0, 2));
+        const __m512 r10 = _mm512_set1_ps(args.RKi(1, 0)), r11 = _mm512_set1_ps(args.RKi(1, 1)),
+                r12 = _mm512_set1_ps(args.RKi(1, 2));
+        const __m512 r20 = _mm512_set1_ps(args.RKi(2, 0)), r21 = _mm512_set1_ps(args.RKi(2, 1)),
+                r22 = _mm512_set1_ps(args.RKi(2, 2));
+        const __m512 t0 = _mm512_set1_ps(args.t[0]), t1 = _mm512_set1_ps(args.t[1]), t2 = _mm512_set1_ps(args.t[2]);
+
+        const __m512 fxl = _mm512_set1_ps(args.fx), fyl = _mm512_set1_ps(args.fy);
+        const __m512 cxl = _mm512_set1_ps(args.cx), cyl = _mm512_set1_ps(args.cy);
+        const __m512 minUV = _mm512_set1_ps(2);
+        const __m512 maxU = _mm512_set1_ps(args.wl - 3), maxV = _mm512_set1_ps(args.hl - 3);
+
+        const __m512 aff0 = _mm512_set1_ps(args.affLL[0]), aff1 = _mm512_set1_ps(args.affLL[1]);
+        const __m512 huberTH = _mm512_set1_ps(args.huberTH);
+        const __m512 cutoffTH = _mm512_set1_ps(args.cutoffTH);
+        const __m512 maxEnergy = _mm512_set1_ps(args.maxEnergy);
+        const __m512 zero = _mm512_setzero_ps(), one = _mm512_set1_ps(1), two = _mm512_set1_ps(2);
+
+        const __m512i three = _mm512_set1_epi32(3);
+        const __m512i wl = _mm512_set1_epi32(args.wl);
+        const int rowStride = 3 * args.wl;
+
+        __m512 E = zero;
+        int numTermsInE = 0, numSaturated = 0, numTermsInWarped = args.numTermsInWarped;
+
+        for (int i = 0; i < n; i += 16) {
+            __m512 x = _mm512_loadu_ps(args.pc_u + i);
+            __m512 y = _mm512_loadu_ps(args.pc_v + i);
+            __m512 id = _mm512_loadu_ps(args.pc_idepth + i);
+
+            // pt = RKi * (x,y,1) + t * id
+            __m512 ptx = _mm512_fmadd_ps(r00, x, _mm512_fmadd_ps(r01, y, _mm512_fmadd_ps(t0, id, r02)));
+            __m512 pty = _mm512_fmadd_ps(r10, x, _mm512_fmadd_ps(r11, y, _mm512_fmadd_ps(t1, id, r12)));
+            __m512 ptz = _mm512_fmadd_ps(r20, x, _mm512_fmadd_ps(r21, y, _mm512_fmadd_ps(t2, id, r22)));
+
+            __m512 u = _mm512_div_ps(ptx, ptz);
+            __m512 v = _mm512_div_ps(pty, ptz);
+            __m512 Ku = _mm512_fmadd_ps(fxl, u, cxl);
+            __m512 Kv = _mm512_fmadd_ps(fyl, v, cyl);
+            __m512 newIdepth = _mm512_div_ps(id, ptz);
+
+            __mmask16 inside = _mm512_cmp_ps_mask(Ku, minUV, _CMP_GT_OQ);
+            inside = _mm512_mask_cmp_ps_mask(inside, Kv, minUV, _CMP_GT_OQ);
+            inside = _mm512_mask_cmp_ps_mask(inside, Ku, maxU, _CMP_LT_OQ);
+            inside = _mm512_mask_cmp_ps_mask(inside, Kv, maxV, _CMP_LT_OQ);
+            inside = _mm512_mask_cmp_ps_mask(inside, newIdepth, zero, _CMP_GT_OQ);
+            if (inside == 0)
+                continue;
+
+            // bilinear interpolation, same weights as getInterpolatedElement33
+            __m512i ix = _mm512_cvttps_epi32(Ku);
+            __m512i iy = _mm512_cvttps_epi32(Kv);
+            __m512 dx = _mm512_sub_ps(Ku, _mm512_cvtepi32_ps(ix));
+            __m512 dy = _mm512_sub_ps(Kv, _mm512_cvtepi32_ps(iy));
+            __m512 dxdy = _mm512_mul_ps(dx, dy);
+            __m512 wbr = dxdy;
+            __m512 wbl = _mm512_sub_ps(dy, dxdy);
+            __m512 wtr = _mm512_sub_ps(dx, dxdy);
+            __m512 wtl = _mm512_add_ps(_mm512_sub_ps(_mm512_sub_ps(one, dx), dy), dxdy);
+
+            __m512i idx = _mm512_mullo_epi32(_mm512_add_epi32(ix, _mm512_mullo_epi32(iy, wl)), three);
+            __m512 hit[3];
+            for (int c = 0; c < 3; c++) {
+                const float *base = args.dINew + c;
+                __m512 tl = gatherAVX512(base, idx, inside);
+                __m512 tr = gatherAVX512(base + 3, idx, inside);
+                __m512 bl = gatherAVX512(base + rowStride, idx, inside);
+                __m512 br = gatherAVX512(base + rowStride + 3, idx, inside);
+                hit[c] = _mm512_fmadd_ps(wbr, br, _mm512_fmadd_ps(wbl, bl,
+                                                                  _mm512_fmadd_ps(wtr, tr, _mm512_mul_ps(wtl, tl))));
+            }
+
+            // finite intensity: hit - hit is 0 and not nan
+            __mmask16 valid = _mm512_mask_cmp_ps_mask(inside, _mm512_sub_ps(hit[0], hit[0]), zero, _CMP_EQ_OQ);
+
+            __m512 refColor = _mm512_loadu_ps(args.pc_color + i);
+            __m512 residual = _mm512_sub_ps(hit[0], _mm512_fmadd_ps(aff0, refColor, aff1));
+            __m512 absRes = _mm512_abs_ps(residual);
+            __m512 hw = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(absRes, huberTH, _CMP_LT_OQ),
+                                             _mm512_div_ps(huberTH, absRes), one);
+            __mmask16 saturated = _mm512_mask_cmp_ps_mask(valid, absRes, cutoffTH, _CMP_GT_OQ);
+            __mmask16 keep = valid & ~saturated;
+
+            __m512 energy = _mm512_mul_ps(_mm512_mul_ps(hw, _mm512_mul_ps(residual, residual)),
+                                          _mm512_sub_ps(two, hw));
+            energy = _mm512_mask_blend_ps(saturated, energy, maxEnergy);
+            E = _mm512_mask_add_ps(E, valid, E, energy);
+
+            numTermsInE += __builtin_popcount(valid);
+            numSaturated += __builtin_popcount(saturated);
+            if (keep == 0)
+                continue;
+
+            _mm512_mask_compressstoreu_ps(args.warped_idepth + numTermsInWarped, keep, newIdepth);
+            _mm512_mask_compressstoreu_ps(args.warped_u + numTermsInWarped, keep, u);
+            _mm512_mask_compressstoreu_ps(args.warped_v + numTermsInWarped, keep, v);
+            _mm512_mask_compressstoreu_ps(args.warped_dx + numTermsInWarped, keep, hit[1]);
+            _mm512_mask_compressstoreu_ps(args.warped_dy + numTermsInWarped, keep, hit[2]);
+            _mm512_mask_compressstoreu_ps(args.warped_residual + numTermsInWarped, keep, residual);
+            _mm512_mask_compressstoreu_ps(args.warped_weight + numTermsInWarped, keep, hw);
+            _mm512_mask_compressstoreu_ps(args.warped_refColor + numTermsInWarped, keep, refColor);
+            numTermsInWarped += __builtin_popcount(keep);
+        }
+
+        args.E += _mm512_reduce_add_ps(E);
+        args.numTermsInE += numTermsInE;
+        args.numSaturated += numSaturated;
+        args.numTermsInWarped = numTermsInWarped;
+        return n;
+    }
+
+    LDSO_TARGET_AVX512
+    static int calcGSAVX512(const GSKernelArgs &args, Accumulator9 &acc) {
+
+        const int n = args.n & ~15;
+
+        const __m512 fxl = _mm512_set1_ps(args.fx);
+        const __m512 fyl = _mm512_set1_ps(args.fy);
+        const __m512 b0 = _mm512_set1_ps(args.b0);
+        const __m512 a = _mm512_set1_ps(args.a);
+        const __m512 one = _mm512_set1_ps(1);
+        const __m512 minusOne = _mm512_set1_ps(-1);
+        const __m512 zero = _mm512_setzero_ps();
+
+        EIGEN_ALIGN16 float lanes[4 * 45];
+        __m512 sum[45];
+
+        for (int start = 0; start < n; start += GS_KERNEL_BLOCK) {
+            const int end = std::min(n, start + GS_KERNEL_BLOCK);
+            for (int k = 0; k < 45; k++)
+                sum[k] = zero;
+
+            for (int i = start; i < end; i += 16) {
+                __m512 dx = _mm512_mul_ps(_mm512_loadu_ps(args.warped_dx + i), fxl);
+                __m512 dy = _mm512_mul_ps(_mm512_loadu_ps(args.warped_dy + i), fyl);
+                __m512 u = _mm512_loadu_ps(args.warped_u + i);
+                __m512 v = _mm512_loadu_ps(args.warped_v + i);
+                __m512 id = _mm512_loadu_ps(args.warped_idepth + i);
+                __m512 w = _mm512_loadu_ps(args.warped_weight + i);
+
+                // same Jacobian as calcGSSSE
+                __m512 J[9];
+                J[0] = _mm512_mul_ps(id, dx);
+                J[1] = _mm512_mul_ps(id, dy);
+                J[2] = _mm512_sub_ps(zero, _mm512_mul_ps(id, _mm512_fmadd_ps(u, dx, _mm512_mul_ps(v, dy))));
+                J[3] = _mm512_sub_ps(zero, _mm512_fmadd_ps(_mm512_mul_ps(u, v), dx,
+                                                           _mm512_mul_ps(dy, _mm512_fmadd_ps(v, v, one))));
+                J[4] = _mm512_fmadd_ps(_mm512_mul_ps(u, v), dy, _mm512_mul_ps(dx, _mm512_fmadd_ps(u, u, one)));
+                J[5] = _mm512_fmsub_ps(u, dy, _mm512_mul_ps(v, dx));
+                J[6] = _mm512_mul_ps(a, _mm512_sub_ps(b0, _mm512_loadu_ps(args.warped_refColor + i)));
+                J[7] = minusOne;
+                J[8] = _mm512_loadu_ps(args.warped_residual + i);
+
+                int k = 0;
+                for (int r = 0; r < 9; r++) {
+                    __m512 Jrw = _mm512_mul_ps(J[r], w);
+                    for (int c = r; c < 9; c++, k++)
+                        sum[k] = _mm512_fmadd_ps(Jrw, J[c], sum[k]);
+                }
+            }
+
+            // fold 16 lanes to 4
+            for (int k = 0; k < 45; k++) {
+                __m128 s = _mm_add_ps(
+                        _mm_add_ps(_mm512_extractf32x4_ps(sum[k], 0), _mm512_extractf32x4_ps(sum[k], 1)),
+                        _mm_add_ps(_mm512_extractf32x4_ps(sum[k], 2), _mm512_extractf32x4_ps(sum[k], 3)));
+                _mm_store_ps(lanes + 4 * k, s);
+            }
+            acc.updateLanes(lanes, end - start);
+        }
+        return n;
+    }
+
+#endif // LDSO_WIDE_KERNELS
+
+    // ============================================================================== //
+    // dispatch
+
+    int CoarseTracker::wideKernelWidth() {
+#ifdef LDSO_WIDE_KERNELS
+        static const int width = []() -> int {
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx512f"))
+                return 16;
+            if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+                return 8;
+            return 4;
+        }();
+        return width;
+#else
+        return 4;
+#endif
+    }
+
+    int CoarseTracker::calcResWide(int lvl, const Mat33f &RKi, const Vec3f &t, const Vec2f &affLL, float cutoffTH,
+                                   float maxEnergy, float &E, int &numTermsInE, int &numTermsInWarped,
+                                   int &numSaturated) {
+#ifdef LDSO_WIDE_KERNELS
+        if (kernelWidth <= 4)
+            return 0;
+
+        ResKernelArgs args;
+        args.pc_u = pc_u[lvl];
+        args.pc_v = pc_v[lvl];
+        args.pc_idepth = pc_idepth[lvl];
+        args.pc_color = pc_color[lvl];
+        args.n = pc_n[lvl];
+        args.dINew = newFrame->dIp[lvl][0].data();
+        args.wl = w[lvl];
+        args.hl = h[lvl];
+        args.fx = fx[lvl];
+        args.fy = fy[lvl];
+        args.cx = cx[lvl];
+        args.cy = cy[lvl];
+        args.RKi = RKi;
+        args.t = t;
+        args.affLL = affLL;
+        args.huberTH = setting_huberTH;
+        args.cutoffTH = cutoffTH;
+        args.maxEnergy = maxEnergy;
+        args.warped_idepth = buf_warped_idepth;
+        args.warped_u = buf_warped_u;
+        args.warped_v = buf_warped_v;
+        args.warped_dx = buf_warped_dx;
+        args.warped_dy = buf_warped_dy;
+        args.warped_residual = buf_warped_residual;
+        args.warped_weight = buf_warped_weight;
+        args.warped_refColor = buf_warped_refColor;
+        args.E = E;
+        args.numTermsInE = numTermsInE;
+        args.numTermsInWarped = numTermsInWarped;
+        args.numSaturated = numSaturated;
+
+        int done = kernelWidth == 16 ? calcResAVX512(args) : calcResAVX2(args);
+
+        E = args.E;
+        numTermsInE = args.numTermsInE;
+        numTermsInWarped = args.numTermsInWarped;
+        numSaturated = args.numSaturated;
+        return done;
+#else
+        return 0;
+#endif
+    }
+
+    int CoarseTracker::calcGSWide(int lvl, float affA) {
+#ifdef LDSO_WIDE_KERNELS
+        if (kernelWidth <= 4)
+            return 0;
+
+        GSKernelArgs args;
+        args.warped_idepth = buf_warped_idepth;
+        args.warped_u = buf_warped_u;
+        args.warped_v = buf_warped_v;
+        args.warped_dx = buf_warped_dx;
+        args.warped_dy = buf_warped_dy;
+        args.warped_residual = buf_warped_residual;
+        args.warped_weight = buf_warped_weight;
+        args.warped_refColor = buf_warped_refColor;
+        args.n = buf_warped_n;
+        args.fx = fx[lvl];
+        args.fy = fy[lvl];
+        args.a = affA;
+        args.b0 = lastRef_aff_g2l.b;
+
+        return kernelWidth == 16 ? calcGSAVX512(args, acc) : calcGSAVX2(args, acc);
+#else
+        return 0;
+#endif
+    }
+}
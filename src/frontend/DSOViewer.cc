@@ -21,7 +21,7 @@ namespace ldso {
         for (auto feat: fr->features) {
             if (feat->point && feat->point->mpPH) {
                 npoints++;
-            } else if (feat->status == Feature::FeatureStatus::IMMATURE && feat->ip) {
+            } else if (feat->status() == Feature::FeatureStatus::IMMATURE && feat->ip) {
                 npoints++;
             }
         }
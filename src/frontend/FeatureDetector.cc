@@ -31,7 +31,7 @@ namespace ldso {
 
     }
 
-    int FeatureDetector::DetectCorners(int nFeatures, shared_ptr<Frame> &frame) {
+    int FeatureDetector::DetectCorners(int nFeatures, shared_ptr<Frame> &frame, IndexThreadReduce<Vec10> *red) {
 
         // grid it
         int gridsize = int(sqrtf(wG[0] * hG[0] / nFeatures) + 0.5);
@@ -41,56 +41,37 @@ namespace ldso {
         float maxScore = 0, scoreTH = 0;
         int skip = (HALF_PATCH_SIZE * 2 / gridsize) + 1;
 
+        // each cell picks its best candidates until picked > nfeatInGrid
+        int topK = int(nfeatInGrid) + 1;
+        cellNum.assign(gridX * gridY, 0);
+        cellCand.resize(gridX * gridY * topK);
+        cellScore.resize(gridX * gridY * topK);
+        cellMaxScore.assign(gridX * gridY, 0);
+
+        if (skip < gridY - skip) {
+            if (red) {
+                red->reduce(bind(&FeatureDetector::scoreCells_Reductor, this, &frame, gridsize, gridX, skip, topK,
+                                 _1, _2, _3, _4), skip, gridY - skip, 1);
+            } else {
+                Vec10 stats = Vec10::Zero();
+                scoreCells_Reductor(&frame, gridsize, gridX, skip, topK, skip, gridY - skip, &stats, 0);
+            }
+        }
+
         for (int gx = skip; gx < gridX - skip; gx++) {  // 最边上的不要
             for (int gy = skip; gy < gridY - skip; gy++) {
+                int cell = gy * gridX + gx;
+                if (cellMaxScore[cell] > maxScore)
+                    maxScore = cellMaxScore[cell];
 
-                float maxGrad = 0, gradTH = 0;
-                float *gradData = &frame->frameHessian->absSquaredGrad[0][gy * gridsize * wG[0] + gx * gridsize];
-
-                for (int x = 0; x < gridsize; x++) {
-                    for (int y = 0; y < gridsize; y++) {
-                        if (gradData[y * wG[0] + x] > maxGrad)
-                            maxGrad = gradData[y * wG[0] + x];
-                    }
-                }
-
-                vector<pair<int, float>> candidate;
-
-                gradTH = (0.5 * maxGrad) > 5 ? 0.5 * maxGrad : 5;
-                int picked = 0;
-
-                for (int x = 0; x < gridsize; x++) {
-                    for (int y = 0; y < gridsize; y++) {
-                        int idx = y * gridsize + x;
-                        if (gradData[y * wG[0] + x] > gradTH) {
-                            // this is an candidate
-                            int realX = gx * gridsize + x, realY = gy * gridsize + y;
-                            float s = ShiTomasiScore(frame, realX, realY);
-                            candidate.push_back(pair<int, float>(idx, s));
-                            if (s > maxScore) {
-                                maxScore = s;
-                            }
-
-                        }
-                    }
-                }
-
-                sort(candidate.begin(), candidate.end(),
-                     [](const pair<int, float> &p1, const pair<int, float> &p2) { return p1.second > p2.second; });
-
-                for (auto &p: candidate) {
-                    int x = p.first % gridsize;
-                    int y = p.first / gridsize;
+                for (int k = 0; k < cellNum[cell]; k++) {
+                    int x = cellCand[cell * topK + k] % gridsize;
+                    int y = cellCand[cell * topK + k] / gridsize;
                     int realX = gx * gridsize + x, realY = gy * gridsize + y;
                     shared_ptr<Feature> feat(new Feature(realX, realY, frame));
-                    feat->score = p.second;
+                    feat->score() = cellScore[cell * topK + k];
                     frame->features.push_back(feat);
-                    picked++;
-
-                    if (picked > (nfeatInGrid))
-                        break;
                 }
-                // LOG(INFO) << "picked " << picked << "/" << nfeatInGrid << " in one grid" << endl;
             }
         }
 
@@ -98,58 +79,144 @@ namespace ldso {
         scoreTH = 0.01 * maxScore;
         vector<shared_ptr<Feature>> corners;
         for (auto &feat: frame->features) {
-            if (feat->score > scoreTH) {
-                feat->isCorner = true;
+            if (feat->score() > scoreTH) {
+                feat->isCorner() = true;
                 corners.push_back(feat);
             }
         }
 
+        // non-maximum suppression: of two corners closer than 5 pixels the weaker one is dropped (on a tie the
+        // earlier one). Corners are hashed into 5x5 cells so only the 3x3 neighbouring cells need to be checked.
+        const int nmsSize = 5;
+        int nmsX = wG[0] / nmsSize + 1, nmsY = hG[0] / nmsSize + 1;
+        nmsCellStart.assign(nmsX * nmsY + 1, 0);
+        nmsCellIndex.resize(corners.size());
+
+        auto nmsCellOf = [&](const shared_ptr<Feature> &feat) {
+            int cx = std::max(0, std::min(nmsX - 1, int(feat->uv()[0]) / nmsSize));
+            int cy = std::max(0, std::min(nmsY - 1, int(feat->uv()[1]) / nmsSize));
+            return cy * nmsX + cx;
+        };
+
+        // counting sort: count, prefix sum to the cell ends, then fill backwards which leaves the cell starts
+        for (auto &feat: corners)
+            nmsCellStart[nmsCellOf(feat)]++;
+        for (int c = 1; c <= nmsX * nmsY; c++)
+            nmsCellStart[c] += nmsCellStart[c - 1];
+        for (int i = int(corners.size()) - 1; i >= 0; i--)
+            nmsCellIndex[--nmsCellStart[nmsCellOf(corners[i])]] = i;
+
         for (int i = 0; i < corners.size(); i++) {
-            for (int j = i + 1; j < corners.size(); j++) {
-                auto &feat1 = corners[i], feat2 = corners[j];
-                if ((feat1->uv - feat2->uv).norm() < 5) {
-                    if (feat1->score > feat2->score)
-                        feat2->isCorner = false;
-                    else
-                        feat1->isCorner = false;
+            auto &feat1 = corners[i];
+            int cx = std::max(0, std::min(nmsX - 1, int(feat1->uv()[0]) / nmsSize));
+            int cy = std::max(0, std::min(nmsY - 1, int(feat1->uv()[1]) / nmsSize));
+            bool suppressed = false;
+            for (int ny = std::max(0, cy - 1); ny <= std::min(nmsY - 1, cy + 1) && !suppressed; ny++) {
+                for (int nx = std::max(0, cx - 1); nx <= std::min(nmsX - 1, cx + 1) && !suppressed; nx++) {
+                    int c = ny * nmsX + nx;
+                    for (int n = nmsCellStart[c]; n < nmsCellStart[c + 1]; n++) {
+                        int j = nmsCellIndex[n];
+                        if (j == i) continue;
+                        auto &feat2 = corners[j];
+                        if ((feat1->uv() - feat2->uv()).norm() < 5 &&
+                            (j > i ? feat2->score() >= feat1->score() : feat2->score() > feat1->score())) {
+                            suppressed = true;
+                            break;
+                        }
+                    }
                 }
-
             }
+            if (suppressed)
+                feat1->isCorner() = false;
         }
 
         int cntCornerSelected = 0;
-        for (auto &feat: frame->features) {
-            if (feat->isCorner) {
-                feat->angle = IC_Angle(
-                        frame->frameHessian->dIp[feat->level], Vec2f(feat->uv[0], feat->uv[1]), feat->level);
-                ComputeDescriptor(frame, feat);
+        for (size_t i = 0; i < frame->features.size(); i++) {
+            auto &feat = frame->features[i];
+            if (feat->isCorner()) {
+                feat->angle() = IC_Angle(
+                        frame->frameHessian->dIp[feat->level()], Vec2f(feat->uv()[0], feat->uv()[1]), feat->level());
+                ComputeDescriptor(frame, feat, feat->descriptor());
                 cntCornerSelected++;
             }
         }
         return cntCornerSelected;
     }
 
-    int FeatureDetector::ComputeDescriptor(shared_ptr<Frame> &frame, shared_ptr<Feature> feat) {
+    void FeatureDetector::scoreCells_Reductor(shared_ptr<Frame> *frame, int gridsize, int gridX, int skip, int topK,
+                                              int min, int max, Vec10 *stats, int tid) {
+
+        for (int gy = min; gy < max; gy++) {
+            for (int gx = skip; gx < gridX - skip; gx++) {
+
+                int cell = gy * gridX + gx;
+                float maxGrad = 0, gradTH = 0;
+                float *gradData = &(*frame)->frameHessian->absSquaredGrad[0][gy * gridsize * wG[0] + gx * gridsize];
+
+                for (int x = 0; x < gridsize; x++) {
+                    for (int y = 0; y < gridsize; y++) {
+                        if (gradData[y * wG[0] + x] > maxGrad)
+                            maxGrad = gradData[y * wG[0] + x];
+                    }
+                }
+
+                gradTH = (0.5 * maxGrad) > 5 ? 0.5 * maxGrad : 5;
+
+                // keep the topK best candidates sorted by descending score, no per-cell allocation
+                int *cand = &cellCand[cell * topK];
+                float *score = &cellScore[cell * topK];
+                int num = 0;
+                float maxScore = 0;
+
+                for (int x = 0; x < gridsize; x++) {
+                    for (int y = 0; y < gridsize; y++) {
+                        if (gradData[y * wG[0] + x] > gradTH) {
+                            // this is an candidate
+                            int realX = gx * gridsize + x, realY = gy * gridsize + y;
+                            float s = ShiTomasiScore(*frame, realX, realY);
+                            if (s > maxScore)
+                                maxScore = s;
+                            if (num == topK && !(s > score[num - 1]))
+                                continue;
+
+                            int k = num < topK ? num++ : num - 1;
+                            for (; k > 0 && s > score[k - 1]; k--) {
+                                cand[k] = cand[k - 1];
+                                score[k] = score[k - 1];
+                            }
+                            cand[k] = y * gridsize + x;
+                            score[k] = s;
+                        }
+                    }
+                }
+
+                cellNum[cell] = num;
+                cellMaxScore[cell] = maxScore;
+            }
+        }
+    }
+
+    int FeatureDetector::ComputeDescriptor(shared_ptr<Frame> &frame, shared_ptr<Feature> feat, unsigned char *desc) {
 
         const float factorPI = (float) (CV_PI / 180.f);
 
-        float angle = feat->angle * factorPI;
+        float angle = feat->angle() * factorPI;
         float a = (float) cosf(angle), b = (float) sinf(angle);
-        Vec3f *img = frame->frameHessian->dIp[feat->level];
+        Vec3f *img = frame->frameHessian->dIp[feat->level()];
 
         int level = 0;
-        float ul = feat->uv[0];
-        float vl = feat->uv[1];
+        float ul = feat->uv()[0];
+        float vl = feat->uv()[1];
 
-        while (level < feat->level) {
+        while (level < feat->level()) {
             ul *= 0.5;
             vl *= 0.5;
             level++;
         }
 
-        const Vec3f *center = img + (int(vl) * wG[feat->level] + (int) ul);
+        const Vec3f *center = img + (int(vl) * wG[feat->level()] + (int) ul);
 
-        const int step = wG[feat->level];
+        const int step = wG[feat->level()];
 
         int *pattern = bit_pattern_31_;
 #define GET_VALUE(idx) \
@@ -182,7 +249,7 @@ namespace ldso {
             t1 = GET_VALUE(30);
             val |= (t0 < t1) << 7;
 
-            feat->descriptor[i] = (uchar) val;
+            desc[i] = (uchar) val;
         }
 #undef GET_VALUE
         return 0;
@@ -198,10 +265,10 @@ namespace ldso {
         }
 
         for (auto &feat: frame->features) {
-            if (feat->isCorner) {
-                cv::circle(img, cv::Point2f(feat->uv[0], feat->uv[1]), 1, cv::Scalar(0, 250, 0), 1);
+            if (feat->isCorner()) {
+                cv::circle(img, cv::Point2f(feat->uv()[0], feat->uv()[1]), 1, cv::Scalar(0, 250, 0), 1);
             } else {
-                cv::circle(img, cv::Point2f(feat->uv[0], feat->uv[1]), 1, cv::Scalar(0, 0, 250), 1);
+                cv::circle(img, cv::Point2f(feat->uv()[0], feat->uv()[1]), 1, cv::Scalar(0, 0, 250), 1);
             }
         }
 
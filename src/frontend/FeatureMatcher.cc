@@ -37,21 +37,27 @@ namespace ldso {
 
         matches.reserve(frame1->features.size());
 
+        // corners of frame2, each corner of frame1 is compared with all of them in one batch
+        vector<int> corners2;
+        corners2.reserve(frame2->features.size());
+        for (size_t j = 0; j < frame2->features.size(); j++) {
+            if (frame2->featureTable.isCorner[j])
+                corners2.push_back(j);
+        }
+        vector<int> dists(corners2.size());
+
         for (size_t i = 0; i < frame1->features.size(); i++) {
-            shared_ptr<Feature> f1 = frame1->features[i];
-            if (f1->isCorner == false)
+            if (frame1->featureTable.isCorner[i] == false)
                 continue;
             int min_dist = 9999;
             int min_dist_index = -1;
 
-            for (size_t j = 0; j < frame2->features.size(); j++) {
-                shared_ptr<Feature> f2 = frame2->features[j];
-                if (f2->isCorner == false)
-                    continue;
-                int dist = DescriptorDistance(f1->descriptor, f2->descriptor);
-                if (dist < min_dist) {
-                    min_dist = dist;
-                    min_dist_index = j;
+            DescriptorDistances(frame1->Descriptor(i), frame2->featureTable.descriptors.data(), corners2.data(),
+                                corners2.size(), dists.data());
+            for (size_t k = 0; k < corners2.size(); k++) {
+                if (dists[k] < min_dist) {
+                    min_dist = dists[k];
+                    min_dist_index = corners2[k];
                 }
             }
 
@@ -73,27 +79,37 @@ namespace ldso {
         DBoW3::FeatureVector::const_iterator f1end = frame1->featVec.end();
         DBoW3::FeatureVector::const_iterator f2end = frame2->featVec.end();
 
+        // feature indices of the current word and their distance matrix, reused across words
+        vector<int> idx1, idx2, dists;
+
         while (f1it != f1end && f2it != f2end) {
             if (f1it->first == f2it->first) {
                 // from the same word
-                const vector<unsigned int> vIdx1 = f1it->second;
-                const vector<unsigned int> vIdx2 = f2it->second;
-
-                for (auto &idx1: vIdx1) {
-                    auto &feat1 = frame1->features[frame1->bowIdx[idx1]];
+                idx1.clear();
+                idx2.clear();
+                for (auto &i: f1it->second)
+                    idx1.push_back(frame1->bowIdx[i]);
+                for (auto &i: f2it->second)
+                    idx2.push_back(frame2->bowIdx[i]);
+
+                const int n2 = idx2.size();
+                dists.resize(idx1.size() * n2);
+                DescriptorDistances(frame1->featureTable.descriptors.data(), idx1.data(), idx1.size(),
+                                    frame2->featureTable.descriptors.data(), idx2.data(), n2, dists.data());
+
+                for (size_t k1 = 0; k1 < idx1.size(); k1++) {
+                    const int *dist = &dists[k1 * n2];
                     int bestDist1 = 256;    // 最近的
                     int bestIdx2 = -1;
                     int bestDist2 = 256;    // 第二近的
 
-                    for (auto &idx2:vIdx2) {
-                        auto &feat2 = frame2->features[frame2->bowIdx[idx2]];
-                        int dist = DescriptorDistance(feat1->descriptor, feat2->descriptor);
-                        if (dist < bestDist1) {
+                    for (int k2 = 0; k2 < n2; k2++) {
+                        if (dist[k2] < bestDist1) {
                             bestDist2 = bestDist1;
-                            bestDist1 = dist;
-                            bestIdx2 = frame2->bowIdx[idx2];
-                        } else if (dist < bestDist2) {
-                            bestDist2 = dist;
+                            bestDist1 = dist[k2];
+                            bestIdx2 = idx2[k2];
+                        } else if (dist[k2] < bestDist2) {
+                            bestDist2 = dist[k2];
                         }
                     }
 
@@ -101,7 +117,7 @@ namespace ldso {
                         if (static_cast<float>(bestDist1) < nnRatio * static_cast<float>(bestDist2)) {
                             // NN ratio
                             Match m;
-                            m.index1 = frame1->bowIdx[idx1];
+                            m.index1 = idx1[k1];
                             m.index2 = bestIdx2;
                             m.dist = bestDist1;
                             matches.push_back(m);
@@ -130,25 +146,25 @@ namespace ldso {
         f2->imgDisplay.copyTo(img(cv::Rect(wG[0], 0, wG[0], hG[0])));
 
         for (auto &m:matches) {
-            cv::circle(img, cv::Point2f(f1->features[m.index1]->uv[0], f1->features[m.index1]->uv[1]), 1,
+            cv::circle(img, cv::Point2f(f1->features[m.index1]->uv()[0], f1->features[m.index1]->uv()[1]), 1,
                        cv::Scalar(0, 250, 0), 2);
 
-            cv::circle(img, cv::Point2f(f2->features[m.index2]->uv[0] + wG[0], f2->features[m.index2]->uv[1]), 1,
+            cv::circle(img, cv::Point2f(f2->features[m.index2]->uv()[0] + wG[0], f2->features[m.index2]->uv()[1]), 1,
                        cv::Scalar(0, 250, 0), 2);
 
-            cv::line(img, cv::Point2f(f1->features[m.index1]->uv[0], f1->features[m.index1]->uv[1]),
-                     cv::Point2f(f2->features[m.index2]->uv[0] + wG[0], f2->features[m.index2]->uv[1]),
+            cv::line(img, cv::Point2f(f1->features[m.index1]->uv()[0], f1->features[m.index1]->uv()[1]),
+                     cv::Point2f(f2->features[m.index2]->uv()[0] + wG[0], f2->features[m.index2]->uv()[1]),
                      cv::Scalar(0, 250, 0),
                      1);
         }
 
         for (auto &feat: f1->features) {
-            if (feat->isCorner)
-                cv::circle(img, cv::Point2f(feat->uv[0], feat->uv[1]), 1, cv::Scalar(0, 0, 250), 2);
+            if (feat->isCorner())
+                cv::circle(img, cv::Point2f(feat->uv()[0], feat->uv()[1]), 1, cv::Scalar(0, 0, 250), 2);
         }
         for (auto &feat: f2->features) {
-            if (feat->isCorner)
-                cv::circle(img, cv::Point2f(feat->uv[0] + wG[0], feat->uv[1]), 1, cv::Scalar(0, 0, 250), 2);
+            if (feat->isCorner())
+                cv::circle(img, cv::Point2f(feat->uv()[0] + wG[0], feat->uv()[1]), 1, cv::Scalar(0, 0, 250), 2);
         }
 
         cv::imshow("Matches", img);
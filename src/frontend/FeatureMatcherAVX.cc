@@ -0,0 +1,145 @@
+#include "frontend/FeatureMatcher.h"
+
+#include <cstdint>
+#include <cstring>
+
+/**
+ * Batched hamming distance kernels of FeatureMatcher::DescriptorDistances
+ *
+ * AVX2 counts bits with a vpshufb nibble lookup and sums the bytes with vpsadbw, AVX-512 uses VPOPCNTQ on two
+ * descriptors per register. Both are compiled with per-function target attributes and picked once at runtime, other
+ * cpus and platforms use the scalar popcount.
+ */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LDSO_WIDE_KERNELS
+#include <immintrin.h>
+#define LDSO_TARGET_AVX2 __attribute__((target("avx2")))
+#define LDSO_TARGET_AVX512 __attribute__((target("avx512f,avx512vpopcntdq,avx2")))
+#endif
+
+namespace ldso {
+
+    typedef void (*HammingKernel)(const unsigned char *desc, const unsigned char *descs, const int *index, int n,
+                                  int *dist);
+
+    // the i-th descriptor to compare with
+    static inline const unsigned char *descriptorRow(const unsigned char *descs, const int *index, int i) {
+        return descs + 32 * (index ? index[i] : i);
+    }
+
+    static void distancesScalar(const unsigned char *desc, const unsigned char *descs, const int *index, int n,
+                                int *dist) {
+        uint64_t a[4];
+        memcpy(a, desc, 32);
+        for (int i = 0; i < n; i++) {
+            uint64_t b[4];
+            memcpy(b, descriptorRow(descs, index, i), 32);
+            dist[i] = __builtin_popcountll(a[0] ^ b[0]) + __builtin_popcountll(a[1] ^ b[1]) +
+                      __builtin_popcountll(a[2] ^ b[2]) + __builtin_popcountll(a[3] ^ b[3]);
+        }
+    }
+
+#ifdef LDSO_WIDE_KERNELS
+
+    // per 64 bit lane bit counts of a ^ b
+    LDSO_TARGET_AVX2 static inline __m256i popcountLanesAVX2(__m256i a, const unsigned char *b) {
+        const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                                0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+        const __m256i low4 = _mm256_set1_epi8(0x0f);
+        __m256i v = _mm256_xor_si256(a, _mm256_loadu_si256((const __m256i *) b));
+        __m256i cnt = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, _mm256_and_si256(v, low4)),
+                                      _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(v, 4), low4)));
+        return _mm256_sad_epu8(cnt, _mm256_setzero_si256());
+    }
+
+    LDSO_TARGET_AVX2 static void distancesAVX2(const unsigned char *desc, const unsigned char *descs,
+                                               const int *index, int n, int *dist) {
+        const __m256i a = _mm256_loadu_si256((const __m256i *) desc);
+        int i = 0;
+        for (; i + 4 <= n; i += 4) {
+            __m256i s0 = popcountLanesAVX2(a, descriptorRow(descs, index, i));
+            __m256i s1 = popcountLanesAVX2(a, descriptorRow(descs, index, i + 1));
+            __m256i s2 = popcountLanesAVX2(a, descriptorRow(descs, index, i + 2));
+            __m256i s3 = popcountLanesAVX2(a, descriptorRow(descs, index, i + 3));
+
+            // lane counts are <= 64, so two descriptors fit into one 64 bit lane
+            __m256i t01 = _mm256_or_si256(s0, _mm256_slli_epi64(s1, 32));
+            __m256i t23 = _mm256_or_si256(s2, _mm256_slli_epi64(s3, 32));
+            __m256i u = _mm256_add_epi32(_mm256_unpacklo_epi64(t01, t23), _mm256_unpackhi_epi64(t01, t23));
+            __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(u), _mm256_extracti128_si256(u, 1));
+            _mm_storeu_si128((__m128i *) (dist + i), sum);
+        }
+        if (i < n)
+            distancesScalar(desc, index ? descs : descs + 32 * i, index ? index + i : nullptr, n - i, dist + i);
+    }
+
+    // per 64 bit lane bit counts of two descriptors
+    LDSO_TARGET_AVX512 static inline __m512i popcountLanesAVX512(__m512i a, const unsigned char *b0,
+                                                                 const unsigned char *b1) {
+        __m512i b = _mm512_inserti64x4(_mm512_castsi256_si512(_mm256_loadu_si256((const __m256i *) b0)),
+                                       _mm256_loadu_si256((const __m256i *) b1), 1);
+        return _mm512_popcnt_epi64(_mm512_xor_si512(a, b));
+    }
+
+    LDSO_TARGET_AVX512 static void distancesAVX512(const unsigned char *desc, const unsigned char *descs,
+                                                   const int *index, int n, int *dist) {
+        const __m512i a = _mm512_broadcast_i64x4(_mm256_loadu_si256((const __m256i *) desc));
+        int i = 0;
+        for (; i + 8 <= n; i += 8) {
+            // p0 holds descriptors i, i+1, p1 holds i+2, i+3 ...
+            __m512i p0 = popcountLanesAVX512(a, descriptorRow(descs, index, i),
+                                             descriptorRow(descs, index, i + 1));
+            __m512i p1 = popcountLanesAVX512(a, descriptorRow(descs, index, i + 2),
+                                             descriptorRow(descs, index, i + 3));
+            __m512i p2 = popcountLanesAVX512(a, descriptorRow(descs, index, i + 4),
+                                             descriptorRow(descs, index, i + 5));
+            __m512i p3 = popcountLanesAVX512(a, descriptorRow(descs, index, i + 6),
+                                             descriptorRow(descs, index, i + 7));
+
+            __m512i t01 = _mm512_or_si512(p0, _mm512_slli_epi64(p1, 32));
+            __m512i t23 = _mm512_or_si512(p2, _mm512_slli_epi64(p3, 32));
+            __m512i u = _mm512_add_epi32(_mm512_unpacklo_epi64(t01, t23), _mm512_unpackhi_epi64(t01, t23));
+
+            // 128 bit lanes 0,1 belong to the even descriptors and 2,3 to the odd ones
+            __m128i even = _mm_add_epi32(_mm512_extracti32x4_epi32(u, 0), _mm512_extracti32x4_epi32(u, 1));
+            __m128i odd = _mm_add_epi32(_mm512_extracti32x4_epi32(u, 2), _mm512_extracti32x4_epi32(u, 3));
+            _mm_storeu_si128((__m128i *) (dist + i), _mm_unpacklo_epi32(even, odd));
+            _mm_storeu_si128((__m128i *) (dist + i + 4), _mm_unpackhi_epi32(even, odd));
+        }
+        if (i < n)
+            distancesAVX2(desc, index ? descs : descs + 32 * i, index ? index + i : nullptr, n - i, dist + i);
+    }
+
+#endif // LDSO_WIDE_KERNELS
+
+    static HammingKernel hammingKernel() {
+#ifdef LDSO_WIDE_KERNELS
+        static const HammingKernel kernel = []() -> HammingKernel {
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vpopcntdq"))
+                return distancesAVX512;
+            if (__builtin_cpu_supports("avx2"))
+                return distancesAVX2;
+            return distancesScalar;
+        }();
+        return kernel;
+#else
+        return distancesScalar;
+#endif
+    }
+
+    void FeatureMatcher::DescriptorDistances(const unsigned char *desc, const unsigned char *descs, const int *index,
+                                             int n, int *dist) {
+        if (n > 0)
+            hammingKernel()(desc, descs, index, n, dist);
+    }
+
+    void FeatureMatcher::DescriptorDistances(const unsigned char *descs1, const int *index1, int m,
+                                             const unsigned char *descs2, const int *index2, int n, int *dist) {
+        if (n <= 0)
+            return;
+        HammingKernel kernel = hammingKernel();
+        for (int i = 0; i < m; i++)
+            kernel(descriptorRow(descs1, index1, i), descs2, index2, n, dist + i * n);
+    }
+}
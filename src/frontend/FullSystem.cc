@@ -1,6 +1,7 @@
 #include "Feature.h"
 #include "Frame.h"
 #include "Point.h"
+#include "MapFile.h"
 
 #include "frontend/FullSystem.h"
 #include "frontend/CoarseInitializer.h"
@@ -14,6 +15,7 @@
 
 #include <opencv2/features2d/features2d.hpp>
 #include <iomanip>
+#include <sstream>
 #include <opencv2/highgui/highgui.hpp>
 
 using namespace ldso;
@@ -21,12 +23,31 @@ using namespace ldso::internal;
 
 namespace ldso {
 
-    FullSystem::FullSystem(shared_ptr<ORBVocabulary> voc) :
+    // the given calibration or else the calling thread's one, bound to the calling thread
+    static shared_ptr<CalibContext> bindSystemCalib(shared_ptr<CalibContext> calib) {
+        if (!calib)
+            calib = CalibContext::Current();
+        CHECK(calib) << "no calibration, call setGlobalCalib or pass a CalibContext";
+        bindCalib(calib);
+        return calib;
+    }
+
+    FullSystem::FullSystem(shared_ptr<ORBVocabulary> voc, shared_ptr<CalibContext> calib,
+                           shared_ptr<ThreadPool> pool) :
+        calib(bindSystemCalib(calib)),
         coarseDistanceMap(new CoarseDistanceMap(wG[0], hG[0])),
         coarseTracker(new CoarseTracker(wG[0], hG[0])),
         coarseTracker_forNewKF(new CoarseTracker(wG[0], hG[0])),
+        coarseTracker_build(new CoarseTracker(wG[0], hG[0])),
         coarseInitializer(new CoarseInitializer(wG[0], hG[0])),
-        ef(new EnergyFunctional()),
+        framePool(setting_framePoolSize > 0 ? new FrameBufferPool(FrameBufferPool::FrameFloats(), setting_framePoolSize,
+                                                                  setting_framePoolHugePages) : nullptr),
+        threadPool(pool ? pool : shared_ptr<ThreadPool>(
+            new ThreadPool(ThreadPool::ResolveNumThreads(setting_numThreads),
+                           setting_threadAffinity >= 0 ? setting_threadAffinity + 3 : -1))),
+        threadReduce(threadPool),
+        trackingReduce(threadPool),
+        ef(new EnergyFunctional(threadReduce.NumSlots())),
         Hcalib(new Camera(fxG[0], fyG[0], cxG[0], cyG[0])),
         globalMap(new Map(this)),
         vocab(voc) {
@@ -42,9 +63,21 @@ namespace ldso {
         ef->red = &this->threadReduce;
         mappingThread = thread(&FullSystem::mappingLoop, this);
 
+        // cores: tracking, mapping, loop closing, then the pool workers
+        // the tracking thread is the one feeding frames, it is pinned on its first addActiveFrame
+        // with a given pool the caller decides about the cores
+        LOG(INFO) << "using " << threadReduce.NumSlots() << " worker threads" << endl;
+        if (setting_threadAffinity >= 0 && !pool) {
+            pinTrackingThread = true;
+            ThreadPool::PinThread(mappingThread, setting_threadAffinity + 1);
+        }
+
         pixelSelector = shared_ptr<PixelSelector>(new PixelSelector(wG[0], hG[0]));
         selectionMap = new float[wG[0] * hG[0]];
 
+        for (int i = 0; i < threadReduce.NumSlots(); i++)
+            coarseTrackerWorkspaces.push_back(shared_ptr<CoarseTracker>(new CoarseTracker(wG[0], hG[0], true)));
+
         if (setting_enableLoopClosing) {
             loopClosing = shared_ptr<LoopClosing>(new LoopClosing(this));
             if (setting_fastLoopClosing)
@@ -57,6 +90,37 @@ namespace ldso {
 
     FullSystem::~FullSystem() {
         blockUntilMappingIsFinished();
+        if (framePool) {
+            FrameBufferPool::Stats s = framePool->GetStats();
+            LOG(INFO) << "frame buffer pool: " << s.hits << " hits, " << s.misses << " misses, peak " << s.peakInUse
+                      << " of " << s.capacity << endl;
+        }
+        MappingStats ms = GetMappingStats();
+        if (ms.keyFrames > 0) {
+            std::ostringstream stages;
+            stages << std::fixed << std::setprecision(1);
+            for (int s = 0; s < MappingStats::NUM_STAGES; s++)
+                stages << " " << MappingStats::StageName(s) << " " << ms.stageTotal[s] / ms.keyFrames << "/"
+                       << ms.stageMax[s];
+            LOG(INFO) << "mapping: " << ms.keyFrames << " keyframes in " << ms.keyFrameTotal / ms.keyFrames
+                      << " ms (max " << ms.keyFrameMax << "), reference published after "
+                      << ms.referenceTotal / ms.keyFrames << " ms (max " << ms.referenceMax << "), "
+                      << ms.nonKeyFrames << " non keyframes, " << ms.skippedFrames << " skipped, queue up to "
+                      << ms.maxQueue << endl;
+            LOG(INFO) << "mapping stages, mean/max ms:" << stages.str() << endl;
+        }
+        if (ms.tracedPoints > 0) {
+            LOG(INFO) << "traced immature points " << ms.tracedPoints << " times: good " << ms.traceOutcomes[0]
+                      << ", bad condition " << ms.traceOutcomes[1] << ", oob " << ms.traceOutcomes[2] << ", outlier "
+                      << ms.traceOutcomes[3] << ", skipped " << ms.traceOutcomes[4] << ", uninitialized "
+                      << ms.traceOutcomes[5] << endl;
+        }
+        KeyFrameArchive::Stats as = globalMap->GetArchiveStats();
+        if (as.frames > 0) {
+            LOG(INFO) << "keyframe archive: " << as.archived << " of " << globalMap->NumFrames() << " keyframes, "
+                      << (as.memoryBytes >> 20) << " MB in memory, " << (as.spillBytes >> 20) << " MB spilled, "
+                      << as.restores << " restores" << endl;
+        }
         // remember to release the inner structure
         this->unmappedTrackedFrames.clear();
         if (setting_enableLoopClosing == false) {
@@ -68,7 +132,12 @@ namespace ldso {
     void FullSystem::addActiveFrame(ImageAndExposure *image, int id) {
         if (isLost)
             return;
+        bindCalib(calib);   // the caller may feed several systems
         unique_lock<mutex> lock(trackMutex);
+        if (pinTrackingThread) {
+            ThreadPool::PinCurrentThread(setting_threadAffinity);
+            pinTrackingThread = false;
+        }
 
         LOG(INFO) << "*** taking frame " << id << " ***" << endl;
 
@@ -76,15 +145,18 @@ namespace ldso {
         // 创建一个Frame
         shared_ptr<Frame> frame(new Frame(image->timestamp));
         // 创建FrameHessian
-        frame->CreateFH(frame);
-        allFrameHistory.push_back(frame);
+        frame->CreateFH(frame, framePool);
+        numFramesReceived++;
+        recentFrames.push_back(frame);
+        if (recentFrames.size() > 3)
+            recentFrames.pop_front();
 
         // ==== make images ==== //
         // 
         shared_ptr<FrameHessian> fh = frame->frameHessian;
         fh->ab_exposure = image->exposure_time;
         // 建立金字塔，同时计算梯度，不过没有用Gaussian模糊啥的
-        fh->makeImages(image->image, Hcalib->mpCH);
+        fh->makeImages(image->image, Hcalib->mpCH, multiThreading ? &trackingReduce : nullptr);
 
         if (!initialized) {
             LOG(INFO) << "Initializing ... " << endl;
@@ -106,12 +178,15 @@ namespace ldso {
         } else {
             // init finished, do tracking
             // =========================== SWAP tracking reference?. =========================
-            if (coarseTracker_forNewKF->refFrameID > coarseTracker->refFrameID) {
+            // the mapping thread only holds the lock to swap in a finished reference
+            {
                 unique_lock<mutex> crlock(coarseTrackerSwapMutex);
-                LOG(INFO) << "swap coarse tracker to " << coarseTracker_forNewKF->refFrameID << endl;
-                auto tmp = coarseTracker;
-                coarseTracker = coarseTracker_forNewKF;
-                coarseTracker_forNewKF = tmp;
+                if (coarseTracker_forNewKF->refFrameID > coarseTracker->refFrameID) {
+                    LOG(INFO) << "swap coarse tracker to " << coarseTracker_forNewKF->refFrameID << endl;
+                    auto tmp = coarseTracker;
+                    coarseTracker = coarseTracker_forNewKF;
+                    coarseTracker_forNewKF = tmp;
+                }
             }
 
             // track the new frame and get the state
@@ -129,7 +204,7 @@ namespace ldso {
             bool needToMakeKF = false;
             if (setting_keyframesPerSecond > 0) {
                 // make key frame by time
-                needToMakeKF = allFrameHistory.size() == 1 ||
+                needToMakeKF = numFramesReceived == 1 ||
                                (frame->timeStamp - frames.back()->timeStamp) >
                                0.95f / setting_keyframesPerSecond;
             } else {
@@ -147,7 +222,7 @@ namespace ldso {
                 bool b1 = b > 1;
                 bool b2 = 2 * coarseTracker->firstCoarseRMSE < tres[0];
 
-                needToMakeKF = allFrameHistory.size() == 1 || b1 || b2;
+                needToMakeKF = numFramesReceived == 1 || b1 || b2;
             }
 
             if (viewer)
@@ -171,8 +246,19 @@ namespace ldso {
         } else {
             unique_lock<mutex> lock(trackMapSyncMutex);
             unmappedTrackedFrames.push_back(fh->frame);
+            // a keyframe is only made if the tracker already used the newest one as reference
+            if (needKF && coarseTracker->lastRef)
+                needNewKFAfter = int(coarseTracker->lastRef->frame->id);
+            {
+                unique_lock<mutex> slck(mappingStatsMutex);
+                mappingStats.maxQueue = max(mappingStats.maxQueue, int(unmappedTrackedFrames.size()));
+            }
             trackedFrameSignal.notify_all();
-            while (coarseTracker_forNewKF->refFrameID == -1 && coarseTracker->refFrameID == -1) {
+            auto haveReference = [this]() {
+                unique_lock<mutex> crlock(coarseTrackerSwapMutex);
+                return coarseTracker_forNewKF->refFrameID != -1 || coarseTracker->refFrameID != -1;
+            };
+            while (!haveReference()) {
                 LOG(INFO) << "wait for mapped frame signal" << endl;
                 mappedFrameSignal.wait(lock);
             }
@@ -182,7 +268,7 @@ namespace ldso {
 
     Vec4 FullSystem::trackNewCoarse(shared_ptr<FrameHessian> fh) {
 
-        assert(allFrameHistory.size() > 0);
+        assert(numFramesReceived > 0);
 
         shared_ptr<FrameHessian> lastF = coarseTracker->lastRef;
         CHECK(coarseTracker->lastRef->frame != nullptr);
@@ -192,15 +278,15 @@ namespace ldso {
         // try a lot of pose values and see which is the best
         std::vector<SE3, Eigen::aligned_allocator<SE3>>
             lastF_2_fh_tries;
-        if (allFrameHistory.size() == 2)
+        if (numFramesReceived == 2)
             for (unsigned int i = 0; i < lastF_2_fh_tries.size(); i++)  // TODO: maybe wrong, size is obviously zero
                 lastF_2_fh_tries.push_back(SE3());  // use identity
         else {
 
             // fill the pose tries ...
             // use the last before last and the last before before last (well my English is really poor...)
-            shared_ptr<Frame> slast = allFrameHistory[allFrameHistory.size() - 2];
-            shared_ptr<Frame> sprelast = allFrameHistory[allFrameHistory.size() - 3];
+            shared_ptr<Frame> slast = recentFrames[recentFrames.size() - 2];
+            shared_ptr<Frame> sprelast = recentFrames[recentFrames.size() - 3];
 
             SE3 slast_2_sprelast;
             SE3 lastF_2_slast;
@@ -325,8 +411,16 @@ namespace ldso {
         Vec5 achievedRes = Vec5::Constant(NAN);
         bool haveOneGood = false;
         int tryIterations = 0;
+        const bool parallelTries = multiThreading && coarseTrackerWorkspaces.size() > 1;
         for (unsigned int i = 0; i < lastF_2_fh_tries.size(); i++) {
 
+            // the first hypothesis is accepted most of the time, only go parallel if it isn't
+            if (i > 0 && parallelTries) {
+                trackHypothesesMT(fh, lastF_2_fh_tries, i, aff_last_2_l, achievedRes, haveOneGood,
+                                  lastF_2_fh, aff_g2l, flowVecs);
+                break;
+            }
+
             AffLight aff_g2l_this = aff_last_2_l;
             SE3 lastF_2_fh_this = lastF_2_fh_tries[i];
 
@@ -375,6 +469,7 @@ namespace ldso {
         SE3 camToWorld = lastF->frame->getPose().inverse() * lastF_2_fh.inverse();
         fh->frame->setPose(camToWorld.inverse());
         fh->frame->aff_g2l = aff_g2l;
+        trajectory.push_back(TrajectoryEntry(fh->frame, lastF->frame, lastF_2_fh));
 
         if (coarseTracker->firstCoarseRMSE < 0)
             coarseTracker->firstCoarseRMSE = achievedRes[0];
@@ -385,7 +480,200 @@ namespace ldso {
         return Vec4(achievedRes[0], flowVecs[0], flowVecs[1], flowVecs[2]);
     }
 
+    /**
+     * shared state of FullSystem::trackHypothesesMT
+     * kept alive by the pool tasks, which may still be queued when trackHypothesesMT returns
+     */
+    struct CoarseTrackingJob {
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+
+        // outcome of one hypothesis, tracked with an abort bound that is never tighter than the serial one
+        struct Result {
+            EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+
+            bool ready = false;
+            bool good = false;          // return value of trackNewestCoarse
+            bool complete = false;      // not aborted by the bound it was tracked with
+            SE3 lastF_2_fh;
+            AffLight aff_g2l;
+            int traceN = 0;
+            int traceLvl[PYR_LEVELS + 1];
+            double traceRes[PYR_LEVELS + 1];
+            Vec3 traceFlow[PYR_LEVELS + 1];
+        };
+
+        CoarseTrackingJob(shared_ptr<FrameHessian> fh, const std::vector<SE3, Eigen::aligned_allocator<SE3>> &tries,
+                          int firstTry, const AffLight &aff_last_2_l, const Vec5 &achievedRes,
+                          const std::vector<shared_ptr<CoarseTracker>> &workspaces) :
+            fh(fh), tries(tries), aff_last_2_l(aff_last_2_l), workspaces(workspaces),
+            minResForAbort(achievedRes), results(tries.size()), nextTry(firstTry) {}
+
+        // track the next hypothesis with tracker, false if none is left
+        bool trackOne(CoarseTracker &tracker) {
+            if (cancelled.load())
+                return false;
+            int i = nextTry.fetch_add(1);
+            if (i >= int(tries.size()))
+                return false;
+
+            Vec5 bound;
+            {
+                unique_lock<mutex> lock(resultMutex);
+                bound = minResForAbort;
+            }
+
+            // only this thread touches results[i] until it is ready
+            Result &r = results[i];
+            r.lastF_2_fh = tries[i];
+            r.aff_g2l = aff_last_2_l;
+            r.good = tracker.trackNewestCoarse(fh, r.lastF_2_fh, r.aff_g2l, pyrLevelsUsed - 1, bound);
+            r.traceN = tracker.lastTraceN;
+            for (int k = 0; k < r.traceN; k++) {
+                r.traceLvl[k] = tracker.lastTraceLvl[k];
+                r.traceRes[k] = tracker.lastTraceRes[k];
+                r.traceFlow[k] = tracker.lastTraceFlow[k];
+            }
+            r.complete = r.traceN > 0 &&
+                         !(r.traceRes[r.traceN - 1] > 1.5 * bound[r.traceLvl[r.traceN - 1]]);
+
+            {
+                unique_lock<mutex> lock(resultMutex);
+                r.ready = true;
+            }
+            resultSignal.notify_all();
+            return true;
+        }
+
+        // pool task, grab a workspace and track until nothing is left
+        void participate() {
+            numRunning.fetch_add(1);
+            if (!cancelled.load()) {
+                int slot = nextSlot.fetch_add(1);
+                if (slot < int(workspaces.size()))
+                    while (trackOne(*workspaces[slot]));
+            }
+            if (numRunning.fetch_sub(1) == 1) {
+                unique_lock<mutex> lock(resultMutex);
+                resultSignal.notify_all();
+            }
+        }
+
+        bool isReady(int i) {
+            unique_lock<mutex> lock(resultMutex);
+            return results[i].ready;
+        }
+
+        void waitReady(int i) {
+            unique_lock<mutex> lock(resultMutex);
+            resultSignal.wait(lock, [this, i] { return results[i].ready; });
+        }
+
+        // hypotheses handed out from now on abort at the given residuals
+        void setMinResForAbort(const Vec5 &achievedRes) {
+            unique_lock<mutex> lock(resultMutex);
+            minResForAbort = achievedRes;
+        }
+
+        // stop handing out hypotheses and wait until no task uses a workspace any more
+        void finish() {
+            cancelled = true;
+            unique_lock<mutex> lock(resultMutex);
+            resultSignal.wait(lock, [this] { return numRunning.load() == 0; });
+        }
+
+        shared_ptr<FrameHessian> fh;
+        const std::vector<SE3, Eigen::aligned_allocator<SE3>> &tries;
+        AffLight aff_last_2_l;
+        std::vector<shared_ptr<CoarseTracker>> workspaces;
+
+        Vec5 minResForAbort;    // protected by resultMutex
+        std::vector<Result, Eigen::aligned_allocator<Result>> results;
+
+        atomic<int> nextTry;
+        atomic<int> nextSlot{1};    // slot 0 is the calling thread's
+        atomic<int> numRunning{0};
+        atomic<bool> cancelled{false};
+
+        mutex resultMutex;
+        condition_variable resultSignal;
+    };
+
+    void FullSystem::trackHypothesesMT(shared_ptr<FrameHessian> fh,
+                                       const std::vector<SE3, Eigen::aligned_allocator<SE3>> &lastF_2_fh_tries,
+                                       int firstTry, const AffLight &aff_last_2_l, Vec5 &achievedRes,
+                                       bool &haveOneGood, SE3 &lastF_2_fh, AffLight &aff_g2l, Vec3 &flowVecs) {
+
+        for (auto &ws: coarseTrackerWorkspaces)
+            ws->shareTrackingRef(*coarseTracker);
+
+        const int numTries = int(lastF_2_fh_tries.size());
+        shared_ptr<CoarseTrackingJob> job(
+            new CoarseTrackingJob(fh, lastF_2_fh_tries, firstTry, aff_last_2_l, achievedRes,
+                                  coarseTrackerWorkspaces));
+
+        int numTickets = std::min(int(coarseTrackerWorkspaces.size()) - 1, numTries - firstTry - 1);
+        for (int i = 0; i < numTickets; i++)
+            threadPool->Submit([job] { job->participate(); });
+
+        CoarseTracker &own = *coarseTrackerWorkspaces[0];
+        for (int i = firstTry; i < numTries; i++) {
+
+            // help tracking until hypothesis i is available
+            while (!job->isReady(i)) {
+                if (!job->trackOne(own))
+                    job->waitReady(i);
+            }
+
+            // replay what trackNewestCoarse would have done with achievedRes as abort bound
+            const CoarseTrackingJob::Result &r = job->results[i];
+            Vec5 lastResiduals = Vec5::Constant(NAN);
+            Vec3 lastFlowIndicators = Vec3::Constant(1000);
+            bool aborted = false;
+            for (int k = 0; k < r.traceN && !aborted; k++) {
+                lastResiduals[r.traceLvl[k]] = r.traceRes[k];
+                lastFlowIndicators = r.traceFlow[k];
+                aborted = r.traceRes[k] > 1.5 * achievedRes[r.traceLvl[k]];
+            }
+
+            SE3 lastF_2_fh_this = r.lastF_2_fh;
+            AffLight aff_g2l_this = r.aff_g2l;
+            bool trackingIsGood = !aborted && r.good;
+            if (!aborted && !r.complete) {
+                // aborted by a bound tighter than achievedRes, should not happen as achievedRes only decreases
+                lastF_2_fh_this = lastF_2_fh_tries[i];
+                aff_g2l_this = aff_last_2_l;
+                trackingIsGood = own.trackNewestCoarse(fh, lastF_2_fh_this, aff_g2l_this, pyrLevelsUsed - 1,
+                                                       achievedRes);
+                lastResiduals = own.lastResiduals;
+                lastFlowIndicators = own.lastFlowIndicators;
+            }
+
+            // same as the serial loop in trackNewCoarse
+            if (trackingIsGood && std::isfinite((float) lastResiduals[0]) &&
+                !(lastResiduals[0] >= achievedRes[0])) {
+                flowVecs = lastFlowIndicators;
+                aff_g2l = aff_g2l_this;
+                lastF_2_fh = lastF_2_fh_this;
+                haveOneGood = true;
+            }
+
+            if (haveOneGood) {
+                for (int l = 0; l < 5; l++) {
+                    if (!std::isfinite((float) achievedRes[l]) || achievedRes[l] > lastResiduals[l])
+                        achievedRes[l] = lastResiduals[l];
+                }
+                job->setMinResForAbort(achievedRes);
+            }
+
+            if (haveOneGood && achievedRes[0] < lastCoarseRMSE[0] * setting_reTrackThreshold)
+                break;
+        }
+
+        job->finish();
+    }
+
     void FullSystem::blockUntilMappingIsFinished() {
+        bindCalib(calib);
         {
             unique_lock<mutex> lock(trackMapSyncMutex);
             if (!runMapping) {
@@ -413,6 +701,7 @@ namespace ldso {
 
     void FullSystem::makeKeyFrame(shared_ptr<FrameHessian> fh) {
 
+        Clock::time_point start = Clock::now(), stage = start;
         shared_ptr<Frame> frame = fh->frame;
         auto refFrame = frames.back();
 
@@ -427,6 +716,7 @@ namespace ldso {
 
         // trace new keyframe
         traceNewCoarse(fh);
+        recordMappingStage(MappingStats::TRACE, stage);
 
         unique_lock<mutex> lock(mapMutex);
 
@@ -451,9 +741,11 @@ namespace ldso {
             shared_ptr<FrameHessian> &fh1 = fht->frameHessian;
             if (fh1 == fh)
                 continue;
-            for (auto feat: fht->features) {
-                if (feat->status == Feature::FeatureStatus::VALID
-                    && feat->point->status == Point::PointStatus::ACTIVE) {
+            for (size_t k = 0; k < fht->features.size(); k++) {
+                if (fht->featureTable.status[k] != Feature::FeatureStatus::VALID)
+                    continue;
+                auto &feat = fht->features[k];
+                if (feat->point->status == Point::PointStatus::ACTIVE) {
 
                     shared_ptr<PointHessian> ph = feat->point->mpPH;
 
@@ -472,15 +764,19 @@ namespace ldso {
             }
         }
 
+        recordMappingStage(MappingStats::RESIDUALS, stage);
+
         // =========================== Activate Points (& flag for marginalization). =========================
         activatePointsMT();
         ef->makeIDX();
+        recordMappingStage(MappingStats::ACTIVATE, stage);
 
         // =========================== OPTIMIZE ALL =========================
         fh->frameEnergyTH = frames.back()->frameHessian->frameEnergyTH;
         LOG(INFO) << "call optimize on kf " << frame->kfId << endl;
         float rmse = optimize(setting_maxOptIterations);
         LOG(INFO) << "optimize is done!" << endl;
+        recordMappingStage(MappingStats::OPTIMIZE, stage);
 
         // =========================== Figure Out if INITIALIZATION FAILED =========================
         int numKFs = globalMap->NumFrames();
@@ -507,14 +803,26 @@ namespace ldso {
 
         // =========================== REMOVE OUTLIER =========================
         removeOutliers();
+        recordMappingStage(MappingStats::OUTLIERS, stage);
 
         // swap the coarse Tracker for new kf
+        // the reference is a copy of the window depth, so it is built outside the lock and the tracker keeps
+        // tracking against the previous one meanwhile. It is published before the marginalization.
         {
-            unique_lock<mutex> crlock(coarseTrackerSwapMutex);
-            coarseTracker_forNewKF->makeK(Hcalib->mpCH);
+            coarseTracker_build->makeK(Hcalib->mpCH);
             vector<shared_ptr<FrameHessian >> fhs;
             for (auto &f: frames) fhs.push_back(f->frameHessian);
-            coarseTracker_forNewKF->setCoarseTrackingRef(fhs);
+            coarseTracker_build->setCoarseTrackingRef(fhs);
+
+            unique_lock<mutex> crlock(coarseTrackerSwapMutex);
+            std::swap(coarseTracker_build, coarseTracker_forNewKF);
+        }
+        recordMappingStage(MappingStats::PUBLISH, stage);
+        {
+            double ms = chrono::duration<double, milli>(stage - start).count();
+            unique_lock<mutex> slck(mappingStatsMutex);
+            mappingStats.referenceTotal += ms;
+            mappingStats.referenceMax = max(mappingStats.referenceMax, ms);
         }
 
         // =========================== (Activate-)Marginalize Points =========================
@@ -527,11 +835,14 @@ namespace ldso {
             ef->lastNullspaces_scale,
             ef->lastNullspaces_affA,
             ef->lastNullspaces_affB);
+        ef->makeNullspaceProjector();
 
         ef->marginalizePointsF();
+        recordMappingStage(MappingStats::MARG_POINTS, stage);
 
         // =========================== add new Immature points & new residuals =========================
         makeNewTraces(fh, 0);
+        recordMappingStage(MappingStats::NEW_TRACES, stage);
 
         // record the relative poses, note we are building a covisibility graph in fact
         auto minandmax = std::minmax_element(frames.begin(), frames.end(), CmpFrameKFID());
@@ -573,6 +884,7 @@ namespace ldso {
         // visualization
         if (viewer)
             viewer->publishKeyframes(frames, false, Hcalib->mpCH);
+        recordMappingStage(MappingStats::RELATIONS, stage);
 
         // =========================== Marginalize Frames =========================
         {
@@ -585,22 +897,63 @@ namespace ldso {
                     i = 0;
                 }
         }
+        recordMappingStage(MappingStats::MARG_FRAMES, stage);
 
         // add current kf into map and detect loops
         globalMap->AddKeyFrame(fh->frame);
         if (setting_enableLoopClosing) {
             loopClosing->InsertKeyFrame(frame);
         }
+
+        // archive the features of old keyframes, never the ones still in the window
+        if (setting_hotKeyFrames > 0 && frame->kfId > (unsigned long) setting_hotKeyFrames) {
+            unique_lock<mutex> lck(framesMutex);
+            unsigned long keepFrom = frame->kfId - setting_hotKeyFrames;
+            for (auto &fr: frames)
+                keepFrom = min(keepFrom, fr->kfId);
+            globalMap->ArchiveKeyFrames(keepFrom);
+        }
+        recordMappingStage(MappingStats::MAP, stage);
+        {
+            double ms = chrono::duration<double, milli>(stage - start).count();
+            unique_lock<mutex> slck(mappingStatsMutex);
+            mappingStats.keyFrames++;
+            mappingStats.keyFrameTotal += ms;
+            mappingStats.keyFrameMax = max(mappingStats.keyFrameMax, ms);
+        }
         LOG(INFO) << "make keyframe done" << endl;
     }
 
     void FullSystem::makeNonKeyFrame(shared_ptr<FrameHessian> &fh) {
+        Clock::time_point start = Clock::now();
         {
             unique_lock<mutex> crlock(shellPoseMutex);
             fh->setEvalPT_scaled(fh->frame->getPose(), fh->frame->aff_g2l);
         }
         traceNewCoarse(fh);
         fh->frame->ReleaseAll();  // no longer needs it
+
+        double ms = chrono::duration<double, milli>(Clock::now() - start).count();
+        unique_lock<mutex> slck(mappingStatsMutex);
+        mappingStats.nonKeyFrames++;
+        mappingStats.nonKeyFrameTotal += ms;
+    }
+
+    void FullSystem::recordMappingStage(int stage, Clock::time_point &since) {
+        Clock::time_point now = Clock::now();
+        double ms = chrono::duration<double, milli>(now - since).count();
+        since = now;
+        unique_lock<mutex> lck(mappingStatsMutex);
+        mappingStats.stageTotal[stage] += ms;
+        mappingStats.stageMax[stage] = max(mappingStats.stageMax[stage], ms);
+    }
+
+    const char *FullSystem::MappingStats::StageName(int stage) {
+        static const char *names[NUM_STAGES] = {
+            "trace", "residuals", "activate", "optimize", "outliers", "publish", "margPoints", "newTraces",
+            "relations", "margFrames", "map"
+        };
+        return stage >= 0 && stage < NUM_STAGES ? names[stage] : "";
     }
 
     void FullSystem::marginalizeFrame(shared_ptr<Frame> &frame) {
@@ -612,9 +965,11 @@ namespace ldso {
         for (shared_ptr<Frame> &fr: frames) {
             if (fr == frame)
                 continue;
-            for (auto feat: fr->features) {
-                if (feat->status == Feature::FeatureStatus::VALID &&
-                    feat->point->status == Point::PointStatus::ACTIVE) {
+            for (size_t k = 0; k < fr->features.size(); k++) {
+                if (fr->featureTable.status[k] != Feature::FeatureStatus::VALID)
+                    continue;
+                auto &feat = fr->features[k];
+                if (feat->point->status == Point::PointStatus::ACTIVE) {
 
                     shared_ptr<PointHessian> ph = feat->point->mpPH;
                     // remove the residuals projected into this frame
@@ -666,13 +1021,14 @@ namespace ldso {
 
             shared_ptr<FrameHessian> &fh = frames[i]->frameHessian;
             int in = 0, out = 0;
-            for (auto &feat: frames[i]->features) {
-                if (feat->status == Feature::FeatureStatus::IMMATURE) {
+            const FeatureTable &table = frames[i]->featureTable;
+            for (size_t k = 0; k < table.size(); k++) {
+                if (table.status[k] == Feature::FeatureStatus::IMMATURE) {
                     in++;
                     continue;
                 }
 
-                shared_ptr<Point> p = feat->point;
+                shared_ptr<Point> &p = frames[i]->features[k]->point;
                 if (p && p->status == Point::PointStatus::ACTIVE)
                     in++;
                 else
@@ -740,10 +1096,11 @@ namespace ldso {
         int numPoints = 0;
         int numLRes = 0;
         for (shared_ptr<Frame> &fr : frames) {
-            for (auto &feat: fr->features) {
-                shared_ptr<Point> p = feat->point;
-                if (feat->status == Feature::FeatureStatus::VALID && p
-                    && p->status == Point::PointStatus::ACTIVE) {
+            for (size_t k = 0; k < fr->features.size(); k++, numPoints++) {
+                if (fr->featureTable.status[k] != Feature::FeatureStatus::VALID)
+                    continue;
+                shared_ptr<Point> &p = fr->features[k]->point;
+                if (p && p->status == Point::PointStatus::ACTIVE) {
                     auto ph = p->mpPH;
                     for (auto &r : ph->residuals) {
                         if (!r->isLinearized) {
@@ -754,7 +1111,6 @@ namespace ldso {
                         }
                     }
                 }
-                numPoints++;
             }
         }
 
@@ -1015,41 +1371,74 @@ namespace ldso {
 
     void FullSystem::traceNewCoarse(shared_ptr<FrameHessian> fh) {
 
-        unique_lock<mutex> lock(mapMutex);
-
-        int trace_total = 0, trace_good = 0, trace_oob = 0, trace_out = 0, trace_skip = 0, trace_badcondition = 0, trace_uninitialized = 0;
-
         Mat33f K = Mat33f::Identity();
         K(0, 0) = Hcalib->mpCH->fxl();
         K(1, 1) = Hcalib->mpCH->fyl();
         K(0, 2) = Hcalib->mpCH->cxl();
         K(1, 2) = Hcalib->mpCH->cyl();
 
-        for (shared_ptr<Frame> fr: frames) {
-            shared_ptr<FrameHessian> host = fr->frameHessian;
+        // collect the points under the lock, trace without it
+        std::vector<TraceHost> hosts;
+        std::vector<TracePoint> points;
+        {
+            unique_lock<mutex> lock(mapMutex);
+            hosts.reserve(frames.size());   // points keep pointers into hosts
+
+            for (shared_ptr<Frame> fr: frames) {
+                shared_ptr<FrameHessian> host = fr->frameHessian;
+
+                SE3 hostToNew = fh->PRE_worldToCam * host->PRE_camToWorld;
+                TraceHost th;
+                th.KRKi = K * hostToNew.rotationMatrix().cast<float>() * K.inverse();
+                th.Kt = K * hostToNew.translation().cast<float>();
+                th.aff = AffLight::fromToVecExposure(host->ab_exposure, fh->ab_exposure, host->aff_g2l(),
+                                                     fh->aff_g2l()).cast<float>();
+                hosts.push_back(th);
+
+                for (size_t k = 0; k < fr->features.size(); k++) {
+                    if (fr->featureTable.status[k] != Feature::FeatureStatus::IMMATURE)
+                        continue;
+                    auto &feat = fr->features[k];
+                    if (feat->ip) {
+                        TracePoint tp;
+                        tp.ip = feat->ip;
+                        tp.host = &hosts.back();
+                        points.push_back(tp);
+                    }
+                }
+            }
+        }
 
-            SE3 hostToNew = fh->PRE_worldToCam * host->PRE_camToWorld;
-            Mat33f KRKi = K * hostToNew.rotationMatrix().cast<float>() * K.inverse();
-            Vec3f Kt = K * hostToNew.translation().cast<float>();
+        Vec10 stats;
+        if (multiThreading) {
+            threadReduce.reduce(bind(&FullSystem::traceNewCoarse_Reductor, this, fh, &points, _1, _2, _3, _4),
+                                0, points.size(), 50);
+            stats = threadReduce.stats;
+        } else {
+            stats.setZero();
+            traceNewCoarse_Reductor(fh, &points, 0, points.size(), &stats, 0);
+        }
 
-            Vec2f aff = AffLight::fromToVecExposure(host->ab_exposure, fh->ab_exposure, host->aff_g2l(),
-                                                    fh->aff_g2l()).cast<float>();
+        unique_lock<mutex> slck(mappingStatsMutex);
+        mappingStats.tracedPoints += points.size();
+        for (int i = 0; i < 6; i++)
+            mappingStats.traceOutcomes[i] += stats[i];
+    }
 
-            for (auto feat: fr->features) {
-                if (feat->status == Feature::FeatureStatus::IMMATURE && feat->ip) {
-                    // update the immature points
-                    shared_ptr<ImmaturePoint> ph = feat->ip;
-                    ph->traceOn(fh, KRKi, Kt, aff, Hcalib->mpCH);
-
-                    if (ph->lastTraceStatus == ImmaturePointStatus::IPS_GOOD) trace_good++;
-                    if (ph->lastTraceStatus == ImmaturePointStatus::IPS_BADCONDITION) trace_badcondition++;
-                    if (ph->lastTraceStatus == ImmaturePointStatus::IPS_OOB) trace_oob++;
-                    if (ph->lastTraceStatus == ImmaturePointStatus::IPS_OUTLIER) trace_out++;
-                    if (ph->lastTraceStatus == ImmaturePointStatus::IPS_SKIPPED) trace_skip++;
-                    if (ph->lastTraceStatus == ImmaturePointStatus::IPS_UNINITIALIZED) trace_uninitialized++;
-                    trace_total++;
-                }
-            }
+    void FullSystem::traceNewCoarse_Reductor(shared_ptr<FrameHessian> fh, const std::vector<TracePoint> *points,
+                                             int min, int max, Vec10 *stats, int tid) {
+
+        shared_ptr<CalibHessian> HCalib = Hcalib->mpCH;
+        for (int k = min; k < max; k++) {
+            const TracePoint &tp = (*points)[k];
+            ImmaturePointStatus status = tp.ip->traceOn(fh, tp.host->KRKi, tp.host->Kt, tp.host->aff, HCalib);
+
+            if (status == ImmaturePointStatus::IPS_GOOD) (*stats)[0]++;
+            if (status == ImmaturePointStatus::IPS_BADCONDITION) (*stats)[1]++;
+            if (status == ImmaturePointStatus::IPS_OOB) (*stats)[2]++;
+            if (status == ImmaturePointStatus::IPS_OUTLIER) (*stats)[3]++;
+            if (status == ImmaturePointStatus::IPS_SKIPPED) (*stats)[4]++;
+            if (status == ImmaturePointStatus::IPS_UNINITIALIZED) (*stats)[5]++;
         }
     }
 
@@ -1098,8 +1487,10 @@ namespace ldso {
             Vec3f Kt = (coarseDistanceMap->K[1] * fhToNew.translation().cast<float>());
 
             for (size_t i = 0; i < host->frame->features.size(); i++) {
+                if (host->frame->featureTable.status[i] != Feature::FeatureStatus::IMMATURE)
+                    continue;
                 shared_ptr<Feature> &feat = host->frame->features[i];
-                if (feat->status == Feature::FeatureStatus::IMMATURE && feat->ip) {
+                if (feat->ip) {
 
                     shared_ptr<Feature> &feat = host->frame->features[i];
                     shared_ptr<ImmaturePoint> &ph = host->frame->features[i]->ip;
@@ -1107,7 +1498,7 @@ namespace ldso {
 
                     // delete points that have never been traced successfully, or that are outlier on the last trace.
                     if (!std::isfinite(ph->idepth_max) || ph->lastTraceStatus == IPS_OUTLIER) {
-                        feat->status = Feature::FeatureStatus::OUTLIER;
+                        feat->status() = Feature::FeatureStatus::OUTLIER;
                         feat->ReleaseImmature();
                         continue;
                     }
@@ -1124,14 +1515,14 @@ namespace ldso {
                         // if point will be out afterwards, delete it instead.
                         if (ph->feature->host.lock()->frameHessian->flaggedForMarginalization ||
                             ph->lastTraceStatus == IPS_OOB) {
-                            feat->status = Feature::FeatureStatus::OUTLIER;
+                            feat->status() = Feature::FeatureStatus::OUTLIER;
                             feat->ReleaseImmature();
                         }
                         continue;
                     }
 
                     // see if we need to activate point due to distance map.
-                    Vec3f ptp = KRKi * Vec3f(feat->uv[0], feat->uv[1], 1) +
+                    Vec3f ptp = KRKi * Vec3f(feat->uv()[0], feat->uv()[1], 1) +
                                 Kt * (0.5f * (ph->idepth_max + ph->idepth_min));
                     int u = ptp[0] / ptp[2] + 0.5f;
                     int v = ptp[1] / ptp[2] + 0.5f;
@@ -1148,7 +1539,7 @@ namespace ldso {
                         }
                     } else {
                         // drop it
-                        feat->status = Feature::FeatureStatus::OUTLIER;
+                        feat->status() = Feature::FeatureStatus::OUTLIER;
                         feat->ReleaseImmature();
                     }
                 }
@@ -1174,7 +1565,7 @@ namespace ldso {
             if (newpoint != nullptr) {
 
                 // remove the immature point
-                ph->feature->status = Feature::FeatureStatus::VALID;
+                ph->feature->status() = Feature::FeatureStatus::VALID;
 
                 ph->feature->point->mpPH = newpoint;
                 ph->feature->ReleaseImmature();
@@ -1185,7 +1576,7 @@ namespace ldso {
 
             } else if (newpoint == nullptr || ph->lastTraceStatus == IPS_OOB) {
 
-                ph->feature->status = Feature::FeatureStatus::OUTLIER;
+                ph->feature->status() = Feature::FeatureStatus::OUTLIER;
                 ph->feature->ReleaseImmature();
 
             }
@@ -1224,16 +1615,18 @@ namespace ldso {
         // go through all active frames
         for (auto &fr : frames) {
             shared_ptr<FrameHessian> host = fr->frameHessian;
-            for (auto &feat: fr->features) {
-                if (feat->status == Feature::FeatureStatus::VALID &&
-                    feat->point->status == Point::PointStatus::ACTIVE) {
+            for (size_t k = 0; k < fr->features.size(); k++) {
+                if (fr->featureTable.status[k] != Feature::FeatureStatus::VALID)
+                    continue;
+                auto &feat = fr->features[k];
+                if (feat->point->status == Point::PointStatus::ACTIVE) {
 
                     shared_ptr<PointHessian> ph = feat->point->mpPH;
 
                     if (ph->idepth_scaled < 0 || ph->residuals.size() == 0) {
                         // no residuals or idepth invalid
                         ph->point->status = Point::PointStatus::OUTLIER;
-                        feat->status = Feature::FeatureStatus::OUTLIER;
+                        feat->status() = Feature::FeatureStatus::OUTLIER;
                         flag_nores++;
 
                     } else if (ph->isOOB(fhsToMargPoints) || host->flaggedForMarginalization) {
@@ -1257,6 +1650,7 @@ namespace ldso {
                                 // idepth is good, margin it.
                                 flag_inin++;
                                 ph->point->status = Point::PointStatus::MARGINALIZED;
+                                ef->queuePointForMarg(ph);
                             } else {
                                 // idepth not good, drop it.
                                 ph->point->status = Point::PointStatus::OUT;
@@ -1278,7 +1672,9 @@ namespace ldso {
         if (setting_pointSelection == 1) {
             LOG(INFO) << "using LDSO point selection strategy " << endl;
             newFrame->frame->features.reserve(setting_desiredImmatureDensity);
-            detector.DetectCorners(setting_desiredImmatureDensity, newFrame->frame);
+            newFrame->frame->featureTable.reserve(setting_desiredImmatureDensity);
+            detector.DetectCorners(setting_desiredImmatureDensity, newFrame->frame,
+                                   multiThreading ? &threadReduce : nullptr);
             for (auto &feat: newFrame->frame->features) {
                 // create a immature point
                 feat->ip = shared_ptr<ImmaturePoint>(
@@ -1290,6 +1686,7 @@ namespace ldso {
             pixelSelector->allowFast = true;
             int numPointsTotal = pixelSelector->makeMaps(newFrame, selectionMap, setting_desiredImmatureDensity);
             newFrame->frame->features.reserve(numPointsTotal);
+            newFrame->frame->featureTable.reserve(numPointsTotal);
 
             for (int y = patternPadding + 1; y < hG[0] - patternPadding - 2; y++)
                 for (int x = patternPadding + 1; x < wG[0] - patternPadding - 2; x++) {
@@ -1301,6 +1698,7 @@ namespace ldso {
                         new ImmaturePoint(newFrame->frame, feat, selectionMap[i], Hcalib->mpCH));
                     if (!std::isfinite(feat->ip->energyTH)) {
                         feat->ReleaseAll();
+                        newFrame->frame->featureTable.PopBack();
                         continue;
                     } else
                         newFrame->frame->features.push_back(feat);
@@ -1311,6 +1709,7 @@ namespace ldso {
             LOG(INFO) << "using random point selection strategy" << endl;
             cv::RNG rng;
             newFrame->frame->features.reserve(setting_desiredImmatureDensity);
+            newFrame->frame->featureTable.reserve(setting_desiredImmatureDensity);
             for (int i = 0; i < setting_desiredImmatureDensity; i++) {
                 int x = rng.uniform(20, wG[0] - 20);
                 int y = rng.uniform(20, hG[0] - 20);
@@ -1319,6 +1718,7 @@ namespace ldso {
                     new ImmaturePoint(newFrame->frame, feat, 1, Hcalib->mpCH));
                 if (!std::isfinite(feat->ip->energyTH)) {
                     feat->ReleaseAll();
+                    newFrame->frame->featureTable.PopBack();
                     continue;
                 } else
                     newFrame->frame->features.push_back(feat);
@@ -1340,6 +1740,7 @@ namespace ldso {
         setPrecalcValues();
 
         fr->features.reserve(wG[0] * hG[0] * 0.2f);
+        fr->featureTable.reserve(wG[0] * hG[0] * 0.2f);
 
         float sumID = 1e-5, numID = 1e-5;
         for (int i = 0; i < coarseInitializer->numPoints[0]; i++) {
@@ -1367,6 +1768,7 @@ namespace ldso {
 
             if (!std::isfinite(feat->ip->energyTH)) {
                 feat->ReleaseImmature();
+                fr->featureTable.PopBack();
                 continue;
             }
 
@@ -1374,6 +1776,7 @@ namespace ldso {
             shared_ptr<PointHessian> ph = feat->point->mpPH;
             if (!std::isfinite(ph->energyTH)) {
                 feat->ReleaseMapPoint();
+                fr->featureTable.PopBack();
                 continue;
             }
             feat->ReleaseImmature();    // no longer needs the immature part
@@ -1406,14 +1809,17 @@ namespace ldso {
     void FullSystem::removeOutliers() {
         int numPointsDropped = 0;
         for (auto &fr: frames) {
-            for (auto &feat: fr->features) {
-                if (feat->status == Feature::FeatureStatus::VALID && feat->point
+            for (size_t k = 0; k < fr->features.size(); k++) {
+                if (fr->featureTable.status[k] != Feature::FeatureStatus::VALID)
+                    continue;
+                auto &feat = fr->features[k];
+                if (feat->point
                     && feat->point->status == Point::PointStatus::ACTIVE) {
 
                     shared_ptr<PointHessian> ph = feat->point->mpPH;
                     if (ph->residuals.empty()) {
                         ph->point->status = Point::PointStatus::OUTLIER;
-                        feat->status = Feature::FeatureStatus::OUTLIER;
+                        feat->status() = Feature::FeatureStatus::OUTLIER;
                         numPointsDropped++;
                     }
                 }
@@ -1435,11 +1841,15 @@ namespace ldso {
     }
 
     void FullSystem::solveSystem(int iteration, double lambda) {
-        ef->lastNullspaces_forLogging = getNullspaces(
-            ef->lastNullspaces_pose,
-            ef->lastNullspaces_scale,
-            ef->lastNullspaces_affA,
-            ef->lastNullspaces_affB);
+        // the window and the linearization points don't change during optimize, neither do the nullspaces
+        if (iteration == 0) {
+            ef->lastNullspaces_forLogging = getNullspaces(
+                ef->lastNullspaces_pose,
+                ef->lastNullspaces_scale,
+                ef->lastNullspaces_affA,
+                ef->lastNullspaces_affB);
+            ef->makeNullspaceProjector();
+        }
         ef->solveSystemF(iteration, lambda, Hcalib->mpCH);
     }
 
@@ -1449,19 +1859,16 @@ namespace ldso {
         double lastEnergyR = 0;
         double num = 0;
 
-        std::vector<shared_ptr<PointFrameResidual>>
-            toRemove[NUM_THREADS];
-        for (int i = 0; i < NUM_THREADS; i++)
-            toRemove[i].clear();
+        toRemove.resize(threadReduce.NumSlots());
 
         if (multiThreading) {
             threadReduce.reduce(
-                bind(&FullSystem::linearizeAll_Reductor, this, fixLinearization, toRemove, _1, _2, _3, _4),
+                bind(&FullSystem::linearizeAll_Reductor, this, fixLinearization, toRemove.data(), _1, _2, _3, _4),
                 0, activeResiduals.size(), 0);
             lastEnergyP = threadReduce.stats[0];
         } else {
             Vec10 stats;
-            linearizeAll_Reductor(fixLinearization, toRemove, 0, activeResiduals.size(), &stats, 0);
+            linearizeAll_Reductor(fixLinearization, toRemove.data(), 0, activeResiduals.size(), &stats, 0);
             lastEnergyP = stats[0];
         }
 
@@ -1469,8 +1876,8 @@ namespace ldso {
 
         if (fixLinearization) {
 
-            for (auto r : activeResiduals) {
-                shared_ptr<PointHessian> ph = r->point.lock();
+            for (auto &r : activeResiduals) {
+                PointHessian *ph = r->pointPtr;
                 if (ph->lastResiduals[0].first == r)
                     ph->lastResiduals[0].second = r->state_state;
                 else if (ph->lastResiduals[1].first == r)
@@ -1478,7 +1885,7 @@ namespace ldso {
             }
 
             int nResRemoved = 0;
-            for (int i = 0; i < NUM_THREADS; i++) {
+            for (size_t i = 0; i < toRemove.size(); i++) {
                 for (auto r : toRemove[i]) {
                     shared_ptr<PointHessian> ph = r->point.lock();
 
@@ -1490,6 +1897,7 @@ namespace ldso {
                     ef->dropResidual(r);    // this will actually remove the residual
                     nResRemoved++;
                 }
+                toRemove[i].clear();
             }
         }
         return Vec3(lastEnergyP, lastEnergyR, num);
@@ -1509,7 +1917,7 @@ namespace ldso {
             int k = min;
             k < max;
             k++) {
-            shared_ptr<PointFrameResidual> r = activeResiduals[k];
+            PointFrameResidual *r = activeResiduals[k].get();
             (*stats)[0] += r->
                 linearize(Hcalib
                               ->mpCH);
@@ -1523,9 +1931,9 @@ namespace ldso {
 
                     ) {
                     if (r->isNew) {
-                        shared_ptr<PointHessian> p = r->point.lock();
-                        shared_ptr<FrameHessian> host = r->host.lock();
-                        shared_ptr<FrameHessian> target = r->target.lock();
+                        PointHessian *p = r->pointPtr;
+                        FrameHessian *host = r->hostPtr;
+                        FrameHessian *target = r->targetPtr;
                         Vec3f ptp_inf = host->targetPrecalc[target->idx].PRE_KRKiTll *
                                         Vec3f(p->u, p->v, 1);    // projected point assuming infinite depth.
                         Vec3f ptp = ptp_inf + host->targetPrecalc[target->idx].PRE_KtTll *
@@ -1571,9 +1979,11 @@ namespace ldso {
                 sumT += step.segment<3>(0).squaredNorm();
                 sumR += step.segment<3>(3).squaredNorm();
 
-                for (auto feat: fr->features) {
-                    if (feat->status == Feature::FeatureStatus::VALID
-                        && feat->point && feat->point->status == Point::PointStatus::ACTIVE) {
+                for (size_t k = 0; k < fr->features.size(); k++) {
+                    if (fr->featureTable.status[k] != Feature::FeatureStatus::VALID)
+                        continue;
+                    auto &feat = fr->features[k];
+                    if (feat->point && feat->point->status == Point::PointStatus::ACTIVE) {
 
                         auto ph = feat->point->mpPH;
                         float step = ph->step + 0.5f * (ph->step_backup);
@@ -1595,8 +2005,11 @@ namespace ldso {
                 sumT += fh->step.segment<3>(0).squaredNorm();
                 sumR += fh->step.segment<3>(3).squaredNorm();
 
-                for (auto feat: fr->features) {
-                    if (feat->status == Feature::FeatureStatus::VALID && feat->point &&
+                for (size_t k = 0; k < fr->features.size(); k++) {
+                    if (fr->featureTable.status[k] != Feature::FeatureStatus::VALID)
+                        continue;
+                    auto &feat = fr->features[k];
+                    if (feat->point &&
                         feat->point->status == Point::PointStatus::ACTIVE) {
                         auto ph = feat->point->mpPH;
                         ph->setIdepth(ph->idepth_backup + stepfacD * ph->step);
@@ -1665,9 +2078,11 @@ namespace ldso {
             for (auto &fr: frames) {
                 auto fh = fr->frameHessian;
                 fh->state_backup = fh->get_state();
-                for (auto feat: fr->features) {
-                    if (feat->status == Feature::FeatureStatus::VALID &&
-                        feat->point->status == Point::PointStatus::ACTIVE) {
+                for (size_t k = 0; k < fr->features.size(); k++) {
+                    if (fr->featureTable.status[k] != Feature::FeatureStatus::VALID)
+                        continue;
+                    auto &feat = fr->features[k];
+                    if (feat->point->status == Point::PointStatus::ACTIVE) {
                         auto ph = feat->point->mpPH;
                         ph->idepth_backup = ph->idepth;
                     }
@@ -1807,10 +2222,11 @@ namespace ldso {
                 a,
                 b
         );
-        LOG(INFO) << string(buff);
+        LOG(INFO) << buff;
     }
 
     void FullSystem::mappingLoop() {
+        bindCalib(calib);
 
         unique_lock<mutex> lock(trackMapSyncMutex);
 
@@ -1854,6 +2270,8 @@ namespace ldso {
                         unique_lock<mutex> crlock(shellPoseMutex);
                         fh->setEvalPT_scaled(fr->getPose(), fh->frame->aff_g2l);
                     }
+                    unique_lock<mutex> slck(mappingStatsMutex);
+                    mappingStats.skippedFrames++;
                 }
             } else {
                 if (setting_realTimeMaxKF || needNewKFAfter >= int(frames.back()->id)) {
@@ -1874,41 +2292,34 @@ namespace ldso {
     }
 
     bool FullSystem::saveAll(const string &filename) {
-        ofstream fout(filename, ios::out | ios::binary);
-        if (!fout) return false;
-        int nKF = globalMap->NumFrames();
-        fout.write((char *) &nKF, sizeof(int));
+        bindCalib(calib);
         auto allKFs = globalMap->GetAllKFs();
-        for (auto &frame: allKFs) {
-            frame->save(fout);
-        }
-        fout.close();
+        vector<shared_ptr<Frame>> kfs(allKFs.begin(), allKFs.end());
+
+        // archived keyframes are restored while they are written and archived again right after, one at a time
+        bool saved = MapFile::Save(filename, kfs, setting_compressMap,
+                                   [this](const shared_ptr<Frame> &kf) { return globalMap->PinKeyFrame(kf); },
+                                   [this](const shared_ptr<Frame> &kf) { globalMap->UnpinKeyFrame(kf); });
+        if (!saved)
+            return false;
         LOG(INFO) << "DONE!" << endl;
         return true;
     }
 
     bool FullSystem::loadAll(const string &filename) {
 
-        ifstream fin(filename);
-        if (!fin) return false;
-        int numKF = 0;
-        fin.read((char *) &numKF, sizeof(numKF));
-
         vector<shared_ptr<Frame>> allKFs;
-        allKFs.resize(numKF, nullptr);
-        for (auto &kf: allKFs) {
-            kf = shared_ptr<Frame>(new Frame());
-        }
-
-        int i = 0;
-        while (!fin.eof() && i < int(allKFs.size())) {
-            shared_ptr<Frame> &newFrame = allKFs[i];
-            newFrame->load(fin, newFrame, allKFs);
-            i++;
+        if (MapFile::IsMapFile(filename)) {
+            MapFile mapFile;
+            if (!mapFile.Open(filename) || !mapFile.LoadAll())
+                return false;
+            allKFs = mapFile.Frames();
+        } else {
+            // maps saved before the chunked format
+            if (!MapFile::LoadLegacy(filename, allKFs))
+                return false;
         }
 
-        fin.close();
-
         if (viewer)
             viewer->publishKeyframes(allKFs, false, Hcalib->mpCH);
 
@@ -1951,6 +2362,52 @@ namespace ldso {
         myfile.close();
     }
 
+    void FullSystem::printTrajectory(const string &filename, bool printOptimized) {
+
+        unique_lock<mutex> lock(trackMutex);
+        unique_lock<mutex> crlock(shellPoseMutex);
+
+        // keyframes are written with their own pose, the other frames relative to their reference keyframe
+        auto allKFs = globalMap->GetAllKFs();
+        map<unsigned long, shared_ptr<Frame>> kfById, kfByKfId;
+        for (auto &fr: allKFs) {
+            kfById[fr->id] = fr;
+            kfByKfId[fr->kfId] = fr;
+        }
+
+        map<unsigned long, pair<double, Sim3>> poses;     // Scw and timestamp by frame id
+        for (auto &fr: allKFs) {
+            Sim3 Scw = printOptimized ? fr->getPoseOpti() : Sim3(fr->getPose().matrix());
+            poses[fr->id] = make_pair(fr->timeStamp, Scw);
+        }
+        for (const TrajectoryEntry &e: trajectory) {
+            if (kfById.count(e.id))
+                continue;
+            Sim3 Scw(e.Tcw.matrix());
+            auto ref = kfByKfId.find(e.refKfId);
+            if (ref != kfByKfId.end()) {
+                Sim3 Scr(e.Tcr.cast<double>().matrix());
+                Scw = Scr * (printOptimized ? ref->second->getPoseOpti() : Sim3(ref->second->getPose().matrix()));
+            }
+            poses[e.id] = make_pair(e.timeStamp, Scw);
+        }
+
+        std::ofstream myfile(filename);
+        myfile << std::setprecision(15);
+        LOG(INFO) << "total frames: " << poses.size() << endl;
+        for (auto &p: poses) {
+            Sim3 Swc = p.second.second.inverse();
+            SE3 Twc(Swc.rotationMatrix(), Swc.translation());
+            myfile << p.second.first <<
+                   " " << Twc.translation().transpose() <<
+                   " " << Twc.so3().unit_quaternion().x() <<
+                   " " << Twc.so3().unit_quaternion().y() <<
+                   " " << Twc.so3().unit_quaternion().z() <<
+                   " " << Twc.so3().unit_quaternion().w() << "\n";
+        }
+        myfile.close();
+    }
+
     void FullSystem::printResultKitti(const string &filename, bool printOptimized) {
 
         LOG(INFO) << "saving kitti trajectory..." << endl;
@@ -1,4 +1,5 @@
 #include "Feature.h"
+#include "FlatVocabulary.h"
 #include "internal/PR.h"
 #include "internal/GlobalCalib.h"
 
@@ -21,12 +22,14 @@ namespace ldso {
 
     // -----------------------------------------------------------
     LoopClosing::LoopClosing(FullSystem *fullsystem) :
-            kfDB(new DBoW3::Database(*fullsystem->vocab)), voc(fullsystem->vocab),
+            kfDB(new DBoW3::Database(fullsystem->vocab)), voc(fullsystem->vocab),
             globalMap(fullsystem->globalMap), Hcalib(fullsystem->Hcalib->mpCH),
             coarseDistanceMap(fullsystem->GetDistanceMap()),
             fullSystem(fullsystem) {
 
         mainLoop = thread(&LoopClosing::Run, this);
+        if (setting_threadAffinity >= 0)
+            ThreadPool::PinThread(mainLoop, setting_threadAffinity + 2);
         idepthMap = new float[wG[0] * hG[0]];
     }
 
@@ -36,6 +39,8 @@ namespace ldso {
     }
 
     void LoopClosing::Run() {
+        bindCalib(fullSystem->calib);
+        FlatVocabulary::Get(voc);   // flatten the tree here instead of at the first keyframe
         finished = false;
 
         while (1) {
@@ -62,10 +67,22 @@ namespace ldso {
                 allKF.push_back(currentKF);
             }
 
+            // the keyframes may have been archived while waiting in the queue or long ago, keep their features
+            // in memory while we use them
+            if (!globalMap->PinKeyFrame(currentKF)) {
+                // no features, its bag of words would go into the database empty
+                LOG(WARNING) << "keyframe " << currentKF->kfId << " cannot be restored, skipped by loop closing"
+                             << endl;
+                globalMap->UnpinKeyFrame(currentKF);
+                continue;
+            }
             currentKF->ComputeBoW(voc);
             if (DetectLoop(currentKF)) {
                 bool mapIdle = globalMap->Idle();
-                if (CorrectLoop(Hcalib)) {
+                shared_ptr<Frame> candidate = candidateKF;
+                bool corrected = globalMap->PinKeyFrame(candidate) && CorrectLoop(Hcalib);
+                globalMap->UnpinKeyFrame(candidate);
+                if (corrected) {
                     // start a pose graph optimization
                     if (mapIdle) {
                         LOG(INFO) << "call global pose graph!" << endl;
@@ -78,6 +95,7 @@ namespace ldso {
                     }
                 }
             }
+            globalMap->UnpinKeyFrame(currentKF);
 
 
             if (needPoseGraph && globalMap->Idle()) {
@@ -176,20 +194,20 @@ namespace ldso {
                 shared_ptr<Feature> &featKF = pKF->features[m.index2];
                 shared_ptr<Feature> &featCurrent = currentKF->features[m.index1];
 
-                if (featKF->status == Feature::FeatureStatus::VALID &&
+                if (featKF->status() == Feature::FeatureStatus::VALID &&
                     featKF->point->status != Point::PointStatus::OUTLIER) {
                     // there should be a 3d point
                     // pt unused?
                     //shared_ptr<Point> &pt = featKF->point;
                     // compute 3d pos in ref
-                    Vec3f pt3 = (1.0 / featKF->invD) * Vec3f(
-                            Hcalib->fxli() * (featKF->uv[0] - Hcalib->cxl()),
-                            Hcalib->fyli() * (featKF->uv[1] - Hcalib->cyl()),
+                    Vec3f pt3 = (1.0 / featKF->invD()) * Vec3f(
+                            Hcalib->fxli() * (featKF->uv()[0] - Hcalib->cxl()),
+                            Hcalib->fyli() * (featKF->uv()[1] - Hcalib->cyl()),
                             1
                     );
                     cv::Point3f pt3d(pt3[0], pt3[1], pt3[2]);
                     p3d.push_back(pt3d);
-                    p2d.push_back(cv::Point2f(featCurrent->uv[0], featCurrent->uv[1]));
+                    p2d.push_back(cv::Point2f(featCurrent->uv()[0], featCurrent->uv()[1]));
                     matchIdx.push_back(k);
                 }
             }
@@ -275,11 +293,11 @@ namespace ldso {
         //SE3 Tcw = currentKF->getPose();
         for (shared_ptr<Frame> fh: activeFrames) {
             if (fh == currentKF) continue;
-            for (shared_ptr<Feature> feat: fh->features) {
-                if (feat->status == Feature::FeatureStatus::VALID &&
-                    feat->point->status == Point::PointStatus::ACTIVE) {
+            for (size_t i = 0; i < fh->features.size(); i++) {
+                if (fh->featureTable.status[i] == Feature::FeatureStatus::VALID &&
+                    fh->features[i]->point->status == Point::PointStatus::ACTIVE) {
 
-                    shared_ptr<PointHessian> ph = feat->point->mpPH;
+                    shared_ptr<PointHessian> ph = fh->features[i]->point->mpPH;
                     if (ph->lastResiduals[0].first != 0 && ph->lastResiduals[0].second == ResState::IN) {
                         shared_ptr<PointFrameResidual> r = ph->lastResiduals[0].first;
                         if (r->target.lock() != currentKF->frameHessian) continue;
@@ -318,12 +336,12 @@ namespace ldso {
         VecVec2 matchedPixels;
 
         // find more matches in the local map of pKF
-        vector<shared_ptr<Feature>> candidateFeatures;
+        vector<size_t> candidateFeatures;   // indices in pKF->features
 
-        for (auto &feat: pKF->features) {
-            if (feat->status == Feature::FeatureStatus::VALID &&
-                feat->point->status != Point::PointStatus::OUTLIER) {
-                candidateFeatures.push_back(feat);
+        for (size_t i = 0; i < pKF->features.size(); i++) {
+            if (pKF->featureTable.status[i] == Feature::FeatureStatus::VALID &&
+                pKF->features[i]->point->status != Point::PointStatus::OUTLIER) {
+                candidateFeatures.push_back(i);
             }
         }
 
@@ -331,12 +349,17 @@ namespace ldso {
         Mat33 Ki;
         Ki << Hcalib->fxli(), 0, Hcalib->cxli(), 0, Hcalib->fyli(), Hcalib->cyli(), 0, 0, 1;
 
+        // nearby features passing the rotation check, their packed descriptors and distances
+        vector<int> nearby, dists;
+        vector<unsigned char> nearbyDesc;
+
         // search by projection
-        for (auto &p: candidateFeatures) {
+        for (size_t &c: candidateFeatures) {
+            auto &p = pKF->features[c];
 
-            Vec3 pRef = (1.0 / p->invD) * Vec3(
-                    Hcalib->fxli() * (p->uv[0] - Hcalib->cxl()),
-                    Hcalib->fyli() * (p->uv[1] - Hcalib->cyl()),
+            Vec3 pRef = (1.0 / p->invD()) * Vec3(
+                    Hcalib->fxli() * (p->uv()[0] - Hcalib->cxl()),
+                    Hcalib->fyli() * (p->uv()[1] - Hcalib->cyl()),
                     1
             );
             Vec3 pc = Scr * pRef;
@@ -354,43 +377,53 @@ namespace ldso {
             auto indices = currentKF->GetFeatureInGrid(u, v, windowSize);
             float idepth = 0;
 
+            // check rotation first, then compute the descriptor distances in one batch
+            nearby.clear();
+            nearbyDesc.clear();
             for (size_t &k: indices) {
+                if (fabsf(currentKF->featureTable.angle[k] - p->angle()) < 0.2) {
+                    nearby.push_back(k);
+                    nearbyDesc.insert(nearbyDesc.end(), currentKF->Descriptor(k), currentKF->Descriptor(k) + 32);
+                }
+            }
+            dists.resize(nearby.size());
+            FeatureMatcher::DescriptorDistances(pKF->Descriptor(c), nearbyDesc.data(), nullptr, nearby.size(),
+                                                dists.data());
+
+            for (size_t n = 0; n < nearby.size(); n++) {
+                int k = nearby[n];
                 shared_ptr<Feature> &feat = currentKF->features[k];
-                if (fabsf(feat->angle - p->angle) < 0.2) {
-                    // check rotation first
-                    int dist = FeatureMatcher::DescriptorDistance(feat->descriptor,
-                                                                  p->descriptor);
-
-                    int ui = int(feat->uv[0] + 0.5f), vi = int(feat->uv[1] + 0.5f);
-                    idepth = idepthMap[vi * wG[0] + ui];
-
-                    if (idepth == 0) {
-                        // NOTE don't need this idepth =0 because we need to estimate the scale
-                        // well in stereo case you can still do this
-                        continue;
-                    }
+                int dist = dists[n];
 
-                    if (dist < bestDist) {
-                        bestDist2 = bestDist;
-                        bestDist = dist;
-                        bestIdx = k;
-                    } else if (dist < bestDist2) {
-                        bestDist2 = dist;
-                    }
+                int ui = int(feat->uv()[0] + 0.5f), vi = int(feat->uv()[1] + 0.5f);
+                idepth = idepthMap[vi * wG[0] + ui];
+
+                if (idepth == 0) {
+                    // NOTE don't need this idepth =0 because we need to estimate the scale
+                    // well in stereo case you can still do this
+                    continue;
+                }
+
+                if (dist < bestDist) {
+                    bestDist2 = bestDist;
+                    bestDist = dist;
+                    bestIdx = k;
+                } else if (dist < bestDist2) {
+                    bestDist2 = dist;
                 }
             }
 
             if (bestDist <= TH_HIGH) {
                 auto bestFeat = currentKF->features[bestIdx];
 
-                int ui = int(bestFeat->uv[0] + 0.5f), vi = int(bestFeat->uv[1] + 0.5f);
+                int ui = int(bestFeat->uv()[0] + 0.5f), vi = int(bestFeat->uv()[1] + 0.5f);
                 idepth = idepthMap[vi * wG[0] + ui];
 
-                Vec3 pcurr = (1.0f / idepth) * (Ki * Vec3(bestFeat->uv[0], bestFeat->uv[1], 1));
+                Vec3 pcurr = (1.0f / idepth) * (Ki * Vec3(bestFeat->uv()[0], bestFeat->uv()[1], 1));
                 matchedPoints.push_back(pRef);
                 matchedFeatures.push_back(pcurr);
 
-                matchedPixels.push_back(Vec2(bestFeat->uv[0], bestFeat->uv[1]));
+                matchedPixels.push_back(Vec2(bestFeat->uv()[0], bestFeat->uv()[1]));
 
                 nmatches++;
             }
@@ -0,0 +1,187 @@
+#include "frontend/SessionServer.h"
+
+#include <algorithm>
+
+namespace ldso {
+
+    SessionServer::SessionServer(shared_ptr<ORBVocabulary> voc, int numThreads, int firstCore) :
+        vocab(voc),
+        pool(new ThreadPool(ThreadPool::ResolveNumThreads(numThreads), firstCore)) {
+        // the tracking threads run next to the workers, keep them to half of the cores
+        maxRunning = std::max(1, pool->NumThreads() / 2);
+        LOG(INFO) << "session server with " << pool->NumThreads() << " workers, tracking at most " << maxRunning
+                  << " sessions at a time" << endl;
+    }
+
+    SessionServer::~SessionServer() {
+        Finish();
+    }
+
+    shared_ptr<FullSystem> SessionServer::createSystem(const Session &s) {
+        shared_ptr<FullSystem> system(new FullSystem(vocab, s.calib, pool));
+        // keyframes on the mapping thread, tracking goes on meanwhile
+        system->linearizeOperation = false;
+        if (s.gammaInv)
+            system->setGammaFunction(s.gammaInv);
+        return system;
+    }
+
+    int SessionServer::AddSession(shared_ptr<CalibContext> calib, float *gammaInv, int priority, int maxQueue) {
+        CHECK(calib) << "a session needs a calibration";
+        unique_ptr<Session> s(new Session);
+        s->calib = calib;
+        s->gammaInv = gammaInv;
+        s->priority = priority;
+        s->maxQueue = std::max(1, maxQueue);
+        s->system = createSystem(*s);
+
+        unique_lock<mutex> lock(serverMutex);
+        sessions.push_back(move(s));
+        int session = int(sessions.size()) - 1;
+        sessions[session]->tracker = thread(&SessionServer::trackingLoop, this, session);
+        return session;
+    }
+
+    shared_ptr<FullSystem> SessionServer::GetSystem(int session) {
+        unique_lock<mutex> lock(serverMutex);
+        return sessions[session]->system;
+    }
+
+    bool SessionServer::AddFrame(int session, ImageAndExposure *image, int id, bool wait) {
+        unique_lock<mutex> lock(serverMutex);
+        Session &s = *sessions[session];
+        if (wait)
+            dequeuedSignal.wait(lock, [this, &s] { return finished || int(s.frames.size()) < s.maxQueue; });
+        if (finished || int(s.frames.size()) >= s.maxQueue) {
+            s.stats.framesDropped++;
+            delete image;
+            return false;
+        }
+
+        QueuedFrame f;
+        f.image = image;
+        f.id = id;
+        f.queuedAt = Clock::now();
+        if (!s.started) {
+            s.started = true;
+            s.firstQueued = f.queuedAt;
+        }
+        s.frames.push_back(f);
+        s.stats.framesQueued++;
+
+        if (!s.scheduled)
+            makeReady(session);
+        dispatch();
+        return true;
+    }
+
+    void SessionServer::makeReady(int session) {
+        Session &s = *sessions[session];
+        s.scheduled = true;
+        s.readySince = readyCounter++;
+        ready.push_back(session);
+    }
+
+    void SessionServer::dispatch() {
+        while (running < maxRunning && !ready.empty()) {
+            // highest priority first, the one waiting longest among equal priorities
+            auto best = ready.begin();
+            for (auto it = ready.begin(); it != ready.end(); ++it) {
+                const Session &a = *sessions[*it], &b = *sessions[*best];
+                if (a.priority > b.priority || (a.priority == b.priority && a.readySince < b.readySince))
+                    best = it;
+            }
+            int session = *best;
+            ready.erase(best);
+            running++;
+            sessions[session]->trackNext = true;
+            sessions[session]->trackSignal.notify_one();
+        }
+    }
+
+    void SessionServer::trackingLoop(int session) {
+        unique_lock<mutex> lock(serverMutex);
+        Session *s = sessions[session].get();
+
+        while (true) {
+            s->trackSignal.wait(lock, [s] { return s->trackNext || s->quit; });
+            if (!s->trackNext)
+                break;
+            s->trackNext = false;
+
+            QueuedFrame f = s->frames.front();
+            s->frames.pop_front();
+            dequeuedSignal.notify_all();
+            shared_ptr<FullSystem> system = s->system;
+            lock.unlock();
+
+            system->addActiveFrame(f.image, f.id);
+            delete f.image;
+
+            if (system->initFailed) {
+                LOG(INFO) << "session " << session << ": init failed, resetting" << endl;
+                system->blockUntilMappingIsFinished();
+                system = createSystem(*s);
+            }
+
+            Clock::time_point now = Clock::now();
+            lock.lock();
+            s->system = system;
+
+            double latency = chrono::duration<double>(now - f.queuedAt).count();
+            SessionStats &st = s->stats;
+            st.framesTracked++;
+            s->latencySum += latency;
+            st.meanLatency = s->latencySum / st.framesTracked;
+            st.maxLatency = std::max(st.maxLatency, latency);
+            double elapsed = chrono::duration<double>(now - s->firstQueued).count();
+            st.throughput = elapsed > 0 ? st.framesTracked / elapsed : 0;
+
+            // next frame of this session goes behind the others waiting with the same priority
+            running--;
+            s->scheduled = false;
+            if (!s->frames.empty())
+                makeReady(session);
+            dispatch();
+
+            if (running == 0 && ready.empty())
+                idleSignal.notify_all();
+        }
+    }
+
+    void SessionServer::WaitIdle() {
+        unique_lock<mutex> lock(serverMutex);
+        idleSignal.wait(lock, [this] { return running == 0 && ready.empty(); });
+    }
+
+    void SessionServer::Finish() {
+        {
+            unique_lock<mutex> lock(serverMutex);
+            if (finished)
+                return;
+            finished = true;
+            dequeuedSignal.notify_all();
+        }
+        WaitIdle();
+
+        vector<shared_ptr<FullSystem>> systems;
+        {
+            unique_lock<mutex> lock(serverMutex);
+            for (auto &s: sessions) {
+                s->quit = true;
+                s->trackSignal.notify_one();
+                systems.push_back(s->system);
+            }
+        }
+        // no session is added once finished, the list does not change any more
+        for (auto &s: sessions)
+            s->tracker.join();
+        for (auto &system: systems)
+            system->blockUntilMappingIsFinished();
+    }
+
+    SessionServer::SessionStats SessionServer::GetStats(int session) {
+        unique_lock<mutex> lock(serverMutex);
+        return sessions[session]->stats;
+    }
+}
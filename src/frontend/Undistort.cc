@@ -30,6 +30,7 @@
 
 #include <Eigen/Core>
 #include <iterator>
+#include <algorithm>
 
 #include "Settings.h"
 #include "internal/GlobalFuncs.h"
@@ -188,6 +189,12 @@ namespace ldso {
 
     template<typename T>
     void PhotometricUndistorter::processFrame(T *image_in, float exposure_time, float factor) {
+        processFrame<T>(image_in, exposure_time, factor, output);
+    }
+
+    template<typename T>
+    void PhotometricUndistorter::processFrame(const T *image_in, float exposure_time, float factor,
+                                              ImageAndExposure *output) const {
         int wh = w * h;
         float *data = output->image;
         assert(output->w == w && output->h == h);
@@ -232,10 +239,22 @@ namespace ldso {
     template void
     PhotometricUndistorter::processFrame<unsigned short>(unsigned short *image_in, float exposure_time, float factor);
 
+    template void
+    PhotometricUndistorter::processFrame<unsigned char>(const unsigned char *image_in, float exposure_time,
+                                                        float factor, ImageAndExposure *output) const;
+
+    template void
+    PhotometricUndistorter::processFrame<unsigned short>(const unsigned short *image_in, float exposure_time,
+                                                         float factor, ImageAndExposure *output) const;
+
 
     Undistort::~Undistort() {
         if (remapX != 0) delete[] remapX;
         if (remapY != 0) delete[] remapY;
+        delete[] remapIdx;
+        for (int k = 0; k < 4; k++)
+            delete[] remapWeight[k];
+        delete[] remapBlockWide;
     }
 
     Undistort *Undistort::getUndistorterForFile(std::string configFilename, std::string gammaFilename,
@@ -363,13 +382,72 @@ namespace ldso {
             exit(1);
         }
 
-        photometricUndist->processFrame<T>(image_raw->data, exposure, factor);
         ImageAndExposure *result = new ImageAndExposure(w, h, timestamp);
-        photometricUndist->output->copyMetaTo(*result);
+        undistort<T>(image_raw, result, exposure, timestamp, factor);
+        return result;
+    }
+
+    template<typename T>
+    void Undistort::undistort(const MinimalImage<T> *image_raw, ImageAndExposure *result, float exposure,
+                              double timestamp, float factor) const {
+        if (image_raw->w != wOrg || image_raw->h != hOrg) {
+            printf("Undistort::undistort: wrong image size (%d %d instead of %d %d) \n", image_raw->w, image_raw->h, w,
+                   h);
+            exit(1);
+        }
+        assert(result->w == w && result->h == h);
+
+        if (benchmark_varNoise > 0) {
+            // the remap is disturbed differently in every frame, the table does not apply
+            ImageAndExposure photo(wOrg, hOrg);
+            undistortPhotometric<T>(image_raw, &photo, exposure, factor);
+            undistortGeometric(&photo, result, timestamp);
+            return;
+        }
+
+        // same choice of photometric model as PhotometricUndistorter::processFrame
+        const PhotometricUndistorter *pu = photometricUndist;
+        const float *G = nullptr;
+        const float *vignetteInv = nullptr;
+        if (pu->valid && exposure > 0 && setting_photometricCalibration != 0) {
+            G = pu->G;
+            if (setting_photometricCalibration == 2)
+                vignetteInv = pu->vignetteMapInv;
+        }
+
+        result->timestamp = timestamp;
+        result->exposure_time = setting_useExposure ? exposure : 1;
+
+        if (passthrough) {
+            const T *in = image_raw->data;
+            float *out = result->image;
+            for (int i = 0; i < w * h; i++) {
+                float v = G ? G[in[i]] : factor * in[i];
+                out[i] = vignetteInv ? v * vignetteInv[i] : v;
+            }
+        } else {
+            remapFused(image_raw->data, result->image, G, factor, vignetteInv);
+        }
+
+        applyBlurNoise(result->image);
+    }
+
+    template<typename T>
+    void Undistort::undistortPhotometric(const MinimalImage<T> *image_raw, ImageAndExposure *photo, float exposure,
+                                         float factor) const {
+        assert(image_raw->w == wOrg && image_raw->h == hOrg);
+        photometricUndist->processFrame<T>(image_raw->data, exposure, factor, photo);
+    }
+
+    void Undistort::undistortGeometric(const ImageAndExposure *photo, ImageAndExposure *result,
+                                       double timestamp) const {
+        assert(photo->w == wOrg && photo->h == hOrg && result->w == w && result->h == h);
+        result->timestamp = timestamp;
+        result->exposure_time = photo->exposure_time;
 
         if (!passthrough) {
             float *out_data = result->image;
-            float *in_data = photometricUndist->output->image;
+            const float *in_data = photo->image;
 
             float *noiseMapX = 0;
             float *noiseMapY = 0;
@@ -440,12 +518,10 @@ namespace ldso {
             }
 
         } else {
-            memcpy(result->image, photometricUndist->output->image, sizeof(float) * w * h);
+            memcpy(result->image, photo->image, sizeof(float) * w * h);
         }
 
         applyBlurNoise(result->image);
-
-        return result;
     }
 
     template ImageAndExposure *
@@ -456,6 +532,22 @@ namespace ldso {
     Undistort::undistort<unsigned short>(const MinimalImage<unsigned short> *image_raw, float exposure,
                                          double timestamp, float factor) const;
 
+    template void
+    Undistort::undistort<unsigned char>(const MinimalImage<unsigned char> *image_raw, ImageAndExposure *result,
+                                        float exposure, double timestamp, float factor) const;
+
+    template void
+    Undistort::undistort<unsigned short>(const MinimalImage<unsigned short> *image_raw, ImageAndExposure *result,
+                                         float exposure, double timestamp, float factor) const;
+
+    template void
+    Undistort::undistortPhotometric<unsigned char>(const MinimalImage<unsigned char> *image_raw,
+                                                   ImageAndExposure *photo, float exposure, float factor) const;
+
+    template void
+    Undistort::undistortPhotometric<unsigned short>(const MinimalImage<unsigned short> *image_raw,
+                                                    ImageAndExposure *photo, float exposure, float factor) const;
+
 
     void Undistort::applyBlurNoise(float *img) const {
         if (benchmark_varBlurNoise == 0) return;
@@ -856,6 +948,7 @@ namespace ldso {
                 }
             }
 
+        makeRemapTable();
         valid = true;
 
 
@@ -865,6 +958,54 @@ namespace ldso {
     }
 
 
+    void Undistort::makeRemapTable() {
+        int n = w * h;
+        remapIdx = new int[n];
+        for (int k = 0; k < 4; k++)
+            remapWeight[k] = new uint16_t[n];
+        remapBlockWide = new unsigned char[(n + 7) / 8];
+
+        for (int idx = 0; idx < n; idx++) {
+            float xx = remapX[idx];
+            float yy = remapY[idx];
+            int xxi = xx;
+            int yyi = yy;
+
+            // the 2x2 neighbourhood has to be inside the original image
+            if (xx < 0 || xxi + 1 >= wOrg || yyi + 1 >= hOrg) {
+                remapIdx[idx] = -1;
+                for (int k = 0; k < 4; k++)
+                    remapWeight[k][idx] = 0;
+                continue;
+            }
+
+            float fx = xx - xxi, fy = yy - yyi, fxfy = fx * fy;
+            float weight[4] = {1 - fx - fy + fxfy, fx - fxfy, fy - fxfy, fxfy};
+            int wi[4], sum = 0, largest = 0;
+            for (int k = 0; k < 4; k++) {
+                wi[k] = int(weight[k] * 32768 + 0.5f);
+                sum += wi[k];
+                if (wi[k] > wi[largest])
+                    largest = k;
+            }
+            wi[largest] += 32768 - sum;     // the weights sum up to exactly one
+
+            remapIdx[idx] = xxi + yyi * wOrg;
+            for (int k = 0; k < 4; k++)
+                remapWeight[k][idx] = uint16_t(wi[k]);
+        }
+
+        // a 4 byte read of the bottom source row starts at most here
+        const int wideLimit = wOrg * hOrg - wOrg - 4;
+        for (int b = 0; b < (n + 7) / 8; b++) {
+            remapBlockWide[b] = 1;
+            for (int idx = b * 8; idx < std::min(n, b * 8 + 8); idx++)
+                if (remapIdx[idx] > wideLimit)
+                    remapBlockWide[b] = 0;
+        }
+    }
+
+
     UndistortFOV::UndistortFOV(const char *configFileName, bool noprefix) {
         printf("Creating FOV undistorter\n");
 
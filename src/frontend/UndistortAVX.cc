@@ -0,0 +1,159 @@
+#include "frontend/Undistort.h"
+
+/**
+ * Fused photometric correction and bilinear remap of Undistort::undistort
+ *
+ * Every output pixel reads its 2x2 source neighbourhood through the remap table, maps the raw values through the
+ * response G (or scales them), multiplies the vignette and blends them with the fixed-point weights of the table.
+ * The AVX2 kernel does 8 pixels at a time with gathers and is picked once at runtime, other cpus, platforms and
+ * 16 bit images use the scalar kernel.
+ */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LDSO_WIDE_KERNELS
+#include <immintrin.h>
+#define LDSO_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
+namespace ldso {
+
+    // input and output of the remap kernels
+    struct RemapKernelArgs {
+        const int *idx;
+        const uint16_t *weight[4];
+        const unsigned char *blockWide;
+        int n;
+        int wOrg;
+
+        const float *G;
+        float factor;
+        const float *vignetteInv;
+    };
+
+    typedef void (*RemapKernel)(const RemapKernelArgs &args, const unsigned char *in, float *out);
+
+    template<typename T>
+    static inline float photometric(const RemapKernelArgs &args, const T *in, int i) {
+        float v = args.G ? args.G[in[i]] : args.factor * in[i];
+        return args.vignetteInv ? v * args.vignetteInv[i] : v;
+    }
+
+    template<typename T>
+    static void remapScalar(const RemapKernelArgs &args, const T *in, float *out, int begin, int end) {
+        const int wOrg = args.wOrg;
+        for (int i = begin; i < end; i++) {
+            int s = args.idx[i];
+            if (s < 0) {
+                out[i] = 0;
+                continue;
+            }
+            float sum = args.weight[0][i] * photometric(args, in, s)
+                        + args.weight[1][i] * photometric(args, in, s + 1)
+                        + args.weight[2][i] * photometric(args, in, s + wOrg)
+                        + args.weight[3][i] * photometric(args, in, s + wOrg + 1);
+            out[i] = sum * (1.0f / 32768);
+        }
+    }
+
+    static void remapScalar8U(const RemapKernelArgs &args, const unsigned char *in, float *out) {
+        remapScalar(args, in, out, 0, args.n);
+    }
+
+#ifdef LDSO_WIDE_KERNELS
+
+    LDSO_TARGET_AVX2
+    static inline __m256 photometric8(const RemapKernelArgs &args, __m256i v, __m256i s) {
+        __m256 r = args.G ? _mm256_i32gather_ps(args.G, v, 4)
+                          : _mm256_mul_ps(_mm256_cvtepi32_ps(v), _mm256_set1_ps(args.factor));
+        if (args.vignetteInv)
+            r = _mm256_mul_ps(r, _mm256_i32gather_ps(args.vignetteInv, s, 4));
+        return r;
+    }
+
+    LDSO_TARGET_AVX2
+    static inline __m256 weight8(const uint16_t *w) {
+        return _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *) w)));
+    }
+
+    LDSO_TARGET_AVX2
+    static void remapAVX2(const RemapKernelArgs &args, const unsigned char *in, float *out) {
+        const __m256i byteMask = _mm256_set1_epi32(0xff);
+        const __m256i rowStep = _mm256_set1_epi32(args.wOrg);
+        const __m256i one = _mm256_set1_epi32(1);
+        const __m256 scale = _mm256_set1_ps(1.0f / 32768);
+
+        int i = 0;
+        for (; i + 8 <= args.n; i += 8) {
+            if (!args.blockWide[i / 8]) {
+                remapScalar(args, in, out, i, i + 8);
+                continue;
+            }
+
+            __m256i s = _mm256_loadu_si256((const __m256i *) (args.idx + i));
+            __m256i inside = _mm256_cmpgt_epi32(s, _mm256_set1_epi32(-1));
+            s = _mm256_max_epi32(s, _mm256_setzero_si256());
+            __m256i sBottom = _mm256_add_epi32(s, rowStep);
+
+            // 4 bytes from the top left and the bottom left pixel, the low two are the 2x2 neighbourhood
+            __m256i top = _mm256_i32gather_epi32((const int *) in, s, 1);
+            __m256i bottom = _mm256_i32gather_epi32((const int *) in, sBottom, 1);
+
+            __m256 v00 = photometric8(args, _mm256_and_si256(top, byteMask), s);
+            __m256 v10 = photometric8(args, _mm256_and_si256(_mm256_srli_epi32(top, 8), byteMask),
+                                      _mm256_add_epi32(s, one));
+            __m256 v01 = photometric8(args, _mm256_and_si256(bottom, byteMask), sBottom);
+            __m256 v11 = photometric8(args, _mm256_and_si256(_mm256_srli_epi32(bottom, 8), byteMask),
+                                      _mm256_add_epi32(sBottom, one));
+
+            __m256 sum = _mm256_mul_ps(weight8(args.weight[0] + i), v00);
+            sum = _mm256_fmadd_ps(weight8(args.weight[1] + i), v10, sum);
+            sum = _mm256_fmadd_ps(weight8(args.weight[2] + i), v01, sum);
+            sum = _mm256_fmadd_ps(weight8(args.weight[3] + i), v11, sum);
+            sum = _mm256_and_ps(_mm256_mul_ps(sum, scale), _mm256_castsi256_ps(inside));
+            _mm256_storeu_ps(out + i, sum);
+        }
+        remapScalar(args, in, out, i, args.n);
+    }
+
+#endif // LDSO_WIDE_KERNELS
+
+    static RemapKernel remapKernel() {
+#ifdef LDSO_WIDE_KERNELS
+        static const RemapKernel kernel = []() -> RemapKernel {
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+                return remapAVX2;
+            return remapScalar8U;
+        }();
+        return kernel;
+#else
+        return remapScalar8U;
+#endif
+    }
+
+    static RemapKernelArgs remapArgs(const int *idx, uint16_t *const *weight, const unsigned char *blockWide, int n,
+                                     int wOrg, const float *G, float factor, const float *vignetteInv) {
+        RemapKernelArgs args;
+        args.idx = idx;
+        for (int k = 0; k < 4; k++)
+            args.weight[k] = weight[k];
+        args.blockWide = blockWide;
+        args.n = n;
+        args.wOrg = wOrg;
+        args.G = G;
+        args.factor = factor;
+        args.vignetteInv = vignetteInv;
+        return args;
+    }
+
+    void Undistort::remapFused(const unsigned char *in, float *out, const float *G, float factor,
+                               const float *vignetteInv) const {
+        RemapKernelArgs args = remapArgs(remapIdx, remapWeight, remapBlockWide, w * h, wOrg, G, factor, vignetteInv);
+        remapKernel()(args, in, out);
+    }
+
+    void Undistort::remapFused(const unsigned short *in, float *out, const float *G, float factor,
+                               const float *vignetteInv) const {
+        RemapKernelArgs args = remapArgs(remapIdx, remapWeight, remapBlockWide, w * h, wOrg, G, factor, vignetteInv);
+        remapScalar(args, in, out, 0, args.n);
+    }
+}
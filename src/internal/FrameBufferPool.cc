@@ -0,0 +1,104 @@
+#include "internal/FrameBufferPool.h"
+#include "internal/GlobalCalib.h"
+
+#include <glog/logging.h>
+#include <sys/mman.h>
+#include <cstring>
+#include <algorithm>
+
+namespace ldso {
+
+    namespace internal {
+
+        size_t FrameBufferPool::FrameFloats() {
+            size_t total = 0;
+            for (int i = 0; i < pyrLevelsUsed; i++)
+                total += 4 * size_t(wG[i] * hG[i]);     // dIp (3 floats) and absSquaredGrad
+            return total;
+        }
+
+        FrameBufferPool::FrameBufferPool(size_t bufferFloats, int capacity, bool hugePages) :
+            bufferFloats(bufferFloats) {
+            bufferBytes = (bufferFloats * sizeof(float) + 63) / 64 * 64;
+            if (capacity <= 0 || bufferFloats == 0)
+                return;
+
+            const size_t hugePageSize = 2 << 20;
+            arenaBytes = (bufferBytes * capacity + hugePageSize - 1) / hugePageSize * hugePageSize;
+
+            void *mem = MAP_FAILED;
+#ifdef MAP_HUGETLB
+            if (hugePages) {
+                mem = mmap(nullptr, arenaBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+                           -1, 0);
+                stats.hugePages = mem != MAP_FAILED;
+            }
+#endif
+            if (mem == MAP_FAILED) {
+                mem = mmap(nullptr, arenaBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                if (mem == MAP_FAILED) {
+                    LOG(WARNING) << "cannot map the frame buffer pool (" << arenaBytes << " bytes), using the heap"
+                                 << endl;
+                    arenaBytes = 0;
+                    return;
+                }
+#ifdef MADV_HUGEPAGE
+                if (hugePages)
+                    stats.hugePages = madvise(mem, arenaBytes, MADV_HUGEPAGE) == 0;
+#endif
+            }
+
+            // touch every page now instead of while tracking
+            arena = static_cast<unsigned char *>(mem);
+            memset(arena, 0, arenaBytes);
+
+            stats.capacity = capacity;
+            freeBuffers.reserve(capacity);
+            for (int i = capacity - 1; i >= 0; i--)
+                freeBuffers.push_back(reinterpret_cast<float *>(arena + i * bufferBytes));
+
+            LOG(INFO) << "frame buffer pool: " << capacity << " buffers of " << bufferBytes / 1024 << " KB"
+                      << (stats.hugePages ? ", huge pages" : "") << endl;
+        }
+
+        FrameBufferPool::~FrameBufferPool() {
+            if (arena)
+                munmap(arena, arenaBytes);
+        }
+
+        float *FrameBufferPool::Borrow() {
+            {
+                unique_lock<mutex> lock(poolMutex);
+                stats.inUse++;
+                stats.peakInUse = std::max(stats.peakInUse, stats.inUse);
+                if (!freeBuffers.empty()) {
+                    stats.hits++;
+                    float *buffer = freeBuffers.back();
+                    freeBuffers.pop_back();
+                    return buffer;
+                }
+                stats.misses++;
+            }
+            return new float[bufferFloats];
+        }
+
+        void FrameBufferPool::Return(float *buffer) {
+            unsigned char *p = reinterpret_cast<unsigned char *>(buffer);
+            bool fromArena = arena && p >= arena && p < arena + arenaBytes;
+            {
+                unique_lock<mutex> lock(poolMutex);
+                stats.inUse--;
+                if (fromArena) {
+                    freeBuffers.push_back(buffer);
+                    return;
+                }
+            }
+            delete[] buffer;
+        }
+
+        FrameBufferPool::Stats FrameBufferPool::GetStats() {
+            unique_lock<mutex> lock(poolMutex);
+            return stats;
+        }
+    }
+}
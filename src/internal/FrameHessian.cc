@@ -42,69 +42,74 @@ namespace ldso {
         }
 
         // 这个函数应该是制作金字塔，同时把梯度准备好
-        void FrameHessian::makeImages(float *color, const shared_ptr<CalibHessian> &HCalib) {
-
+        void FrameHessian::makeImages(float *color, const shared_ptr<CalibHessian> &HCalib,
+                                      IndexThreadReduce<Vec10> *red) {
+
+            // one block for dIp and absSquaredGrad of all levels
+            if (imageData == nullptr) {
+                size_t total = FrameBufferPool::FrameFloats();
+                if (bufferPool && bufferPool->BufferFloats() >= total) {
+                    imageData = bufferPool->Borrow();
+                } else {
+                    bufferPool = nullptr;
+                    imageData = new float[total];
+                }
+            }
+            float *p = imageData;
             for (int i = 0; i < pyrLevelsUsed; i++) {
-                dIp[i] = new Eigen::Vector3f[wG[i] * hG[i]];
-                absSquaredGrad[i] = new float[wG[i] * hG[i]];
-                memset(absSquaredGrad[i], 0, wG[i] * hG[i]);
-                memset(dIp[i], 0, 3 * wG[i] * hG[i]);
+                dIp[i] = reinterpret_cast<Vec3f *>(p);
+                p += 3 * wG[i] * hG[i];
+                absSquaredGrad[i] = p;
+                p += wG[i] * hG[i];
             }
             // dI是个Vec3f的指针
             dI = dIp[0];
 
-            // make d0
-            // 第0层金字塔
             int w = wG[0];
             int h = hG[0];
-            for (int i = 0; i < w * h; i++) {
-                // 0通道存放图像
-                dI[i][0] = color[i];
+
+            // level 1.. intensities, in a buffer of this thread that is reused for the next frames
+            static thread_local vector<float> pyramidBuffer;
+            size_t pyramidSize = 0;
+            for (int i = 1; i < pyrLevelsUsed; i++)
+                pyramidSize += wG[i] * hG[i];
+            if (pyramidBuffer.size() < pyramidSize)
+                pyramidBuffer.resize(pyramidSize);
+
+            PyramidBands pyr;
+            pyr.level[0] = color;
+            float *q = pyramidBuffer.data();
+            for (int i = 1; i < pyrLevelsUsed; i++) {
+                pyr.level[i] = q;
+                q += wG[i] * hG[i];
             }
 
-            for (int lvl = 0; lvl < pyrLevelsUsed; lvl++) {
-                int wl = wG[lvl], hl = hG[lvl];
-                Eigen::Vector3f *dI_l = dIp[lvl];
-
-                float *dabs_l = absSquaredGrad[lvl];
-                if (lvl > 0) {
-                    int lvlm1 = lvl - 1;
-                    int wlm1 = wG[lvlm1];
-                    Eigen::Vector3f *dI_lm = dIp[lvlm1];
-
-                    // 如果不是第0层，先获取相应的图像
-                    for (int y = 0; y < hl; y++)
-                        for (int x = 0; x < wl; x++) {
-                            dI_l[x + y * wl][0] = 0.25f * (dI_lm[2 * x + 2 * y * wlm1][0] +
-                                                           dI_lm[2 * x + 1 + 2 * y * wlm1][0] +
-                                                           dI_lm[2 * x + 2 * y * wlm1 + wlm1][0] +
-                                                           dI_lm[2 * x + 1 + 2 * y * wlm1 + wlm1][0]);
-                        }
+            // the weight getBGradOnly would give for each intensity, squared
+            float gradWeight2[256];
+            pyr.gradWeight2 = nullptr;
+            if (setting_gammaWeightsPixelSelect == 1 && HCalib != 0) {
+                for (int c = 0; c < 256; c++) {
+                    float gw = HCalib->getBGradOnly(c);
+                    gradWeight2[c] = gw * gw;
                 }
+                pyr.gradWeight2 = gradWeight2;
+            }
 
-                // 计算当前层的x y方向的梯度
-                for (int idx = wl; idx < wl * (hl - 1); idx++) {
-                    float dx = 0.5f * (dI_l[idx + 1][0] - dI_l[idx - 1][0]);
-                    float dy = 0.5f * (dI_l[idx + wl][0] - dI_l[idx - wl][0]);
-
-                    if (std::isnan(dx) || std::fabs(dx) > 255.0) dx = 0;
-                    if (std::isnan(dy) || std::fabs(dy) > 255.0) dy = 0;
-
-                    // 存储
-                    dI_l[idx][1] = dx;
-                    dI_l[idx][2] = dy;
-
-                    // 计算梯度的大小
-                    dabs_l[idx] = dx * dx + dy * dy;
-
-                    // TODO: wuch 有空回来补上
-                    if (setting_gammaWeightsPixelSelect == 1 && HCalib != 0) {
-                        float gw = HCalib->getBGradOnly((float) (dI_l[idx][0]));
-                        dabs_l[idx] *=
-                                gw * gw;    // convert to gradient of original color space (before removing response).
-                        // if (std::isnan(dabs_l[idx])) dabs_l[idx] = 0;
-                    }
-                }
+            // bands start at a row that exists on every level
+            int align = 1 << (pyrLevelsUsed - 1);
+            pyr.bandRows = ((32 + align - 1) / align) * align;
+            pyr.numBands = (h + pyr.bandRows - 1) / pyr.bandRows;
+
+            if (red && w * h >= 640 * 480) {
+                // one range of bands per thread, so only the rows at the few range boundaries are left
+                int bandsPerTask = (pyr.numBands + red->NumSlots() - 1) / red->NumSlots();
+                red->reduce(bind(&FrameHessian::makeImages_Reductor, this, &pyr, _1, _2, _3, _4), 0, pyr.numBands,
+                            bandsPerTask);
+                for (int b = bandsPerTask; b < pyr.numBands; b += bandsPerTask)
+                    makeBoundaryGradients(&pyr, b);
+            } else {
+                Vec10 stats;
+                makeImages_Reductor(&pyr, 0, pyr.numBands, &stats, 0);
             }
 
             // === debug stuffs === //
@@ -120,6 +125,71 @@ namespace ldso {
             }
         }
 
+        void FrameHessian::makeImages_Reductor(PyramidBands *pyr, int min, int max, Vec10 *stats, int tid) {
+            if (min >= max)
+                return;
+
+            // per level, the first row whose gradients are not computed yet
+            int next[PYR_LEVELS];
+            for (int lvl = 0; lvl < pyrLevelsUsed; lvl++)
+                next[lvl] = min == 0 ? 0 : ((min * pyr->bandRows) >> lvl) + 1;
+
+            for (int band = min; band < max; band++) {
+                // level by level, the rows of the level above are still in cache
+                for (int lvl = 1; lvl < pyrLevelsUsed; lvl++) {
+                    int wl = wG[lvl], hl = hG[lvl], wlm1 = wG[lvl - 1];
+                    int y0 = (band * pyr->bandRows) >> lvl;
+                    int y1 = std::min(hl, ((band + 1) * pyr->bandRows) >> lvl);
+                    const float *above = pyr->level[lvl - 1];
+                    float *out = pyr->level[lvl];
+                    for (int y = y0; y < y1; y++)
+                        downsampleRow(above + 2 * y * wlm1, above + (2 * y + 1) * wlm1, out + y * wl, wl);
+                }
+
+                // the rows up to the last one of the band, which needs the next band, the last row of the image none
+                for (int lvl = 0; lvl < pyrLevelsUsed; lvl++) {
+                    int hl = hG[lvl];
+                    int y1 = std::min(hl, ((band + 1) * pyr->bandRows) >> lvl);
+                    int limit = band == pyr->numBands - 1 ? hl : y1 - 1;
+                    if (limit > next[lvl]) {
+                        gradientRows(pyr, lvl, next[lvl], limit);
+                        next[lvl] = limit;
+                    }
+                }
+            }
+        }
+
+        void FrameHessian::makeBoundaryGradients(PyramidBands *pyr, int b) {
+            for (int lvl = 0; lvl < pyrLevelsUsed; lvl++) {
+                int y = (b * pyr->bandRows) >> lvl;
+                gradientRows(pyr, lvl, y - 1, y + 1);
+            }
+        }
+
+        void FrameHessian::gradientRows(PyramidBands *pyr, int lvl, int y0, int y1) {
+            int wl = wG[lvl], hl = hG[lvl];
+            const float *I = pyr->level[lvl];
+            Vec3f *dI_l = dIp[lvl];
+            float *dabs_l = absSquaredGrad[lvl];
+
+            // first and last row have no gradient
+            for (int y: {0, hl - 1}) {
+                if (y < y0 || y >= y1)
+                    continue;
+                for (int idx = y * wl; idx < (y + 1) * wl; idx++) {
+                    dI_l[idx] = Vec3f(I[idx], 0, 0);
+                    dabs_l[idx] = 0;
+                }
+            }
+
+            // the pixels in between as one range, as before the left and right neighbours of the border
+            // columns are in the previous and next row
+            int begin = std::max(y0, 1) * wl;
+            int end = std::min(y1, hl - 1) * wl;
+            if (begin < end)
+                gradients(I, wl, begin, end, pyr->gradWeight2, dI_l, dabs_l);
+        }
+
         void FrameHessian::takeData() {
             prior = getPrior().head<8>();
             delta = get_state_minus_stateZero().head<8>();
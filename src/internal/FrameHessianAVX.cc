@@ -0,0 +1,152 @@
+#include "internal/FrameHessian.h"
+
+#include <cmath>
+
+/**
+ * Row kernels of FrameHessian::makeImages: the 2x2 box filter of the pyramid and the central difference gradients
+ *
+ * The AVX2 kernels do 8 pixels at a time and compute in the same order as the scalar ones, so without fp contraction
+ * both give the same images.
+ * They are compiled with per-function target attributes and picked once at runtime, other cpus and platforms use the
+ * scalar kernels.
+ */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LDSO_WIDE_KERNELS
+#include <immintrin.h>
+#define LDSO_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace ldso {
+
+    namespace internal {
+
+        static void downsampleScalar(const float *r0, const float *r1, float *out, int n) {
+            for (int x = 0; x < n; x++)
+                out[x] = 0.25f * (r0[2 * x] + r0[2 * x + 1] + r1[2 * x] + r1[2 * x + 1]);
+        }
+
+        static inline void gradientPixel(const float *I, int wl, int idx, const float *gradWeight2, Vec3f *dI,
+                                         float *dabs) {
+            float dx = 0.5f * (I[idx + 1] - I[idx - 1]);
+            float dy = 0.5f * (I[idx + wl] - I[idx - wl]);
+
+            if (std::isnan(dx) || std::fabs(dx) > 255.0) dx = 0;
+            if (std::isnan(dy) || std::fabs(dy) > 255.0) dy = 0;
+
+            dI[idx] = Vec3f(I[idx], dx, dy);
+            float d = dx * dx + dy * dy;
+            if (gradWeight2) {
+                // convert to gradient of original color space (before removing response).
+                int c = I[idx] + 0.5f;
+                c = c < 5 ? 5 : (c > 250 ? 250 : c);
+                d *= gradWeight2[c];
+            }
+            dabs[idx] = d;
+        }
+
+        static void gradientsScalar(const float *I, int wl, int begin, int end, const float *gradWeight2, Vec3f *dI,
+                                    float *dabs) {
+            for (int idx = begin; idx < end; idx++)
+                gradientPixel(I, wl, idx, gradWeight2, dI, dabs);
+        }
+
+#ifdef LDSO_WIDE_KERNELS
+
+        // even and odd elements of 16 floats, in order
+        LDSO_TARGET_AVX2
+        static inline void deinterleave(const float *p, __m256 &even, __m256 &odd) {
+            __m256 lo = _mm256_loadu_ps(p);
+            __m256 hi = _mm256_loadu_ps(p + 8);
+            even = _mm256_castpd_ps(_mm256_permute4x64_pd(
+                    _mm256_castps_pd(_mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0))), _MM_SHUFFLE(3, 1, 2, 0)));
+            odd = _mm256_castpd_ps(_mm256_permute4x64_pd(
+                    _mm256_castps_pd(_mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1))), _MM_SHUFFLE(3, 1, 2, 0)));
+        }
+
+        LDSO_TARGET_AVX2
+        static void downsampleAVX2(const float *r0, const float *r1, float *out, int n) {
+            const __m256 quarter = _mm256_set1_ps(0.25f);
+            int x = 0;
+            for (; x + 8 <= n; x += 8) {
+                __m256 a, b, c, d;
+                deinterleave(r0 + 2 * x, a, b);
+                deinterleave(r1 + 2 * x, c, d);
+                __m256 sum = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(a, b), c), d);
+                _mm256_storeu_ps(out + x, _mm256_mul_ps(quarter, sum));
+            }
+            downsampleScalar(r0 + 2 * x, r1 + 2 * x, out + x, n - x);
+        }
+
+        // d if |d| <= 255, else (or if nan) 0
+        LDSO_TARGET_AVX2
+        static inline __m256 clampGradient(__m256 d) {
+            const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+            __m256 inRange = _mm256_cmp_ps(_mm256_and_ps(d, absMask), _mm256_set1_ps(255.0f), _CMP_LE_OQ);
+            return _mm256_and_ps(d, inRange);
+        }
+
+        LDSO_TARGET_AVX2
+        static void gradientsAVX2(const float *I, int wl, int begin, int end, const float *gradWeight2, Vec3f *dI,
+                                  float *dabs) {
+            const __m256 half = _mm256_set1_ps(0.5f);
+            const __m256i cMin = _mm256_set1_epi32(5), cMax = _mm256_set1_epi32(250);
+            alignas(32) float dxs[8], dys[8];
+
+            int idx = begin;
+            for (; idx + 8 <= end; idx += 8) {
+                __m256 center = _mm256_loadu_ps(I + idx);
+                __m256 dx = _mm256_mul_ps(half, _mm256_sub_ps(_mm256_loadu_ps(I + idx + 1),
+                                                              _mm256_loadu_ps(I + idx - 1)));
+                __m256 dy = _mm256_mul_ps(half, _mm256_sub_ps(_mm256_loadu_ps(I + idx + wl),
+                                                              _mm256_loadu_ps(I + idx - wl)));
+                dx = clampGradient(dx);
+                dy = clampGradient(dy);
+
+                __m256 d = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+                if (gradWeight2) {
+                    __m256i c = _mm256_cvttps_epi32(_mm256_add_ps(center, half));
+                    c = _mm256_min_epi32(_mm256_max_epi32(c, cMin), cMax);
+                    d = _mm256_mul_ps(d, _mm256_i32gather_ps(gradWeight2, c, 4));
+                }
+                _mm256_storeu_ps(dabs + idx, d);
+
+                _mm256_store_ps(dxs, dx);
+                _mm256_store_ps(dys, dy);
+                for (int k = 0; k < 8; k++)
+                    dI[idx + k] = Vec3f(I[idx + k], dxs[k], dys[k]);
+            }
+            gradientsScalar(I, wl, idx, end, gradWeight2, dI, dabs);
+        }
+
+#endif // LDSO_WIDE_KERNELS
+
+        static bool useAVX2() {
+#ifdef LDSO_WIDE_KERNELS
+            static const bool avx2 = []() -> bool {
+                __builtin_cpu_init();
+                return __builtin_cpu_supports("avx2");
+            }();
+            return avx2;
+#else
+            return false;
+#endif
+        }
+
+        void FrameHessian::downsampleRow(const float *r0, const float *r1, float *out, int n) {
+#ifdef LDSO_WIDE_KERNELS
+            if (useAVX2())
+                return downsampleAVX2(r0, r1, out, n);
+#endif
+            downsampleScalar(r0, r1, out, n);
+        }
+
+        void FrameHessian::gradients(const float *I, int wl, int begin, int end, const float *gradWeight2, Vec3f *dI,
+                                     float *dabs) {
+#ifdef LDSO_WIDE_KERNELS
+            if (useAVX2())
+                return gradientsAVX2(I, wl, begin, end, gradWeight2, dI, dabs);
+#endif
+            gradientsScalar(I, wl, begin, end, gradWeight2, dI, dabs);
+        }
+    }
+}
@@ -1,77 +1,136 @@
 #include "internal/GlobalCalib.h"
 
+#include <mutex>
+
 namespace ldso {
 
     namespace internal {
 
-        int wG[PYR_LEVELS], hG[PYR_LEVELS];
-        float fxG[PYR_LEVELS], fyG[PYR_LEVELS],
+        thread_local int wG[PYR_LEVELS], hG[PYR_LEVELS];
+        thread_local float fxG[PYR_LEVELS], fyG[PYR_LEVELS],
                 cxG[PYR_LEVELS], cyG[PYR_LEVELS];
 
-        float fxiG[PYR_LEVELS], fyiG[PYR_LEVELS],
+        thread_local float fxiG[PYR_LEVELS], fyiG[PYR_LEVELS],
                 cxiG[PYR_LEVELS], cyiG[PYR_LEVELS];
 
-        Eigen::Matrix3f KG[PYR_LEVELS], KiG[PYR_LEVELS];
+        thread_local Eigen::Matrix3f KG[PYR_LEVELS], KiG[PYR_LEVELS];
 
 
-        float wM3G;
-        float hM3G;
+        thread_local float wM3G;
+        thread_local float hM3G;
 
-        void setGlobalCalib(int w, int h, const Eigen::Matrix3f &K) {
+        // the calibration bound to this thread, and which version of it has been copied
+        static thread_local shared_ptr<CalibContext> tlsCalib = nullptr;
+        static thread_local int tlsCalibVersion = 0;
+
+        // calibration of the threads that have none bound, set by setGlobalCalib
+        static mutex defaultCalibMutex;
+        static shared_ptr<CalibContext> defaultCalib = nullptr;
+
+        void CalibContext::Set(int w, int h, const Eigen::Matrix3f &K) {
             int wlvl = w;
             int hlvl = h;
-            pyrLevelsUsed = 1;
-            while (wlvl % 2 == 0 && hlvl % 2 == 0 && wlvl * hlvl > 5000 && pyrLevelsUsed < PYR_LEVELS) {
+            int pyrLevels = 1;
+            while (wlvl % 2 == 0 && hlvl % 2 == 0 && wlvl * hlvl > 5000 && pyrLevels < PYR_LEVELS) {
                 wlvl /= 2;
                 hlvl /= 2;
-                pyrLevelsUsed++;
+                pyrLevels++;
             }
             printf("using pyramid levels 0 to %d. coarsest resolution: %d x %d!\n",
-                   pyrLevelsUsed - 1, wlvl, hlvl);
+                   pyrLevels - 1, wlvl, hlvl);
             if (wlvl > 100 && hlvl > 100) {
                 printf("\n\n===============WARNING!===================\n "
                                "using not enough pyramid levels.\n"
                                "Consider scaling to a resolution that is a multiple of a power of 2.\n");
             }
-            if (pyrLevelsUsed < 3) {
+            if (pyrLevels < 3) {
                 printf("\n\n===============WARNING!===================\n "
                                "I need higher resolution.\n"
                                "I will probably segfault.\n");
             }
 
-            wM3G = w - 3;
-            hM3G = h - 3;
-
-            wG[0] = w;
-            hG[0] = h;
-            KG[0] = K;
-            fxG[0] = K(0, 0);
-            fyG[0] = K(1, 1);
-            cxG[0] = K(0, 2);
-            cyG[0] = K(1, 2);
-            KiG[0] = KG[0].inverse();
-            fxiG[0] = KiG[0](0, 0);
-            fyiG[0] = KiG[0](1, 1);
-            cxiG[0] = KiG[0](0, 2);
-            cyiG[0] = KiG[0](1, 2);
-
-            for (int level = 1; level < pyrLevelsUsed; ++level) {
-                wG[level] = w >> level;
-                hG[level] = h >> level;
-
-                fxG[level] = fxG[level - 1] * 0.5;
-                fyG[level] = fyG[level - 1] * 0.5;
-                cxG[level] = (cxG[0] + 0.5) / ((int) 1 << level) - 0.5;
-                cyG[level] = (cyG[0] + 0.5) / ((int) 1 << level) - 0.5;
-
-                KG[level] << fxG[level], 0.0, cxG[level], 0.0, fyG[level], cyG[level], 0.0, 0.0, 1.0;    // synthetic
-                KiG[level] = KG[level].inverse();
-
-                fxiG[level] = KiG[level](0, 0);
-                fyiG[level] = KiG[level](1, 1);
-                cxiG[level] = KiG[level](0, 2);
-                cyiG[level] = KiG[level](1, 2);
+            unique_lock<mutex> lock(setMutex);
+            this->pyrLevels = pyrLevels;
+            wM3 = w - 3;
+            hM3 = h - 3;
+
+            this->w[0] = w;
+            this->h[0] = h;
+            this->K[0] = K;
+            fx[0] = K(0, 0);
+            fy[0] = K(1, 1);
+            cx[0] = K(0, 2);
+            cy[0] = K(1, 2);
+            Ki[0] = this->K[0].inverse();
+            fxi[0] = Ki[0](0, 0);
+            fyi[0] = Ki[0](1, 1);
+            cxi[0] = Ki[0](0, 2);
+            cyi[0] = Ki[0](1, 2);
+
+            for (int level = 1; level < pyrLevels; ++level) {
+                this->w[level] = w >> level;
+                this->h[level] = h >> level;
+
+                fx[level] = fx[level - 1] * 0.5;
+                fy[level] = fy[level - 1] * 0.5;
+                cx[level] = (cx[0] + 0.5) / ((int) 1 << level) - 0.5;
+                cy[level] = (cy[0] + 0.5) / ((int) 1 << level) - 0.5;
+
+                this->K[level] << fx[level], 0.0, cx[level], 0.0, fy[level], cy[level], 0.0, 0.0, 1.0;    // synthetic
+                Ki[level] = this->K[level].inverse();
+
+                fxi[level] = Ki[level](0, 0);
+                fyi[level] = Ki[level](1, 1);
+                cxi[level] = Ki[level](0, 2);
+                cyi[level] = Ki[level](1, 2);
+            }
+            version++;
+        }
+
+        shared_ptr<CalibContext> CalibContext::Current() {
+            if (tlsCalib)
+                return tlsCalib;
+            unique_lock<mutex> lock(defaultCalibMutex);
+            return defaultCalib;
+        }
+
+        void bindCalib(const shared_ptr<CalibContext> &calib) {
+            if (!calib)
+                return;
+            if (calib == tlsCalib && calib->version.load() == tlsCalibVersion)
+                return;
+
+            // Set does not change it while we copy
+            unique_lock<mutex> lock(calib->setMutex);
+            tlsCalib = calib;
+            tlsCalibVersion = calib->version.load();
+
+            for (int level = 0; level < PYR_LEVELS; level++) {
+                wG[level] = calib->w[level];
+                hG[level] = calib->h[level];
+                fxG[level] = calib->fx[level];
+                fyG[level] = calib->fy[level];
+                cxG[level] = calib->cx[level];
+                cyG[level] = calib->cy[level];
+                fxiG[level] = calib->fxi[level];
+                fyiG[level] = calib->fyi[level];
+                cxiG[level] = calib->cxi[level];
+                cyiG[level] = calib->cyi[level];
+                KG[level] = calib->K[level];
+                KiG[level] = calib->Ki[level];
+            }
+            wM3G = calib->wM3;
+            hM3G = calib->hM3;
+            pyrLevelsUsed = calib->pyrLevels;
+        }
+
+        void setGlobalCalib(int w, int h, const Eigen::Matrix3f &K) {
+            shared_ptr<CalibContext> calib(new CalibContext(w, h, K));
+            {
+                unique_lock<mutex> lock(defaultCalibMutex);
+                defaultCalib = calib;
             }
+            bindCalib(calib);
         }
     }
-}
\ No newline at end of file
+}
@@ -17,7 +17,7 @@ namespace ldso {
             assert(hostFrame->frameHessian);
             gradH.setZero();
             shared_ptr<FrameHessian> host = hostFrame->frameHessian;
-            float u = feature->uv[0], v = feature->uv[1];
+            float u = feature->uv()[0], v = feature->uv()[1];
             for (int idx = 0; idx < patternNum; idx++) {
                 int dx = patternP[idx][0];
                 int dy = patternP[idx][1];
@@ -55,7 +55,7 @@ namespace ldso {
             // ============== project min and max. return if one of them is OOB ===================
             // step 1. 检查极线上点的位置
             // check idepthmin, 最近距离
-            Vec3f pr = hostToFrame_KRKi * Vec3f(feature->uv[0], feature->uv[1], 1);
+            Vec3f pr = hostToFrame_KRKi * Vec3f(feature->uv()[0], feature->uv()[1], 1);
             Vec3f ptpMin = pr + hostToFrame_Kt * idepth_min;
             float uMin = ptpMin[0] / ptpMin[2];
             float vMin = ptpMin[1] / ptpMin[2];
@@ -339,7 +339,7 @@ namespace ldso {
                 float Ku, Kv;
                 Vec3f KliP;
 
-                if (!projectPoint(this->feature->uv[0], this->feature->uv[1], idepth, dx, dy, HCalib,
+                if (!projectPoint(this->feature->uv()[0], this->feature->uv()[1], idepth, dx, dy, HCalib,
                                   PRE_RTll, PRE_tTll, drescale, u, v, Ku, Kv, KliP, new_idepth)) {
                     tmpRes->state_NewState = ResState::OOB;
                     return tmpRes->state_energy;
@@ -394,7 +394,7 @@ namespace ldso {
 
             for (int idx = 0; idx < patternNum; idx++) {
                 float Ku, Kv;
-                if (!projectPoint(this->feature->uv[0] + patternP[idx][0], this->feature->uv[1] + patternP[idx][1],
+                if (!projectPoint(this->feature->uv()[0] + patternP[idx][0], this->feature->uv()[1] + patternP[idx][1],
                                   idepth, PRE_KRKiTll, PRE_KtTll, Ku, Kv)) { return 1e10; }
 
                 Vec3f hitColor = (getInterpolatedElement33(dIl, Ku, Kv, wG[0]));
@@ -427,7 +427,7 @@ namespace ldso {
             float Ku, Kv;
             Vec3f KliP;
 
-            projectPoint(this->feature->uv[0], this->feature->uv[1], idepth, 0, 0, HCalib,
+            projectPoint(this->feature->uv()[0], this->feature->uv()[1], idepth, 0, 0, HCalib,
                          precalc->PRE_RTll, PRE_tTll, drescale, u, v, Ku, Kv, KliP, new_idepth);
 
             float dxdd = (PRE_tTll[0] - PRE_tTll[2] * u) * HCalib->fxl();
@@ -6,10 +6,10 @@ namespace ldso {
 
     namespace internal {
 
-        void AccumulatedSCHessianSSE::addPoint(shared_ptr<PointHessian> p, bool shiftPriorToZero, int tid) {
+        void AccumulatedSCHessianSSE::addPoint(const shared_ptr<PointHessian> &p, bool shiftPriorToZero, int tid) {
 
             int ngoodres = 0;
-            for (auto r : p->residuals)
+            for (auto &r : p->residuals)
                 if (r->isActive())
                     ngoodres++;
 
@@ -34,11 +34,11 @@ namespace ldso {
             assert(std::isfinite((float) (p->HdiF)));
 
             int nFrames2 = nframes[tid] * nframes[tid];
-            for (auto r1 : p->residuals) {
+            for (auto &r1 : p->residuals) {
                 if (!r1->isActive()) continue;
                 int r1ht = r1->hostIDX + r1->targetIDX * nframes[tid];
 
-                for (auto r2 : p->residuals) {
+                for (auto &r2 : p->residuals) {
                     if (!r2->isActive())
                         continue;
 
@@ -53,7 +53,7 @@ namespace ldso {
         void AccumulatedSCHessianSSE::stitchDoubleInternal(
                 MatXX *H, VecX *b, EnergyFunctional const *const EF,
                 int min, int max, Vec10 *stats, int tid) {
-            int toAggregate = NUM_THREADS;
+            int toAggregate = NumThreads();
             if (tid == -1) {
                 toAggregate = 1;
                 tid = 0;
@@ -118,64 +118,6 @@ namespace ldso {
             }
         }
 
-        void AccumulatedSCHessianSSE::stitchDouble(MatXX &H, VecX &b, const EnergyFunctional *const EF, int tid) {
-
-            int nf = nframes[0];
-            int nframes2 = nf * nf;
-
-            H = MatXX::Zero(nf * 8 + CPARS, nf * 8 + CPARS);
-            b = VecX::Zero(nf * 8 + CPARS);
-
-
-            for (int i = 0; i < nf; i++)
-                for (int j = 0; j < nf; j++) {
-                    int iIdx = CPARS + i * 8;
-                    int jIdx = CPARS + j * 8;
-                    int ijIdx = i + nf * j;
-
-                    accE[tid][ijIdx].finish();
-                    accEB[tid][ijIdx].finish();
-
-                    Mat8C accEM = accE[tid][ijIdx].A1m.cast<double>();
-                    Vec8 accEBV = accEB[tid][ijIdx].A1m.cast<double>();
-
-                    H.block<8, CPARS>(iIdx, 0) += EF->adHost[ijIdx] * accEM;
-                    H.block<8, CPARS>(jIdx, 0) += EF->adTarget[ijIdx] * accEM;
-
-                    b.segment<8>(iIdx) += EF->adHost[ijIdx] * accEBV;
-                    b.segment<8>(jIdx) += EF->adTarget[ijIdx] * accEBV;
-
-                    for (int k = 0; k < nf; k++) {
-                        int kIdx = CPARS + k * 8;
-                        int ijkIdx = ijIdx + k * nframes2;
-                        int ikIdx = i + nf * k;
-
-                        accD[tid][ijkIdx].finish();
-                        if (accD[tid][ijkIdx].num == 0) continue;
-                        Mat88 accDM = accD[tid][ijkIdx].A1m.cast<double>();
-
-                        H.block<8, 8>(iIdx, iIdx) += EF->adHost[ijIdx] * accDM * EF->adHost[ikIdx].transpose();
-
-                        H.block<8, 8>(jIdx, kIdx) += EF->adTarget[ijIdx] * accDM * EF->adTarget[ikIdx].transpose();
-
-                        H.block<8, 8>(jIdx, iIdx) += EF->adTarget[ijIdx] * accDM * EF->adHost[ikIdx].transpose();
-
-                        H.block<8, 8>(iIdx, kIdx) += EF->adHost[ijIdx] * accDM * EF->adTarget[ikIdx].transpose();
-                    }
-                }
-
-            accHcc[tid].finish();
-            accbc[tid].finish();
-            H.topLeftCorner<CPARS, CPARS>() = accHcc[tid].A1m.cast<double>();
-            b.head<CPARS>() = accbc[tid].A1m.cast<double>();
-
-            // ----- new: copy transposed parts for calibration only.
-            for (int h = 0; h < nf; h++) {
-                int hIdx = CPARS + h * 8;
-                H.block<CPARS, 8>(0, hIdx).noalias() = H.block<8, CPARS>(hIdx, 0).transpose();
-            }
-        }
-
     }
 
 }
\ No newline at end of file
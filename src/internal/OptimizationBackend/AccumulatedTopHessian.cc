@@ -6,7 +6,7 @@ namespace ldso {
     namespace internal {
 
         template<int mode>
-        void AccumulatedTopHessianSSE::addPoint(shared_ptr<PointHessian> p, EnergyFunctional const *const ef,
+        void AccumulatedTopHessianSSE::addPoint(const shared_ptr<PointHessian> &p, EnergyFunctional const *const ef,
                                                 int tid) { // 0 = active, 1 = linearized, 2=marginalize
 
 
@@ -34,7 +34,7 @@ namespace ldso {
                     assert(r->isLinearized);
                 }
 
-                shared_ptr<RawResidualJacobian> rJ = r->J;
+                const RawResidualJacobian *rJ = &r->J;
                 int htIDX = r->hostIDX + r->targetIDX * nframes[tid];
                 Mat18f dp = ef->adHTdeltaF[htIDX];
 
@@ -118,81 +118,17 @@ namespace ldso {
         }
 
         template void
-        AccumulatedTopHessianSSE::addPoint<0>(shared_ptr<PointHessian> p, EnergyFunctional const *const ef, int tid);
+        AccumulatedTopHessianSSE::addPoint<0>(const shared_ptr<PointHessian> &p, EnergyFunctional const *const ef, int tid);
 
         template void
-        AccumulatedTopHessianSSE::addPoint<1>(shared_ptr<PointHessian> p, EnergyFunctional const *const ef, int tid);
+        AccumulatedTopHessianSSE::addPoint<1>(const shared_ptr<PointHessian> &p, EnergyFunctional const *const ef, int tid);
 
         template void
-        AccumulatedTopHessianSSE::addPoint<2>(shared_ptr<PointHessian> p, EnergyFunctional const *const ef, int tid);
-
-        void AccumulatedTopHessianSSE::stitchDouble(MatXX &H, VecX &b, EnergyFunctional const *const EF, bool usePrior,
-                                                    bool useDelta, int tid) {
-            H = MatXX::Zero(nframes[tid] * 8 + CPARS, nframes[tid] * 8 + CPARS);
-            b = VecX::Zero(nframes[tid] * 8 + CPARS);
-
-            for (int h = 0; h < nframes[tid]; h++)
-                for (int t = 0; t < nframes[tid]; t++) {
-                    int hIdx = CPARS + h * 8;
-                    int tIdx = CPARS + t * 8;
-                    int aidx = h + nframes[tid] * t;
-
-
-                    acc[tid][aidx].finish();
-                    if (acc[tid][aidx].num == 0) continue;
-
-                    MatPCPC accH = acc[tid][aidx].H.cast<double>();
-
-
-                    H.block<8, 8>(hIdx, hIdx).noalias() +=
-                            EF->adHost[aidx] * accH.block<8, 8>(CPARS, CPARS) * EF->adHost[aidx].transpose();
-
-                    H.block<8, 8>(tIdx, tIdx).noalias() +=
-                            EF->adTarget[aidx] * accH.block<8, 8>(CPARS, CPARS) * EF->adTarget[aidx].transpose();
-
-                    H.block<8, 8>(hIdx, tIdx).noalias() +=
-                            EF->adHost[aidx] * accH.block<8, 8>(CPARS, CPARS) * EF->adTarget[aidx].transpose();
-
-                    H.block<8, CPARS>(hIdx, 0).noalias() += EF->adHost[aidx] * accH.block<8, CPARS>(CPARS, 0);
-
-                    H.block<8, CPARS>(tIdx, 0).noalias() += EF->adTarget[aidx] * accH.block<8, CPARS>(CPARS, 0);
-
-                    H.topLeftCorner<CPARS, CPARS>().noalias() += accH.block<CPARS, CPARS>(0, 0);
-
-                    b.segment<8>(hIdx).noalias() += EF->adHost[aidx] * accH.block<8, 1>(CPARS, 8 + CPARS);
-
-                    b.segment<8>(tIdx).noalias() += EF->adTarget[aidx] * accH.block<8, 1>(CPARS, 8 + CPARS);
-
-                    b.head<CPARS>().noalias() += accH.block<CPARS, 1>(0, 8 + CPARS);
-                }
-
-            // ----- new: copy transposed parts.
-            for (int h = 0; h < nframes[tid]; h++) {
-                int hIdx = CPARS + h * 8;
-                H.block<CPARS, 8>(0, hIdx).noalias() = H.block<8, CPARS>(hIdx, 0).transpose();
-
-                for (int t = h + 1; t < nframes[tid]; t++) {
-                    int tIdx = CPARS + t * 8;
-                    H.block<8, 8>(hIdx, tIdx).noalias() += H.block<8, 8>(tIdx, hIdx).transpose();
-                    H.block<8, 8>(tIdx, hIdx).noalias() = H.block<8, 8>(hIdx, tIdx).transpose();
-                }
-            }
-
-
-            if (usePrior) {
-                assert(useDelta);
-                H.diagonal().head<CPARS>() += EF->cPrior;
-                b.head<CPARS>() += EF->cPrior.cwiseProduct(EF->cDeltaF.cast<double>());
-                for (int h = 0; h < nframes[tid]; h++) {
-                    H.diagonal().segment<8>(CPARS + h * 8) += EF->frames[h]->prior;
-                    b.segment<8>(CPARS + h * 8) += EF->frames[h]->prior.cwiseProduct(EF->frames[h]->delta_prior);
-                }
-            }
-        }
+        AccumulatedTopHessianSSE::addPoint<2>(const shared_ptr<PointHessian> &p, EnergyFunctional const *const ef, int tid);
 
         void AccumulatedTopHessianSSE::stitchDoubleInternal(MatXX *H, VecX *b, EnergyFunctional const *const EF,
                                                             bool usePrior, int min, int max, Vec10 *stats, int tid) {
-            int toAggregate = NUM_THREADS;
+            int toAggregate = NumThreads();
             if (tid == -1) {
                 toAggregate = 1;
                 tid = 0;
@@ -0,0 +1,100 @@
+#include "internal/OptimizationBackend/BlockCholesky.h"
+
+#include <Eigen/Cholesky>
+
+namespace ldso {
+
+    namespace internal {
+
+        void BlockCholesky::Reserve(int n) {
+            if (n <= frameCapacity)
+                return;
+            frameCapacity = n;
+            Lff.resize(n * n);
+            Lcf.resize(n);
+            nz.resize(n * n);
+        }
+
+        bool BlockCholesky::Compute(const Eigen::Ref<const MatXX> &H, int n) {
+            assert(H.rows() == CPARS + 8 * n && H.cols() == CPARS + 8 * n);
+            Reserve(n);
+            nFrames = n;
+
+            // load the lower triangle
+            for (int i = 0; i < n; i++) {
+                for (int j = 0; j <= i; j++) {
+                    L(i, j) = H.block<8, 8>(CPARS + 8 * i, CPARS + 8 * j);
+                    nz[i * frameCapacity + j] = i == j || !L(i, j).isZero(0);
+                }
+                Lcf[i] = H.block<CPARS, 8>(0, CPARS + 8 * i);
+            }
+            Lcc = H.topLeftCorner<CPARS, CPARS>();
+
+            // right looking elimination of the frames, then of the calibration
+            numOffDiagonal = 0;
+            for (int k = 0; k < n; k++) {
+                Eigen::LLT<Mat88> llt(L(k, k));
+                if (llt.info() != Eigen::Success)
+                    return false;
+                L(k, k) = llt.matrixL();
+                auto LkkT = L(k, k).triangularView<Eigen::Lower>().transpose();
+
+                for (int i = k + 1; i < n; i++) {
+                    if (!nonZero(i, k))
+                        continue;
+                    LkkT.solveInPlace<Eigen::OnTheRight>(L(i, k));
+                    numOffDiagonal++;
+                }
+                LkkT.solveInPlace<Eigen::OnTheRight>(Lcf[k]);
+
+                // update the trailing blocks, a pair of nonzeros in column k fills in their block
+                for (int i = k + 1; i < n; i++) {
+                    if (!nonZero(i, k))
+                        continue;
+                    for (int j = k + 1; j <= i; j++) {
+                        if (!nonZero(j, k))
+                            continue;
+                        L(i, j).noalias() -= L(i, k) * L(j, k).transpose();
+                        nz[i * frameCapacity + j] = 1;
+                    }
+                    Lcf[i].noalias() -= Lcf[k] * L(i, k).transpose();
+                }
+                Lcc.noalias() -= Lcf[k] * Lcf[k].transpose();
+            }
+
+            Eigen::LLT<MatCC> llt(Lcc);
+            if (llt.info() != Eigen::Success)
+                return false;
+            Lcc = llt.matrixL();
+            return true;
+        }
+
+        void BlockCholesky::SolveInPlace(Eigen::Ref<VecX> b) const {
+            assert(b.size() == CPARS + 8 * nFrames);
+            const int n = nFrames;
+
+            // forward, L y = b
+            for (int k = 0; k < n; k++) {
+                auto yk = b.segment<8>(CPARS + 8 * k);
+                L(k, k).triangularView<Eigen::Lower>().solveInPlace(yk);
+                for (int i = k + 1; i < n; i++)
+                    if (nonZero(i, k))
+                        b.segment<8>(CPARS + 8 * i).noalias() -= L(i, k) * yk;
+                b.head<CPARS>().noalias() -= Lcf[k] * yk;
+            }
+            auto c = b.head<CPARS>();
+            Lcc.triangularView<Eigen::Lower>().solveInPlace(c);
+
+            // backward, L^T x = y
+            Lcc.triangularView<Eigen::Lower>().transpose().solveInPlace(c);
+            for (int k = n - 1; k >= 0; k--) {
+                auto xk = b.segment<8>(CPARS + 8 * k);
+                for (int i = k + 1; i < n; i++)
+                    if (nonZero(i, k))
+                        xk.noalias() -= L(i, k).transpose() * b.segment<8>(CPARS + 8 * i);
+                xk.noalias() -= Lcf[k].transpose() * c;
+                L(k, k).triangularView<Eigen::Lower>().transpose().solveInPlace(xk);
+            }
+        }
+    }
+}
@@ -10,10 +10,18 @@ namespace ldso {
         bool EFIndicesValid = false;
         bool EFDeltaValid = false;
 
-        EnergyFunctional::EnergyFunctional() :
-                accSSE_top_L(new AccumulatedTopHessianSSE),
-                accSSE_top_A(new AccumulatedTopHessianSSE),
-                accSSE_bot(new AccumulatedSCHessianSSE) {}
+        EnergyFunctional::EnergyFunctional(int numThreads) :
+                HM(nullptr, 0, 0, Eigen::OuterStride<>(1)), bM(nullptr, 0),
+                accSSE_top_L(new AccumulatedTopHessianSSE(numThreads)),
+                accSSE_top_A(new AccumulatedTopHessianSSE(numThreads)),
+                accSSE_bot(new AccumulatedSCHessianSSE(numThreads)) {
+            // sized for a full window, so the solver does not allocate once running
+            ws.Reserve(setting_maxFrames + 1, numThreads);
+            reserveAdjoints(setting_maxFrames + 1);
+            resizePrior(CPARS);
+            HM.setZero();
+            bM.setZero();
+        }
 
         EnergyFunctional::~EnergyFunctional() {
             if (adHost != 0) delete[] adHost;
@@ -37,11 +45,11 @@ namespace ldso {
 
             // extend H,b
             assert(HM.cols() == 8 * nFrames + CPARS - 8);
-            bM.conservativeResize(8 * nFrames + CPARS);
-            HM.conservativeResize(8 * nFrames + CPARS, 8 * nFrames + CPARS);
+            resizePrior(8 * nFrames + CPARS);
             bM.tail<8>().setZero();
             HM.rightCols<8>().setZero();
             HM.bottomRows<8>().setZero();
+            ws.Reserve(nFrames, accSSE_top_A->NumThreads());
 
             // set index as invalid
             EFIndicesValid = false;
@@ -83,20 +91,10 @@ namespace ldso {
                 int ntail = 8 * (nFrames - fh->idx - 1);
                 assert((io + 8 + ntail) == nFrames * 8 + CPARS);
 
-                Vec8 bTmp = bM.segment<8>(io);
-                VecX tailTMP = bM.tail(ntail);
-                bM.segment(io, ntail) = tailTMP;
-                bM.tail<8>() = bTmp;
-
-                MatXX HtmpCol = HM.block(0, io, odim, 8);
-                MatXX rightColsTmp = HM.rightCols(ntail);
-                HM.block(0, io, odim, ntail) = rightColsTmp;
-                HM.rightCols(8) = HtmpCol;
-
-                MatXX HtmpRow = HM.block(io, 0, 8, odim);
-                MatXX botRowsTmp = HM.bottomRows(ntail);
-                HM.block(io, 0, ntail, odim) = botRowsTmp;
-                HM.bottomRows(8) = HtmpRow;
+                // rotate [io, odim) in place by three reversals, the other frames keep their order
+                reversePrior(io, io + 8);
+                reversePrior(io + 8, odim);
+                reversePrior(io, odim);
             }
 
 
@@ -104,31 +102,23 @@ namespace ldso {
             HM.bottomRightCorner<8, 8>().diagonal() += fh->prior;
             bM.tail<8>() += fh->prior.cwiseProduct(fh->delta_prior);
 
-            VecX SVec = (HM.diagonal().cwiseAbs() + VecX::Constant(HM.cols(), 10)).cwiseSqrt();
-            VecX SVecI = SVec.cwiseInverse();
-
-            // scale!
-            MatXX HMScaled = SVecI.asDiagonal() * HM * SVecI.asDiagonal();
-            VecX bMScaled = SVecI.asDiagonal() * bM;
-
-            // invert bottom part!
-            Mat88 hpi = HMScaled.bottomRightCorner<8, 8>();
-            hpi = 0.5f * (hpi + hpi);
-            hpi = hpi.inverse();
-            hpi = 0.5f * (hpi + hpi);
+            // invert bottom part, scaled! Scaling the rest of the system as well cancels out in the
+            // schur-complement, so only the inverse is scaled (and unscaled).
+            Vec8 SVecI = (HM.diagonal().tail<8>().cwiseAbs() + Vec8::Constant(10)).cwiseSqrt().cwiseInverse();
+            Mat88 hpi = SVecI.asDiagonal() * HM.bottomRightCorner<8, 8>() * SVecI.asDiagonal();
+            hpi = SVecI.asDiagonal() * hpi.inverse() * SVecI.asDiagonal();
 
-            // schur-complement!
-            MatXX bli = HMScaled.bottomLeftCorner(8, ndim).transpose() * hpi;
-            HMScaled.topLeftCorner(ndim, ndim).noalias() -= bli * HMScaled.bottomLeftCorner(8, ndim);
-            bMScaled.head(ndim).noalias() -= bli * bMScaled.tail<8>();
+            // schur-complement! in place on the top left ndim corner
+            auto bli = ws.margK.topRows(ndim);
+            bli.noalias() = HM.bottomLeftCorner(8, ndim).transpose() * hpi;
+            HM.topLeftCorner(ndim, ndim).noalias() -= bli * HM.bottomLeftCorner(8, ndim);
+            bM.head(ndim).noalias() -= bli * bM.tail<8>();
 
-            // unscale!
-            HMScaled = SVec.asDiagonal() * HMScaled * SVec.asDiagonal();
-            bMScaled = SVec.asDiagonal() * bMScaled;
-
-            // set.
-            HM = 0.5 * (HMScaled.topLeftCorner(ndim, ndim) + HMScaled.topLeftCorner(ndim, ndim).transpose());
-            bM = bMScaled.head(ndim);
+            // symmetrize and set.
+            for (int c = 0; c < ndim; c++)
+                for (int r = 0; r < c; r++)
+                    HM(r, c) = HM(c, r) = 0.5 * (HM(r, c) + HM(c, r));
+            resizePrior(ndim);
 
             // remove from vector, without changing the order!
             for (unsigned int i = fh->idx; i + 1 < frames.size(); i++) {
@@ -162,60 +152,51 @@ namespace ldso {
             EFIndicesValid = false;
         }
 
-        void EnergyFunctional::marginalizePointsF() {
-
-            allPointsToMarg.clear();
-
-            // go through all points to see which to marg
-            for (auto f: frames) {
-                for (shared_ptr<Feature> feat: f->frame->features) {
+        void EnergyFunctional::queuePointForMarg(shared_ptr<PointHessian> ph) {
+            allPointsToMarg.push_back(ph);
+        }
 
-                    if (feat->status == Feature::FeatureStatus::VALID &&
-                        feat->point->status == Point::PointStatus::MARGINALIZED) {
-                        shared_ptr<PointHessian> p = feat->point->mpPH;
-                        p->priorF *= setting_idepthFixPriorMargFac;
-                        for (auto r: p->residuals)
-                            if (r->isActive())
-                                connectivityMap[(((uint64_t) r->host.lock()->frameID) << 32) +
-                                                ((uint64_t) r->target.lock()->frameID)][1]++;
-                        allPointsToMarg.push_back(p);
-                    }
-                }
-            }
+        void EnergyFunctional::marginalizePointsF() {
 
             accSSE_bot->setZero(nFrames);
             accSSE_top_A->setZero(nFrames);
 
             for (auto p : allPointsToMarg) {
+                if (p->point->status != Point::PointStatus::MARGINALIZED)
+                    continue;
+                p->priorF *= setting_idepthFixPriorMargFac;
+                for (auto r: p->residuals)
+                    if (r->isActive())
+                        connectivityMap[(((uint64_t) r->host.lock()->frameID) << 32) +
+                                        ((uint64_t) r->target.lock()->frameID)][1]++;
+
                 accSSE_top_A->addPoint<2>(p, this);
                 accSSE_bot->addPoint(p, false);
                 removePoint(p);
             }
+            allPointsToMarg.clear();
 
-            MatXX M, Msc;
-            VecX Mb, Mbsc;
-            accSSE_top_A->stitchDouble(M, Mb, this, false, false);
-            accSSE_bot->stitchDouble(Msc, Mbsc, this);
+            // stitched into the workspace, the solver does not use it until the next solveSystemF
+            const int dim = nFrames * 8 + CPARS;
+            accSSE_top_A->stitchDoubleMT(red, ws.HA, ws.bA, ws.HsA, ws.bsA, this, false, false);
+            accSSE_bot->stitchDoubleMT(red, ws.Hsc, ws.bsc, ws.HsSC, ws.bsSC, this, false);
 
             resInM += accSSE_top_A->nres[0];
 
-            MatXX H = M - Msc;
-            VecX b = Mb - Mbsc;
-
             if (setting_solverMode & SOLVER_ORTHOGONALIZE_POINTMARG) {
                 bool haveFirstFrame = false;
                 for (auto f:frames)
                     if (f->frameID == 0)
                         haveFirstFrame = true;
                 if (!haveFirstFrame)
-                    orthogonalize(&bM, &HM);
+                    orthogonalize(bM, HM);
             }
 
-            HM += setting_margWeightFac * H;
-            bM += setting_margWeightFac * b;
+            HM += setting_margWeightFac * (ws.HA.topLeftCorner(dim, dim) - ws.Hsc.topLeftCorner(dim, dim));
+            bM += setting_margWeightFac * (ws.bA.head(dim) - ws.bsc.head(dim));
 
             if (setting_solverMode & SOLVER_ORTHOGONALIZE_FULL)
-                orthogonalize(&bM, &HM);
+                orthogonalize(bM, HM);
 
             EFIndicesValid = false;
             makeIDX();
@@ -246,18 +227,23 @@ namespace ldso {
             assert(EFAdjointsValid);
             assert(EFIndicesValid);
 
-            // construct matricies
-            MatXX HL_top, HA_top, H_sc;
-            VecX bL_top, bA_top, bM_top, b_sc;
+            // construct matricies, in the workspace buffers
+            const int n = CPARS + 8 * nFrames;
+            accumulateF_MT(multiThreading);
 
-            accumulateAF_MT(HA_top, bA_top, multiThreading);
-            accumulateLF_MT(HL_top, bL_top, multiThreading);
-            accumulateSCF_MT(H_sc, b_sc, multiThreading);
+            Eigen::Block<MatXX> HL_top = ws.HL.topLeftCorner(n, n);
+            Eigen::Block<MatXX> HA_top = ws.HA.topLeftCorner(n, n);
+            Eigen::Block<MatXX> H_sc = ws.Hsc.topLeftCorner(n, n);
+            Eigen::VectorBlock<VecX> bL_top = ws.bL.head(n);
+            Eigen::VectorBlock<VecX> bA_top = ws.bA.head(n);
+            Eigen::VectorBlock<VecX> b_sc = ws.bsc.head(n);
 
-            bM_top = (bM + HM * getStitchedDeltaF());
+            Eigen::VectorBlock<VecX> bM_top = ws.bMtop.head(n);
+            bM_top.noalias() = HM * getStitchedDeltaF();
+            bM_top += bM;
 
-            MatXX HFinal_top;
-            VecX bFinal_top;
+            Eigen::Block<MatXX> HFinal_top = ws.HFinal.topLeftCorner(n, n);
+            Eigen::VectorBlock<VecX> bFinal_top = ws.bFinal.head(n);
 
             if (setting_solverMode & SOLVER_ORTHOGONALIZE_SYSTEM) {
                 // have a look if prior is there.
@@ -266,33 +252,29 @@ namespace ldso {
                     if (f->frameID == 0)
                         haveFirstFrame = true;
 
-                MatXX HT_act = HL_top + HA_top - H_sc;
-                VecX bT_act = bL_top + bA_top - b_sc;
+                // the active system is orthogonalized in place, then the prior is added
+                HFinal_top = HL_top + HA_top - H_sc;
+                bFinal_top = bL_top + bA_top - b_sc;
 
                 if (!haveFirstFrame)
-                    orthogonalize(&bT_act, &HT_act);
+                    orthogonalize(bFinal_top, HFinal_top);
 
-                HFinal_top = HT_act + HM;
-                bFinal_top = bT_act + bM_top;
-                lastHS = HFinal_top;
-                lastbS = bFinal_top;
+                HFinal_top += HM;
+                bFinal_top += bM_top;
 
-                for (int i = 0; i < 8 * nFrames + CPARS; i++)
+                for (int i = 0; i < n; i++)
                     HFinal_top(i, i) *= (1 + lambda);
             } else {
                 HFinal_top = HL_top + HM + HA_top;
                 bFinal_top = bL_top + bM_top + bA_top - b_sc;
 
-                lastHS = HFinal_top - H_sc;
-                lastbS = bFinal_top;
-
-                for (int i = 0; i < 8 * nFrames + CPARS; i++)
+                for (int i = 0; i < n; i++)
                     HFinal_top(i, i) *= (1 + lambda);
                 HFinal_top -= H_sc * (1.0f / (1 + lambda));
             }
 
             // get the result
-            VecX x;
+            Eigen::VectorBlock<VecX> x = ws.x.head(n);
             if (setting_solverMode & SOLVER_SVD) {
                 VecX SVecI = HFinal_top.diagonal().cwiseSqrt().cwiseInverse();
                 MatXX HFinalScaled = SVecI.asDiagonal() * HFinal_top * SVecI.asDiagonal();
@@ -323,29 +305,33 @@ namespace ldso {
 
             } else {
 
-                VecX SVecI = (HFinal_top.diagonal() + VecX::Constant(HFinal_top.cols(), 10)).cwiseSqrt().cwiseInverse();
-                MatXX HFinalScaled = SVecI.asDiagonal() * HFinal_top * SVecI.asDiagonal();
-
-                /*
-                x = SVecI.asDiagonal() * HFinalScaled.ldlt().solve(
-                        SVecI.asDiagonal() * bFinal_top);//  SVec.asDiagonal() * svd.matrixV() * Ub;
-                        */
-
-                x = SVecI.asDiagonal() * HFinalScaled.ldlt().solve(
-                        SVecI.asDiagonal() * bFinal_top);//  SVec.asDiagonal() * svd.matrixV() * Ub;
-
+                Eigen::VectorBlock<VecX> SVecI = ws.SVecI.head(n);
+                SVecI = (HFinal_top.diagonal() + VecX::Constant(n, 10)).cwiseSqrt().cwiseInverse();
+                Eigen::Block<MatXX> HFinalScaled = ws.HScaled.topLeftCorner(n, n);
+                HFinalScaled = SVecI.asDiagonal() * HFinal_top * SVecI.asDiagonal();
+
+                // x = SVecI * HFinalScaled^-1 * SVecI * bFinal_top, solved in place
+                // large windows go through the 8x8 frame blocks, the dense LDLT is the fallback if that fails
+                x = SVecI.asDiagonal() * bFinal_top;
+                if (setting_solverBlockMinFrames > 0 && nFrames >= setting_solverBlockMinFrames &&
+                    ws.blockCholesky.Compute(HFinalScaled, nFrames)) {
+                    ws.blockCholesky.SolveInPlace(x);
+                } else {
+                    Eigen::LDLT<MatXX> &ldlt = ws.LDLT(n);
+                    ldlt.compute(HFinalScaled);
+                    x = ldlt.solve(x);
+                }
+                x = SVecI.asDiagonal() * x;
             }
 
+            lastX = x;
             if ((setting_solverMode & SOLVER_ORTHOGONALIZE_X) ||
                 (iteration >= 2 && (setting_solverMode & SOLVER_ORTHOGONALIZE_X_LATER))) {
-                VecX xOld = x;
-                orthogonalize(&x, 0);
+                orthogonalize(lastX);
             }
 
-            lastX = x;
-
             currentLambda = lambda;
-            resubstituteF_MT(x, HCalib, multiThreading);
+            resubstituteF_MT(lastX, HCalib, multiThreading);
             currentLambda = 0;
 
         }
@@ -354,8 +340,10 @@ namespace ldso {
             assert(EFDeltaValid);
             assert(EFAdjointsValid);
             assert(EFIndicesValid);
-            VecX delta = getStitchedDeltaF();
-            return delta.dot(2 * bM + HM * delta);
+            Eigen::VectorBlock<VecX> delta = getStitchedDeltaF();
+            Eigen::VectorBlock<VecX> HMdelta = ws.HMdelta.head(delta.size());
+            HMdelta.noalias() = HM * delta;
+            return delta.dot(2 * bM + HMdelta);
         }
 
         double EnergyFunctional::calcLEnergyF_MT() {
@@ -369,12 +357,17 @@ namespace ldso {
 
             E += cDeltaF.cwiseProduct(cPriorF).dot(cDeltaF);
 
-            red->reduce(bind(&EnergyFunctional::calcLEnergyPt,
-                             this, _1, _2, _3, _4), 0, allPoints.size(), 50);
+            Vec10 stats = Vec10::Zero();
+            if (multiThreading) {
+                red->reduce(bind(&EnergyFunctional::calcLEnergyPt,
+                                 this, _1, _2, _3, _4), 0, allPoints.size(), 50);
+                stats = red->stats;
+            } else
+                calcLEnergyPt(0, allPoints.size(), &stats, 0);
 
             // E += calcLEnergyFeat(); // calc feature's energy
 
-            return E + red->stats[0];
+            return E + stats[0];
         }
 
         void EnergyFunctional::makeIDX() {
@@ -386,13 +379,13 @@ namespace ldso {
 
             for (auto f: frames) {
                 for (shared_ptr<Feature> feat: f->frame->features) {
-                    if (feat->status == Feature::FeatureStatus::VALID &&
+                    if (feat->status() == Feature::FeatureStatus::VALID &&
                         feat->point->status == Point::PointStatus::ACTIVE) {
                         shared_ptr<PointHessian> p = feat->point->mpPH;
                         allPoints.push_back(p);
                         for (auto &r : p->residuals) {
-                            r->hostIDX = r->host.lock()->idx;
-                            r->targetIDX = r->target.lock()->idx;
+                            r->hostIDX = r->hostPtr->idx;
+                            r->targetIDX = r->targetPtr->idx;
                         }
                     }
                 }
@@ -401,8 +394,7 @@ namespace ldso {
         }
 
         void EnergyFunctional::setDeltaF(shared_ptr<CalibHessian> HCalib) {
-            if (adHTdeltaF != 0) delete[] adHTdeltaF;
-            adHTdeltaF = new Mat18f[nFrames * nFrames];
+            assert(nFrames <= adCapacity);
             for (int h = 0; h < nFrames; h++)
                 for (int t = 0; t < nFrames; t++) {
                     int idx = h + t * nFrames;
@@ -418,7 +410,7 @@ namespace ldso {
                 f->delta_prior = (f->get_state() - f->getPriorZero()).head<8>();
 
                 for (auto feat: f->frame->features) {
-                    if (feat->status == Feature::FeatureStatus::VALID && feat->point &&
+                    if (feat->status() == Feature::FeatureStatus::VALID && feat->point &&
                         feat->point->status == Point::PointStatus::ACTIVE) {
                         auto p = feat->point->mpPH;
                         p->deltaF = p->idepth - p->idepth_zero;
@@ -428,13 +420,51 @@ namespace ldso {
             EFDeltaValid = true;
         }
 
-        void EnergyFunctional::setAdjointsF(shared_ptr<CalibHessian> Hcalib) {
+        void EnergyFunctional::reserveAdjoints(int n) {
+            if (n <= adCapacity)
+                return;
 
             if (adHost != 0) delete[] adHost;
             if (adTarget != 0) delete[] adTarget;
+            if (adHostF != 0) delete[] adHostF;
+            if (adTargetF != 0) delete[] adTargetF;
+            if (adHTdeltaF != 0) delete[] adHTdeltaF;
 
-            adHost = new Mat88[nFrames * nFrames];
-            adTarget = new Mat88[nFrames * nFrames];
+            adCapacity = n;
+            adHost = new Mat88[n * n];
+            adTarget = new Mat88[n * n];
+            adHostF = new Mat88f[n * n];
+            adTargetF = new Mat88f[n * n];
+            adHTdeltaF = new Mat18f[n * n];
+        }
+
+        void EnergyFunctional::resizePrior(int dim) {
+            if (dim > HMStorage.rows()) {
+                // only if the window outgrows setting_maxFrames
+                const int capacity = std::max(dim, CPARS + 8 * (setting_maxFrames + 1));
+                MatXX H = MatXX::Zero(capacity, capacity);
+                VecX b = VecX::Zero(capacity);
+                H.topLeftCorner(HM.rows(), HM.cols()) = HM;
+                b.head(bM.size()) = bM;
+                HMStorage.swap(H);
+                bMStorage.swap(b);
+            }
+            new(&HM) Eigen::Map<MatXX, 0, Eigen::OuterStride<>>(HMStorage.data(), dim, dim,
+                                                                Eigen::OuterStride<>(HMStorage.rows()));
+            new(&bM) Eigen::Map<VecX>(bMStorage.data(), dim);
+        }
+
+        void EnergyFunctional::reversePrior(int begin, int end) {
+            for (int i = begin, j = end - 1; i < j; i++, j--) {
+                HM.row(i).swap(HM.row(j));
+                HM.col(i).swap(HM.col(j));
+                std::swap(bM[i], bM[j]);
+            }
+        }
+
+        void EnergyFunctional::setAdjointsF(shared_ptr<CalibHessian> Hcalib) {
+
+            reserveAdjoints(nFrames);
 
             for (int h = 0; h < nFrames; h++)
                 for (int t = 0; t < nFrames; t++) {
@@ -472,12 +502,6 @@ namespace ldso {
 
             cPrior = VecC::Constant(setting_initialCalibHessian);
 
-
-            if (adHostF != 0) delete[] adHostF;
-            if (adTargetF != 0) delete[] adTargetF;
-            adHostF = new Mat88f[nFrames * nFrames];
-            adTargetF = new Mat88f[nFrames * nFrames];
-
             for (int h = 0; h < nFrames; h++)
                 for (int t = 0; t < nFrames; t++) {
                     adHostF[h + t * nFrames] = adHost[h + t * nFrames].cast<float>();
@@ -491,10 +515,11 @@ namespace ldso {
         void EnergyFunctional::resubstituteF_MT(const VecX &x, shared_ptr<CalibHessian> HCalib, bool MT) {
             assert(x.size() == CPARS + nFrames * 8);
 
-            VecXf xF = x.cast<float>();
+            Eigen::VectorBlock<VecXf> xF = ws.xF.head(x.size());
+            xF = x.cast<float>();
             HCalib->step = -x.head<CPARS>();
 
-            Mat18f *xAd = new Mat18f[nFrames * nFrames];
+            Mat18f *xAd = ws.xAd.data();
             VecCf cstep = xF.head<CPARS>();
             for (auto h : frames) {
                 h->step.head<8>() = -x.segment<8>(CPARS + 8 * h->idx);
@@ -511,17 +536,15 @@ namespace ldso {
                                  this, cstep, xAd, _1, _2, _3, _4), 0, allPoints.size(), 50);
             else
                 resubstituteFPt(cstep, xAd, 0, allPoints.size(), 0, 0);
-
-            delete[] xAd;
         }
 
         void EnergyFunctional::resubstituteFPt(const VecCf &xc, Mat18f *xAd, int min, int max, Vec10 *stats, int tid) {
 
             for (int k = min; k < max; k++) {
-                auto p = allPoints[k];
+                const shared_ptr<PointHessian> &p = allPoints[k];
 
                 int ngoodres = 0;
-                for (auto r : p->residuals)
+                for (auto &r : p->residuals)
                     if (r->isActive())
                         ngoodres++;
 
@@ -533,7 +556,7 @@ namespace ldso {
                 float b = p->bdSumF;
                 b -= xc.dot(p->Hcd_accAF + p->Hcd_accLF);
 
-                for (auto r : p->residuals) {
+                for (auto &r : p->residuals) {
                     if (!r->isActive()) continue;
                     b -= xAd[r->hostIDX * nFrames + r->targetIDX] * r->JpJdF;
                 }
@@ -546,81 +569,51 @@ namespace ldso {
             }
         }
 
-        // accumulates & shifts L.
-        void EnergyFunctional::accumulateAF_MT(MatXX &H, VecX &b, bool MT) {
+        void EnergyFunctional::accumulateF_MT(bool MT) {
             if (MT) {
-                red->reduce(bind(&AccumulatedTopHessianSSE::setZero, accSSE_top_A, nFrames, _1, _2, _3, _4), 0,
-                            0, 0);
-                red->reduce(bind(&AccumulatedTopHessianSSE::addPointsInternal<0>,
-                                 accSSE_top_A, &allPoints, this, _1, _2, _3, _4), 0, allPoints.size(), 50);
-                accSSE_top_A->stitchDoubleMT(red, H, b, this, false, true);
-                resInA = accSSE_top_A->nres[0];
+                red->reduce(bind(&EnergyFunctional::setZeroAccumulatorsF, this, _1, _2, _3, _4), 0, 0, 0);
+                red->reduce(bind(&EnergyFunctional::accumulatePointsF, this, _1, _2, _3, _4),
+                            0, allPoints.size(), 50);
+
+                // stitch the three of them in a single reduction over the frame pairs
+                accSSE_top_A->clearStitchBuffersMT(ws.HsA, ws.bsA);
+                accSSE_top_L->clearStitchBuffersMT(ws.HsL, ws.bsL);
+                accSSE_bot->clearStitchBuffersMT(ws.HsSC, ws.bsSC);
+
+                red->reduce([this](int min, int max, Vec10 *stats, int tid) {
+                    accSSE_top_A->stitchDoubleInternal(ws.HsA.data(), ws.bsA.data(), this, false, min, max, stats, tid);
+                    accSSE_top_L->stitchDoubleInternal(ws.HsL.data(), ws.bsL.data(), this, true, min, max, stats, tid);
+                    accSSE_bot->stitchDoubleInternal(ws.HsSC.data(), ws.bsSC.data(), this, min, max, stats, tid);
+                }, 0, nFrames * nFrames, 0);
+
+                accSSE_top_A->finishStitchMT(ws.HsA, ws.bsA, ws.HA, ws.bA);
+                accSSE_top_L->finishStitchMT(ws.HsL, ws.bsL, ws.HL, ws.bL);
+                accSSE_bot->finishStitchMT(ws.HsSC, ws.bsSC, ws.Hsc, ws.bsc);
             } else {
-                accSSE_top_A->setZero(nFrames);
-                int cntPointAdded = 0;
-                for (auto f : frames) {
-                    for (shared_ptr<Feature> &feat: f->frame->features) {
-                        if (feat->status == Feature::FeatureStatus::VALID && feat->point &&
-                            feat->point->status == Point::PointStatus::ACTIVE) {
-                            auto p = feat->point->mpPH;
-                            accSSE_top_A->addPoint<0>(p, this);
-                            cntPointAdded++;
-                        }
-                    }
-                }
-                accSSE_top_A->stitchDoubleMT(red, H, b, this, false, false);
-                resInA = accSSE_top_A->nres[0];
+                setZeroAccumulatorsF(0, 0, 0, 0);
+                accumulatePointsF(0, allPoints.size(), 0, 0);
+
+                accSSE_top_A->stitchDoubleMT(red, ws.HA, ws.bA, ws.HsA, ws.bsA, this, false, false);
+                accSSE_top_L->stitchDoubleMT(red, ws.HL, ws.bL, ws.HsL, ws.bsL, this, true, false);
+                accSSE_bot->stitchDoubleMT(red, ws.Hsc, ws.bsc, ws.HsSC, ws.bsSC, this, false);
             }
+            resInA = accSSE_top_A->nres[0];
+            resInL = accSSE_top_L->nres[0];
         }
 
-        // accumulates & shifts L.
-        void EnergyFunctional::accumulateLF_MT(MatXX &H, VecX &b, bool MT) {
-            if (MT) {
-                red->reduce(bind(&AccumulatedTopHessianSSE::setZero, accSSE_top_L, nFrames, _1, _2, _3, _4), 0,
-                            0, 0);
-                red->reduce(bind(&AccumulatedTopHessianSSE::addPointsInternal<1>,
-                                 accSSE_top_L, &allPoints, this, _1, _2, _3, _4), 0, allPoints.size(), 50);
-                accSSE_top_L->stitchDoubleMT(red, H, b, this, true, true);
-                resInL = accSSE_top_L->nres[0];
-            } else {
-                accSSE_top_L->setZero(nFrames);
-                int cntPointAdded = 0;
-                for (auto f : frames) {
-                    for (auto feat: f->frame->features) {
-                        if (feat->status == Feature::FeatureStatus::VALID &&
-                            feat->point->status == Point::PointStatus::ACTIVE) {
-                            auto p = feat->point->mpPH;
-                            accSSE_top_L->addPoint<1>(p, this);
-                            cntPointAdded++;
-                        }
-                    }
-                }
-                accSSE_top_L->stitchDoubleMT(red, H, b, this, true, false);
-                resInL = accSSE_top_L->nres[0];
-            }
+        void EnergyFunctional::setZeroAccumulatorsF(int min, int max, Vec10 *stats, int tid) {
+            accSSE_top_A->setZero(nFrames, min, max, stats, tid);
+            accSSE_top_L->setZero(nFrames, min, max, stats, tid);
+            accSSE_bot->setZero(nFrames, min, max, stats, tid);
         }
 
-        void EnergyFunctional::accumulateSCF_MT(MatXX &H, VecX &b, bool MT) {
-            if (MT) {
-                red->reduce(bind(&AccumulatedSCHessianSSE::setZero, accSSE_bot, nFrames, _1, _2, _3, _4), 0, 0,
-                            0);
-                red->reduce(bind(&AccumulatedSCHessianSSE::addPointsInternal,
-                                 accSSE_bot, &allPoints, true, _1, _2, _3, _4), 0, allPoints.size(), 50);
-                accSSE_bot->stitchDoubleMT(red, H, b, this, true);
-            } else {
-                accSSE_bot->setZero(nFrames);
-                int cntPointAdded = 0;
-                for (auto f : frames) {
-                    for (auto feat: f->frame->features) {
-                        if (feat->status == Feature::FeatureStatus::VALID &&
-                            feat->point->status == Point::PointStatus::ACTIVE) {
-                            auto p = feat->point->mpPH;
-                            accSSE_bot->addPoint(p, true);
-                            cntPointAdded++;
-                        }
-                    }
-                }
-                accSSE_bot->stitchDoubleMT(red, H, b, this, false);
+        void EnergyFunctional::accumulatePointsF(int min, int max, Vec10 *stats, int tid) {
+            for (int i = min; i < max; i++) {
+                const shared_ptr<PointHessian> &p = allPoints[i];
+                // the Schur complement needs the active and linearized sums of this point, computed just before
+                accSSE_top_A->addPoint<0>(p, this, tid);
+                accSSE_top_L->addPoint<1>(p, this, tid);
+                accSSE_bot->addPoint(p, true, tid);
             }
         }
 
@@ -631,14 +624,14 @@ namespace ldso {
             VecCf dc = cDeltaF;
 
             for (int i = min; i < max; i++) {
-                auto p = allPoints[i];
+                const shared_ptr<PointHessian> &p = allPoints[i];
                 float dd = p->deltaF;
 
-                for (auto r : p->residuals) {
+                for (auto &r : p->residuals) {
                     if (!r->isLinearized || !r->isActive()) continue;
 
                     Mat18f dp = adHTdeltaF[r->hostIDX + nFrames * r->targetIDX];
-                    shared_ptr<RawResidualJacobian> rJ = r->J;
+                    const RawResidualJacobian *rJ = &r->J;
 
                     // compute Jp*delta
                     float Jp_delta_x_1 = rJ->Jpdxi[0].dot(dp.head<6>())
@@ -682,7 +675,7 @@ namespace ldso {
         }
 
 
-        void EnergyFunctional::orthogonalize(VecX *b, MatXX *H) {
+        void EnergyFunctional::makeNullspaceProjector() {
 
             std::vector<VecX> ns;
             ns.insert(ns.end(), lastNullspaces_pose.begin(), lastNullspaces_pose.end());
@@ -709,11 +702,35 @@ namespace ldso {
             }
 
             MatXX Npi = svdNN.matrixU() * SNN.asDiagonal() * svdNN.matrixV().transpose();    // [dim] x 9.
-            MatXX NNpiT = N * Npi.transpose();    // [dim] x [dim].
-            MatXX NNpiTS = 0.5 * (NNpiT + NNpiT.transpose());    // = N * (N' * N)^-1 * N'.
 
-            if (b != 0) *b -= NNpiTS * *b;
-            if (H != 0) *H -= NNpiTS * *H * NNpiTS;
+            // 0.5 * (N * Npi' + Npi * N') = N * (N' * N)^-1 * N', kept as [dim] x 18 factors
+            const int k = 2 * N.cols();
+            ws.nsU.resize(N.rows(), k);
+            ws.nsW.resize(N.rows(), k);
+            ws.nsU << N, Npi;
+            ws.nsW << 0.5 * Npi, 0.5 * N;
+            ws.nsWb.resize(k);
+            ws.nsUWb.resize(N.rows());
+            ws.nsWH.resize(k, N.rows());
+            ws.nsWHU.resize(k, k);
+            ws.nsUWHU.resize(N.rows(), k);
+        }
+
+        void EnergyFunctional::orthogonalize(Eigen::Ref<VecX> b) {
+            assert(ws.nsU.rows() == b.size());
+            ws.nsWb.noalias() = ws.nsW.transpose() * b;
+            ws.nsUWb.noalias() = ws.nsU * ws.nsWb;
+            b -= ws.nsUWb;
+        }
+
+        void EnergyFunctional::orthogonalize(Eigen::Ref<VecX> b, Eigen::Ref<MatXX> H) {
+            orthogonalize(b);
+
+            // H -= U * W' * H * U * W', without forming the [dim] x [dim] projection
+            ws.nsWH.noalias() = ws.nsW.transpose() * H;
+            ws.nsWHU.noalias() = ws.nsWH * ws.nsU;
+            ws.nsUWHU.noalias() = ws.nsU * ws.nsWHU;
+            H.noalias() -= ws.nsUWHU * ws.nsW.transpose();
         }
     }
 }
\ No newline at end of file
@@ -7,8 +7,8 @@ namespace ldso {
     namespace internal {
 
         PointHessian::PointHessian(shared_ptr<ImmaturePoint> rawPoint) {
-            u = rawPoint->feature->uv[0];
-            v = rawPoint->feature->uv[1];
+            u = rawPoint->feature->uv()[0];
+            v = rawPoint->feature->uv()[1];
             my_type = rawPoint->my_type;
 
             this->idepth = SCALE_IDEPTH_INVERSE * (rawPoint->idepth_max + rawPoint->idepth_min) * 0.5;
@@ -20,9 +20,9 @@ namespace ldso {
                 return state_energy;
             }
 
-            shared_ptr<FrameHessian> f = host.lock();
-            shared_ptr<FrameHessian> ftarget = target.lock();
-            shared_ptr<PointHessian> fPoint = point.lock();
+            FrameHessian *f = hostPtr;
+            FrameHessian *ftarget = targetPtr;
+            PointHessian *fPoint = pointPtr;
             FrameFramePrecalc *precalc = &(f->targetPrecalc[ftarget->idx]);
 
             float energyLeft = 0;
@@ -53,7 +53,7 @@ namespace ldso {
                 Vec3f KliP;
 
                 // 重投影
-                shared_ptr<PointHessian> p = point.lock();
+                PointHessian *p = pointPtr;
                 if (!projectPoint(p->u, p->v, p->idepth_zero_scaled, 0, 0, HCalib,
                                   PRE_RTll_0, PRE_tTll_0, drescale, u, v, Ku, Kv, KliP, new_idepth)) {
                     state_NewState = ResState::OOB;
@@ -106,14 +106,14 @@ namespace ldso {
 
 
             {
-                J->Jpdxi[0] = d_xi_x;
-                J->Jpdxi[1] = d_xi_y;
+                J.Jpdxi[0] = d_xi_x;
+                J.Jpdxi[1] = d_xi_y;
 
-                J->Jpdc[0] = d_C_x;
-                J->Jpdc[1] = d_C_y;
+                J.Jpdc[0] = d_C_x;
+                J.Jpdc[1] = d_C_y;
 
-                J->Jpdd[0] = d_d_x;
-                J->Jpdd[1] = d_d_y;
+                J.Jpdd[0] = d_d_x;
+                J.Jpdd[1] = d_d_y;
 
             }
 
@@ -125,7 +125,7 @@ namespace ldso {
 
             for (int idx = 0; idx < patternNum; idx++) {
                 float Ku, Kv;
-                shared_ptr<PointHessian> p = point.lock();
+                PointHessian *p = pointPtr;
                 if (!projectPoint(p->u + patternP[idx][0], p->v + patternP[idx][1], p->idepth_scaled,
                                   PRE_KRKiTll, PRE_KtTll, Ku, Kv)) {
                     state_NewState = ResState::OOB;
@@ -159,12 +159,12 @@ namespace ldso {
                     hitColor[1] *= hw;
                     hitColor[2] *= hw;
 
-                    J->resF[idx] = residual * hw;
+                    J.resF[idx] = residual * hw;
 
-                    J->JIdx[0][idx] = hitColor[1];
-                    J->JIdx[1][idx] = hitColor[2];
-                    J->JabF[0][idx] = drdA * hw;
-                    J->JabF[1][idx] = hw;
+                    J.JIdx[0][idx] = hitColor[1];
+                    J.JIdx[1][idx] = hitColor[2];
+                    J.JabF[0][idx] = drdA * hw;
+                    J.JabF[1][idx] = hw;
 
                     JIdxJIdx_00 += hitColor[1] * hitColor[1];
                     JIdxJIdx_11 += hitColor[2] * hitColor[2];
@@ -181,24 +181,24 @@ namespace ldso {
 
                     wJI2_sum += hw * hw * (hitColor[1] * hitColor[1] + hitColor[2] * hitColor[2]);
 
-                    if (setting_affineOptModeA < 0) J->JabF[0][idx] = 0;
-                    if (setting_affineOptModeB < 0) J->JabF[1][idx] = 0;
+                    if (setting_affineOptModeA < 0) J.JabF[0][idx] = 0;
+                    if (setting_affineOptModeB < 0) J.JabF[1][idx] = 0;
 
                 }
             }
 
-            J->JIdx2(0, 0) = JIdxJIdx_00;
-            J->JIdx2(0, 1) = JIdxJIdx_10;
-            J->JIdx2(1, 0) = JIdxJIdx_10;
-            J->JIdx2(1, 1) = JIdxJIdx_11;
-            J->JabJIdx(0, 0) = JabJIdx_00;
-            J->JabJIdx(0, 1) = JabJIdx_01;
-            J->JabJIdx(1, 0) = JabJIdx_10;
-            J->JabJIdx(1, 1) = JabJIdx_11;
-            J->Jab2(0, 0) = JabJab_00;
-            J->Jab2(0, 1) = JabJab_01;
-            J->Jab2(1, 0) = JabJab_01;
-            J->Jab2(1, 1) = JabJab_11;
+            J.JIdx2(0, 0) = JIdxJIdx_00;
+            J.JIdx2(0, 1) = JIdxJIdx_10;
+            J.JIdx2(1, 0) = JIdxJIdx_10;
+            J.JIdx2(1, 1) = JIdxJIdx_11;
+            J.JabJIdx(0, 0) = JabJIdx_00;
+            J.JabJIdx(0, 1) = JabJIdx_01;
+            J.JabJIdx(1, 0) = JabJIdx_10;
+            J.JabJIdx(1, 1) = JabJIdx_11;
+            J.Jab2(0, 0) = JabJab_00;
+            J.Jab2(0, 1) = JabJab_01;
+            J.Jab2(1, 0) = JabJab_01;
+            J.Jab2(1, 1) = JabJab_11;
 
             state_NewEnergyWithOutlier = energyLeft;
 
@@ -218,23 +218,23 @@ namespace ldso {
             Vec8f dp = ef->adHTdeltaF[hostIDX + ef->nFrames * targetIDX];
 
             // compute Jp*delta
-            __m128 Jp_delta_x = _mm_set1_ps(J->Jpdxi[0].dot(dp.head<6>())
-                                            + J->Jpdc[0].dot(ef->cDeltaF)
-                                            + J->Jpdd[0] * point.lock()->deltaF);
-            __m128 Jp_delta_y = _mm_set1_ps(J->Jpdxi[1].dot(dp.head<6>())
-                                            + J->Jpdc[1].dot(ef->cDeltaF)
-                                            + J->Jpdd[1] * point.lock()->deltaF);
+            __m128 Jp_delta_x = _mm_set1_ps(J.Jpdxi[0].dot(dp.head<6>())
+                                            + J.Jpdc[0].dot(ef->cDeltaF)
+                                            + J.Jpdd[0] * pointPtr->deltaF);
+            __m128 Jp_delta_y = _mm_set1_ps(J.Jpdxi[1].dot(dp.head<6>())
+                                            + J.Jpdc[1].dot(ef->cDeltaF)
+                                            + J.Jpdd[1] * pointPtr->deltaF);
 
             __m128 delta_a = _mm_set1_ps((float) (dp[6]));
             __m128 delta_b = _mm_set1_ps((float) (dp[7]));
 
             for (int i = 0; i < patternNum; i += 4) {
                 // PATTERN: rtz = resF - [JI*Jp Ja]*delta.
-                __m128 rtz = _mm_load_ps(((float *) &J->resF) + i);
-                rtz = _mm_sub_ps(rtz, _mm_mul_ps(_mm_load_ps(((float *) (J->JIdx)) + i), Jp_delta_x));
-                rtz = _mm_sub_ps(rtz, _mm_mul_ps(_mm_load_ps(((float *) (J->JIdx + 1)) + i), Jp_delta_y));
-                rtz = _mm_sub_ps(rtz, _mm_mul_ps(_mm_load_ps(((float *) (J->JabF)) + i), delta_a));
-                rtz = _mm_sub_ps(rtz, _mm_mul_ps(_mm_load_ps(((float *) (J->JabF + 1)) + i), delta_b));
+                __m128 rtz = _mm_load_ps(((float *) &J.resF) + i);
+                rtz = _mm_sub_ps(rtz, _mm_mul_ps(_mm_load_ps(((float *) (J.JIdx)) + i), Jp_delta_x));
+                rtz = _mm_sub_ps(rtz, _mm_mul_ps(_mm_load_ps(((float *) (J.JIdx + 1)) + i), Jp_delta_y));
+                rtz = _mm_sub_ps(rtz, _mm_mul_ps(_mm_load_ps(((float *) (J.JabF)) + i), delta_a));
+                rtz = _mm_sub_ps(rtz, _mm_mul_ps(_mm_load_ps(((float *) (J.JabF + 1)) + i), delta_b));
                 _mm_store_ps(((float *) &res_toZeroF) + i, rtz);
             }
 
@@ -333,14 +333,14 @@ namespace ldso {
             d_xi_y[5] = u * HCalib->fyl();
 
 
-            J->Jpdxi[0] = d_xi_x;
-            J->Jpdxi[1] = d_xi_y;
+            J.Jpdxi[0] = d_xi_x;
+            J.Jpdxi[1] = d_xi_y;
 
-            J->Jpdc[0] = d_C_x;
-            J->Jpdc[1] = d_C_y;
+            J.Jpdc[0] = d_C_x;
+            J.Jpdc[1] = d_C_y;
 
-            J->Jpdd[0] = d_d_x;
-            J->Jpdd[1] = d_d_y;
+            J.Jpdd[0] = d_d_x;
+            J.Jpdd[1] = d_d_y;
 
             Vec2f residual = Vec2f(Ku, Kv) - obsPixel;
             // LOG(INFO) << "proj: " << Ku << ", " << Kv << ", obs: " << obsPixel[0] << ", " << obsPixel[1] << ", res="
@@ -354,7 +354,7 @@ namespace ldso {
 
             if (hw < 1) hw = sqrtf(hw);
             hw = hw * w;
-            J->resF = hw * residual;
+            J.resF = hw * residual;
 
             state_NewEnergyWithOutlier = energyLeft;
 
@@ -375,15 +375,15 @@ namespace ldso {
             Vec8f dp = ef->adHTdeltaF[hostIDX + ef->nFrames * targetIDX];
 
             // compute Jp*delta
-            float Jp_delta_x = (J->Jpdxi[0].dot(dp.head<6>())
-                                + J->Jpdc[0].dot(ef->cDeltaF)
-                                + J->Jpdd[0] * point.lock()->deltaF);
-            float Jp_delta_y = (J->Jpdxi[1].dot(dp.head<6>())
-                                + J->Jpdc[1].dot(ef->cDeltaF)
-                                + J->Jpdd[1] * point.lock()->deltaF);
-
-            res_toZeroF[0] = Jp_delta_x + J->resF[0];
-            res_toZeroF[1] = Jp_delta_y + J->resF[1];
+            float Jp_delta_x = (J.Jpdxi[0].dot(dp.head<6>())
+                                + J.Jpdc[0].dot(ef->cDeltaF)
+                                + J.Jpdd[0] * pointPtr->deltaF);
+            float Jp_delta_y = (J.Jpdxi[1].dot(dp.head<6>())
+                                + J.Jpdc[1].dot(ef->cDeltaF)
+                                + J.Jpdd[1] * pointPtr->deltaF);
+
+            res_toZeroF[0] = Jp_delta_x + J.resF[0];
+            res_toZeroF[1] = Jp_delta_y + J.resF[1];
             isLinearized = true;
         }
          */
@@ -0,0 +1,190 @@
+#include "internal/ThreadPool.h"
+#include "internal/GlobalCalib.h"
+#include "Settings.h"
+
+#include <glog/logging.h>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace ldso {
+
+    namespace internal {
+
+        // which pool and slot the current thread belongs to
+        static thread_local const ThreadPool *tlsPool = nullptr;
+        static thread_local int tlsWorker = -1;
+
+        // pin a pthread to core, wrapped around the number of hardware threads
+        static bool pinNativeThread(thread::native_handle_type handle, int core) {
+            if (core < 0)
+                return false;
+#ifdef __linux__
+            int numCores = int(thread::hardware_concurrency());
+            if (numCores <= 0)
+                return false;
+            cpu_set_t cpuset;
+            CPU_ZERO(&cpuset);
+            CPU_SET(core % numCores, &cpuset);
+            return pthread_setaffinity_np(handle, sizeof(cpu_set_t), &cpuset) == 0;
+#else
+            return false;
+#endif
+        }
+
+        ThreadPool::ThreadPool(int numThreads, int firstCore) {
+            if (numThreads < 1)
+                numThreads = 1;
+            for (int i = 0; i < numThreads; i++)
+                queues.emplace_back(new WorkerQueue);
+            for (int i = 0; i < numThreads; i++) {
+                workers.emplace_back(&ThreadPool::WorkerLoop, this, i);
+                if (firstCore >= 0)
+                    PinThread(workers.back(), firstCore + i);
+            }
+        }
+
+        ThreadPool::~ThreadPool() {
+            {
+                unique_lock<mutex> lock(sleepMutex);
+                running = false;
+            }
+            wakeSignal.notify_all();
+            for (auto &th: workers)
+                th.join();
+            LOG(INFO) << "destroyed ThreadPool" << endl;
+        }
+
+        shared_ptr<ThreadPool> ThreadPool::Global() {
+            static shared_ptr<ThreadPool> pool(new ThreadPool(ResolveNumThreads(setting_numThreads)));
+            return pool;
+        }
+
+        int ThreadPool::ResolveNumThreads(int numThreads) {
+            if (numThreads > 0)
+                return numThreads;
+            int hw = int(thread::hardware_concurrency());
+            return hw > 0 ? hw : 1;
+        }
+
+        bool ThreadPool::PinThread(thread &th, int core) {
+            return pinNativeThread(th.native_handle(), core);
+        }
+
+        bool ThreadPool::PinCurrentThread(int core) {
+#ifdef __linux__
+            return pinNativeThread(pthread_self(), core);
+#else
+            return false;
+#endif
+        }
+
+        int ThreadPool::CurrentWorker() const {
+            return tlsPool == this ? tlsWorker : -1;
+        }
+
+        void ThreadPool::Submit(function<void()> task) {
+            // the pool may work for several systems, run the task with the calibration of the submitting thread
+            Task t;
+            t.run = move(task);
+            t.calib = CalibContext::Current();
+
+            int idx = CurrentWorker();
+            if (idx < 0)
+                idx = int(nextQueue.fetch_add(1, memory_order_relaxed) % queues.size());
+
+            {
+                unique_lock<mutex> lock(queues[idx]->queueMutex);
+                queues[idx]->PushBack(t);
+            }
+            numQueued.fetch_add(1);
+
+            // take the sleep mutex so a worker can't miss the wake up between checking numQueued and waiting
+            {
+                unique_lock<mutex> lock(sleepMutex);
+            }
+            wakeSignal.notify_one();
+        }
+
+        void ThreadPool::WorkerQueue::PushBack(Task &task) {
+            if (count == ring.size()) {
+                // unroll into a buffer twice as large
+                vector<Task> larger(2 * ring.size());
+                for (size_t i = 0; i < count; i++)
+                    larger[i] = move(ring[(head + i) % ring.size()]);
+                ring.swap(larger);
+                head = 0;
+            }
+            ring[(head + count) % ring.size()] = move(task);
+            count++;
+        }
+
+        bool ThreadPool::WorkerQueue::PopBack(Task &task) {
+            if (count == 0)
+                return false;
+            count--;
+            task = move(ring[(head + count) % ring.size()]);
+            return true;
+        }
+
+        bool ThreadPool::WorkerQueue::PopFront(Task &task) {
+            if (count == 0)
+                return false;
+            task = move(ring[head]);
+            head = (head + 1) % ring.size();
+            count--;
+            return true;
+        }
+
+        bool ThreadPool::TryGetTask(int idx, Task &task) {
+            const int n = int(queues.size());
+            {
+                WorkerQueue &own = *queues[idx];
+                unique_lock<mutex> lock(own.queueMutex);
+                if (own.PopBack(task)) {
+                    numQueued.fetch_sub(1);
+                    return true;
+                }
+            }
+            for (int k = 1; k < n; k++) {
+                WorkerQueue &victim = *queues[(idx + k) % n];
+                unique_lock<mutex> lock(victim.queueMutex, try_to_lock);
+                if (!lock.owns_lock() || !victim.PopFront(task))
+                    continue;
+                numQueued.fetch_sub(1);
+                return true;
+            }
+            return false;
+        }
+
+        void ThreadPool::WorkerLoop(int idx) {
+            tlsPool = this;
+            tlsWorker = idx;
+
+            Task task;
+            while (true) {
+                if (TryGetTask(idx, task)) {
+                    if (task.calib)
+                        bindCalib(task.calib);
+                    task.run();
+                    task.run = nullptr;
+                    task.calib = nullptr;
+                    continue;
+                }
+
+                // a victim may have been skipped because its lock was busy, so only sleep if nothing is queued
+                if (numQueued.load() > 0) {
+                    this_thread::yield();
+                    continue;
+                }
+
+                unique_lock<mutex> lock(sleepMutex);
+                wakeSignal.wait(lock, [this] { return !running || numQueued.load() > 0; });
+                if (!running && numQueued.load() == 0)
+                    break;
+            }
+        }
+    }
+}
@@ -0,0 +1,153 @@
+#pragma once
+#ifndef LDSO_TEST_RANDOM_WINDOW_H_
+#define LDSO_TEST_RANDOM_WINDOW_H_
+
+#include "internal/OptimizationBackend/EnergyFunctional.h"
+#include "internal/IndexThreadReduce.h"
+#include "internal/Residuals.h"
+#include "internal/CalibHessian.h"
+#include "Feature.h"
+#include "Point.h"
+#include "Frame.h"
+
+#include <random>
+
+namespace ldso {
+    namespace test {
+
+        using namespace internal;
+
+        /**
+         * A synthetic optimization window for the backend tests: random poses, points and linearized residuals
+         * inserted into an EnergyFunctional, without any images. The numbers are meaningless, the structure
+         * (hosts, targets, active / linearized residuals, depth priors) is the one FullSystem builds.
+         */
+        struct RandomWindow {
+
+            /**
+             * @param nThreads threads of the reduction pool
+             * @param nFrames keyframes in the window
+             * @param nPoints points, each observed by about two thirds of the other frames
+             * @param seed random seed, equal seeds give equal windows
+             */
+            RandomWindow(int nThreads, int nFrames, int nPoints, unsigned seed = 5) :
+                    pool(new ThreadPool(nThreads)), red(pool), rng(seed) {
+
+                ef = shared_ptr<EnergyFunctional>(new EnergyFunctional(red.NumSlots()));
+                ef->red = &red;
+                shared_ptr<Camera> cam(new Camera(400, 400, 320, 240));
+                Hcalib = shared_ptr<CalibHessian>(new CalibHessian(cam));
+
+                for (int f = 0; f < nFrames; f++) {
+                    shared_ptr<Frame> fr(new Frame());
+                    fr->id = f + 1;
+                    fr->kfId = f;
+                    shared_ptr<FrameHessian> fh(new FrameHessian(fr));
+                    fh->frameID = f;
+                    Vec6 t;
+                    for (int i = 0; i < 6; i++) t[i] = 0.3 * U();
+                    Vec10 state = Vec10::Zero();
+                    state[6] = 0.1 * U();
+                    state[7] = 0.1 * U();
+                    fh->setEvalPT(SE3::exp(t), state);
+                    for (int i = 0; i < 8; i++) state[i] += 1e-3 * U();
+                    fh->setState(state);
+                    frames.push_back(fh);
+                    ef->insertFrame(fh, Hcalib);
+                }
+                Hcalib->value_minus_value_zero = VecC::Constant(1e-3);
+
+                for (int p = 0; p < nPoints; p++) {
+                    int hostIdx = rng() % nFrames;
+                    shared_ptr<FrameHessian> host = frames[hostIdx];
+                    shared_ptr<Feature> feat(new Feature(100 * U(), 100 * U(), host->frame));
+                    feat->status() = Feature::FeatureStatus::VALID;
+                    shared_ptr<Point> pt(new Point());
+                    pt->status = Point::PointStatus::ACTIVE;
+                    feat->point = pt;
+                    shared_ptr<PointHessian> ph(new PointHessian());
+                    ph->point = pt;
+                    pt->mpPH = ph;
+                    ph->idepth = 1 + 0.1 * U();
+                    ph->idepth_zero = ph->idepth + 0.01 * U();
+                    ph->hasDepthPrior = p % 5 == 0;
+                    ph->takeData();
+                    host->frame->features.push_back(feat);
+                    points.push_back(ph);
+
+                    for (int t = 0; t < nFrames; t++) {
+                        if (t == hostIdx || rng() % 3 == 0) continue;
+                        shared_ptr<PointFrameResidual> r(new PointFrameResidual(ph, host, frames[t]));
+                        RawResidualJacobian &J = r->J;
+                        J.JIdx2.setZero();
+                        J.JabJIdx.setZero();
+                        J.Jab2.setZero();
+                        for (int i = 0; i < patternNum; i++) {
+                            J.resF[i] = U();
+                            J.JIdx[0][i] = 10 * U();
+                            J.JIdx[1][i] = 10 * U();
+                            J.JabF[0][i] = U();
+                            J.JabF[1][i] = U();
+                            r->res_toZeroF[i] = U();
+                            Vec2f a(J.JIdx[0][i], J.JIdx[1][i]), b(J.JabF[0][i], J.JabF[1][i]);
+                            J.JIdx2 += a * a.transpose();
+                            J.JabJIdx += b * a.transpose();
+                            J.Jab2 += b * b.transpose();
+                        }
+                        for (int i = 0; i < 6; i++) {
+                            J.Jpdxi[0][i] = U();
+                            J.Jpdxi[1][i] = U();
+                        }
+                        for (int i = 0; i < CPARS; i++) {
+                            J.Jpdc[0][i] = U();
+                            J.Jpdc[1][i] = U();
+                        }
+                        J.Jpdd[0] = U();
+                        J.Jpdd[1] = U();
+                        r->isActiveAndIsGoodNEW = rng() % 10 != 0;
+                        r->isLinearized = rng() % 4 == 0;
+                        ph->residuals.push_back(r);
+                        ef->insertResidual(r);
+                    }
+                }
+
+                ef->setAdjointsF(Hcalib);
+                ef->setDeltaF(Hcalib);
+                ef->makeIDX();
+            }
+
+            /**
+             * set random (not orthogonal) gauge directions as the 7 nullspaces and build their projector
+             */
+            void SetRandomNullspaces(unsigned seed = 11) {
+                std::mt19937 g(seed);
+                std::normal_distribution<double> N;
+                const int dim = CPARS + 8 * int(frames.size());
+                ef->lastNullspaces_pose.clear();
+                ef->lastNullspaces_scale.clear();
+                for (int i = 0; i < 7; i++) {
+                    VecX v(dim);
+                    for (int k = 0; k < dim; k++) v[k] = N(g);
+                    if (i < 6) ef->lastNullspaces_pose.push_back(v);
+                    else ef->lastNullspaces_scale.push_back(v);
+                }
+                ef->makeNullspaceProjector();
+            }
+
+            /// uniform in [-1, 1]
+            double U() { return uniform(rng); }
+
+            shared_ptr<ThreadPool> pool;
+            IndexThreadReduce<Vec10> red;
+            shared_ptr<EnergyFunctional> ef;
+            shared_ptr<CalibHessian> Hcalib;
+            vector<shared_ptr<FrameHessian>> frames;
+            vector<shared_ptr<PointHessian>> points;
+
+            std::mt19937 rng;
+            std::uniform_real_distribution<double> uniform{-1, 1};
+        };
+    }
+}
+
+#endif // LDSO_TEST_RANDOM_WINDOW_H_
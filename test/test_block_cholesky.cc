@@ -0,0 +1,89 @@
+/**
+ * BlockCholesky against the dense LDLT it replaces for large windows: the solutions of random positive definite
+ * systems with the frame block layout of the EnergyFunctional must agree, on dense, banded and disconnected block
+ * patterns, and a full solver step on a synthetic window must not depend on the solver.
+ */
+
+#include "internal/OptimizationBackend/BlockCholesky.h"
+#include "RandomWindow.h"
+
+#include <Eigen/Cholesky>
+
+#include <cstdio>
+#include <random>
+
+using namespace ldso;
+using namespace ldso::internal;
+using namespace ldso::test;
+
+/**
+ * J'J + I of a random jacobian whose rows observe frames at most span apart
+ * @param span frame distance of the coupled blocks, 0: the frames only couple through the calibration
+ */
+MatXX RandomSystem(std::mt19937 &rng, int nFrames, int span) {
+    std::normal_distribution<double> N;
+    const int n = CPARS + 8 * nFrames;
+    MatXX J = MatXX::Zero(40 * nFrames, n);
+    for (int r = 0; r < J.rows(); r++) {
+        int host = rng() % nFrames;
+        for (int c = 0; c < CPARS; c++) J(r, c) = N(rng);
+        for (int t = 0; t < nFrames; t++)
+            if (std::abs(t - host) <= span)
+                for (int c = 0; c < 8; c++) J(r, CPARS + 8 * t + c) = N(rng);
+    }
+    return J.transpose() * J + MatXX::Identity(n, n);
+}
+
+int main(int argc, char **argv) {
+
+    int failed = 0;
+    std::mt19937 rng(1);
+    BlockCholesky bc;
+
+    for (int nFrames : {1, 2, 7, 10, 20}) {
+        for (int span : {1000, 3, 1, 0}) {
+            MatXX H = RandomSystem(rng, nFrames, span);
+            VecX b = VecX::Random(H.rows());
+
+            Eigen::LDLT<MatXX> ldlt(H);
+            VecX xDense = ldlt.solve(b);
+
+            VecX xBlock = b;
+            bool ok = bc.Compute(H, nFrames);
+            if (ok) bc.SolveInPlace(xBlock);
+            double diff = (xBlock - xDense).norm() / xDense.norm();
+
+            printf("frames %2d span %4d: off-diagonal blocks %3d, rel diff %.2g\n", nFrames, span,
+                   bc.NumOffDiagonalBlocks(), diff);
+            if (!ok || !(diff < 1e-10)) failed++;
+        }
+    }
+
+    // not positive definite: the block solver must refuse, the caller falls back to the LDLT
+    {
+        MatXX H = RandomSystem(rng, 7, 2);
+        H(CPARS + 20, CPARS + 20) = -1e6;
+        bool ok = bc.Compute(H, 7);
+        printf("indefinite system: %s\n", ok ? "accepted" : "rejected");
+        if (ok) failed++;
+    }
+
+    // the whole solver step, once dense and once through the blocks
+    {
+        VecX x[2];
+        for (int useBlocks = 0; useBlocks < 2; useBlocks++) {
+            multiThreading = false;
+            setting_solverBlockMinFrames = useBlocks ? 1 : 0;
+            RandomWindow w(1, 12, 3000);
+            w.SetRandomNullspaces();
+            w.ef->solveSystemF(3, 1e-5, w.Hcalib);
+            x[useBlocks] = w.ef->lastX;
+        }
+        double diff = (x[1] - x[0]).norm() / x[0].norm();
+        printf("solver step, 12 frames: rel diff %.2g\n", diff);
+        if (!(diff < 1e-8)) failed++;
+    }
+
+    printf(failed ? "FAILED\n" : "passed\n");
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,149 @@
+/**
+ * The in-place marginalization against the original one:
+ * - marginalizeFrame against the original algorithm (frame moved to the end through temporaries, whole system scaled
+ *   for the inversion, new prior copied out), on a prior built by marginalizing points, for the first, a middle and
+ *   the last frame of the window, with and without orthogonalizing the prior;
+ * - marginalizePointsF does not depend on the order of the queue nor on the number of threads, up to the rounding of
+ *   the accumulators, which sum in float.
+ */
+
+#include "RandomWindow.h"
+
+#include <algorithm>
+#include <cstdio>
+
+using namespace ldso;
+using namespace ldso::test;
+
+/// the original EnergyFunctional::marginalizeFrame, on copies of HM and bM
+void referenceMarginalizeFrame(MatXX &HM, VecX &bM, int idx, int nFrames, const Vec8 &prior,
+                               const Vec8 &deltaPrior) {
+    int ndim = nFrames * 8 + CPARS - 8;// new dimension
+    int odim = nFrames * 8 + CPARS;// old dimension
+
+    if (idx != nFrames - 1) {
+        int io = idx * 8 + CPARS;    // index of frame to move to end
+        int ntail = 8 * (nFrames - idx - 1);
+
+        Vec8 bTmp = bM.segment<8>(io);
+        VecX tailTMP = bM.tail(ntail);
+        bM.segment(io, ntail) = tailTMP;
+        bM.tail<8>() = bTmp;
+
+        MatXX HtmpCol = HM.block(0, io, odim, 8);
+        MatXX rightColsTmp = HM.rightCols(ntail);
+        HM.block(0, io, odim, ntail) = rightColsTmp;
+        HM.rightCols(8) = HtmpCol;
+
+        MatXX HtmpRow = HM.block(io, 0, 8, odim);
+        MatXX botRowsTmp = HM.bottomRows(ntail);
+        HM.block(io, 0, ntail, odim) = botRowsTmp;
+        HM.bottomRows(8) = HtmpRow;
+    }
+
+    // marginalize. First add prior here, instead of to active.
+    HM.bottomRightCorner<8, 8>().diagonal() += prior;
+    bM.tail<8>() += prior.cwiseProduct(deltaPrior);
+
+    VecX SVec = (HM.diagonal().cwiseAbs() + VecX::Constant(HM.cols(), 10)).cwiseSqrt();
+    VecX SVecI = SVec.cwiseInverse();
+
+    // scale!
+    MatXX HMScaled = SVecI.asDiagonal() * HM * SVecI.asDiagonal();
+    VecX bMScaled = SVecI.asDiagonal() * bM;
+
+    // invert bottom part!
+    Mat88 hpi = HMScaled.bottomRightCorner<8, 8>();
+    hpi = 0.5f * (hpi + hpi);
+    hpi = hpi.inverse();
+    hpi = 0.5f * (hpi + hpi);
+
+    // schur-complement!
+    MatXX bli = HMScaled.bottomLeftCorner(8, ndim).transpose() * hpi;
+    HMScaled.topLeftCorner(ndim, ndim).noalias() -= bli * HMScaled.bottomLeftCorner(8, ndim);
+    bMScaled.head(ndim).noalias() -= bli * bMScaled.tail<8>();
+
+    // unscale!
+    HMScaled = SVec.asDiagonal() * HMScaled * SVec.asDiagonal();
+    bMScaled = SVec.asDiagonal() * bMScaled;
+
+    // set.
+    HM = 0.5 * (HMScaled.topLeftCorner(ndim, ndim) + HMScaled.topLeftCorner(ndim, ndim).transpose());
+    bM = bMScaled.head(ndim);
+}
+
+/// flag every third point as marginalized and queue them, in reverse if asked
+void margPoints(RandomWindow &w, bool reverse) {
+    vector<shared_ptr<PointHessian>> marg;
+    for (size_t i = 0; i < w.points.size(); i += 3) {
+        w.points[i]->point->status = Point::PointStatus::MARGINALIZED;
+        marg.push_back(w.points[i]);
+    }
+    if (reverse)
+        std::reverse(marg.begin(), marg.end());
+    for (auto &p : marg)
+        w.ef->queuePointForMarg(p);
+    w.ef->marginalizePointsF();
+}
+
+double relDiff(const MatXX &a, const MatXX &b) {
+    return (a - b).norm() / b.norm();
+}
+
+int main(int argc, char **argv) {
+
+    const int nFrames = 8, nPoints = 2000;
+    const int solverMode = setting_solverMode;
+    int failed = 0;
+
+    // points: serial in queue order against parallel in reverse order
+    {
+        multiThreading = false;
+        RandomWindow serial(1, nFrames, nPoints);
+        margPoints(serial, false);
+        multiThreading = true;
+        RandomWindow parallel(4, nFrames, nPoints);
+        margPoints(parallel, true);
+        multiThreading = false;
+
+        double dH = relDiff(parallel.ef->HM, serial.ef->HM), db = relDiff(parallel.ef->bM, serial.ef->bM);
+        printf("points: %d residuals marginalized, parallel reversed vs serial: HM %.2g bM %.2g\n",
+               serial.ef->resInM, dH, db);
+        if (serial.ef->resInM == 0 || serial.ef->resInM != parallel.ef->resInM || !(dH < 1e-5) || !(db < 1e-5))
+            failed++;
+    }
+
+    // frames
+    for (int orthogonalize = 0; orthogonalize < 2; orthogonalize++) {
+        for (int margIdx : {0, nFrames / 2, nFrames - 1}) {
+            setting_solverMode = orthogonalize ? solverMode | SOLVER_ORTHOGONALIZE_FULL : solverMode;
+            RandomWindow w(1, nFrames, nPoints);
+            w.SetRandomNullspaces();
+            for (auto &f : w.frames)
+                for (int i = 0; i < 8; i++) {
+                    f->prior[i] = 1e4 * (i + 1);
+                    f->delta_prior[i] = 1e-3 * w.U();
+                }
+            margPoints(w, false);
+
+            shared_ptr<FrameHessian> fh = w.frames[margIdx];
+            MatXX HM = w.ef->HM;
+            VecX bM = w.ef->bM;
+            referenceMarginalizeFrame(HM, bM, fh->idx, w.ef->nFrames, fh->prior, fh->delta_prior);
+
+            w.ef->marginalizeFrame(fh);
+
+            bool sizes = w.ef->HM.rows() == HM.rows() && w.ef->HM.cols() == HM.cols() && w.ef->bM.size() == bM.size();
+            double dH = sizes ? relDiff(w.ef->HM, HM) : 1, db = sizes ? relDiff(w.ef->bM, bM) : 1;
+            bool symmetric = sizes && w.ef->HM == MatXX(w.ef->HM.transpose());
+            printf("frame %d of %d, orthogonalize %d: HM %.2g bM %.2g, %s\n", margIdx, nFrames, orthogonalize, dH, db,
+                   symmetric ? "symmetric" : "NOT SYMMETRIC");
+            if (!(dH < 1e-10) || !(db < 1e-10) || !symmetric || w.ef->nFrames != nFrames - 1)
+                failed++;
+        }
+    }
+    setting_solverMode = solverMode;
+
+    printf(failed ? "FAILED\n" : "passed\n");
+    return failed ? 1 : 0;
+}
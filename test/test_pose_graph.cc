@@ -0,0 +1,116 @@
+/**
+ * The pose graph kept between the runs against the optimization of the whole graph, on a small loop: keyframes on a
+ * circle, each related to the two before it by noisy relative poses, the odometry moving the poses of the window
+ * between the runs, and a loop constraint near the end. The runs after the loop closure relinearize only the newest
+ * keyframes. After every run the poses of the incremental map have to be the ones of a copy optimized as a whole
+ * (lastOptimizeAllKFs) within the tolerance.
+ */
+
+#include "Map.h"
+
+#include <cstdio>
+#include <random>
+#include <thread>
+
+using namespace ldso;
+
+const int numKFs = 16;
+const int windowSize = 3;       // keyframes the odometry still moves
+const int loopKF = 12;          // relates to the first keyframe
+const double tolerance = 5e-3;  // of the positions, the circle has a radius of 2
+
+typedef vector<Sim3, Eigen::aligned_allocator<Sim3>> VecSim3;
+
+/// noisy relative poses and odometry moves, drawn once so both copies get the same ones
+struct Measurements {
+    VecSim3 truth;                  // Scw
+    VecSim3 odometry;               // pose of keyframe k relative to k-1 as the odometry estimated it
+    VecSim3 windowMove;             // change of the world frame of the window before run k
+    VecSim3 rel1, rel2;             // keyframe k relative to k-1 and k-2
+    Sim3 loop;                      // loopKF relative to the first
+
+    Measurements() {
+        std::mt19937 rng(3);
+        std::normal_distribution<double> noise(0, 1e-3);
+        auto noisy = [&](const Sim3 &T) {
+            Vec7 d;
+            for (int i = 0; i < 7; i++) d[i] = noise(rng);
+            return Sim3::exp(d) * T;
+        };
+
+        for (int k = 0; k < numKFs; k++) {
+            double a = 2 * M_PI * k / loopKF;
+            SE3 Twc(SO3::exp(Vec3(0, -a, 0)), Vec3(2 * sin(a), 0, 2 - 2 * cos(a)));
+            truth.push_back(Sim3(Twc.inverse().matrix()));
+        }
+        for (int k = 0; k < numKFs; k++) {
+            auto relative = [&](int r) { return truth[k] * truth[r].inverse(); };
+            odometry.push_back(k > 0 ? noisy(relative(k - 1)) : Sim3());
+            rel1.push_back(k > 0 ? noisy(relative(k - 1)) : Sim3());
+            rel2.push_back(k > 1 ? noisy(relative(k - 2)) : Sim3());
+            Vec7 d = Vec7::Zero();
+            d.head<3>() = Vec3(noise(rng), noise(rng), noise(rng)) * 20;
+            windowMove.push_back(Sim3::exp(d));
+        }
+        loop = noisy(truth[loopKF] * truth[0].inverse());
+    }
+};
+
+/// one copy of the keyframes with its map
+struct Sequence {
+    Map map;
+    vector<shared_ptr<Frame>> kfs;
+
+    Sequence() : map(nullptr) {}
+
+    /// add keyframe k the way the odometry does, after moving the window
+    void AddKeyFrame(const Measurements &m, int k) {
+        shared_ptr<Frame> kf(new Frame(k * 0.1));
+        kf->kfId = k;
+        kf->setPoseOpti(k > 0 ? m.odometry[k] * kfs[k - 1]->getPoseOpti() : m.truth[0]);
+        kfs.push_back(kf);
+
+        for (int i = max(0, k - windowSize + 1); i <= k; i++)
+            kfs[i]->setPoseOpti(kfs[i]->getPoseOpti() * m.windowMove[k]);
+
+        unique_lock<mutex> lock(kf->mutexPoseRel);
+        if (k > 0) kf->poseRel[kfs[k - 1]] = Frame::RELPOSE(m.rel1[k]);
+        if (k > 1) kf->poseRel[kfs[k - 2]] = Frame::RELPOSE(m.rel2[k]);
+        if (k == loopKF) kf->poseRel[kfs[0]] = Frame::RELPOSE(m.loop, Mat77::Identity(), true);
+        lock.unlock();
+
+        map.AddKeyFrame(kf);
+    }
+};
+
+int main(int argc, char **argv) {
+
+    Measurements m;
+    Sequence incremental, batch;
+    int failed = 0;
+
+    for (int k = 0; k < numKFs; k++) {
+        incremental.AddKeyFrame(m, k);
+        batch.AddKeyFrame(m, k);
+        if (k == 0)
+            continue;
+
+        incremental.map.OptimizeALLKFs();
+        while (!incremental.map.Idle())
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        batch.map.lastOptimizeAllKFs();
+
+        double maxError = 0;
+        for (int i = 0; i <= k; i++) {
+            Vec3 p1 = incremental.kfs[i]->getPoseOpti().inverse().translation();
+            Vec3 p2 = batch.kfs[i]->getPoseOpti().inverse().translation();
+            maxError = max(maxError, (p1 - p2).norm());
+        }
+        printf("%2d keyframes%s: incremental against the whole graph %.6f\n", k + 1, k >= loopKF ? ", loop" : "",
+               maxError);
+        if (!(maxError < tolerance)) failed++;
+    }
+
+    printf(failed ? "FAILED\n" : "passed\n");
+    return failed ? 1 : 0;
+}
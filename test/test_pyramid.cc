@@ -0,0 +1,127 @@
+/**
+ * FrameHessian::makeImages against a scalar reference of the pyramid and the gradients (the original single pass
+ * implementation). The row kernels, wide or scalar, compute in the reference order, so the images have to be equal
+ * bit for bit, serial and band-parallel, with and without the gamma weighting. The parallel runs split the bands
+ * into a few ranges and into ranges of one band, so every kind of range boundary is hit.
+ * Like the kernels, this file has to be compiled without fp contraction (see test/CMakeLists.txt).
+ */
+
+#include "internal/FrameHessian.h"
+#include "internal/GlobalCalib.h"
+#include "internal/CalibHessian.h"
+#include "Camera.h"
+
+#include <cmath>
+#include <cstdio>
+
+using namespace ldso;
+using namespace ldso::internal;
+
+/// the scalar pyramid and gradients, as makeImages computed them in one thread
+void referenceImages(const float *color, vector<vector<Vec3f>> &dIp, vector<vector<float>> &absSquaredGrad,
+                     CalibHessian *HCalib) {
+    dIp.assign(pyrLevelsUsed, vector<Vec3f>());
+    absSquaredGrad.assign(pyrLevelsUsed, vector<float>());
+    for (int lvl = 0; lvl < pyrLevelsUsed; lvl++) {
+        dIp[lvl].assign(wG[lvl] * hG[lvl], Vec3f::Zero());
+        absSquaredGrad[lvl].assign(wG[lvl] * hG[lvl], 0);
+    }
+    for (int i = 0; i < wG[0] * hG[0]; i++)
+        dIp[0][i][0] = color[i];
+
+    for (int lvl = 0; lvl < pyrLevelsUsed; lvl++) {
+        int wl = wG[lvl], hl = hG[lvl];
+        Vec3f *dI_l = dIp[lvl].data();
+        float *dabs_l = absSquaredGrad[lvl].data();
+
+        if (lvl > 0) {
+            int wlm1 = wG[lvl - 1];
+            const Vec3f *dI_lm = dIp[lvl - 1].data();
+            for (int y = 0; y < hl; y++)
+                for (int x = 0; x < wl; x++)
+                    dI_l[x + y * wl][0] = 0.25f * (dI_lm[2 * x + 2 * y * wlm1][0] +
+                                                   dI_lm[2 * x + 1 + 2 * y * wlm1][0] +
+                                                   dI_lm[2 * x + 2 * y * wlm1 + wlm1][0] +
+                                                   dI_lm[2 * x + 1 + 2 * y * wlm1 + wlm1][0]);
+        }
+
+        for (int idx = wl; idx < wl * (hl - 1); idx++) {
+            float dx = 0.5f * (dI_l[idx + 1][0] - dI_l[idx - 1][0]);
+            float dy = 0.5f * (dI_l[idx + wl][0] - dI_l[idx - wl][0]);
+
+            if (std::isnan(dx) || std::fabs(dx) > 255.0) dx = 0;
+            if (std::isnan(dy) || std::fabs(dy) > 255.0) dy = 0;
+
+            dI_l[idx][1] = dx;
+            dI_l[idx][2] = dy;
+            dabs_l[idx] = dx * dx + dy * dy;
+
+            if (HCalib) {
+                float gw = HCalib->getBGradOnly(dI_l[idx][0]);
+                dabs_l[idx] *= gw * gw;
+            }
+        }
+    }
+}
+
+inline bool same(float a, float b) {
+    return a == b || (std::isnan(a) && std::isnan(b));
+}
+
+int main(int argc, char **argv) {
+
+    IndexThreadReduce<Vec10> red3(shared_ptr<ThreadPool>(new ThreadPool(3)));
+    IndexThreadReduce<Vec10> red64(shared_ptr<ThreadPool>(new ThreadPool(64)));
+    IndexThreadReduce<Vec10> *reds[] = {nullptr, &red3, &red64};
+    int failed = 0;
+
+    const int sizes[][2] = {{1280, 1024}, {752, 480}, {1240, 376}};
+    for (auto &size : sizes) {
+        const int w = size[0], h = size[1];
+        Mat33f K;
+        K << 500, 0, w / 2.0f, 0, 500, h / 2.0f, 0, 0, 1;
+        setGlobalCalib(w, h, K);
+
+        // saturated and invalid pixels hit the clamping of the gradients
+        vector<float> color(w * h);
+        for (int i = 0; i < w * h; i++)
+            color[i] = float((i * 2654435761u >> 7) % 25600) / 100.f;
+        color[5000] = NAN;
+        color[7000] = 1e6;
+
+        shared_ptr<Camera> cam(new Camera(500, 500, w / 2, h / 2));
+        cam->CreateCH(cam);
+        shared_ptr<CalibHessian> HCalib = cam->mpCH;
+        for (int i = 0; i < 256; i++)
+            HCalib->B[i] = 255.f * std::pow(i / 255.f, 0.8f);
+
+        const int gammaWeights = setting_gammaWeightsPixelSelect;
+        for (int gamma = 0; gamma < 2; gamma++) {
+            setting_gammaWeightsPixelSelect = gamma;
+            vector<vector<Vec3f>> refI;
+            vector<vector<float>> refAbs;
+            referenceImages(color.data(), refI, refAbs, gamma ? HCalib.get() : nullptr);
+
+            for (IndexThreadReduce<Vec10> *red : reds) {
+                shared_ptr<FrameHessian> fh(new FrameHessian(nullptr));
+                fh->makeImages(color.data(), HCalib, red);
+
+                long mismatches = 0;
+                for (int lvl = 0; lvl < pyrLevelsUsed; lvl++)
+                    for (int i = 0; i < wG[lvl] * hG[lvl]; i++) {
+                        for (int c = 0; c < 3; c++)
+                            if (!same(refI[lvl][i][c], fh->dIp[lvl][i][c])) mismatches++;
+                        if (!same(refAbs[lvl][i], fh->absSquaredGrad[lvl][i])) mismatches++;
+                    }
+
+                printf("%4d x %4d, %d levels, gamma weights %d, %d threads: %ld mismatches\n", w, h, pyrLevelsUsed,
+                       gamma, red ? red->NumSlots() : 1, mismatches);
+                if (mismatches) failed++;
+            }
+        }
+        setting_gammaWeightsPixelSelect = gammaWeights;
+    }
+
+    printf(failed ? "FAILED\n" : "passed\n");
+    return failed ? 1 : 0;
+}
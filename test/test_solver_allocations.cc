@@ -0,0 +1,206 @@
+/**
+ * The solver iterations of a fixed window must not touch the heap: the system, the nullspace projection and the
+ * reductions all live in preallocated buffers (SolverWorkspace, IndexThreadReduce, the ThreadPool deques).
+ * Counts every operator new and, on glibc, every malloc (Eigen allocates through malloc) during the iterations,
+ * first of the backend alone on a random window, then of FullSystem::optimize on a tracked synthetic sequence.
+ */
+
+#include "RandomWindow.h"
+#include "frontend/FullSystem.h"
+#include "frontend/ImageAndExposure.h"
+#include "internal/GlobalCalib.h"
+
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+using namespace ldso;
+using namespace ldso::test;
+
+static long numAllocs = 0;
+static bool countAllocs = false;
+
+#ifdef __GLIBC__
+extern "C" void *__libc_malloc(size_t);
+extern "C" void *__libc_realloc(void *, size_t);
+extern "C" void *__libc_memalign(size_t, size_t);
+
+extern "C" void *malloc(size_t n) {
+    if (countAllocs) numAllocs++;
+    return __libc_malloc(n);
+}
+
+extern "C" void *realloc(void *p, size_t n) {
+    if (countAllocs) numAllocs++;
+    return __libc_realloc(p, n);
+}
+
+extern "C" int posix_memalign(void **p, size_t alignment, size_t n) {
+    if (countAllocs) numAllocs++;
+    *p = __libc_memalign(alignment, n);
+    return *p ? 0 : ENOMEM;
+}
+
+extern "C" void *aligned_alloc(size_t alignment, size_t n) {
+    if (countAllocs) numAllocs++;
+    return __libc_memalign(alignment, n);
+}
+#endif
+
+void *operator new(size_t n) {
+#ifndef __GLIBC__
+    if (countAllocs) numAllocs++;
+#endif
+    void *p = malloc(n ? n : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void *operator new[](size_t n) {
+    return operator new(n);
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+void operator delete[](void *p) noexcept {
+    free(p);
+}
+
+/**
+ * run a few optimize iterations on a window and count the allocations of the later ones
+ * @return allocations per iteration
+ */
+double AllocationsPerIteration(int nThreads, int solverMode) {
+    multiThreading = nThreads > 1;
+    setting_solverMode = solverMode;
+
+    RandomWindow w(nThreads, 7, 2000);
+    w.SetRandomNullspaces();
+
+    // warm up: the first iterations size the buffers and grow the pool deques
+    const int warmup = 3, iterations = 10;
+    for (int it = 0; it < warmup; it++) {
+        w.ef->setDeltaF(w.Hcalib);
+        w.ef->solveSystemF(it, 1e-5, w.Hcalib);
+    }
+
+    numAllocs = 0;
+    countAllocs = true;
+    for (int it = warmup; it < warmup + iterations; it++) {
+        w.ef->setDeltaF(w.Hcalib);
+        w.ef->solveSystemF(it, 1e-5, w.Hcalib);
+        w.ef->calcMEnergyF();
+        w.ef->calcLEnergyF_MT();
+    }
+    countAllocs = false;
+    return double(numAllocs) / iterations;
+}
+
+/// frame i of a camera moving sideways in front of a textured plane at 2m
+ImageAndExposure *PlaneImage(int w, int h, const Mat33f &K, int i) {
+    ImageAndExposure *img = new ImageAndExposure(w, h, 0.05 * i);
+    const float depth = 2, cell = 0.03, tx = 0.02f * i;
+    auto noise = [](int x, int y) { return float((unsigned(x) * 73856093u ^ unsigned(y) * 19349663u) % 1000) / 1000; };
+    for (int v = 0; v < h; v++)
+        for (int u = 0; u < w; u++) {
+            // value noise on the plane, bilinear between the cells
+            float X = (tx + (u - K(0, 2)) / K(0, 0) * depth) / cell, Y = (v - K(1, 2)) / K(1, 1) * depth / cell;
+            int x0 = int(std::floor(X)), y0 = int(std::floor(Y));
+            float fx = X - x0, fy = Y - y0;
+            float n = (1 - fx) * (1 - fy) * noise(x0, y0) + fx * (1 - fy) * noise(x0 + 1, y0) +
+                      (1 - fx) * fy * noise(x0, y0 + 1) + fx * fy * noise(x0 + 1, y0 + 1);
+            img->image[u + v * w] = 40 + 180 * n;
+        }
+    return img;
+}
+
+/**
+ * track the synthetic sequence until the window holds a few keyframes, then count the allocations of
+ * FullSystem::optimize with a short and a long iteration count. The difference is what the extra iterations
+ * allocated, linearizeAll and applyRes_Reductor included; what a call allocates once (the log lines, the step
+ * history) cancels out.
+ * @return allocations per iteration, -1 if the sequence did not initialize
+ */
+double AllocationsPerOptimizeIteration(int nThreads) {
+    multiThreading = nThreads > 1;
+    setting_enableLoopClosing = false;
+    setting_forceAceptStep = true;  // every iteration applies the residuals
+    const int minOptIterations = setting_minOptIterations;
+
+    const int w = 640, h = 480;
+    Mat33f K;
+    K << 400, 0, w / 2.0f, 0, 400, h / 2.0f, 0, 0, 1;
+    shared_ptr<CalibContext> calib(new CalibContext(w, h, K));
+    shared_ptr<FullSystem> fullSystem(
+            new FullSystem(nullptr, calib, shared_ptr<ThreadPool>(new ThreadPool(nThreads))));
+
+    for (int i = 0; i < 100 && fullSystem->GetActiveFrames().size() < 5; i++) {
+        ImageAndExposure *img = PlaneImage(w, h, K, i);
+        fullSystem->addActiveFrame(img, i);
+        delete img;
+        if (fullSystem->initFailed || fullSystem->isLost)
+            break;
+    }
+    fullSystem->blockUntilMappingIsFinished();
+    if (fullSystem->GetActiveFrames().size() < 5 || fullSystem->isLost) {
+        printf("the synthetic sequence did not initialize\n");
+        return -1;
+    }
+
+    // no early break, run exactly the iterations asked for
+    const int shortRun = 2, longRun = 8;
+    setting_minOptIterations = longRun;
+    fullSystem->optimize(longRun);      // warm up
+
+    numAllocs = 0;
+    countAllocs = true;
+    fullSystem->optimize(shortRun);
+    countAllocs = false;
+    long shortAllocs = numAllocs;
+
+    numAllocs = 0;
+    countAllocs = true;
+    fullSystem->optimize(longRun);
+    countAllocs = false;
+    long longAllocs = numAllocs;
+
+    setting_minOptIterations = minOptIterations;
+    return double(longAllocs - shortAllocs) / (longRun - shortRun);
+}
+
+int main(int argc, char **argv) {
+
+    const int defaultMode = setting_solverMode;
+    struct {
+        int threads;
+        int mode;
+        const char *name;
+    } cases[] = {
+            {1, defaultMode,                                 "default"},
+            {4, defaultMode,                                 "default"},
+            {1, defaultMode | SOLVER_ORTHOGONALIZE_SYSTEM,   "orthogonalize system"},
+            {4, defaultMode | SOLVER_ORTHOGONALIZE_SYSTEM,   "orthogonalize system"},
+            {4, defaultMode | SOLVER_ORTHOGONALIZE_X,        "orthogonalize x"},
+    };
+
+    int failed = 0;
+    for (auto &c : cases) {
+        double allocs = AllocationsPerIteration(c.threads, c.mode);
+        printf("%-22s %d threads: %.1f allocations per iteration\n", c.name, c.threads, allocs);
+        if (allocs > 0) failed++;
+    }
+    setting_solverMode = defaultMode;
+
+    for (int threads : {1, 4}) {
+        double allocs = AllocationsPerOptimizeIteration(threads);
+        printf("%-22s %d threads: %.1f allocations per iteration\n", "full optimize", threads, allocs);
+        if (allocs != 0) failed++;
+    }
+
+    printf(failed ? "FAILED\n" : "passed\n");
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,107 @@
+/**
+ * The fused undistortion against its reference paths:
+ * - the 8 bit remap (the AVX2 kernel on cpus that have it) against the scalar kernel, which 16 bit images always use;
+ * - the fused pass against the float two pass undistortion (undistortPhotometric + undistortGeometric).
+ * With no, response only and full photometric calibration. The calibration files are written next to the binary.
+ */
+
+#include "frontend/Undistort.h"
+#include "frontend/ImageRW.h"
+#include "Settings.h"
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <random>
+
+using namespace ldso;
+
+/**
+ * max abs difference of two images, and the number of pixels that differ by more than tol
+ * @param skipBlanked skip the pixels of the bottom two rows that a is blank (0) in: their 2x2 source neighbourhood
+ * leaves the original image, the fused pass blanks them and the float reference reads past the image
+ */
+double maxDiff(const ImageAndExposure &a, const ImageAndExposure &b, float tol, int &numBad, bool skipBlanked) {
+    double maxd = 0;
+    numBad = 0;
+    for (int i = 0; i < a.w * a.h; i++) {
+        if (skipBlanked && a.image[i] == 0 && i / a.w >= a.h - 2) continue;
+        double d = std::fabs(a.image[i] - b.image[i]);
+        if (!(d <= tol)) numBad++;
+        if (d > maxd) maxd = d;
+    }
+    return maxd;
+}
+
+int main(int argc, char **argv) {
+
+    const int wOrg = 752, hOrg = 480;
+    const std::string calibFile = "test_undistort_camera.txt";
+    const std::string gammaFile = "test_undistort_pcalib.txt";
+    const std::string vignetteFile = "test_undistort_vignette.png";
+
+    {
+        std::ofstream f(calibFile);
+        f << "RadTan 0.6099122 0.95061667 0.4883178 0.51722791 -0.28340811 0.07395907 0.00019359 1.76187114e-05\n"
+          << wOrg << " " << hOrg << "\n0.6 0.9 0.5 0.5 0\n640 480\n";
+    }
+    {
+        std::ofstream f(gammaFile);
+        for (int i = 0; i < 256; i++) f << 255.0 * std::pow(i / 255.0, 1.3) + 0.1 * i << " ";
+        f << "\n";
+    }
+    {
+        MinimalImageB vignette(wOrg, hOrg);
+        for (int y = 0; y < hOrg; y++)
+            for (int x = 0; x < wOrg; x++) {
+                double r2 = (std::pow(x - wOrg / 2.0, 2) + std::pow(y - hOrg / 2.0, 2)) / (wOrg * wOrg / 4.0);
+                vignette.at(x, y) = (unsigned char) (255 * (1 - 0.4 * r2));
+            }
+        IOWrap::writeImage(vignetteFile, &vignette);
+    }
+
+    Undistort *undistort = Undistort::getUndistorterForFile(calibFile, gammaFile, vignetteFile);
+    if (!undistort || !undistort->photometricUndist->getG()) {
+        printf("could not set up the undistortion\nFAILED\n");
+        return 1;
+    }
+    const int w = undistort->getSize()[0], h = undistort->getSize()[1];
+
+    std::mt19937 rng(3);
+    MinimalImageB raw(wOrg, hOrg);
+    MinimalImage<unsigned short> raw16(wOrg, hOrg);
+    for (int i = 0; i < wOrg * hOrg; i++)
+        raw16.data[i] = raw.data[i] = (unsigned char) (rng() & 255);
+
+    int failed = 0;
+    const int photometricCalibration = setting_photometricCalibration;
+    for (int mode = 0; mode < 3; mode++) {
+        // mode 0: no calibration (linear with factor), 1: response only, 2: response and vignette
+        setting_photometricCalibration = mode == 0 ? photometricCalibration : mode;
+        float exposure = mode == 0 ? 0 : 2.0f;
+        float factor = 0.8f;
+
+        ImageAndExposure fused(w, h), fused16(w, h), reference(w, h), photo(wOrg, hOrg);
+        undistort->undistort<unsigned char>(&raw, &fused, exposure, 1.5, factor);
+        undistort->undistort<unsigned short>(&raw16, &fused16, exposure, 1.5, factor);
+        undistort->undistortPhotometric<unsigned char>(&raw, &photo, exposure, factor);
+        undistort->undistortGeometric(&photo, &reference, 1.5);
+
+        // the wide kernel only differs from the scalar one in the rounding of the fused multiply adds
+        int badKernel, badReference;
+        double dKernel = maxDiff(fused, fused16, 1e-3f, badKernel, false);
+        // the fused pass rounds the bilinear weights to 1/32768
+        double dReference = maxDiff(fused, reference, 0.05f, badReference, true);
+
+        printf("photometric mode %d: wide vs scalar kernel max diff %.2g, fused vs reference max diff %.2g (%d bad)\n",
+               mode, dKernel, dReference, badReference);
+        if (badKernel || badReference || fused.timestamp != reference.timestamp ||
+            fused.exposure_time != reference.exposure_time)
+            failed++;
+    }
+    setting_photometricCalibration = photometricCalibration;
+    delete undistort;
+
+    printf(failed ? "FAILED\n" : "passed\n");
+    return failed ? 1 : 0;
+}
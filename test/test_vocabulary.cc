@@ -0,0 +1,140 @@
+/**
+ * FlatVocabulary::Transform against the DBoW3 transform it replaces: on a vocabulary trained by DBoW3, the bag of
+ * words and the feature vectors of random frames have to be the same, for all the levelsup, with the accumulating and
+ * the binary weightings and with and without normalization; also through a saved and mapped vocabulary file.
+ * A feature whose word lies above the level of the feature vector is left out of the feature vectors: DBoW3 does not
+ * set its node (it keeps the one of the feature before), the flat transform stores the node of the word.
+ */
+
+#include "FlatVocabulary.h"
+
+#include <cstdio>
+#include <random>
+
+using namespace ldso;
+
+/// n descriptors near a few random centers, one per row
+cv::Mat randomDescriptors(std::mt19937 &rng, const vector<cv::Mat> &centers, int n) {
+    cv::Mat descs(n, 32, CV_8U);
+    for (int i = 0; i < n; i++) {
+        const unsigned char *c = centers[rng() % centers.size()].ptr<unsigned char>(0);
+        unsigned char *d = descs.ptr<unsigned char>(i);
+        for (int b = 0; b < 32; b++)
+            d[b] = c[b] ^ (unsigned char) (rng() & rng() & rng());   // flips about one bit in eight
+    }
+    return descs;
+}
+
+/// depth of the word of each feature, the root is at 0
+vector<int> wordDepths(const ORBVocabulary &voc, const vector<cv::Mat> &features) {
+    vector<int> depths;
+    for (auto &f : features) {
+        DBoW3::WordId word = voc.DBoW3::Vocabulary::transform(f);
+        int depth = 0;
+        while (voc.getParentNode(word, depth) != 0)
+            depth++;
+        depths.push_back(depth);
+    }
+    return depths;
+}
+
+/// fv without the features whose word is above nodeLevel
+DBoW3::FeatureVector reachingLevel(const DBoW3::FeatureVector &fv, const vector<int> &depths, int nodeLevel) {
+    DBoW3::FeatureVector r;
+    for (auto &node : fv)
+        for (unsigned int i : node.second)
+            if (depths[i] >= nodeLevel)
+                r.addFeature(node.first, i);
+    return r;
+}
+
+int main(int argc, char **argv) {
+
+    std::mt19937 rng(3);
+    vector<cv::Mat> centers;
+    for (int c = 0; c < 40; c++) {
+        cv::Mat center(1, 32, CV_8U);
+        for (int b = 0; b < 32; b++) center.at<unsigned char>(0, b) = (unsigned char) rng();
+        centers.push_back(center);
+    }
+
+    vector<cv::Mat> training;
+    for (int image = 0; image < 30; image++)
+        training.push_back(randomDescriptors(rng, centers, 100));
+
+    // a frame, packed like FeatureTable::descriptors, and a permutation of it
+    const int n = 500;
+    cv::Mat frame = randomDescriptors(rng, centers, n);
+    vector<cv::Mat> features, permuted;
+    vector<int> index(n);
+    for (int i = 0; i < n; i++) {
+        index[i] = (i * 7) % n;
+        features.push_back(frame.row(i));
+        permuted.push_back(frame.row(index[i]));
+    }
+
+    int failed = 0;
+    const DBoW3::WeightingType weightings[] = {DBoW3::TF_IDF, DBoW3::BINARY};
+    const DBoW3::ScoringType scorings[] = {DBoW3::L1_NORM, DBoW3::L2_NORM, DBoW3::DOT_PRODUCT};   // L1, L2, no normalization
+    for (auto weighting : weightings) {
+        // a small tree: 6 children per node, 3 levels. DBoW3 declares setWeightingType inline but defines it in
+        // Vocabulary.cpp, so it cannot be called from here: train a vocabulary for each weighting instead
+        shared_ptr<ORBVocabulary> voc(new ORBVocabulary(6, 3, weighting, DBoW3::L1_NORM));
+        voc->create(training);
+        printf("weighting %d: vocabulary of %u words\n", weighting, voc->size());
+        vector<int> depths = wordDepths(*voc, features), permutedDepths = wordDepths(*voc, permuted);
+
+        for (auto scoring : scorings) {
+            voc->setScoringType(scoring);
+            FlatVocabulary flat(*voc);
+
+            const string file = "test_vocabulary.flat";
+            shared_ptr<ORBVocabulary> mapped;
+            if (flat.Save(file))
+                mapped = FlatVocabulary::LoadORBVocabulary(file);
+            if (!flat.Valid() || !mapped || mapped->size() != voc->size()) {
+                printf("weighting %d scoring %d: could not flatten, save or map the vocabulary\n", weighting, scoring);
+                failed++;
+                continue;
+            }
+
+            for (int levelsup = 0; levelsup <= 3; levelsup++) {
+                DBoW3::BowVector bow, bowFlat, bowPermuted, bowMapped;
+                DBoW3::FeatureVector feat, featFlat, featPermuted, featMapped;
+                voc->DBoW3::Vocabulary::transform(features, bow, feat, levelsup);
+                flat.Transform(frame.ptr<unsigned char>(0), nullptr, n, bowFlat, featFlat, levelsup);
+                mapped->transform(features, bowMapped, featMapped, levelsup);
+
+                DBoW3::BowVector bowRef;
+                DBoW3::FeatureVector featRef;
+                voc->DBoW3::Vocabulary::transform(permuted, bowRef, featRef, levelsup);
+                flat.Transform(frame.ptr<unsigned char>(0), index.data(), n, bowPermuted, featPermuted, levelsup);
+
+                const int nodeLevel = voc->getDepthLevels() - levelsup;
+                feat = reachingLevel(feat, depths, nodeLevel);
+                featFlat = reachingLevel(featFlat, depths, nodeLevel);
+                featMapped = reachingLevel(featMapped, depths, nodeLevel);
+                featRef = reachingLevel(featRef, permutedDepths, nodeLevel);
+                featPermuted = reachingLevel(featPermuted, permutedDepths, nodeLevel);
+
+                bool same = bow == bowFlat && feat == featFlat && bow == bowMapped && feat == featMapped &&
+                            bowRef == bowPermuted && featRef == featPermuted;
+                printf("weighting %d scoring %d levelsup %d: %zu words, %zu nodes, %s\n", weighting, scoring,
+                       levelsup, bow.size(), feat.size(), same ? "same" : "DIFFERENT");
+                if (!same) failed++;
+            }
+
+            int wordMismatches = 0;
+            for (int i = 0; i < n; i++)
+                if (voc->DBoW3::Vocabulary::transform(features[i]) != flat.Word(frame.ptr<unsigned char>(i)))
+                    wordMismatches++;
+            if (wordMismatches) {
+                printf("weighting %d scoring %d: %d single word mismatches\n", weighting, scoring, wordMismatches);
+                failed++;
+            }
+        }
+    }
+
+    printf(failed ? "FAILED\n" : "passed\n");
+    return failed ? 1 : 0;
+}
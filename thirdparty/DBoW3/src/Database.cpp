@@ -23,6 +23,15 @@ Database::Database
 
 // --------------------------------------------------------------------------
 
+Database::Database
+  (std::shared_ptr<Vocabulary> voc, bool use_di, int di_levels)
+  : m_voc(voc.get()), m_sharedVoc(voc), m_use_di(use_di), m_dilevels(di_levels)
+{
+  clear();
+}
+
+// --------------------------------------------------------------------------
+
 
 Database::Database
   (const Database &db)
@@ -56,7 +65,7 @@ Database::Database
 
 Database::~Database(void)
 {
-  delete m_voc;
+  if (!m_sharedVoc) delete m_voc;
 }
 
 // --------------------------------------------------------------------------
@@ -161,7 +170,8 @@ EntryId Database::add(const BowVector &v,
   void Database::setVocabulary
   (const Vocabulary& voc)
 {
-  delete m_voc;
+  if (!m_sharedVoc) delete m_voc;
+  m_sharedVoc.reset();
   m_voc = new Vocabulary(voc);
   clear();
 }
@@ -174,7 +184,8 @@ EntryId Database::add(const BowVector &v,
 {
   m_use_di = use_di;
   m_dilevels = di_levels;
-  delete m_voc;
+  if (!m_sharedVoc) delete m_voc;
+  m_sharedVoc.reset();
   m_voc = new Vocabulary(voc);
   clear();
 }
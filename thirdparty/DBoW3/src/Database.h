@@ -17,6 +17,7 @@
 #include <string>
 #include <list>
 #include <set>
+#include <memory>
 
 #include "Vocabulary.h"
 #include "QueryResults.h"
@@ -55,6 +56,17 @@ public:
   explicit Database(const Vocabulary &voc, bool use_di = true,
     int di_levels = 0);
 
+  /**
+   * Creates a database that uses the given vocabulary without copying it,
+   * so several databases can share one vocabulary
+   * @param voc vocabulary, must not be changed while the database uses it
+   * @param use_di a direct index is used to store feature indexes
+   * @param di_levels levels to go up the vocabulary tree to select the
+   *   node id to store in the direct index when adding images
+   */
+  explicit Database(std::shared_ptr<Vocabulary> voc, bool use_di = true,
+    int di_levels = 0);
+
   /**
    * Copy constructor. Copies the vocabulary too
    * @param db object to copy
@@ -328,6 +340,9 @@ protected:
 
   /// Associated vocabulary
   Vocabulary *m_voc;
+
+  /// Owner of m_voc if it is shared with others, m_voc is not deleted then
+  std::shared_ptr<Vocabulary> m_sharedVoc;
   
   /// Flag to use direct index
   bool m_use_di;
@@ -213,6 +213,36 @@ public:
    */
   virtual inline WordValue getWordWeight(WordId wid) const;
   
+  /**
+   * Returns the number of nodes of the tree, node 0 is the root
+   */
+  inline unsigned int getNumNodes() const { return (unsigned int)m_nodes.size(); }
+
+  /**
+   * Returns the children of a node, in the order transform visits them
+   * @param nid node id
+   */
+  inline const std::vector<NodeId> &getNodeChildren(NodeId nid) const { return m_nodes[nid].children; }
+
+  /**
+   * Returns the descriptor of a node (empty for the root)
+   * @param nid node id
+   */
+  inline const cv::Mat &getNodeDescriptor(NodeId nid) const { return m_nodes[nid].descriptor; }
+
+  /**
+   * Returns the word id and the weight of a leaf node
+   * @param nid node id
+   */
+  inline WordId getNodeWordId(NodeId nid) const { return m_nodes[nid].word_id; }
+  inline WordValue getNodeWeight(NodeId nid) const { return m_nodes[nid].weight; }
+
+  /**
+   * Returns whether the scoring needs normalized bow vectors, and with which norm
+   * @param norm (out) norm to use
+   */
+  inline bool mustNormalize(LNorm &norm) const { return m_scoring_object->mustNormalize(norm); }
+
   /** 
    * Returns the weighting method
    * @return weighting method